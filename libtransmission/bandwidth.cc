@@ -7,6 +7,7 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <initializer_list>
 #include <limits>
 #include <memory>
@@ -65,7 +66,7 @@ void tr_bandwidth::notify_bandwidth_consumed_bytes(uint64_t const now, RateContr
 {
     if (r.date_[r.newest_] + GranularityMSec >= now)
     {
-        r.size_[r.newest_] += size;
+        r.size_[r.newest_] += static_cast<uint32_t>(size);
     }
     else
     {
@@ -75,7 +76,7 @@ void tr_bandwidth::notify_bandwidth_consumed_bytes(uint64_t const now, RateContr
         }
 
         r.date_[r.newest_] = now;
-        r.size_[r.newest_] = size;
+        r.size_[r.newest_] = static_cast<uint32_t>(size);
     }
 
     /* invalidate cache_val*/
@@ -143,6 +144,19 @@ void tr_bandwidth::set_parent(tr_bandwidth* new_parent)
 
 // ---
 
+void tr_bandwidth::for_each_peer(std::function<void(tr_peerIo&)> const& func) const
+{
+    if (auto const shared = peer_.lock(); shared)
+    {
+        func(*shared);
+    }
+
+    for (auto const* const child : children_)
+    {
+        child->for_each_peer(func);
+    }
+}
+
 void tr_bandwidth::allocate_bandwidth(
     tr_priority_t parent_priority,
     uint64_t period_msec,
@@ -194,12 +208,17 @@ void tr_bandwidth::phase_one(std::vector<tr_peerIo*>& peers, tr_direction dir)
             // Value of 3000 bytes chosen so that when using µTP we'll send a full-size
             // frame right away and leave enough buffered data for the next frame to go
             // out in a timely manner.
-            static auto constexpr Increment = 3000U;
+            static auto constexpr Increment = size_t{ 3000U };
+
+            // LAN peers aren't sharing a slow link with anyone, so
+            // they can move a lot more per pass.
+            static auto constexpr LanIncrement = size_t{ 64U * 1024U };
 
-            auto const bytes_used = peers[i]->flush(dir, Increment);
+            auto const increment = peers[i]->is_lan() ? LanIncrement : Increment;
+            auto const bytes_used = peers[i]->flush(dir, increment);
             tr_logAddTrace(fmt::format("peer #{} of {} used {} bytes in this pass", i, n_unfinished, bytes_used));
 
-            if (bytes_used != Increment)
+            if (bytes_used != increment)
             {
                 // peer is done writing for now; move it to the end of the list
                 std::swap(peers[i], peers[n_unfinished - 1]);
@@ -293,12 +312,22 @@ size_t tr_bandwidth::clamp(tr_direction const dir, size_t byte_count) const noex
 }
 
 void tr_bandwidth::notify_bandwidth_consumed(tr_direction dir, size_t byte_count, bool is_piece_data, uint64_t now)
+{
+    notify_bandwidth_consumed(dir, byte_count, is_piece_data, true, now);
+}
+
+void tr_bandwidth::notify_bandwidth_consumed(
+    tr_direction dir,
+    size_t byte_count,
+    bool is_piece_data,
+    bool uses_quota,
+    uint64_t now)
 {
     TR_ASSERT(tr_isDirection(dir));
 
     auto& band = band_[dir];
 
-    if (band.is_limited_ && is_piece_data)
+    if (band.is_limited_ && is_piece_data && uses_quota)
     {
         band.bytes_left_ -= std::min(band.bytes_left_, byte_count);
     }
@@ -310,9 +339,11 @@ void tr_bandwidth::notify_bandwidth_consumed(tr_direction dir, size_t byte_count
         notify_bandwidth_consumed_bytes(now, band.piece_, byte_count);
     }
 
+    // Bytes always count towards the parents' speeds, but if we
+    // ignored their limits, they don't use up their quotas either.
     if (parent_ != nullptr)
     {
-        parent_->notify_bandwidth_consumed(dir, byte_count, is_piece_data, now);
+        parent_->notify_bandwidth_consumed(dir, byte_count, is_piece_data, uses_quota && band.honor_parent_limits_, now);
     }
 }
 
@@ -12,6 +12,7 @@
 #include <array>
 #include <cstddef> // size_t
 #include <cstdint> // uint64_t
+#include <functional>
 #include <memory>
 #include <utility> // for std::move()
 #include <vector>
@@ -110,6 +111,11 @@ public:
         peer_ = std::move(peer);
     }
 
+    /**
+     * @brief Call `func` on the peer of this bandwidth and of every bandwidth below it.
+     */
+    void for_each_peer(std::function<void(tr_peerIo&)> const& func) const;
+
     /**
      * @brief Notify the bandwidth object that some of its allocated bandwidth has been consumed.
      * This is is usually invoked by the peer-io after a read or write.
@@ -212,6 +218,10 @@ public:
      * (for example) a peer is constrained by a per-torrent cap and the global cap.
      * But when we set a torrent's speed mode to `TR_SPEEDLIMIT_UNLIMITED`, then
      * in that particular case we want to ignore the global speed limit...
+     *
+     * A bandwidth that ignores its parents' limits also doesn't use up their
+     * quotas, so it can't starve the peers that do honor them. Its bytes still
+     * count towards the parents' speeds.
      */
     constexpr bool honor_parent_limits(tr_direction direction, bool is_enabled)
     {
@@ -231,10 +241,12 @@ public:
     void set_limits(tr_bandwidth_limits const& limits);
 
 private:
+    // Every peer has one of these per direction, so keep it compact:
+    // no granule of GranularityMSec will ever see 4 GiB.
     struct RateControl
     {
         std::array<uint64_t, HistorySize> date_;
-        std::array<size_t, HistorySize> size_;
+        std::array<uint32_t, HistorySize> size_;
         uint64_t cache_time_;
         Speed cache_val_;
         int newest_;
@@ -261,6 +273,8 @@ private:
 
     static void notify_bandwidth_consumed_bytes(uint64_t now, RateControl& r, size_t size);
 
+    void notify_bandwidth_consumed(tr_direction dir, size_t byte_count, bool is_piece_data, bool uses_quota, uint64_t now);
+
     static void phase_one(std::vector<tr_peerIo*>& peers, tr_direction dir);
 
     void allocate_bandwidth(
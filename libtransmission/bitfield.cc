@@ -6,6 +6,8 @@
 #include <algorithm> // std::copy, std::fill_n, std::min, std::max
 #include <cstddef>
 #include <cstdint>
+#include <cstring> // std::memcpy
+#include <optional>
 #include <vector> // std::vector
 
 #include "libtransmission/bitfield.h"
@@ -52,15 +54,60 @@ void setAllTrue(uint8_t* array, size_t bit_count)
 /* Switch to std::popcount if project upgrades to c++20 or newer */
 [[nodiscard]] uint32_t doPopcount(uint8_t flags) noexcept
 {
-    /* If flags are ever expanded to use machine words instead of
-       uint8_t popcnt64 is also available */
     return tr_popcnt<uint8_t>::count(flags);
 }
 
+// Bulk operations work on 64-bit words instead of single bytes.
+// The compiler is free to vectorize the word loops further.
+using Word = uint64_t;
+auto constexpr WordBytes = sizeof(Word);
+
+[[nodiscard]] Word load_native(uint8_t const* bytes) noexcept
+{
+    auto word = Word{};
+    std::memcpy(&word, bytes, sizeof(word));
+    return word;
+}
+
+void store_native(uint8_t* bytes, Word word) noexcept
+{
+    std::memcpy(bytes, &word, sizeof(word));
+}
+
+// Load up to 8 bytes as a word whose most significant bit is the
+// first flag, so that the word's bit order matches BEP0003's.
+[[nodiscard]] Word load_ordered(uint8_t const* bytes, size_t n_bytes) noexcept
+{
+    auto word = Word{};
+
+    if (n_bytes >= WordBytes)
+    {
+        // compilers turn this into a single load and byte swap
+        for (size_t i = 0; i < WordBytes; ++i)
+        {
+            word = (word << 8U) | bytes[i];
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < WordBytes; ++i)
+        {
+            word = (word << 8U) | (i < n_bytes ? bytes[i] : 0U);
+        }
+    }
+
+    return word;
+}
+
 [[nodiscard]] size_t rawCountFlags(uint8_t const* flags, size_t n) noexcept
 {
     auto ret = size_t{};
 
+    for (; n >= WordBytes; flags += WordBytes, n -= WordBytes)
+    {
+        ret += tr_popcnt<Word>::count(load_native(flags));
+    }
+
     for (auto const* const end = flags + n; flags != end; ++flags)
     {
         ret += doPopcount(*flags);
@@ -69,6 +116,30 @@ void setAllTrue(uint8_t* array, size_t bit_count)
     return ret;
 }
 
+// Set `dst[i] = op(dst[i], src[i])` for `n` bytes.
+// Returns the number of flags set in the result.
+template<typename Op>
+size_t transformFlags(uint8_t* dst, uint8_t const* src, size_t n, Op op) noexcept
+{
+    auto ret = size_t{};
+    auto i = size_t{};
+
+    for (; i + WordBytes <= n; i += WordBytes)
+    {
+        auto const word = op(load_native(dst + i), load_native(src + i));
+        store_native(dst + i, word);
+        ret += tr_popcnt<Word>::count(word);
+    }
+
+    for (; i < n; ++i)
+    {
+        dst[i] = static_cast<uint8_t>(op(Word{ dst[i] }, Word{ src[i] }));
+        ret += doPopcount(dst[i]);
+    }
+
+    return ret;
+}
+
 } // namespace
 
 // ---
@@ -80,77 +151,35 @@ size_t tr_bitfield::count_flags() const noexcept
 
 size_t tr_bitfield::count_flags(size_t begin, size_t end) const noexcept
 {
-    auto ret = size_t{};
-    size_t const first_byte = begin >> 3U;
-    size_t const last_byte = (end - 1) >> 3U;
-
     if (bit_count_ == 0)
     {
         return 0;
     }
 
-    if (first_byte >= std::size(flags_))
+    end = std::min(end, std::size(flags_) * 8U);
+    if (begin >= end)
     {
         return 0;
     }
 
-    TR_ASSERT(begin < end);
-    TR_ASSERT(!std::empty(flags_));
+    auto const first_byte = begin >> 3U;
+    auto const last_byte = (end - 1U) >> 3U;
+    auto const first_mask = static_cast<uint8_t>(0xFFU >> (begin & 7U));
+    auto const last_mask = static_cast<uint8_t>(0xFFU << (7U - ((end - 1U) & 7U)));
 
+    auto ret = size_t{};
     if (first_byte == last_byte)
     {
-        uint8_t val = flags_[first_byte];
-
-        auto i = begin & 7U;
-        val <<= i;
-        i = (begin - end) & 7U;
-        val >>= i;
-        ret = doPopcount(val);
+        ret = doPopcount(static_cast<uint8_t>(flags_[first_byte] & first_mask & last_mask));
     }
     else
     {
-        size_t const walk_end = std::min(std::size(flags_), last_byte);
-
-        /* first byte */
-        size_t const first_shift = begin & 7U;
-        uint8_t val = flags_[first_byte];
-        val <<= first_shift;
-        /* No need to shift back val for correct popcount. */
-        ret = doPopcount(val);
-
-        /* middle bytes */
-
-        /* Use 2x accumulators to help alleviate high latency of
-           popcnt instruction on many architectures. */
-        size_t tmp_accum = 0;
-        for (size_t i = first_byte + 1; i < walk_end;)
-        {
-            tmp_accum += doPopcount(flags_[i]);
-            i += 2;
-            if (i > walk_end)
-            {
-                break;
-            }
-            ret += doPopcount(flags_[i - 1]);
-        }
-        ret += tmp_accum;
-
-        /* last byte */
-        if (last_byte < std::size(flags_))
-        {
-            /* -end & 7U. Since bitcount is unsigned do ~end + 1 to
-               replace -end as linters warn about negating unsigned
-               types. Any compiler will optimize ~x + 1 to -x in the
-               backend. */
-            uint32_t const last_shift = (~end + 1) & 7U;
-            val = flags_[last_byte];
-            val >>= last_shift;
-            /* No need to shift back val for correct popcount. */
-            ret += doPopcount(val);
-        }
+        ret = doPopcount(static_cast<uint8_t>(flags_[first_byte] & first_mask));
+        ret += rawCountFlags(std::data(flags_) + first_byte + 1U, last_byte - first_byte - 1U);
+        ret += doPopcount(static_cast<uint8_t>(flags_[last_byte] & last_mask));
     }
 
-    TR_ASSERT(ret <= (begin - end));
+    TR_ASSERT(ret <= end - begin);
     return ret;
 }
 
@@ -450,12 +479,10 @@ tr_bitfield& tr_bitfield::operator|=(tr_bitfield const& that) noexcept
 
     flags_.resize(std::max(std::size(flags_), std::size(that.flags_)));
 
-    for (size_t i = 0, n = std::size(that.flags_); i < n; ++i)
-    {
-        flags_[i] |= that.flags_[i];
-    }
-
-    rebuild_true_count();
+    auto const n = std::size(that.flags_);
+    auto const true_count = transformFlags(std::data(flags_), std::data(that.flags_), n, [](Word a, Word b) { return a | b; }) +
+        rawCountFlags(std::data(flags_) + n, std::size(flags_) - n);
+    set_true_count(true_count);
     return *this;
 }
 
@@ -474,12 +501,39 @@ tr_bitfield& tr_bitfield::operator&=(tr_bitfield const& that) noexcept
 
     flags_.resize(std::min(std::size(flags_), std::size(that.flags_)));
 
-    for (size_t i = 0, n = std::size(flags_); i < n; ++i)
+    auto const n = std::size(flags_);
+    set_true_count(transformFlags(std::data(flags_), std::data(that.flags_), n, [](Word a, Word b) { return a & b; }));
+    return *this;
+}
+
+tr_bitfield& tr_bitfield::and_not(tr_bitfield const& that) noexcept
+{
+    if (has_none() || that.has_none())
     {
-        flags_[i] &= that.flags_[i];
+        return *this;
     }
 
-    rebuild_true_count();
+    if (that.has_all())
+    {
+        set_has_none();
+        return *this;
+    }
+
+    if (has_all())
+    {
+        // we don't know how many bits there are to keep
+        if (bit_count_ == 0U)
+        {
+            return *this;
+        }
+
+        ensure_bits_alloced(bit_count_);
+    }
+
+    auto const n = std::min(std::size(flags_), std::size(that.flags_));
+    auto const true_count = transformFlags(std::data(flags_), std::data(that.flags_), n, [](Word a, Word b) { return a & ~b; }) +
+        rawCountFlags(std::data(flags_) + n, std::size(flags_) - n);
+    set_true_count(true_count);
     return *this;
 }
 
@@ -495,9 +549,22 @@ bool tr_bitfield::intersects(tr_bitfield const& that) const noexcept
         return true;
     }
 
-    for (size_t i = 0, n = std::min(std::size(flags_), std::size(that.flags_)); i < n; ++i)
+    auto const* const mine = std::data(flags_);
+    auto const* const theirs = std::data(that.flags_);
+    auto const n = std::min(std::size(flags_), std::size(that.flags_));
+    auto i = size_t{};
+
+    for (; i + WordBytes <= n; i += WordBytes)
+    {
+        if ((load_native(mine + i) & load_native(theirs + i)) != 0U)
+        {
+            return true;
+        }
+    }
+
+    for (; i < n; ++i)
     {
-        if ((flags_[i] & that.flags_[i]) != 0U)
+        if ((mine[i] & theirs[i]) != 0U)
         {
             return true;
         }
@@ -505,3 +572,86 @@ bool tr_bitfield::intersects(tr_bitfield const& that) const noexcept
 
     return false;
 }
+
+size_t tr_bitfield::count_intersection(tr_bitfield const& that) const noexcept
+{
+    if (has_none() || that.has_none())
+    {
+        return 0U;
+    }
+
+    auto const n_bits = std::min(bit_count_, that.bit_count_);
+
+    if (has_all())
+    {
+        return that.count(0U, n_bits);
+    }
+
+    if (that.has_all())
+    {
+        return count(0U, n_bits);
+    }
+
+    auto const* const mine = std::data(flags_);
+    auto const* const theirs = std::data(that.flags_);
+    auto const n = std::min(std::size(flags_), std::size(that.flags_));
+    auto i = size_t{};
+    auto ret = size_t{};
+
+    for (; i + WordBytes <= n; i += WordBytes)
+    {
+        ret += tr_popcnt<Word>::count(load_native(mine + i) & load_native(theirs + i));
+    }
+
+    for (; i < n; ++i)
+    {
+        ret += doPopcount(mine[i] & theirs[i]);
+    }
+
+    return ret;
+}
+
+std::optional<size_t> tr_bitfield::find_first_and_not(tr_bitfield const& that, size_t begin) const noexcept
+{
+    if (begin >= bit_count_ || has_none() || that.has_all())
+    {
+        return {};
+    }
+
+    auto const mine_all = has_all() && std::empty(flags_);
+    auto const n_mine = mine_all ? getBytesNeededSafe(bit_count_) : std::size(flags_);
+    auto const n_theirs = that.has_none() ? 0U : std::size(that.flags_);
+
+    // ignore the bits in begin's byte that come before it
+    auto first_mask = ~Word{} >> (begin & 7U);
+
+    for (auto byte = begin >> 3U; byte < n_mine; byte += WordBytes)
+    {
+        auto word = mine_all ? ~Word{} : flags_word(byte);
+        if (byte < n_theirs)
+        {
+            word &= ~that.flags_word(byte);
+        }
+        word &= first_mask;
+        first_mask = ~Word{};
+
+        if (word != 0U)
+        {
+            if (auto const bit = byte * 8U + count_leading_zeros(word); bit < bit_count_)
+            {
+                return bit;
+            }
+
+            return {};
+        }
+    }
+
+    return {};
+}
+
+uint64_t tr_bitfield::flags_word(size_t byte) const noexcept
+{
+    TR_ASSERT(byte < std::size(flags_));
+
+    return load_ordered(std::data(flags_) + byte, std::size(flags_) - byte);
+}
@@ -11,6 +11,7 @@
 
 #include <cstddef> // size_t
 #include <cstdint> // uint8_t
+#include <optional>
 #include <vector> // std::vector
 
 #include "libtransmission/tr-macros.h" // TR_CONSTEXPR20
@@ -63,6 +64,12 @@ public:
     void set_raw(uint8_t const* raw, size_t byte_count);
     [[nodiscard]] std::vector<uint8_t> raw() const;
 
+    // how many bytes the bit array has allocated, not counting sizeof(tr_bitfield)
+    [[nodiscard]] TR_CONSTEXPR20 size_t memory_usage() const noexcept
+    {
+        return flags_.capacity();
+    }
+
     [[nodiscard]] constexpr bool has_all() const noexcept
     {
         return have_all_hint_ || (bit_count_ > 0 && bit_count_ == true_count_);
@@ -112,11 +119,73 @@ public:
         return static_cast<float>(count()) / size();
     }
 
+    // Bulk operations. These work a machine word at a time
+    // instead of a bit at a time, so prefer them over loops
+    // of test() and set() when working with whole bitfields.
+
     tr_bitfield& operator|=(tr_bitfield const& that) noexcept;
     tr_bitfield& operator&=(tr_bitfield const& that) noexcept;
+
+    // clear the bits that are set in `that`, i.e. `this &= ~that`
+    tr_bitfield& and_not(tr_bitfield const& that) noexcept;
+
     [[nodiscard]] bool intersects(tr_bitfield const& that) const noexcept;
 
+    // the number of bits that are set both here and in `that`
+    [[nodiscard]] size_t count_intersection(tr_bitfield const& that) const noexcept;
+
+    // the first bit at or after `begin` that's set here but not in `that`
+    [[nodiscard]] std::optional<size_t> find_first_and_not(tr_bitfield const& that, size_t begin = 0U) const noexcept;
+
+    // call `func(bit)` for each set bit, in ascending order
+    template<typename Func>
+    void for_each_set_bit(Func&& func) const
+    {
+        if (has_all())
+        {
+            for (size_t bit = 0U; bit < bit_count_; ++bit)
+            {
+                func(bit);
+            }
+        }
+        else if (!has_none())
+        {
+            for (size_t byte = 0U, n = std::size(flags_); byte < n; byte += sizeof(uint64_t))
+            {
+                for (auto word = flags_word(byte); word != 0U;)
+                {
+                    auto const zeros = count_leading_zeros(word);
+                    auto const bit = byte * 8U + zeros;
+                    if (bit >= bit_count_)
+                    {
+                        return;
+                    }
+
+                    func(bit);
+                    word ^= uint64_t{ 1U } << (63U - zeros);
+                }
+            }
+        }
+    }
+
 private:
+    // the 64 flags starting at `byte`, with the first one in the most significant bit
+    [[nodiscard]] uint64_t flags_word(size_t byte) const noexcept;
+
+    [[nodiscard]] static size_t count_leading_zeros(uint64_t word) noexcept
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<size_t>(__builtin_clzll(word));
+#else
+        auto n = size_t{};
+        for (auto mask = uint64_t{ 1U } << 63U; (word & mask) == 0U; mask >>= 1U)
+        {
+            ++n;
+        }
+        return n;
+#endif
+    }
+
     [[nodiscard]] size_t count_flags() const noexcept;
     [[nodiscard]] size_t count_flags(size_t begin, size_t end) const noexcept;
 
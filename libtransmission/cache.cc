@@ -9,6 +9,8 @@
 #include <cstdint> // uint8_t
 #include <iterator> // std::distance(), std::next(), std::prev()
 #include <memory>
+#include <mutex>
+#include <new> // ::operator new()
 #include <numeric> // std::accumulate()
 #include <utility> // std::make_pair()
 #include <vector>
@@ -24,6 +26,88 @@
 #include "libtransmission/torrents.h"
 #include "libtransmission/tr-assert.h"
 
+namespace
+{
+// Recycles the memory of freed Cache::BlockData. It's shared by the
+// session thread and the webseed threads, so it has its own lock.
+class BlockDataPool
+{
+public:
+    // enough to cover a few seconds of a fast download
+    static auto constexpr MaxIdle = size_t{ 256U };
+
+    [[nodiscard]] static BlockDataPool& instance()
+    {
+        // never destroyed, since blocks may be freed during static destruction
+        static auto* const pool = new BlockDataPool{};
+        return *pool;
+    }
+
+    [[nodiscard]] void* acquire()
+    {
+        {
+            auto const lock = std::lock_guard{ mutex_ };
+            if (!std::empty(idle_))
+            {
+                auto* const ptr = idle_.back();
+                idle_.pop_back();
+                return ptr;
+            }
+        }
+
+        return ::operator new(sizeof(Cache::BlockData));
+    }
+
+    void release(void* ptr) noexcept
+    {
+        {
+            auto const lock = std::lock_guard{ mutex_ };
+            if (std::size(idle_) < MaxIdle)
+            {
+                idle_.emplace_back(ptr);
+                return;
+            }
+        }
+
+        ::operator delete(ptr);
+    }
+
+private:
+    BlockDataPool()
+    {
+        idle_.reserve(MaxIdle);
+    }
+
+    std::mutex mutex_;
+    std::vector<void*> idle_;
+};
+} // namespace
+
+void* Cache::BlockData::operator new(size_t const size)
+{
+    // subclasses don't use the pool
+    return size == sizeof(BlockData) ? BlockDataPool::instance().acquire() : ::operator new(size);
+}
+
+void Cache::BlockData::operator delete(void* const ptr, size_t const size) noexcept
+{
+    if (ptr == nullptr)
+    {
+        return;
+    }
+
+    if (size == sizeof(BlockData))
+    {
+        BlockDataPool::instance().release(ptr);
+    }
+    else
+    {
+        ::operator delete(ptr);
+    }
+}
+
+// ---
+
 Cache::Key Cache::make_key(tr_torrent const& tor, tr_block_info::Location const loc) noexcept
 {
     return std::make_pair(tor.id(), loc.block);
@@ -183,6 +267,23 @@ int Cache::read_block(tr_torrent const& tor, tr_block_info::Location const& loc,
     return tr_ioRead(tor, loc, len, setme);
 }
 
+std::shared_ptr<Cache::BlockData const> Cache::get_shared_block(
+    tr_torrent const& tor,
+    tr_block_info::Location const& loc) noexcept
+{
+    if (auto const iter = get_block(tor, loc); iter != std::end(blocks_))
+    {
+        return iter->buf;
+    }
+
+    return {};
+}
+
+bool Cache::contains(tr_torrent const& tor, tr_block_info::Location const& loc) const noexcept
+{
+    return std::binary_search(std::begin(blocks_), std::end(blocks_), make_key(tor, loc), CompareCacheBlockByKey);
+}
+
 // ---
 
 int Cache::flush_span(CIter const begin, CIter const end)
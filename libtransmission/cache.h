@@ -11,7 +11,7 @@
 
 #include <cstddef> // for size_t
 #include <cstdint> // for intX_t, uintX_t
-#include <memory> // for std::unique_ptr
+#include <memory> // for std::shared_ptr, std::unique_ptr
 #include <utility> // for std::pair
 #include <vector>
 
@@ -28,7 +28,17 @@ struct tr_torrent;
 class Cache
 {
 public:
-    using BlockData = small::max_size_vector<uint8_t, tr_block_info::BlockSize>;
+    // A block's worth of data. Blocks are allocated and freed as fast as
+    // they're downloaded, so freed ones are kept on a free list for reuse.
+    class BlockData : public small::max_size_vector<uint8_t, tr_block_info::BlockSize>
+    {
+    public:
+        using small::max_size_vector<uint8_t, tr_block_info::BlockSize>::max_size_vector;
+
+        [[nodiscard]] static void* operator new(size_t size);
+        static void operator delete(void* ptr, size_t size) noexcept;
+    };
+
     using Memory = libtransmission::Values::Memory;
 
     Cache(tr_torrents const& torrents, Memory max_size);
@@ -39,6 +49,17 @@ public:
     int write_block(tr_torrent_id_t tor, tr_block_index_t block, std::unique_ptr<BlockData> writeme);
 
     int read_block(tr_torrent const& tor, tr_block_info::Location const& loc, size_t len, uint8_t* setme);
+
+    // @return the cached block at `loc`, or nullptr if it's not in the cache.
+    // This is a reference to the cache's copy, not a copy of it, so it stays
+    // valid after the block is flushed or replaced.
+    [[nodiscard]] std::shared_ptr<BlockData const> get_shared_block(
+        tr_torrent const& tor,
+        tr_block_info::Location const& loc) noexcept;
+
+    // @return true if the block at `loc` is in the cache and not yet written to disk
+    [[nodiscard]] bool contains(tr_torrent const& tor, tr_block_info::Location const& loc) const noexcept;
+
     int flush_torrent(tr_torrent_id_t tor_id);
     int flush_file(tr_torrent const& tor, tr_file_index_t file);
 
@@ -48,7 +69,7 @@ private:
     struct CacheBlock
     {
         Key key;
-        std::unique_ptr<BlockData> buf;
+        std::shared_ptr<BlockData> buf;
     };
 
     using Blocks = std::vector<CacheBlock>;
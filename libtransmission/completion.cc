@@ -103,20 +103,27 @@ void tr_completion::amount_done(float* tab, size_t n_tabs) const
     }
 }
 
-std::vector<uint8_t> tr_completion::create_piece_bitfield() const
+tr_bitfield tr_completion::pieces() const
 {
     size_t const n = block_info_->piece_count();
     auto pieces = tr_bitfield{ n };
 
-    // NOLINTNEXTLINE modernize-avoid-c-arrays
-    auto flags = std::make_unique<bool[]>(n);
-    for (tr_piece_index_t piece = 0; piece < n; ++piece)
+    if (has_all())
+    {
+        pieces.set_has_all();
+    }
+    else if (!has_none())
     {
-        flags[piece] = has_piece(piece);
+        // NOLINTNEXTLINE modernize-avoid-c-arrays
+        auto flags = std::make_unique<bool[]>(n);
+        for (tr_piece_index_t piece = 0; piece < n; ++piece)
+        {
+            flags[piece] = has_piece(piece);
+        }
+        pieces.set_from_bools(flags.get(), n);
     }
-    pieces.set_from_bools(flags.get(), n);
 
-    return pieces.raw();
+    return pieces;
 }
 
 // --- mutators
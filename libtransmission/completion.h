@@ -115,7 +115,13 @@ struct tr_completion
         return TR_LEECH;
     }
 
-    [[nodiscard]] std::vector<uint8_t> create_piece_bitfield() const;
+    // the pieces that we have
+    [[nodiscard]] tr_bitfield pieces() const;
+
+    [[nodiscard]] std::vector<uint8_t> create_piece_bitfield() const
+    {
+        return pieces().raw();
+    }
 
     [[nodiscard]] size_t count_missing_blocks_in_piece(tr_piece_index_t piece) const
     {
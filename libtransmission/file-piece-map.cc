@@ -236,3 +236,24 @@ bool tr_files_wanted::piece_wanted(tr_piece_index_t const piece) const
     auto const [begin, end] = fpm_->file_span_for_piece(piece);
     return wanted_.count(begin, end) != 0U;
 }
+
+tr_bitfield tr_files_wanted::pieces_wanted(tr_piece_index_t const n_pieces) const
+{
+    auto pieces = tr_bitfield{ n_pieces };
+
+    if (wanted_.has_all())
+    {
+        pieces.set_has_all();
+    }
+    else
+    {
+        wanted_.for_each_set_bit(
+            [this, &pieces](size_t file)
+            {
+                auto const [begin, end] = fpm_->piece_span_for_file(static_cast<tr_file_index_t>(file));
+                pieces.set_span(begin, end);
+            });
+    }
+
+    return pieces;
+}
@@ -115,6 +115,9 @@ public:
 
     [[nodiscard]] bool piece_wanted(tr_piece_index_t piece) const;
 
+    // the pieces that piece_wanted() is true for
+    [[nodiscard]] tr_bitfield pieces_wanted(tr_piece_index_t n_pieces) const;
+
 private:
     tr_file_piece_map const* fpm_;
     tr_bitfield wanted_;
@@ -73,8 +73,11 @@ ReadState tr_handshake::read_yb(tr_peerIo* peer_io)
 
     // get the peer's public key
     peer_io->read_bytes(std::data(peer_public_key), std::size(peer_public_key));
-    dh_.setPeerPublicKey(peer_public_key);
+    return compute_dh(peer_public_key, &tr_handshake::send_crypto_provide);
+}
 
+ReadState tr_handshake::send_crypto_provide(tr_peerIo* peer_io)
+{
     /* now send these: HASH('req1', S), HASH('req2', SKEY) xor HASH('req3', S),
      * ENCRYPT(VC, crypto_provide, len(PadC), PadC, len(IA)), ENCRYPT(IA) */
     static auto constexpr BufSize = std::tuple_size_v<tr_sha1_digest_t> * 2 + std::size(VC) + sizeof(crypto_provide_) +
@@ -367,8 +370,11 @@ ReadState tr_handshake::read_ya(tr_peerIo* peer_io)
 
     /* read the incoming peer's public key */
     peer_io->read_bytes(std::data(peer_public_key), std::size(peer_public_key));
-    dh_.setPeerPublicKey(peer_public_key);
+    return compute_dh(peer_public_key, &tr_handshake::send_yb);
+}
 
+ReadState tr_handshake::send_yb(tr_peerIo* peer_io)
+{
     // send our public key to the peer
     tr_logAddTraceHand(this, "sending B->A: Diffie Hellman Yb, PadB");
     send_public_key_and_pad<PadbMaxlen>(peer_io);
@@ -554,7 +560,7 @@ ReadState tr_handshake::read_ia(tr_peerIo* peer_io)
 
 // ---
 
-ReadState tr_handshake::can_read(tr_peerIo* peer_io, void* vhandshake, size_t* piece)
+ReadState tr_handshake::can_read(tr_peerIo* peer_io, void* vhandshake, size_t /*max_bytes*/, size_t* piece)
 {
     auto* handshake = static_cast<tr_handshake*>(vhandshake);
 
@@ -576,6 +582,11 @@ ReadState tr_handshake::can_read(tr_peerIo* peer_io, void* vhandshake, size_t* p
             ret = handshake->read_peer_id(peer_io);
             break;
 
+        case State::AwaitingDh:
+            // leave the input buffered until the keys are ready
+            ret = READ_LATER;
+            break;
+
         case State::AwaitingYa:
             ret = handshake->read_ya(peer_io);
             break;
@@ -628,6 +639,7 @@ void tr_handshake::on_error(tr_peerIo* io, tr_error const& error, void* vhandsha
 
     auto const retry = [&]()
     {
+        handshake->cancel_dh();
         handshake->send_handshake(io);
         handshake->set_state(State::AwaitingHandshake);
     };
@@ -637,20 +649,22 @@ void tr_handshake::on_error(tr_peerIo* io, tr_error const& error, void* vhandsha
         handshake->done(false);
     };
 
-    if (io->is_utp() && !io->is_incoming() && handshake->is_state(State::AwaitingYb))
+    // An outgoing µTP connect error can arrive while we're waiting for
+    // the peer's first reply, or while our keys are still being computed.
+    auto const awaiting_first_reply = handshake->is_state(State::AwaitingYb) || handshake->is_state(State::AwaitingDh);
+
+    if (io->is_utp() && !io->is_incoming() && awaiting_first_reply)
     {
         // the peer probably doesn't speak µTP.
 
-        auto const info_hash = io->torrent_hash();
-        auto const info = handshake->mediator_->torrent(info_hash);
-
         /* Don't mark a peer as non-µTP unless it's really a connect failure. */
-        if ((error.code() == ETIMEDOUT || error.code() == ECONNREFUSED) && info)
+        if (error.code() == ETIMEDOUT || error.code() == ECONNREFUSED)
         {
-            handshake->mediator_->set_utp_failed(info_hash, io->socket_address());
+            handshake->utp_failed_ = true;
         }
 
-        if (handshake->mediator_->allows_tcp() && io->reconnect())
+        // a raced TCP attempt is already connecting to this peer
+        if (!handshake->is_raced_ && handshake->mediator_->allows_tcp() && io->reconnect())
         {
             retry();
             return;
@@ -663,7 +677,7 @@ void tr_handshake::on_error(tr_peerIo* io, tr_error const& error, void* vhandsha
     /* if the error happened while we were sending a public key, we might
      * have encountered a peer that doesn't do encryption... reconnect and
      * try a plaintext handshake */
-    if ((handshake->is_state(State::AwaitingYb) || handshake->is_state(State::AwaitingVc)) &&
+    if ((handshake->is_state(State::AwaitingYb) || handshake->is_state(State::AwaitingVc)) && !handshake->is_raced_ &&
         handshake->encryption_mode_ != TR_ENCRYPTION_REQUIRED && handshake->mediator_->allows_tcp() && io->reconnect())
     {
         tr_logAddTraceHand(handshake, "handshake failed, trying plaintext...");
@@ -769,6 +783,72 @@ uint32_t tr_handshake::crypto_provide() const noexcept
     return 0;
 }
 
+// --- Diffie-Hellman
+
+ReadState tr_handshake::compute_dh(std::optional<DH::key_bigend_t> const& peer_public_key, Resume resume)
+{
+    auto const job = std::make_shared<DhJob>();
+    job->dh = dh_;
+    job->peer_public_key = peer_public_key;
+    job->resume = resume;
+    job->handshake = this;
+    dh_job_ = job;
+
+    auto const prev_state = state();
+    set_state(State::AwaitingDh);
+    tr_logAddTraceHand(this, fmt::format("computing keys after state [{}]", state_string(prev_state)));
+
+    mediator_->run_in_worker(
+        [job]()
+        {
+            if (job->peer_public_key)
+            {
+                job->dh.setPeerPublicKey(*job->peer_public_key);
+            }
+
+            [[maybe_unused]] auto const public_key = job->dh.publicKey();
+        },
+        [job]()
+        {
+            job->is_done = true;
+
+            if (job->handshake != nullptr && !job->is_inline)
+            {
+                job->handshake->on_dh_done();
+            }
+        });
+
+    job->is_inline = false;
+
+    // if the mediator ran the job synchronously, keep going now
+    return job->is_done ? finish_dh() : READ_LATER;
+}
+
+ReadState tr_handshake::finish_dh()
+{
+    auto const job = std::move(dh_job_);
+    TR_ASSERT(job && job->is_done);
+    dh_ = job->dh;
+    return (this->*job->resume)(peer_io_.get());
+}
+
+void tr_handshake::on_dh_done()
+{
+    // keep the io alive in case the handshake gets destroyed
+    auto const peer_io = peer_io_;
+
+    tr_logAddTraceHand(this, "keys are ready");
+
+    // resume reading any input that arrived while we were busy.
+    // Anything other than READ_NOW means the handshake may be gone.
+    if (finish_dh() == READ_NOW)
+    {
+        peer_io->process_read_buffer();
+    }
+}
+
+// ---
+
 bool tr_handshake::fire_done(bool is_connected)
 {
     maybe_recycle_dh();
@@ -784,7 +864,7 @@ bool tr_handshake::fire_done(bool is_connected)
     auto cb = DoneFunc{};
     std::swap(cb, on_done_);
 
-    return (cb)(Result{ peer_io_, peer_id_, have_read_anything_from_peer_, is_connected });
+    return (cb)(Result{ peer_io_, peer_id_, have_read_anything_from_peer_, is_connected, utp_failed_ });
 }
 
 std::string_view tr_handshake::state_string(State state) noexcept
@@ -795,6 +875,8 @@ std::string_view tr_handshake::state_string(State state) noexcept
         return "awaiting handshake";
     case State::AwaitingPeerId:
         return "awaiting peer id";
+    case State::AwaitingDh:
+        return "awaiting dh";
     case State::AwaitingYa:
         return "awaiting ya";
     case State::AwaitingPadA:
@@ -820,13 +902,19 @@ std::string_view tr_handshake::state_string(State state) noexcept
     return "unknown state";
 }
 
-tr_handshake::tr_handshake(Mediator* mediator, std::shared_ptr<tr_peerIo> peer_io, tr_encryption_mode mode, DoneFunc on_done)
+tr_handshake::tr_handshake(
+    Mediator* mediator,
+    std::shared_ptr<tr_peerIo> peer_io,
+    tr_encryption_mode mode,
+    DoneFunc on_done,
+    bool is_raced)
     : dh_{ tr_handshake::get_dh(mediator) }
     , on_done_{ std::move(on_done) }
     , peer_io_{ std::move(peer_io) }
     , timeout_timer_{ mediator->timer_maker().create([this]() { fire_done(false); }) }
     , mediator_{ mediator }
     , encryption_mode_{ mode }
+    , is_raced_{ is_raced }
 {
     timeout_timer_->start_single_shot(HandshakeTimeoutSec);
 
@@ -838,7 +926,7 @@ tr_handshake::tr_handshake(Mediator* mediator, std::shared_ptr<tr_peerIo> peer_i
     }
     else if (encryption_mode_ != TR_CLEAR_PREFERRED)
     {
-        send_ya(peer_io_.get());
+        compute_dh({}, &tr_handshake::on_ya_ready);
     }
     else
     {
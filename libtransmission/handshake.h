@@ -49,6 +49,10 @@ public:
         std::optional<tr_peer_id_t> peer_id;
         bool read_anything_from_peer = false;
         bool is_connected = false;
+
+        // true if an outgoing µTP connect failed in a way that
+        // suggests the peer doesn't speak µTP
+        bool utp_failed = false;
     };
 
     using DoneFunc = std::function<bool(Result const&)>;
@@ -77,10 +81,39 @@ public:
             return DH::randomPrivateKey();
         }
 
-        virtual void set_utp_failed(tr_sha1_digest_t const& info_hash, tr_socket_address const& socket_address) = 0;
+        // Run `work` on a worker thread, then `on_done` on the session thread.
+        // The default implementation runs both right away in the caller's thread.
+        virtual void run_in_worker(std::function<void()> work, std::function<void()> on_done)
+        {
+            work();
+            on_done();
+        }
     };
 
-    tr_handshake(Mediator* mediator, std::shared_ptr<tr_peerIo> peer_io, tr_encryption_mode mode_in, DoneFunc on_done);
+    // A raced handshake is one of several connection attempts to the same
+    // peer, so it doesn't reconnect on errors; the other attempts cover that.
+    tr_handshake(
+        Mediator* mediator,
+        std::shared_ptr<tr_peerIo> peer_io,
+        tr_encryption_mode mode_in,
+        DoneFunc on_done,
+        bool is_raced = false);
+
+    tr_handshake(tr_handshake const&) = delete;
+    tr_handshake(tr_handshake&&) = delete;
+    tr_handshake& operator=(tr_handshake const&) = delete;
+    tr_handshake& operator=(tr_handshake&&) = delete;
+
+    ~tr_handshake()
+    {
+        // if a key computation is still running, don't resume a dead handshake
+        cancel_dh();
+    }
+
+    [[nodiscard]] constexpr auto const& peer_io() const noexcept
+    {
+        return peer_io_;
+    }
 
 private:
     enum class State : uint8_t
@@ -88,6 +121,7 @@ private:
         // incoming and outgoing
         AwaitingHandshake,
         AwaitingPeerId,
+        AwaitingDh,
 
         // incoming
         AwaitingYa,
@@ -118,6 +152,34 @@ private:
     ReadState read_yb(tr_peerIo*);
 
     void send_ya(tr_peerIo*);
+    ReadState send_yb(tr_peerIo*);
+    ReadState send_crypto_provide(tr_peerIo*);
+
+    ReadState on_ya_ready(tr_peerIo* io)
+    {
+        send_ya(io);
+        return READ_NOW;
+    }
+
+    // The Diffie-Hellman math is slow enough to stall the session thread
+    // when lots of peers connect at once, so it's done in the background.
+    using Resume = ReadState (tr_handshake::*)(tr_peerIo*);
+
+    struct DhJob
+    {
+        DH dh;
+        std::optional<DH::key_bigend_t> peer_public_key;
+        Resume resume = nullptr;
+        tr_handshake* handshake = nullptr;
+        bool is_done = false;
+        bool is_inline = true;
+    };
+
+    // Compute our public key and, if `peer_public_key` is given, the shared
+    // secret. Then call `resume` to continue the handshake.
+    ReadState compute_dh(std::optional<DH::key_bigend_t> const& peer_public_key, Resume resume);
+    ReadState finish_dh();
+    void on_dh_done();
 
     void set_peer_id(tr_peer_id_t const& id) noexcept
     {
@@ -157,7 +219,7 @@ private:
         return state_string(state_);
     }
 
-    static ReadState can_read(tr_peerIo* peer_io, void* vhandshake, size_t* piece);
+    static ReadState can_read(tr_peerIo* peer_io, void* vhandshake, size_t max_bytes, size_t* piece);
 
     static void on_error(tr_peerIo* io, tr_error const&, void* vhandshake);
 
@@ -285,6 +347,16 @@ private:
         }
     }
 
+    // Stop waiting for a key computation, e.g. when falling back to TCP.
+    // Its result is dropped when it finishes.
+    void cancel_dh() noexcept
+    {
+        if (auto const job = std::exchange(dh_job_, {}); job)
+        {
+            job->handshake = nullptr;
+        }
+    }
+
     void maybe_recycle_dh()
     {
         // keys are expensive to make, so recycle iff the peer was unreachable
@@ -303,6 +375,8 @@ private:
 
     DH dh_{};
 
+    std::shared_ptr<DhJob> dh_job_;
+
     DoneFunc on_done_;
 
     std::optional<tr_peer_id_t> peer_id_;
@@ -329,4 +403,8 @@ private:
     bool have_read_anything_from_peer_ = false;
 
     bool have_sent_bittorrent_handshake_ = false;
+
+    bool is_raced_ = false;
+
+    bool utp_failed_ = false;
 };
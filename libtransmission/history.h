@@ -11,7 +11,7 @@
 
 #include <array>
 #include <cstddef> // for size_t
-#include <cstdint> // for uint32_t
+#include <cstdint> // for uint16_t, uint32_t
 #include <ctime> // for time_t
 
 /**
@@ -31,10 +31,10 @@ public:
      */
     constexpr void add(time_t now, SizeType n)
     {
-        if (timestamps_[newest_] != now)
+        if (auto const timestamp = static_cast<Timestamp>(now); timestamps_[newest_] != timestamp)
         {
-            newest_ = (newest_ + 1) % Seconds;
-            timestamps_[newest_] = now;
+            newest_ = static_cast<uint16_t>((newest_ + 1U) % Seconds);
+            timestamps_[newest_] = timestamp;
             count_[newest_] = {};
         }
 
@@ -53,7 +53,7 @@ public:
 
         for (std::size_t i = 0; i < Seconds; ++i)
         {
-            if (timestamps_[i] >= oldest)
+            if (time_t{ timestamps_[i] } >= oldest)
             {
                 sum += count_[i];
             }
@@ -63,7 +63,13 @@ public:
     }
 
 private:
-    std::array<time_t, Seconds> timestamps_ = {};
+    // One of these lives in every peer, several times over, so keep it small:
+    // seconds since the epoch fit in 32 bits until 2106.
+    using Timestamp = uint32_t;
+
+    static_assert(Seconds <= 0xFFFFU);
+
+    std::array<Timestamp, Seconds> timestamps_ = {};
     std::array<SizeType, Seconds> count_ = {};
-    uint32_t newest_ = 0;
+    uint16_t newest_ = 0;
 };
@@ -0,0 +1,165 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <algorithm> // std::copy_n, std::for_each, std::max, std::nth_element
+#include <cstddef> // ptrdiff_t, size_t
+#include <cstdint>
+#include <iterator> // std::next
+#include <numeric> // std::accumulate
+#include <string_view>
+#include <utility> // std::pair
+#include <vector>
+
+#include "libtransmission/incoming-admission.h"
+#include "libtransmission/net.h"
+#include "libtransmission/tr-assert.h"
+
+using namespace std::literals;
+
+tr_incoming_admission::Verdict tr_incoming_admission::check(tr_address const& addr)
+{
+    // cheapest checks first
+    if (mediator_.peer_limit_reached())
+    {
+        return drop(Verdict::PeerLimit);
+    }
+
+    if (mediator_.pending_handshakes() >= MaxPendingHandshakes)
+    {
+        return drop(Verdict::PendingHandshakes);
+    }
+
+    auto const now = mediator_.now_msec();
+    auto const subnet_key = make_key(addr, true);
+    auto const address_key = make_key(addr, false);
+
+    if (!has_token(per_subnet_, subnet_key, now, PerSubnetBurst, PerSubnetIntervalMsec))
+    {
+        return drop(Verdict::PerSubnet);
+    }
+
+    if (!has_token(per_address_, address_key, now, PerAddressBurst, PerAddressIntervalMsec))
+    {
+        return drop(Verdict::PerAddress);
+    }
+
+    prune(per_subnet_, now);
+    prune(per_address_, now);
+    take_token(per_subnet_, subnet_key, now, PerSubnetIntervalMsec);
+    take_token(per_address_, address_key, now, PerAddressIntervalMsec);
+    return Verdict::Admit;
+}
+
+uint64_t tr_incoming_admission::n_dropped() const noexcept
+{
+    return std::accumulate(std::begin(drops_), std::end(drops_), uint64_t{});
+}
+
+std::string_view tr_incoming_admission::verdict_name(Verdict const verdict) noexcept
+{
+    switch (verdict)
+    {
+    case Verdict::Admit:
+        return "admitted"sv;
+    case Verdict::PeerLimit:
+        return "peer limit reached"sv;
+    case Verdict::PendingHandshakes:
+        return "too many pending handshakes"sv;
+    case Verdict::PerSubnet:
+        return "subnet rate-limited"sv;
+    case Verdict::PerAddress:
+        return "address rate-limited"sv;
+    default:
+        TR_ASSERT_MSG(false, "invalid verdict");
+        return "unknown"sv;
+    }
+}
+
+tr_incoming_admission::Key tr_incoming_admission::make_key(tr_address const& addr, bool const subnet) noexcept
+{
+    auto key = Key{};
+    key[0] = static_cast<uint8_t>(addr.type);
+
+    if (addr.is_ipv4())
+    {
+        // /32 or /24
+        auto const* const bytes = reinterpret_cast<uint8_t const*>(&addr.addr.addr4);
+        std::copy_n(bytes, subnet ? 3U : 4U, std::begin(key) + 1);
+    }
+    else if (addr.is_ipv6())
+    {
+        // /64 or /48
+        auto const* const bytes = reinterpret_cast<uint8_t const*>(&addr.addr.addr6);
+        std::copy_n(bytes, subnet ? 6U : 8U, std::begin(key) + 1);
+    }
+
+    return key;
+}
+
+bool tr_incoming_admission::has_token(
+    Buckets const& buckets,
+    Key const& key,
+    uint64_t const now,
+    uint64_t const burst,
+    uint64_t const interval)
+{
+    auto const it = buckets.find(key);
+    if (it == std::end(buckets))
+    {
+        return true;
+    }
+
+    // the bucket is empty if it won't be full again
+    // until after `burst` more intervals
+    auto const full_at = std::max(it->second, now);
+    return full_at - now + interval <= burst * interval;
+}
+
+void tr_incoming_admission::take_token(Buckets& buckets, Key const& key, uint64_t const now, uint64_t const interval)
+{
+    auto& full_at = buckets.try_emplace(key, now).first->second;
+    full_at = std::max(full_at, now) + interval;
+}
+
+void tr_incoming_admission::prune(Buckets& buckets, uint64_t const now)
+{
+    if (std::size(buckets) < MaxTrackedPerMap)
+    {
+        return;
+    }
+
+    // forget the buckets that have refilled
+    for (auto it = std::begin(buckets); it != std::end(buckets);)
+    {
+        it = it->second <= now ? buckets.erase(it) : std::next(it);
+    }
+
+    // If that wasn't enough, we're being flooded from too many sources
+    // to track. Forget the buckets that are closest to full, since they
+    // cost the least to forget, and keep the ones that are throttling
+    // someone. Free up some headroom so we don't do this on every call.
+    if (std::size(buckets) < MaxTrackedPerMap)
+    {
+        return;
+    }
+
+    auto by_full_at = std::vector<std::pair<uint64_t, Key>>{};
+    by_full_at.reserve(std::size(buckets));
+    for (auto const& [key, full_at] : buckets)
+    {
+        by_full_at.emplace_back(full_at, key);
+    }
+
+    auto const n_evict = std::size(buckets) - MaxTrackedPerMap * 3U / 4U;
+    auto const evict_end = std::next(std::begin(by_full_at), static_cast<ptrdiff_t>(n_evict));
+    std::nth_element(std::begin(by_full_at), evict_end, std::end(by_full_at));
+    std::for_each(std::begin(by_full_at), evict_end, [&buckets](auto const& entry) { buckets.erase(entry.second); });
+}
+
+tr_incoming_admission::Verdict tr_incoming_admission::drop(Verdict const reason) noexcept
+{
+    ++drops_[static_cast<size_t>(reason)];
+    return reason;
+}
@@ -0,0 +1,134 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#ifndef __TRANSMISSION__
+#error only libtransmission should #include this header.
+#endif
+
+#pragma once
+
+#include <array>
+#include <cstddef> // size_t
+#include <cstdint> // uint8_t, uint64_t
+#include <string_view>
+#include <unordered_map>
+
+#include "libtransmission/net.h" // tr_address
+
+/**
+ * Decides whether to keep a freshly-accepted incoming peer connection.
+ *
+ * This runs right after accept(), before we allocate anything for the
+ * connection, so that a flood of incoming connections costs us as little
+ * as possible. Each source address and each source subnet gets a token
+ * bucket; on top of that, there's a cap on how many incoming handshakes
+ * may be pending at once.
+ *
+ * For IPv6, where a single host usually owns a whole /64, the per-address
+ * bucket covers the /64 and the per-subnet bucket covers the /48.
+ */
+class tr_incoming_admission
+{
+public:
+    enum class Verdict : uint8_t
+    {
+        Admit,
+
+        // reasons for dropping the connection
+        PeerLimit,
+        PendingHandshakes,
+        PerSubnet,
+        PerAddress,
+
+        N_VERDICTS
+    };
+
+    class Mediator
+    {
+    public:
+        virtual ~Mediator() noexcept = default;
+
+        // the number of incoming handshakes that haven't finished yet
+        [[nodiscard]] virtual size_t pending_handshakes() const = 0;
+
+        // true if we're already at our global peer limit
+        [[nodiscard]] virtual bool peer_limit_reached() const = 0;
+
+        [[nodiscard]] virtual uint64_t now_msec() const = 0;
+    };
+
+    // one connection per source address every `PerAddressIntervalMsec`,
+    // with bursts of up to `PerAddressBurst`
+    static auto constexpr PerAddressBurst = uint64_t{ 4U };
+    static auto constexpr PerAddressIntervalMsec = uint64_t{ 5000U };
+
+    // one connection per source subnet every `PerSubnetIntervalMsec`,
+    // with bursts of up to `PerSubnetBurst`
+    static auto constexpr PerSubnetBurst = uint64_t{ 16U };
+    static auto constexpr PerSubnetIntervalMsec = uint64_t{ 500U };
+
+    static auto constexpr MaxPendingHandshakes = size_t{ 128U };
+
+    explicit tr_incoming_admission(Mediator const& mediator) noexcept
+        : mediator_{ mediator }
+    {
+    }
+
+    // Decide whether to keep a connection from `addr`.
+    // Counts the drop if the answer is anything but `Verdict::Admit`.
+    [[nodiscard]] Verdict check(tr_address const& addr);
+
+    [[nodiscard]] constexpr auto n_dropped(Verdict const reason) const noexcept
+    {
+        return drops_[static_cast<size_t>(reason)];
+    }
+
+    [[nodiscard]] uint64_t n_dropped() const noexcept;
+
+    // the number of addresses and subnets currently being tracked
+    [[nodiscard]] auto n_tracked() const noexcept
+    {
+        return std::size(per_address_) + std::size(per_subnet_);
+    }
+
+    [[nodiscard]] static std::string_view verdict_name(Verdict verdict) noexcept;
+
+private:
+    // a subnet prefix, big enough for an IPv6 /64 plus the address type
+    using Key = std::array<uint8_t, 9U>;
+
+    struct KeyHash
+    {
+        [[nodiscard]] size_t operator()(Key const& key) const noexcept
+        {
+            return std::hash<std::string_view>{}({ reinterpret_cast<char const*>(std::data(key)), std::size(key) });
+        }
+    };
+
+    // A token bucket, stored as the time when it will be full again.
+    // A bucket that's already full is implicitly `now`.
+    using Buckets = std::unordered_map<Key, uint64_t, KeyHash>;
+
+    [[nodiscard]] static Key make_key(tr_address const& addr, bool subnet) noexcept;
+
+    [[nodiscard]] static bool has_token(Buckets const& buckets, Key const& key, uint64_t now, uint64_t burst, uint64_t interval);
+
+    static void take_token(Buckets& buckets, Key const& key, uint64_t now, uint64_t interval);
+
+    static void prune(Buckets& buckets, uint64_t now);
+
+    Verdict drop(Verdict reason) noexcept;
+
+    // how many buckets to track before we start forgetting idle ones.
+    // if none are idle, the ones closest to full are forgotten.
+    static auto constexpr MaxTrackedPerMap = size_t{ 4096U };
+
+    Mediator const& mediator_;
+
+    Buckets per_address_;
+    Buckets per_subnet_;
+
+    std::array<uint64_t, static_cast<size_t>(Verdict::N_VERDICTS)> drops_ = {};
+};
@@ -9,6 +9,7 @@
 #include <cstddef>
 #include <optional>
 #include <string_view>
+#include <utility> // std::move
 
 #include <fmt/core.h>
 
@@ -268,6 +269,44 @@ int tr_ioWrite(tr_torrent& tor, tr_block_info::Location const& loc, size_t const
     return error.code();
 }
 
+int tr_ioFindFileSpan(
+    tr_torrent const& tor,
+    tr_block_info::Location const& loc,
+    size_t const len,
+    tr_open_files::SharedFd* const setme_fd,
+    uint64_t* const setme_offset)
+{
+    if (loc.piece >= tor.piece_count())
+    {
+        return EINVAL;
+    }
+
+    auto const [file_index, file_offset] = tor.file_offset(loc);
+    if (file_offset + len > tor.file_size(file_index))
+    {
+        return EXDEV;
+    }
+
+    auto error = tr_error{};
+    auto& session = *tor.session;
+    auto& open_files = session.openFiles();
+    auto const fd = get_fd(session, open_files, tor, false /*writable*/, file_index, error);
+    if (!fd || error)
+    {
+        return error ? error.code() : ENOENT;
+    }
+
+    auto shared_fd = open_files.get_shared(tor.id(), file_index);
+    if (!shared_fd)
+    {
+        return EMFILE;
+    }
+
+    *setme_fd = std::move(shared_fd);
+    *setme_offset = file_offset;
+    return 0;
+}
+
 bool tr_ioTestPiece(tr_torrent const& tor, tr_piece_index_t const piece)
 {
     auto const hash = recalculate_hash(tor, piece);
@@ -15,6 +15,7 @@
 #include "libtransmission/transmission.h"
 
 #include "libtransmission/block-info.h"
+#include "libtransmission/open-files.h" // tr_open_files::SharedFd
 
 struct tr_torrent;
 
@@ -35,6 +36,21 @@ struct tr_torrent;
  */
 [[nodiscard]] int tr_ioWrite(tr_torrent& tor, tr_block_info::Location const& loc, size_t len, uint8_t const* writeme);
 
+/**
+ * Finds where the block specified by the piece index, offset, and length
+ * lives on disk, so that it can be handed to the kernel as-is, e.g. with
+ * sendfile(). The returned descriptor is shared with other callers and
+ * stays open until the last reference to it is released.
+ * @return 0 on success, EXDEV if the block crosses a file boundary,
+ *         or an errno value on failure.
+ */
+[[nodiscard]] int tr_ioFindFileSpan(
+    tr_torrent const& tor,
+    tr_block_info::Location const& loc,
+    size_t len,
+    tr_open_files::SharedFd* setme_fd,
+    uint64_t* setme_offset);
+
 /**
  * @brief Test to see if the piece matches its metainfo's SHA1 checksum.
  */
@@ -0,0 +1,165 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <algorithm> // std::copy_n, std::min
+#include <array>
+#include <cstddef> // size_t, std::byte
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include <fmt/core.h>
+
+#include "libtransmission/lan-peers.h"
+#include "libtransmission/log.h"
+#include "libtransmission/net.h"
+#include "libtransmission/utils.h"
+
+namespace
+{
+using Bytes = std::array<std::byte, tr_address::CompactAddrMaxBytes>;
+
+[[nodiscard]] Bytes to_bytes(tr_address const& addr) noexcept
+{
+    auto bytes = Bytes{};
+    addr.to_compact(std::begin(bytes));
+    return bytes;
+}
+
+[[nodiscard]] constexpr uint8_t max_prefix_len(tr_address const& addr) noexcept
+{
+    return addr.is_ipv4() ? 32U : 128U;
+}
+} // namespace
+
+bool tr_lan_peers::Subnet::contains(tr_address const& addr) const noexcept
+{
+    if (addr.type != address.type)
+    {
+        return false;
+    }
+
+    auto const a = to_bytes(addr);
+    auto const b = to_bytes(address);
+
+    auto n_bits = size_t{ prefix_len };
+    for (size_t i = 0U; n_bits > 0U; ++i, n_bits -= std::min(n_bits, size_t{ 8U }))
+    {
+        auto const mask = static_cast<std::byte>(0xFF << (8U - std::min(n_bits, size_t{ 8U })));
+        if ((a[i] & mask) != (b[i] & mask))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+std::optional<tr_lan_peers::Subnet> tr_lan_peers::parse_subnet(std::string_view str)
+{
+    // "address" or "address/prefix_len"
+    auto const address = tr_address::from_string(tr_strv_sep(&str, '/'));
+    if (!address)
+    {
+        return {};
+    }
+
+    auto subnet = Subnet{ *address, max_prefix_len(*address) };
+    if (std::empty(str))
+    {
+        return subnet;
+    }
+
+    auto remainder = std::string_view{};
+    auto const prefix_len = tr_num_parse<uint8_t>(str, &remainder);
+    if (!prefix_len || !std::empty(remainder) || *prefix_len > subnet.prefix_len)
+    {
+        return {};
+    }
+
+    subnet.prefix_len = *prefix_len;
+    return subnet;
+}
+
+bool tr_lan_peers::set_subnets(std::string_view subnets)
+{
+    subnets_.clear();
+
+    auto ok = true;
+    auto token = std::string_view{};
+    while (tr_strv_sep(&subnets, &token, ','))
+    {
+        token = tr_strv_strip(token);
+        if (std::empty(token))
+        {
+            continue;
+        }
+
+        if (auto const subnet = parse_subnet(token); subnet)
+        {
+            subnets_.emplace_back(*subnet);
+        }
+        else
+        {
+            tr_logAddWarn(fmt::format("Couldn't parse LAN peer subnet '{}'", token));
+            ok = false;
+        }
+    }
+
+    return ok;
+}
+
+bool tr_lan_peers::contains(tr_address const& addr) const noexcept
+{
+    if (is_local_address(addr))
+    {
+        return true;
+    }
+
+    for (auto const& subnet : subnets_)
+    {
+        if (subnet.contains(addr))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool tr_lan_peers::is_local_address(tr_address const& addr) noexcept
+{
+    auto const a = to_bytes(addr);
+    auto const byte = [&a](size_t i)
+    {
+        return std::to_integer<uint8_t>(a[i]);
+    };
+
+    if (addr.is_ipv4())
+    {
+        return byte(0) == 10U || // 10.0.0.0/8
+            byte(0) == 127U || // 127.0.0.0/8
+            (byte(0) == 169U && byte(1) == 254U) || // 169.254.0.0/16
+            (byte(0) == 172U && (byte(1) & 0xF0U) == 16U) || // 172.16.0.0/12
+            (byte(0) == 192U && byte(1) == 168U); // 192.168.0.0/16
+    }
+
+    if (addr.is_ipv6())
+    {
+        if (addr.is_ipv4_mapped_address())
+        {
+            auto mapped = tr_address{};
+            mapped.type = TR_AF_INET;
+            std::copy_n(std::data(a) + 12U, 4U, reinterpret_cast<std::byte*>(&mapped.addr.addr4.s_addr));
+            return is_local_address(mapped);
+        }
+
+        return (byte(0) & 0xFEU) == 0xFCU || // fc00::/7
+            addr.is_ipv6_link_local_address() || // fe80::/10
+            IN6_IS_ADDR_LOOPBACK(&addr.addr.addr6); // ::1
+    }
+
+    return false;
+}
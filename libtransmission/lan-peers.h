@@ -0,0 +1,63 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#ifndef __TRANSMISSION__
+#error only libtransmission should #include this header.
+#endif
+
+#pragma once
+
+#include <cstddef> // size_t
+#include <cstdint> // uint8_t
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "libtransmission/net.h" // tr_address
+
+/**
+ * Decides which peers are on the local network.
+ *
+ * Peers at private (RFC 1918), unique local (RFC 4193), link-local, or
+ * loopback addresses are local, as are peers in any of the subnets from
+ * the `lan-peer-subnets` setting.
+ *
+ * Local peers get a fast path: bigger socket buffers, a deeper request
+ * queue, plaintext connections unless encryption is required, and, if
+ * `lan-peers-unlimited` is set, no speed limits.
+ */
+class tr_lan_peers
+{
+public:
+    // LAN peers' socket buffers never get smaller than this
+    static auto constexpr MinSocketBuf = size_t{ 1024U * 1024U };
+
+    // Sets the extra subnets to treat as local, e.g. "10.8.0.0/16, fd12:3456::/32".
+    // Returns false if any of them can't be parsed; those are skipped.
+    bool set_subnets(std::string_view subnets);
+
+    [[nodiscard]] bool contains(tr_address const& addr) const noexcept;
+
+    // true for private, unique local, link-local, and loopback addresses
+    [[nodiscard]] static bool is_local_address(tr_address const& addr) noexcept;
+
+    [[nodiscard]] auto n_subnets() const noexcept
+    {
+        return std::size(subnets_);
+    }
+
+private:
+    struct Subnet
+    {
+        [[nodiscard]] bool contains(tr_address const& addr) const noexcept;
+
+        tr_address address;
+        uint8_t prefix_len = {};
+    };
+
+    [[nodiscard]] static std::optional<Subnet> parse_subnet(std::string_view str);
+
+    std::vector<Subnet> subnets_;
+};
@@ -395,30 +395,40 @@ tr_socket_t tr_netBindTCP(tr_address const& addr, tr_port port, bool suppress_ms
     return tr_netBindTCPImpl(addr, port, suppress_msgs, &unused);
 }
 
-std::optional<std::pair<tr_socket_address, tr_socket_t>> tr_netAccept(tr_session* session, tr_socket_t listening_sockfd)
+std::optional<std::pair<tr_socket_address, tr_socket_t>> tr_netAccept(tr_socket_t listening_sockfd)
 {
-    TR_ASSERT(session != nullptr);
-
-    // accept the incoming connection
-    auto sock = sockaddr_storage{};
-    socklen_t len = sizeof(struct sockaddr_storage);
-    auto const sockfd = accept(listening_sockfd, reinterpret_cast<sockaddr*>(&sock), &len);
-    if (sockfd == TR_BAD_SOCKET)
+    for (;;)
     {
-        return {};
-    }
+        // accept the incoming connection
+        auto sock = sockaddr_storage{};
+        socklen_t len = sizeof(struct sockaddr_storage);
+#ifdef HAVE_ACCEPT4
+        auto const sockfd = accept4(listening_sockfd, reinterpret_cast<sockaddr*>(&sock), &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+        auto const sockfd = accept(listening_sockfd, reinterpret_cast<sockaddr*>(&sock), &len);
+#endif
+        if (sockfd == TR_BAD_SOCKET)
+        {
+            // nothing left to accept, or an error; either way, we're done for now
+            return {};
+        }
 
-    // get the address and port,
-    // make the socket unblocking,
-    // and confirm we don't have too many peers
-    auto const addrport = tr_socket_address::from_sockaddr(reinterpret_cast<struct sockaddr*>(&sock));
-    if (!addrport || evutil_make_socket_nonblocking(sockfd) == -1 || tr_peer_socket::limit_reached(session))
-    {
+        // get the address and port,
+        // and make the socket unblocking
+        auto const addrport = tr_socket_address::from_sockaddr(reinterpret_cast<struct sockaddr*>(&sock));
+#ifdef HAVE_ACCEPT4
+        auto const nonblocking = true;
+#else
+        auto const nonblocking = evutil_make_socket_nonblocking(sockfd) != -1;
+#endif
+        if (addrport && nonblocking)
+        {
+            return std::pair{ *addrport, sockfd };
+        }
+
+        // skip this one and try the next
         tr_net_close_socket(sockfd);
-        return {};
     }
-
-    return std::pair{ *addrport, sockfd };
 }
 
 void tr_net_close_socket(tr_socket_t sockfd)
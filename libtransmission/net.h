@@ -460,9 +460,10 @@ struct tr_session;
 
 tr_socket_t tr_netBindTCP(tr_address const& addr, tr_port port, bool suppress_msgs);
 
-[[nodiscard]] std::optional<std::pair<tr_socket_address, tr_socket_t>> tr_netAccept(
-    tr_session* session,
-    tr_socket_t listening_sockfd);
+// Accept the next pending connection on a nonblocking listening socket.
+// The accepted socket is nonblocking too.
+// Returns nullopt when there's nothing left to accept.
+[[nodiscard]] std::optional<std::pair<tr_socket_address, tr_socket_t>> tr_netAccept(tr_socket_t listening_sockfd);
 
 void tr_netSetCongestionControl(tr_socket_t s, char const* algorithm);
 
@@ -5,10 +5,16 @@
 
 #include <algorithm> // std::min
 #include <array>
+#include <cerrno>
 #include <cstdint> // uint8_t, uint64_t
+#include <memory>
 #include <string_view>
 #include <utility>
 
+#ifndef _WIN32
+#include <unistd.h> // dup()
+#endif
+
 #include <fmt/core.h>
 
 #include "libtransmission/transmission.h"
@@ -252,6 +258,37 @@ std::optional<tr_sys_file_t> tr_open_files::get(
     return fd;
 }
 
+tr_open_files::SharedFd tr_open_files::get_shared(tr_torrent_id_t tor_id, tr_file_index_t file_num)
+{
+    auto* const found = pool_.get(make_key(tor_id, file_num));
+    if (found == nullptr)
+    {
+        return {};
+    }
+
+#ifndef _WIN32
+    if (!found->shared_)
+    {
+        auto const fd = dup(found->fd_);
+        if (!is_open(fd))
+        {
+            auto const err = errno;
+            tr_logAddDebug(fmt::format("Couldn't duplicate file descriptor: {} ({})", tr_strerror(err), err));
+            return {};
+        }
+
+        found->shared_ = SharedFd{ new tr_sys_file_t{ fd },
+                                   [](tr_sys_file_t const* pfd)
+                                   {
+                                       tr_sys_file_close(*pfd);
+                                       delete pfd;
+                                   } };
+    }
+#endif
+
+    return found->shared_;
+}
+
 void tr_open_files::close_all()
 {
     pool_.clear();
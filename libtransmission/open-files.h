@@ -11,6 +11,7 @@
 
 #include <cstddef> // for size_t
 #include <cstdint> // for uintX_t
+#include <memory>
 #include <optional>
 #include <string_view>
 #include <utility>
@@ -31,6 +32,11 @@ public:
         Full
     };
 
+    // A read-only descriptor for a file in the pool that stays open for as
+    // long as someone holds a reference to it, even after the pool closes
+    // the file. Used to queue file spans for sendfile().
+    using SharedFd = std::shared_ptr<tr_sys_file_t const>;
+
     [[nodiscard]] std::optional<tr_sys_file_t> get(tr_torrent_id_t tor_id, tr_file_index_t file_num, bool writable);
 
     [[nodiscard]] std::optional<tr_sys_file_t> get(
@@ -41,6 +47,10 @@ public:
         Preallocation allocation,
         uint64_t file_size);
 
+    // Returns a SharedFd for a file that's already open in the pool.
+    // All callers share a single duplicate of the pool's descriptor.
+    [[nodiscard]] SharedFd get_shared(tr_torrent_id_t tor_id, tr_file_index_t file_num);
+
     void close_all();
     void close_torrent(tr_torrent_id_t tor_id);
     void close_file(tr_torrent_id_t tor_id, tr_file_index_t file_num);
@@ -66,11 +76,13 @@ private:
         {
             std::swap(this->fd_, that.fd_);
             std::swap(this->writable_, that.writable_);
+            std::swap(this->shared_, that.shared_);
             return *this;
         }
         ~Val();
 
         tr_sys_file_t fd_ = TR_BAD_SYS_FILE;
+        SharedFd shared_;
         bool writable_ = false;
     };
 
@@ -12,6 +12,8 @@
 #include <array>
 #include <cstddef> // size_t
 #include <cstdint> // uint8_t, uint32_t, uint64_t
+#include <ctime> // time_t
+#include <optional>
 #include <string>
 
 #include "libtransmission/transmission.h"
@@ -41,6 +43,7 @@ public:
         ClientGotBlock, // applies to webseed too
         ClientGotChoke,
         ClientGotPieceData, // applies to webseed too
+        ClientGotWastedData, // piece data that arrived too late to be used
         ClientGotAllowedFast,
         ClientGotSuggest,
         ClientGotPort,
@@ -49,6 +52,7 @@ public:
         ClientGotHave,
         ClientGotHaveAll,
         ClientGotHaveNone,
+        ClientSentBlock, // a block of ours was queued for the peer
         ClientSentPieceData,
         Error // generic
     };
@@ -58,7 +62,7 @@ public:
     tr_bitfield* bitfield = nullptr; // for GotBitfield
     uint32_t pieceIndex = 0; // for GotBlock, GotHave, Cancel, Allowed, Suggest
     uint32_t offset = 0; // for GotBlock
-    uint32_t length = 0; // for GotBlock, GotPieceData
+    uint32_t length = 0; // for GotBlock, GotPieceData, GotWastedData
     int err = 0; // errno for GotError
     tr_port port = {}; // for GotPort
 
@@ -161,6 +165,23 @@ public:
         return event;
     }
 
+    [[nodiscard]] constexpr static auto GotWastedData(uint32_t length) noexcept
+    {
+        auto event = tr_peer_event{};
+        event.type = Type::ClientGotWastedData;
+        event.length = length;
+        return event;
+    }
+
+    [[nodiscard]] constexpr static auto SentBlock(tr_piece_index_t piece, uint32_t length) noexcept
+    {
+        auto event = tr_peer_event{};
+        event.type = Type::ClientSentBlock;
+        event.pieceIndex = piece;
+        event.length = length;
+        return event;
+    }
+
     [[nodiscard]] constexpr static auto SentPieceData(uint32_t length) noexcept
     {
         auto event = tr_peer_event{};
@@ -229,6 +250,24 @@ struct tr_peer
     // whether or not this peer sent us any given block
     tr_bitfield blame;
 
+    // whether or not we've sent this peer any of a given piece
+    tr_bitfield served;
+
+    // how many pieces we served this peer have since
+    // shown up at peers that we didn't serve them to
+    tr_recentHistory<uint16_t> pieces_redistributed;
+
+    // when we last unchoked this peer, or 0 if we never have
+    uint64_t unchoked_at_msec = 0;
+
+    // the piece we're currently super-seeding to this peer, and when we offered it
+    std::optional<tr_piece_index_t> super_seed_piece;
+    time_t super_seed_offered_at = 0;
+
+    // how many of this peer's pieces we still want.
+    // We're interested in the peer iff this is nonzero.
+    size_t wanted_piece_count = 0;
+
     // whether or not we should free this peer soon.
     bool do_purge = false;
 
@@ -254,6 +293,10 @@ struct tr_swarm_stats
     std::array<uint16_t, TR_PEER_FROM__MAX> peer_from_count;
     // known peers by peer source
     std::array<uint16_t, TR_PEER_FROM__MAX> known_peer_from_count;
+    // pieces that peers finished with data that we uploaded to them
+    uint64_t distributed_pieces;
+    // approximate memory used by the known peers pool
+    uint64_t peer_pool_bytes;
 };
 
 tr_swarm_stats tr_swarmGetStats(tr_swarm const* swarm);
@@ -3,6 +3,7 @@
 // or any future license endorsed by Mnemosyne LLC.
 // License text can be found in the licenses/ folder.
 
+#include <array>
 #include <cerrno>
 #include <cstdint>
 #include <functional>
@@ -27,6 +28,7 @@
 #include "libtransmission/bandwidth.h"
 #include "libtransmission/block-info.h" // tr_block_info
 #include "libtransmission/error.h"
+#include "libtransmission/lan-peers.h"
 #include "libtransmission/log.h"
 #include "libtransmission/net.h"
 #include "libtransmission/peer-io.h"
@@ -126,7 +128,8 @@ std::shared_ptr<tr_peerIo> tr_peerIo::new_outgoing(
     tr_socket_address const& socket_address,
     tr_sha1_digest_t const& info_hash,
     bool is_seed,
-    bool utp)
+    bool utp,
+    bool tcp)
 {
     using preferred_key_t = std::underlying_type_t<tr_preferred_transport>;
     auto const preferred = session->preferred_transport();
@@ -134,7 +137,7 @@ std::shared_ptr<tr_peerIo> tr_peerIo::new_outgoing(
     TR_ASSERT(!tr_peer_socket::limit_reached(session));
     TR_ASSERT(session != nullptr);
     TR_ASSERT(socket_address.is_valid());
-    TR_ASSERT(utp || session->allowsTCP());
+    TR_ASSERT(utp || (tcp && session->allowsTCP()));
 
     auto peer_io = tr_peerIo::create(session, parent, &info_hash, false, is_seed);
     auto const func = small::max_size_map<preferred_key_t, std::function<bool()>, TR_NUM_PREFERRED_TRANSPORT>{
@@ -160,7 +163,7 @@ std::shared_ptr<tr_peerIo> tr_peerIo::new_outgoing(
         { TR_PREFER_TCP,
           [&]()
           {
-              if (!peer_io->socket_.is_valid())
+              if (tcp && !peer_io->socket_.is_valid())
               {
                   if (auto sock = tr_netOpenPeerSocket(session, socket_address, is_seed); sock.is_valid())
                   {
@@ -206,6 +209,10 @@ void tr_peerIo::set_socket(tr_peer_socket socket_in)
     close(); // tear down the previous socket, if any
 
     socket_ = std::move(socket_in);
+    buffers_ = {};
+    buffers_tuned_at_ = {};
+
+    update_lan_status();
 
     if (socket_.is_tcp())
     {
@@ -224,6 +231,15 @@ void tr_peerIo::set_socket(tr_peer_socket socket_in)
     }
 }
 
+void tr_peerIo::update_lan_status()
+{
+    // LAN peers get the fast path, which can include ignoring the speed limits
+    is_lan_ = session_->lan_peers().contains(socket_.address());
+    auto const is_unlimited = is_lan_ && session_->lan_peers_unlimited();
+    bandwidth_.honor_parent_limits(TR_UP, !is_unlimited);
+    bandwidth_.honor_parent_limits(TR_DOWN, !is_unlimited);
+}
+
 void tr_peerIo::close()
 {
     socket_.close();
@@ -260,6 +276,8 @@ bool tr_peerIo::reconnect()
         return false;
     }
     socket_ = std::move(sock);
+    buffers_ = {};
+    buffers_tuned_at_ = {};
 
     this->event_read_.reset(event_new(session_->event_base(), socket_.handle.tcp, EV_READ, event_read_cb, this));
     this->event_write_.reset(event_new(session_->event_base(), socket_.handle.tcp, EV_WRITE, event_write_cb, this));
@@ -314,8 +332,7 @@ size_t tr_peerIo::try_write(size_t max)
         return {};
     }
 
-    auto& buf = outbuf_;
-    max = std::min(max, std::size(buf));
+    max = std::min(max, pending_write_bytes());
     max = bandwidth().clamp(Dir, max);
     if (max == 0U)
     {
@@ -324,26 +341,201 @@ size_t tr_peerIo::try_write(size_t max)
     }
 
     auto error = tr_error{};
-    auto const n_written = socket_.try_write(buf, max, &error);
+    auto const n_written = std::empty(outchunks_) ? socket_.try_write(outbuf_, max, &error) : try_write_chunks(max, &error);
     // enable further writes if there's more data to write
-    set_enabled(Dir, !std::empty(buf) && (!error || can_retry_from_error(error.code())));
+    set_enabled(Dir, pending_write_bytes() > 0U && (!error || can_retry_from_error(error.code())));
 
-    if (error)
+    // account for what was sent before looking at errors, since
+    // try_write_chunks() can fail after having made some progress
+    if (n_written > 0U)
     {
-        if (!can_retry_from_error(error.code()))
+        did_write_wrapper(n_written);
+    }
+
+    if (error && !can_retry_from_error(error.code()))
+    {
+        tr_logAddTraceIo(
+            this,
+            fmt::format("try_write err: wrote:{}, errno:{} ({})", n_written, error.code(), error.message()));
+        call_error_callback(error);
+    }
+
+    return n_written;
+}
+
+// Send up to `max` bytes, alternating between outbuf_ and the queued
+// chunks so that everything goes out in the order it was written.
+size_t tr_peerIo::try_write_chunks(size_t max, tr_error* error)
+{
+    using ConstSpan = tr_peer_socket::ConstSpan;
+
+    auto n_written = size_t{};
+
+    while (n_written < max && pending_write_bytes() > 0U)
+    {
+        auto const budget = max - n_written;
+        auto n_wanted = size_t{};
+        auto n_sent = size_t{};
+
+        if (!std::empty(outchunks_) && outchunks_.front().is_file() && outchunks_.front().n_buffered_before == 0U)
         {
-            tr_logAddTraceIo(
-                this,
-                fmt::format("try_write err: wrote:{}, errno:{} ({})", n_written, error.code(), error.message()));
-            call_error_callback(error);
+            auto& chunk = outchunks_.front();
+            n_wanted = std::min(budget, chunk.n_bytes);
+            n_sent = socket_.try_write_file(*chunk.file, chunk.offset, n_wanted, error);
+            chunk.n_bytes -= n_sent;
+            n_chunk_bytes_ -= n_sent;
+            if (chunk.n_bytes == 0U)
+            {
+                outchunks_.pop_front();
+            }
+        }
+        else
+        {
+            // gather everything up to the next file chunk into a single write
+            auto spans = std::array<ConstSpan, tr_peer_socket::MaxWritevSpans>{};
+            auto n_spans = size_t{};
+            auto add_span = [&](std::byte const* data, size_t len)
+            {
+                len = std::min(len, budget - n_wanted);
+                if (len > 0U)
+                {
+                    spans[n_spans++] = ConstSpan{ data, len };
+                    n_wanted += len;
+                }
+            };
+
+            auto const* buffered = std::data(outbuf_);
+            auto more = false;
+            auto iter = std::begin(outchunks_);
+            for (auto const end = std::end(outchunks_); iter != end; ++iter)
+            {
+                if (n_spans + 3U > std::size(spans) || n_wanted == budget)
+                {
+                    break;
+                }
+
+                add_span(buffered, iter->n_buffered_before);
+                buffered += iter->n_buffered_before;
+
+                if (iter->is_file())
+                {
+                    // the file chunk follows immediately, so tell the kernel
+                    // not to push out e.g. the piece message's header by itself
+                    more = n_wanted < budget;
+                    break;
+                }
+
+                auto const [data, len] = iter->unsent();
+                add_span(data, len);
+            }
+
+            if (iter == std::end(outchunks_))
+            {
+                add_span(buffered, std::data(outbuf_) + std::size(outbuf_) - buffered);
+            }
+
+            n_sent = socket_.try_writev(std::data(spans), n_spans, error, more);
+            drain_chunks(n_sent);
+        }
+
+        n_written += n_sent;
+
+        if (n_sent == 0U || n_sent < n_wanted || (error != nullptr && *error))
+        {
+            break;
         }
     }
-    else if (n_written > 0U)
+
+    return n_written;
+}
+
+// Remove `n_bytes` that were sent by try_writev() from the front of the queue.
+void tr_peerIo::drain_chunks(size_t n_bytes)
+{
+    while (n_bytes > 0U && !std::empty(outchunks_))
     {
-        did_write_wrapper(n_written);
+        auto& chunk = outchunks_.front();
+
+        auto n_drained = std::min(n_bytes, chunk.n_buffered_before);
+        outbuf_.drain(n_drained);
+        chunk.n_buffered_before -= n_drained;
+        n_bytes -= n_drained;
+
+        if (n_bytes == 0U)
+        {
+            return;
+        }
+
+        // file chunks are only sent by try_write_file()
+        TR_ASSERT(!chunk.is_file());
+
+        n_drained = std::min(n_bytes, chunk.n_bytes);
+        chunk.offset += n_drained;
+        chunk.n_bytes -= n_drained;
+        n_chunk_bytes_ -= n_drained;
+        n_bytes -= n_drained;
+
+        if (chunk.n_bytes == 0U)
+        {
+            outchunks_.pop_front();
+        }
     }
 
-    return n_written;
+    outbuf_.drain(n_bytes);
+}
+
+void tr_peerIo::push_chunk(OutboundChunk&& chunk, bool is_piece_data)
+{
+    chunk.n_buffered_before = std::empty(outchunks_) ? std::size(outbuf_) : n_buffered_after_chunks_;
+    n_buffered_after_chunks_ = {};
+    n_chunk_bytes_ += chunk.n_bytes;
+    queue_write_info(chunk.n_bytes, is_piece_data);
+    outchunks_.emplace_back(std::move(chunk));
+}
+
+void tr_peerIo::write_chunk(std::shared_ptr<std::byte const> data, size_t n_bytes, bool is_piece_data)
+{
+    if (n_bytes == 0U)
+    {
+        return;
+    }
+
+    if (is_encrypted())
+    {
+        // we can't encrypt someone else's data in place
+        write_bytes(data.get(), n_bytes, is_piece_data);
+        return;
+    }
+
+    push_chunk(OutboundChunk{ std::move(data), n_bytes }, is_piece_data);
+}
+
+void tr_peerIo::write_owned_chunk(std::shared_ptr<std::byte> data, size_t n_bytes, bool is_piece_data)
+{
+    if (n_bytes == 0U)
+    {
+        return;
+    }
+
+    filter_.encrypt(data.get(), n_bytes, data.get());
+    push_chunk(OutboundChunk{ std::shared_ptr<std::byte const>{ std::move(data) }, n_bytes }, is_piece_data);
+}
+
+void tr_peerIo::write_file(
+    std::shared_ptr<tr_sys_file_t const> file,
+    uint64_t offset,
+    size_t n_bytes,
+    bool is_piece_data)
+{
+    TR_ASSERT(supports_sendfile());
+    TR_ASSERT(file);
+
+    if (n_bytes == 0U)
+    {
+        return;
+    }
+
+    push_chunk(OutboundChunk{ std::move(file), offset, n_bytes }, is_piece_data);
 }
 
 void tr_peerIo::event_write_cb([[maybe_unused]] evutil_socket_t fd, short /*event*/, void* vio)
@@ -375,58 +567,51 @@ void tr_peerIo::can_read_wrapper()
     auto const lock = session_->unique_lock();
     auto const keep_alive = shared_from_this();
 
-    auto const now = tr_time_msec();
-    auto done = false;
-    auto err = false;
-
-    // In normal conditions, only continue processing if we still have bandwidth
-    // quota for it.
+    // In normal conditions, only process as much input as we have bandwidth
+    // quota for.
     //
     // The read buffer will grow indefinitely if libutp or the TCP stack keeps buffering
     // data faster than the bandwidth limit allows. To safeguard against that, we keep
-    // processing if the read buffer is more than twice as large as the target size.
-    while (!done && !err && (read_buffer_size() > RcvBuf * 2U || bandwidth().clamp(TR_DOWN, read_buffer_size()) != 0U))
+    // processing until the read buffer is no more than twice as large as the target size.
+    auto const n_start = read_buffer_size();
+    auto const n_over = n_start > read_size() * 2U ? n_start - read_size() * 2U : 0U;
+    auto const max_bytes = std::max(n_over, bandwidth().clamp(TR_DOWN, n_start));
+
+    // Let the reader take as many messages as it can per call. We only
+    // call it again if it hands the input off to a different reader,
+    // e.g. when a handshake finishes and the peer-msgs take over.
+    auto n_piece = size_t{};
+    for (auto read_state = READ_NOW; read_state == READ_NOW && can_read_ != nullptr && !std::empty(inbuf_);)
     {
-        size_t piece = 0U;
-        auto const old_len = read_buffer_size();
-        auto const read_state = can_read_ != nullptr ? can_read_(this, user_data_, &piece) : READ_ERR;
-        auto const used = old_len - read_buffer_size();
-        auto const overhead = socket_.guess_packet_overhead(used);
-
-        if (piece != 0U)
+        auto const n_used = n_start - read_buffer_size();
+        if (n_used >= max_bytes)
         {
-            bandwidth().notify_bandwidth_consumed(TR_DOWN, piece, true, now);
-        }
-
-        if (used != piece)
-        {
-            bandwidth().notify_bandwidth_consumed(TR_DOWN, used - piece, false, now);
+            break;
         }
 
-        if (overhead > 0U)
-        {
-            bandwidth().notify_bandwidth_consumed(TR_DOWN, overhead, false, now);
-        }
+        auto piece = size_t{};
+        read_state = can_read_(this, user_data_, max_bytes - n_used, &piece);
+        n_piece += piece;
+    }
 
-        switch (read_state)
-        {
-        case READ_NOW:
-            if (!std::empty(inbuf_))
-            {
-                continue;
-            }
+    // account for all of it at once
+    auto const now = tr_time_msec();
+    auto const used = n_start - read_buffer_size();
+    auto const overhead = socket_.guess_packet_overhead(used);
 
-            done = true;
-            break;
+    if (n_piece != 0U)
+    {
+        bandwidth().notify_bandwidth_consumed(TR_DOWN, n_piece, true, now);
+    }
 
-        case READ_LATER:
-            done = true;
-            break;
+    if (used != n_piece)
+    {
+        bandwidth().notify_bandwidth_consumed(TR_DOWN, used - n_piece, false, now);
+    }
 
-        case READ_ERR:
-            err = true;
-            break;
-        }
+    if (overhead > 0U)
+    {
+        bandwidth().notify_bandwidth_consumed(TR_DOWN, overhead, false, now);
     }
 }
 
@@ -451,6 +636,7 @@ size_t tr_peerIo::try_read(size_t max)
     auto& buf = inbuf_;
     auto error = tr_error{};
     auto const n_read = socket_.try_read(buf, max, std::empty(buf), &error);
+    buf.trim(); // don't hold onto storage if nothing was read
     set_enabled(Dir, !error || can_retry_from_error(error.code()));
 
     if (error)
@@ -471,9 +657,8 @@ size_t tr_peerIo::try_read(size_t max)
 
 void tr_peerIo::event_read_cb([[maybe_unused]] evutil_socket_t fd, short /*event*/, void* vio)
 {
-    static auto constexpr MaxLen = RcvBuf;
-
     auto* const io = static_cast<tr_peerIo*>(vio);
+    auto const max_len = io->read_size();
     tr_logAddTraceIo(io, "libevent says this peer socket is ready for reading");
 
     TR_ASSERT(io->socket_.is_tcp());
@@ -483,7 +668,7 @@ void tr_peerIo::event_read_cb([[maybe_unused]] evutil_socket_t fd, short /*event
 
     // if we don't have any bandwidth left, stop reading
     auto const n_used = std::size(io->inbuf_);
-    auto const n_left = n_used >= MaxLen ? 0U : MaxLen - n_used;
+    auto const n_left = n_used >= max_len ? 0U : max_len - n_used;
     io->try_read(n_left);
 }
 
@@ -576,6 +761,15 @@ size_t tr_peerIo::flush(tr_direction dir, size_t limit)
     return dir == TR_DOWN ? try_read(limit) : try_write(limit);
 }
 
+tr_peer_memory_usage tr_peerIo::memory_usage() const noexcept
+{
+    auto ret = tr_peer_memory_usage{};
+    ret.io_bytes = sizeof(*this) + outbuf_info_.capacity() * sizeof(outbuf_info_.front()) +
+        outchunks_.capacity() * sizeof(OutboundChunk);
+    ret.buffer_bytes = inbuf_.capacity_bytes() + outbuf_.capacity_bytes();
+    return ret;
+}
+
 size_t tr_peerIo::flush_outgoing_protocol_msgs()
 {
     size_t byte_count = 0U;
@@ -597,10 +791,72 @@ size_t tr_peerIo::flush_outgoing_protocol_msgs()
 
 // ---
 
+void tr_peerIo::tune_buffers(uint64_t now_msec)
+{
+    if (!socket_.is_valid())
+    {
+        return;
+    }
+
+    // Leave the OS defaults alone until we've seen some traffic.
+    // LAN peers skip the wait, since their buffers start out bigger.
+    if (buffers_tuned_at_ == 0U && !is_lan_)
+    {
+        buffers_tuned_at_ = now_msec;
+        return;
+    }
+
+    if (buffers_tuned_at_ != 0U && now_msec - buffers_tuned_at_ < TuneBuffersIntervalMsec)
+    {
+        return;
+    }
+
+    buffers_tuned_at_ = now_msec;
+
+    auto const down = bandwidth_.get_raw_speed(now_msec, TR_DOWN).base_quantity();
+    auto const up = bandwidth_.get_raw_speed(now_msec, TR_UP).base_quantity();
+    auto const rtt_usec = socket_.rtt_usec().value_or(DefaultRttUsec);
+    auto const min_socket_buf = is_lan_ ? tr_lan_peers::MinSocketBuf : tr_peer_io_buffers::MinSocketBuf;
+    auto picked = tr_peer_io_buffers::pick(buffers_, down, up, rtt_usec, min_socket_buf);
+
+    if (picked.socket_rcvbuf != buffers_.socket_rcvbuf || picked.socket_sndbuf != buffers_.socket_sndbuf)
+    {
+        tr_logAddTraceIo(
+            this,
+            fmt::format(
+                "rtt {} usec; picked rcvbuf {}, sndbuf {}, read size {}",
+                rtt_usec,
+                picked.socket_rcvbuf,
+                picked.socket_sndbuf,
+                picked.read_size));
+        // only applies to µTP; the kernel autotunes TCP's buffers
+        socket_.set_buffer_sizes(picked.socket_rcvbuf, picked.socket_sndbuf);
+    }
+
+    if (picked.notsent_lowat != buffers_.notsent_lowat && !socket_.set_notsent_lowat(picked.notsent_lowat))
+    {
+        picked.notsent_lowat = {};
+    }
+
+    buffers_ = picked;
+}
+
+tr_peer_io_buffers tr_peerIo::applied_buffers() const
+{
+    auto ret = buffers_;
+
+    auto const sizes = socket_.buffer_sizes();
+    ret.socket_rcvbuf = sizes ? sizes->first : 0U;
+    ret.socket_sndbuf = sizes ? sizes->second : 0U;
+    ret.rtt_usec = socket_.rtt_usec().value_or(0U);
+
+    return ret;
+}
+
 size_t tr_peerIo::get_write_buffer_space(uint64_t now) const noexcept
 {
     size_t const desired_len = get_desired_output_buffer_size(this, now);
-    size_t const current_len = std::size(outbuf_);
+    size_t const current_len = pending_write_bytes();
     return desired_len > current_len ? desired_len - current_len : 0U;
 }
 
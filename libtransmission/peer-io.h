@@ -12,10 +12,9 @@
 #include <algorithm>
 #include <cstddef> // size_t
 #include <cstdint> // uintX_t
-#include <deque>
 #include <memory>
 #include <optional>
-#include <utility> // std::pair
+#include <utility> // std::move, std::pair
 
 #include <event2/util.h> // for evutil_socket_t
 
@@ -23,8 +22,10 @@
 
 #include "libtransmission/bandwidth.h"
 #include "libtransmission/block-info.h"
+#include "libtransmission/file.h" // tr_sys_file_t
 #include "libtransmission/peer-mse.h"
 #include "libtransmission/peer-socket.h"
+#include "libtransmission/ring.h"
 #include "libtransmission/tr-buffer.h"
 #include "libtransmission/tr-macros.h" // tr_sha1_digest_t, TR_CONSTEXPR20
 #include "libtransmission/utils-ev.h"
@@ -37,6 +38,8 @@ struct tr_socket_address;
 namespace libtransmission::test
 {
 class HandshakeTest;
+class PeerIoTest;
+class PeerMsgsTest;
 } // namespace libtransmission::test
 
 enum ReadState
@@ -46,6 +49,73 @@ enum ReadState
     READ_ERR
 };
 
+// The buffer sizes that tr_peerIo has picked for a connection,
+// based on the connection's throughput and round-trip time.
+// Everything is zero until there's been enough traffic to pick them.
+struct tr_peer_io_buffers
+{
+    static constexpr auto MinSocketBuf = size_t{ 32U * 1024U };
+    static constexpr auto MaxSocketBuf = size_t{ 8U * 1024U * 1024U };
+    static constexpr auto MaxReadSize = size_t{ 4U * 1024U * 1024U };
+    static constexpr auto MinNotsentLowat = size_t{ 16U * 1024U };
+
+    // Pick new sizes for a connection whose buffers are currently `current`.
+    // The socket buffers are sized to hold two bandwidth-delay products so
+    // that a window-limited connection can double its speed between calls.
+    // They grow right away, but only shrink once they're far too big,
+    // and never below `min_socket_buf`.
+    [[nodiscard]] static constexpr tr_peer_io_buffers pick(
+        tr_peer_io_buffers const& current,
+        uint64_t down_bytes_per_second,
+        uint64_t up_bytes_per_second,
+        uint32_t rtt_usec,
+        size_t min_socket_buf = MinSocketBuf) noexcept
+    {
+        auto const settle = [rtt_usec, min_socket_buf](size_t const cur, uint64_t const bytes_per_second)
+        {
+            auto const bdp = bytes_per_second * rtt_usec / 1000000U;
+            auto const wanted = static_cast<size_t>(
+                std::clamp(bdp * 2U, uint64_t{ min_socket_buf }, uint64_t{ std::max(min_socket_buf, MaxSocketBuf) }));
+            return cur == 0U || wanted > cur || wanted <= cur / 4U ? wanted : cur;
+        };
+
+        auto ret = tr_peer_io_buffers{};
+        ret.socket_rcvbuf = settle(current.socket_rcvbuf, down_bytes_per_second);
+        ret.socket_sndbuf = settle(current.socket_sndbuf, up_bytes_per_second);
+        ret.notsent_lowat = std::max(MinNotsentLowat, ret.socket_sndbuf / 4U);
+        ret.read_size = std::min(ret.socket_rcvbuf, MaxReadSize);
+        ret.rtt_usec = rtt_usec;
+        return ret;
+    }
+
+    // UTP_RCVBUF and UTP_SNDBUF for µTP. TCP's socket buffers are left
+    // to the kernel, but these still size read_size and notsent_lowat.
+    size_t socket_rcvbuf = {};
+    size_t socket_sndbuf = {};
+
+    // TCP_NOTSENT_LOWAT, or zero if it's not supported
+    size_t notsent_lowat = {};
+
+    // the most bytes to read from the socket at once
+    size_t read_size = {};
+
+    // the round-trip time that these sizes were picked for
+    uint32_t rtt_usec = {};
+};
+
+// Approximately how much memory one peer connection is using.
+struct tr_peer_memory_usage
+{
+    // the tr_peerMsgs and what it owns, besides buffers
+    size_t msgs_bytes = {};
+
+    // the tr_peerIo, including its tr_bandwidth and write queues
+    size_t io_bytes = {};
+
+    // storage for data that's waiting to be parsed, sent, or saved
+    size_t buffer_bytes = {};
+};
+
 enum tr_preferred_transport : uint8_t
 {
     // More preferred transports goes on top
@@ -58,7 +128,8 @@ class tr_peerIo final : public std::enable_shared_from_this<tr_peerIo>
 {
     using DH = tr_message_stream_encryption::DH;
     using Filter = tr_message_stream_encryption::Filter;
-    using CanRead = ReadState (*)(tr_peerIo* io, void* user_data, size_t* setme_piece_byte_count);
+    // Reads up to about `max_bytes` of input, i.e. as many messages as fit in it.
+    using CanRead = ReadState (*)(tr_peerIo* io, void* user_data, size_t max_bytes, size_t* setme_piece_byte_count);
     using DidWrite = void (*)(tr_peerIo* io, size_t bytesWritten, bool wasPieceData, void* userData);
     using GotError = void (*)(tr_peerIo* io, tr_error const& error, void* userData);
 
@@ -78,7 +149,8 @@ public:
         tr_socket_address const& socket_address,
         tr_sha1_digest_t const& info_hash,
         bool is_seed,
-        bool utp);
+        bool utp,
+        bool tcp = true);
 
     static std::shared_ptr<tr_peerIo> new_incoming(tr_session* session, tr_bandwidth* parent, tr_peer_socket socket);
 
@@ -95,6 +167,11 @@ public:
         set_callbacks(nullptr, nullptr, nullptr, nullptr);
     }
 
+    [[nodiscard]] constexpr auto has_callbacks() const noexcept
+    {
+        return can_read_ != nullptr;
+    }
+
     void set_socket(tr_peer_socket);
 
     [[nodiscard]] constexpr auto is_utp() const noexcept
@@ -128,6 +205,13 @@ public:
 
     void read_bytes(void* bytes, size_t n_bytes);
 
+    // Process any input that's already been received, e.g. when the
+    // reader had been waiting on something other than more input.
+    void process_read_buffer()
+    {
+        can_read_wrapper();
+    }
+
     void read_uint8(uint8_t* setme)
     {
         read_bytes(setme, sizeof(uint8_t));
@@ -143,7 +227,8 @@ public:
 
     void write_bytes(void const* bytes, size_t n_bytes, bool is_piece_data)
     {
-        outbuf_info_.emplace_back(n_bytes, is_piece_data);
+        queue_write_info(n_bytes, is_piece_data);
+        n_buffered_after_chunks_ += n_bytes;
 
         auto [resbuf, reslen] = outbuf_.reserve_space(n_bytes);
         filter_.encrypt(reinterpret_cast<std::byte const*>(bytes), n_bytes, resbuf);
@@ -160,8 +245,47 @@ public:
         buf.drain(n_bytes);
     }
 
+    // True if write_file() can be used on this peer, i.e. if the bytes
+    // can go from disk to the socket without being copied or encrypted.
+    [[nodiscard]] constexpr bool supports_sendfile() const noexcept
+    {
+        return socket_.can_send_files() && !filter_.is_active();
+    }
+
+    // Queue `n_bytes` from `file`, starting at `offset`, to be sent after
+    // everything that's already been written. Queued spans keep a reference
+    // to `file`, so spans from the same file share one descriptor.
+    // Only valid if supports_sendfile() is true.
+    void write_file(std::shared_ptr<tr_sys_file_t const> file, uint64_t offset, size_t n_bytes, bool is_piece_data);
+
+    // Queue `n_bytes` at `data` to be sent after everything that's already
+    // been written. This keeps a reference to `data` instead of copying it,
+    // so `data` must not be modified afterwards.
+    // On encrypted peers, `data` is copied as write_bytes() would.
+    void write_chunk(std::shared_ptr<std::byte const> data, size_t n_bytes, bool is_piece_data);
+
+    // Like write_chunk(), but the caller hands over `data` completely,
+    // which lets encrypted peers encrypt it in place instead of copying it.
+    void write_owned_chunk(std::shared_ptr<std::byte> data, size_t n_bytes, bool is_piece_data);
+
     size_t flush_outgoing_protocol_msgs();
 
+    // Resize the connection's buffers to suit its current throughput
+    // and round-trip time. Cheap to call often; it rate-limits itself.
+    void tune_buffers(uint64_t now_msec);
+
+    [[nodiscard]] constexpr auto const& buffers() const noexcept
+    {
+        return buffers_;
+    }
+
+    // Like buffers(), but with the socket buffer sizes that are actually
+    // in effect and the RTT that was measured, or 0 for whatever's unknown.
+    [[nodiscard]] tr_peer_io_buffers applied_buffers() const;
+
+    // Fills in `io_bytes` and `buffer_bytes`.
+    [[nodiscard]] tr_peer_memory_usage memory_usage() const noexcept;
+
     size_t flush(tr_direction dir, size_t byte_limit);
 
     ///
@@ -265,6 +389,16 @@ public:
         return is_incoming_;
     }
 
+    // true if the peer is on the local network, per tr_lan_peers
+    [[nodiscard]] constexpr auto is_lan() const noexcept
+    {
+        return is_lan_;
+    }
+
+    // Re-check is_lan() and whether that exempts the peer from the speed
+    // limits. Done when the socket is set and when the LAN settings change.
+    void update_lan_status();
+
     [[nodiscard]] constexpr auto const& address() const noexcept
     {
         return socket_.address();
@@ -319,14 +453,64 @@ public:
 private:
     // Our target socket receive buffer size.
     // Gets read from the socket buffer into the PeerBuffer inbuf_.
+    // This is the default until tune_buffers() picks a size.
     static constexpr auto RcvBuf = size_t{ 256 * 1024 };
 
-    // The buffer size for incoming & outgoing peer messages.
-    // Starts off with enough capacity to read a single BT Piece message,
-    // but has a 5x GrowthFactor so that it can quickly to high volume.
-    using PeerBuffer = libtransmission::StackBuffer<tr_block_info::BlockSize + 16U, std::byte, std::ratio<5, 1>>;
+    // How often tune_buffers() resizes the buffers.
+    static constexpr auto TuneBuffersIntervalMsec = uint64_t{ 4000U };
+
+    // The RTT to assume when the transport can't tell us, e.g. for µTP.
+    static constexpr auto DefaultRttUsec = uint32_t{ 100000U };
+
+    // The buffer for incoming & outgoing peer messages.
+    // Only holds storage while there's data pending, starting off with
+    // enough capacity to read a single BT Piece message.
+    using PeerBuffer = libtransmission::PooledBuffer<tr_block_info::BlockSize + 16U, std::byte>;
+
+    // A run of bytes that is sent without being copied into outbuf_:
+    // either a refcounted chunk of memory queued by write_chunk(),
+    // or a part of a file queued by write_file().
+    struct OutboundChunk
+    {
+        OutboundChunk(std::shared_ptr<std::byte const> data_in, size_t n_bytes_in) noexcept
+            : data{ std::move(data_in) }
+            , n_bytes{ n_bytes_in }
+        {
+        }
+
+        OutboundChunk(std::shared_ptr<tr_sys_file_t const> file_in, uint64_t offset_in, size_t n_bytes_in) noexcept
+            : file{ std::move(file_in) }
+            , offset{ offset_in }
+            , n_bytes{ n_bytes_in }
+        {
+        }
+
+        [[nodiscard]] auto is_file() const noexcept
+        {
+            return static_cast<bool>(file);
+        }
+
+        [[nodiscard]] auto unsent() const noexcept
+        {
+            return tr_peer_socket::ConstSpan{ data.get() + offset, n_bytes };
+        }
+
+        std::shared_ptr<std::byte const> data;
+        std::shared_ptr<tr_sys_file_t const> file;
+
+        // the position of the next unsent byte in `data` or `fd`
+        uint64_t offset = {};
+
+        // how many bytes are left to send
+        size_t n_bytes = {};
+
+        // how many bytes of outbuf_ must be sent before this chunk
+        size_t n_buffered_before = {};
+    };
 
     friend class libtransmission::test::HandshakeTest;
+    friend class libtransmission::test::PeerIoTest;
+    friend class libtransmission::test::PeerMsgsTest;
 
     [[nodiscard]] constexpr auto is_seed() const noexcept
     {
@@ -359,6 +543,32 @@ private:
 
     size_t try_read(size_t max);
     size_t try_write(size_t max);
+    size_t try_write_chunks(size_t max, tr_error* error);
+    void drain_chunks(size_t n_bytes);
+    void push_chunk(OutboundChunk&& chunk, bool is_piece_data);
+
+    void queue_write_info(size_t n_bytes, bool is_piece_data)
+    {
+        // merge runs of the same kind of data to keep the queue short
+        if (!std::empty(outbuf_info_) && outbuf_info_.back().second == is_piece_data)
+        {
+            outbuf_info_.back().first += n_bytes;
+        }
+        else
+        {
+            outbuf_info_.emplace_back(n_bytes, is_piece_data);
+        }
+    }
+
+    [[nodiscard]] TR_CONSTEXPR20 size_t pending_write_bytes() const noexcept
+    {
+        return std::size(outbuf_) + n_chunk_bytes_;
+    }
+
+    [[nodiscard]] constexpr size_t read_size() const noexcept
+    {
+        return buffers_.read_size != 0U ? buffers_.read_size : RcvBuf;
+    }
 
     // this is only public for testing purposes.
     // production code should use new_outgoing() or new_incoming()
@@ -372,7 +582,7 @@ private:
     Filter filter_;
     std::optional<size_t> decrypt_remain_len_;
 
-    std::deque<std::pair<size_t /*n_bytes*/, bool /*is_piece_data*/>> outbuf_info_;
+    tr_ring<std::pair<size_t /*n_bytes*/, bool /*is_piece_data*/>> outbuf_info_;
 
     tr_peer_socket socket_ = {};
 
@@ -383,6 +593,14 @@ private:
     PeerBuffer inbuf_;
     PeerBuffer outbuf_;
 
+    // Sends queued by write_chunk() and write_file(), interleaved with outbuf_.
+    tr_ring<OutboundChunk> outchunks_;
+    size_t n_chunk_bytes_ = {};
+    size_t n_buffered_after_chunks_ = {};
+
+    tr_peer_io_buffers buffers_;
+    uint64_t buffers_tuned_at_ = {};
+
     tr_session* const session_;
 
     CanRead can_read_ = nullptr;
@@ -399,6 +617,7 @@ private:
 
     bool const is_seed_;
     bool const is_incoming_;
+    bool is_lan_ = false;
 
     bool utp_supported_ = false;
     bool dht_supported_ = false;
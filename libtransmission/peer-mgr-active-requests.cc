@@ -5,13 +5,16 @@
 
 #include <algorithm>
 #include <cstddef> // size_t
+#include <cstdint> // uint32_t
 #include <ctime>
+#include <deque>
+#include <limits>
 #include <memory>
 #include <utility>
 #include <unordered_map>
 #include <vector>
 
-#include <small/map.hpp>
+#include <small/vector.hpp>
 
 #define LIBTRANSMISSION_PEER_MODULE
 
@@ -23,149 +26,421 @@
 
 struct tr_peer;
 
+// Each request lives in a pooled `Entry` that is linked into three indices:
+// - `blocks_`, a hash of block -> the (few) entries requesting that block;
+// - `peers_`, a per-peer intrusive list, so dropping a peer is O(its requests);
+// - `wheel_`, a coarse timing wheel of `SlotSecs`-wide slots ordered by send
+//   time, so that `sentBefore()` only visits expired requests plus at most one
+//   partially-expired slot instead of every outstanding request.
 class ActiveRequests::Impl
 {
 public:
-    [[nodiscard]] size_t size() const
+    using Index = uint32_t;
+    static auto constexpr NoIndex = std::numeric_limits<Index>::max();
+    static auto constexpr SlotSecs = time_t{ 4 };
+
+    struct Entry
+    {
+        tr_peer* peer = nullptr;
+        tr_block_index_t block = {};
+        time_t sent_at = {};
+        time_t tick = {};
+
+        Index peer_prev = NoIndex;
+        Index peer_next = NoIndex;
+        Index slot_prev = NoIndex;
+        Index slot_next = NoIndex;
+    };
+
+    struct PeerList
+    {
+        Index head = NoIndex;
+        size_t count = 0U;
+    };
+
+    struct Slot
+    {
+        time_t tick = {};
+        Index head = NoIndex;
+        Index tail = NoIndex;
+    };
+
+    using BlockEntries = small::vector<Index, Wishlist::EndgameMaxPeers>;
+
+    [[nodiscard]] size_t size() const noexcept
     {
         return size_;
     }
 
     [[nodiscard]] size_t count(tr_peer const* peer) const
     {
-        auto const it = count_.find(peer);
-        return it != std::end(count_) ? it->second : size_t{};
+        auto const it = peers_.find(peer);
+        return it != std::end(peers_) ? it->second.count : size_t{};
     }
 
-    void incCount(tr_peer const* peer)
+    [[nodiscard]] size_t count(tr_block_index_t block) const
     {
-        ++count_[peer];
-        ++size_;
+        auto const it = blocks_.find(block);
+        return it != std::end(blocks_) ? std::size(it->second) : size_t{};
     }
 
-    void decCount(tr_peer const* peer)
+    [[nodiscard]] Index find(tr_block_index_t block, tr_peer const* peer) const
     {
-        auto it = count_.find(peer);
-        TR_ASSERT(it != std::end(count_));
-        TR_ASSERT(it->second > 0);
-        TR_ASSERT(size_ > 0);
+        if (auto const it = blocks_.find(block); it != std::end(blocks_))
+        {
+            for (auto const idx : it->second)
+            {
+                if (entries_[idx].peer == peer)
+                {
+                    return idx;
+                }
+            }
+        }
+
+        return NoIndex;
+    }
 
-        if (it != std::end(count_))
+    bool add(tr_block_index_t block, tr_peer* peer, time_t when)
+    {
+        auto& block_entries = blocks_[block];
+        for (auto const idx : block_entries)
         {
-            if (--it->second == 0)
+            if (entries_[idx].peer == peer)
             {
-                count_.erase(it);
+                return false;
             }
-            --size_;
         }
+
+        auto const idx = alloc_entry();
+        auto& entry = entries_[idx];
+        entry.peer = peer;
+        entry.block = block;
+        entry.sent_at = when;
+        entry.tick = tick_of(when);
+        block_entries.push_back(idx);
+        link_peer(idx);
+        link_slot(idx);
+        ++size_;
+        return true;
     }
 
-    std::unordered_map<tr_peer const*, size_t> count_;
+    // unlink `idx` from the peer list and the wheel; the caller owns `blocks_`
+    void release(Index idx)
+    {
+        TR_ASSERT(size_ > 0U);
 
-    std::unordered_map<tr_block_index_t, small::map<tr_peer const*, time_t, Wishlist::EndgameMaxPeers>> blocks_;
+        unlink_peer(idx);
+        unlink_slot(idx);
+        entries_[idx] = Entry{};
+        free_.push_back(idx);
+        --size_;
+    }
 
-private:
-    size_t size_ = 0;
-};
+    bool remove(tr_block_index_t block, tr_peer const* peer)
+    {
+        auto const it = blocks_.find(block);
+        if (it == std::end(blocks_))
+        {
+            return false;
+        }
 
-ActiveRequests::ActiveRequests()
-    : impl_{ std::make_unique<Impl>() }
-{
-}
+        auto& block_entries = it->second;
+        auto const pos = std::find_if(
+            std::begin(block_entries),
+            std::end(block_entries),
+            [this, peer](Index idx) { return entries_[idx].peer == peer; });
+        if (pos == std::end(block_entries))
+        {
+            return false;
+        }
 
-ActiveRequests::~ActiveRequests() = default;
+        release(*pos);
+        block_entries.erase(pos);
+        if (std::empty(block_entries))
+        {
+            blocks_.erase(it);
+        }
 
-bool ActiveRequests::add(tr_block_index_t block, tr_peer* peer, time_t when)
-{
-    bool const added = impl_->blocks_[block].emplace(peer, when).second;
+        return true;
+    }
 
-    if (added)
+    std::vector<tr_block_index_t> remove(tr_peer const* peer)
     {
-        impl_->incCount(peer);
-    }
+        auto removed = std::vector<tr_block_index_t>{};
 
-    return added;
-}
+        auto const it = peers_.find(peer);
+        if (it == std::end(peers_))
+        {
+            return removed;
+        }
 
-// remove a request to `peer` for `block`
-bool ActiveRequests::remove(tr_block_index_t block, tr_peer const* peer)
-{
-    auto const it = impl_->blocks_.find(block);
-    auto const removed = it != std::end(impl_->blocks_) && it->second.erase(peer) != 0;
+        removed.reserve(it->second.count);
+        for (auto idx = it->second.head; idx != NoIndex; idx = entries_[idx].peer_next)
+        {
+            removed.push_back(entries_[idx].block);
+        }
+
+        for (auto const block : removed)
+        {
+            remove(block, peer);
+        }
 
-    if (removed)
+        return removed;
+    }
+
+    std::vector<tr_peer*> remove(tr_block_index_t block)
     {
-        impl_->decCount(peer);
+        auto removed = std::vector<tr_peer*>{};
+
+        auto const it = blocks_.find(block);
+        if (it == std::end(blocks_))
+        {
+            return removed;
+        }
 
-        if (std::empty(it->second))
+        removed.reserve(std::size(it->second));
+        for (auto const idx : it->second)
         {
-            impl_->blocks_.erase(it);
+            removed.push_back(entries_[idx].peer);
+            release(idx);
         }
+
+        blocks_.erase(it);
+        return removed;
     }
 
-    return removed;
-}
+    [[nodiscard]] std::vector<std::pair<tr_block_index_t, tr_peer*>> sent_before(time_t when) const
+    {
+        auto sent_before = std::vector<std::pair<tr_block_index_t, tr_peer*>>{};
 
-// remove requests to `peer` and return the associated blocks
-std::vector<tr_block_index_t> ActiveRequests::remove(tr_peer const* peer)
-{
-    auto removed = std::vector<tr_block_index_t>{};
-    removed.reserve(impl_->blocks_.size());
+        for (auto const& slot : wheel_)
+        {
+            // every entry in a slot was sent in [tick * SlotSecs, (tick + 1) * SlotSecs)
+            auto const slot_begin = slot.tick * SlotSecs;
+            if (slot_begin >= when)
+            {
+                break;
+            }
+
+            auto const whole_slot = slot_begin + SlotSecs <= when;
+            for (auto idx = slot.head; idx != NoIndex; idx = entries_[idx].slot_next)
+            {
+                if (auto const& entry = entries_[idx]; whole_slot || entry.sent_at < when)
+                {
+                    sent_before.emplace_back(entry.block, entry.peer);
+                }
+            }
+
+            if (!whole_slot)
+            {
+                break;
+            }
+        }
 
-    for (auto const& [block, peers_at] : impl_->blocks_)
+        return sent_before;
+    }
+
+private:
+    [[nodiscard]] static constexpr time_t tick_of(time_t when) noexcept
     {
-        if (peers_at.count(peer) != 0U)
+        // floor division, so that negative times still land in ascending slots
+        return when >= 0 ? when / SlotSecs : -((-when + SlotSecs - 1) / SlotSecs);
+    }
+
+    Index alloc_entry()
+    {
+        if (!std::empty(free_))
         {
-            removed.push_back(block);
+            auto const idx = free_.back();
+            free_.pop_back();
+            return idx;
         }
+
+        entries_.emplace_back();
+        return static_cast<Index>(std::size(entries_) - 1U);
     }
 
-    for (auto block : removed)
+    void link_peer(Index idx)
     {
-        remove(block, peer);
+        auto& list = peers_[entries_[idx].peer];
+        entries_[idx].peer_next = list.head;
+        if (list.head != NoIndex)
+        {
+            entries_[list.head].peer_prev = idx;
+        }
+        list.head = idx;
+        ++list.count;
     }
 
-    return removed;
-}
+    void unlink_peer(Index idx)
+    {
+        auto& entry = entries_[idx];
+        auto const it = peers_.find(entry.peer);
+        TR_ASSERT(it != std::end(peers_));
+        if (it == std::end(peers_))
+        {
+            return;
+        }
 
-// remove requests for `block` and return the associated peers
-std::vector<tr_peer*> ActiveRequests::remove(tr_block_index_t block)
-{
-    auto removed = std::vector<tr_peer*>{};
+        if (entry.peer_prev != NoIndex)
+        {
+            entries_[entry.peer_prev].peer_next = entry.peer_next;
+        }
+        else
+        {
+            it->second.head = entry.peer_next;
+        }
 
-    if (auto it = impl_->blocks_.find(block); it != std::end(impl_->blocks_))
+        if (entry.peer_next != NoIndex)
+        {
+            entries_[entry.peer_next].peer_prev = entry.peer_prev;
+        }
+
+        if (--it->second.count == 0U)
+        {
+            peers_.erase(it);
+        }
+    }
+
+    [[nodiscard]] std::deque<Slot>::iterator find_slot(time_t tick)
     {
-        auto const n = std::size(it->second);
-        removed.resize(n);
-        std::transform(
-            std::begin(it->second),
-            std::end(it->second),
-            std::begin(removed),
-            [](auto const& iter) { return const_cast<tr_peer*>(iter.first); });
-        impl_->blocks_.erase(block);
+        return std::lower_bound(
+            std::begin(wheel_),
+            std::end(wheel_),
+            tick,
+            [](Slot const& slot, time_t key) { return slot.tick < key; });
+    }
+
+    void link_slot(Index idx)
+    {
+        auto const tick = entries_[idx].tick;
+
+        // requests are almost always added in time order, so the newest slot is the usual target
+        auto slot = std::end(wheel_);
+        if (std::empty(wheel_) || wheel_.back().tick < tick)
+        {
+            wheel_.push_back(Slot{ tick });
+            slot = std::prev(std::end(wheel_));
+        }
+        else if (wheel_.back().tick == tick)
+        {
+            slot = std::prev(std::end(wheel_));
+        }
+        else if (slot = find_slot(tick); slot == std::end(wheel_) || slot->tick != tick)
+        {
+            slot = wheel_.insert(slot, Slot{ tick });
+        }
+
+        auto& entry = entries_[idx];
+        entry.slot_prev = slot->tail;
+        entry.slot_next = NoIndex;
+        if (slot->tail != NoIndex)
+        {
+            entries_[slot->tail].slot_next = idx;
+        }
+        else
+        {
+            slot->head = idx;
+        }
+        slot->tail = idx;
     }
 
-    for (auto const* const peer : removed)
+    void unlink_slot(Index idx)
     {
-        impl_->decCount(peer);
+        auto& entry = entries_[idx];
+        auto const slot = find_slot(entry.tick);
+        TR_ASSERT(slot != std::end(wheel_) && slot->tick == entry.tick);
+        if (slot == std::end(wheel_) || slot->tick != entry.tick)
+        {
+            return;
+        }
+
+        if (entry.slot_prev != NoIndex)
+        {
+            entries_[entry.slot_prev].slot_next = entry.slot_next;
+        }
+        else
+        {
+            slot->head = entry.slot_next;
+        }
+
+        if (entry.slot_next != NoIndex)
+        {
+            entries_[entry.slot_next].slot_prev = entry.slot_prev;
+        }
+        else
+        {
+            slot->tail = entry.slot_prev;
+        }
+
+        // only the ends of the wheel are trimmed eagerly; empty slots
+        // in the middle are dropped once they drift to the front
+        if (slot->head == NoIndex && (slot == std::begin(wheel_) || std::next(slot) == std::end(wheel_)))
+        {
+            wheel_.erase(slot);
+
+            while (!std::empty(wheel_) && wheel_.front().head == NoIndex)
+            {
+                wheel_.pop_front();
+            }
+
+            while (!std::empty(wheel_) && wheel_.back().head == NoIndex)
+            {
+                wheel_.pop_back();
+            }
+        }
     }
 
-    return removed;
+    std::vector<Entry> entries_;
+    std::vector<Index> free_;
+
+    std::unordered_map<tr_block_index_t, BlockEntries> blocks_;
+    std::unordered_map<tr_peer const*, PeerList> peers_;
+    std::deque<Slot> wheel_;
+
+    size_t size_ = 0U;
+};
+
+ActiveRequests::ActiveRequests()
+    : impl_{ std::make_unique<Impl>() }
+{
+}
+
+ActiveRequests::~ActiveRequests() = default;
+
+bool ActiveRequests::add(tr_block_index_t block, tr_peer* peer, time_t when)
+{
+    return impl_->add(block, peer, when);
+}
+
+// remove a request to `peer` for `block`
+bool ActiveRequests::remove(tr_block_index_t block, tr_peer const* peer)
+{
+    return impl_->remove(block, peer);
+}
+
+// remove requests to `peer` and return the associated blocks
+std::vector<tr_block_index_t> ActiveRequests::remove(tr_peer const* peer)
+{
+    return impl_->remove(peer);
+}
+
+// remove requests for `block` and return the associated peers
+std::vector<tr_peer*> ActiveRequests::remove(tr_block_index_t block)
+{
+    return impl_->remove(block);
 }
 
 // return true if there's an active request to `peer` for `block`
 bool ActiveRequests::has(tr_block_index_t block, tr_peer const* peer) const
 {
-    auto const iter = impl_->blocks_.find(block);
-    return iter != std::end(impl_->blocks_) && (iter->second.count(peer) != 0U);
+    return impl_->find(block, peer) != Impl::NoIndex;
 }
 
 // count how many peers we're asking for `block`
 size_t ActiveRequests::count(tr_block_index_t block) const
 {
-    auto const& blocks = impl_->blocks_;
-    auto const iter = blocks.find(block);
-    return iter == std::end(blocks) ? 0U : std::size(iter->second);
+    return impl_->count(block);
 }
 
 // count how many active block requests we have to `peer`
@@ -183,19 +458,5 @@ size_t ActiveRequests::size() const
 // returns the active requests sent before `when`
 std::vector<std::pair<tr_block_index_t, tr_peer*>> ActiveRequests::sentBefore(time_t when) const
 {
-    auto sent_before = std::vector<std::pair<tr_block_index_t, tr_peer*>>{};
-    sent_before.reserve(std::size(impl_->blocks_));
-
-    for (auto const& [block, peers_at] : impl_->blocks_)
-    {
-        for (auto const& [peer, sent_at] : peers_at)
-        {
-            if (sent_at < when)
-            {
-                sent_before.emplace_back(block, const_cast<tr_peer*>(peer));
-            }
-        }
-    }
-
-    return sent_before;
+    return impl_->sent_before(when);
 }
@@ -53,7 +53,8 @@ public:
     // return the total number of active requests
     [[nodiscard]] size_t size() const;
 
-    // returns the active requests sent before `when`
+    // returns the active requests sent before `when`.
+    // cost is proportional to the number of expired requests, not to size()
     [[nodiscard]] std::vector<std::pair<tr_block_index_t, tr_peer*>> sentBefore(time_t when) const;
 
 private:
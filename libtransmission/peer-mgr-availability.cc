@@ -0,0 +1,60 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <cstddef>
+#include <cstdint>
+
+#define LIBTRANSMISSION_PEER_MODULE
+
+#include "libtransmission/transmission.h"
+
+#include "libtransmission/bitfield.h"
+#include "libtransmission/peer-mgr-availability.h"
+#include "libtransmission/tr-assert.h"
+
+template<typename Func>
+void PieceAvailability::for_each_piece(tr_bitfield const& peer_has, Func&& func)
+{
+    auto const n_pieces = std::size(counts_);
+
+    // a have-all that arrived before the metainfo has no bits to walk
+    if (peer_has.has_all())
+    {
+        for (size_t piece = 0U; piece < n_pieces; ++piece)
+        {
+            func(counts_[piece]);
+        }
+
+        return;
+    }
+
+    peer_has.for_each_set_bit(
+        [this, &func, n_pieces](size_t piece)
+        {
+            if (piece < n_pieces)
+            {
+                func(counts_[piece]);
+            }
+        });
+}
+
+void PieceAvailability::add(tr_bitfield const& peer_has)
+{
+    for_each_piece(peer_has, [](uint16_t& count) { ++count; });
+}
+
+void PieceAvailability::remove(tr_bitfield const& peer_has)
+{
+    for_each_piece(
+        peer_has,
+        [](uint16_t& count)
+        {
+            TR_ASSERT(count > 0U);
+            if (count > 0U)
+            {
+                --count;
+            }
+        });
+}
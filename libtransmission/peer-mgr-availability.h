@@ -0,0 +1,73 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#pragma once
+
+#ifndef LIBTRANSMISSION_PEER_MODULE
+#error only the libtransmission peer module should #include this header.
+#endif
+
+#include <cstddef> // size_t
+#include <cstdint> // uint16_t
+#include <vector>
+
+#include "libtransmission/transmission.h" // tr_piece_index_t
+
+struct tr_bitfield;
+
+/**
+ * Counts how many of a swarm's connected peers have each piece.
+ *
+ * A peer's pieces are added as it announces them and removed when it
+ * disconnects. For the counts to stay right, `remove()` must be given the
+ * same pieces that were added, so a peer's piece set may only grow after
+ * its first bitfield; peer-msgs ignores bitfields and have-alls that
+ * would replace pieces the peer has already announced.
+ */
+class PieceAvailability
+{
+public:
+    explicit PieceAvailability(size_t piece_count = 0U)
+        : counts_(piece_count)
+    {
+    }
+
+    // Forget all the peers, e.g. when the piece count becomes known.
+    void reset(size_t piece_count)
+    {
+        counts_.assign(piece_count, 0U);
+    }
+
+    // a peer sent a bitfield or a have-all
+    void add(tr_bitfield const& peer_has);
+
+    // a peer sent a have
+    void add(tr_piece_index_t piece) noexcept
+    {
+        if (piece < std::size(counts_))
+        {
+            ++counts_[piece];
+        }
+    }
+
+    // a peer that has `peer_has` disconnected
+    void remove(tr_bitfield const& peer_has);
+
+    [[nodiscard]] uint16_t count(tr_piece_index_t piece) const noexcept
+    {
+        return piece < std::size(counts_) ? counts_[piece] : 0U;
+    }
+
+    [[nodiscard]] constexpr auto const& counts() const noexcept
+    {
+        return counts_;
+    }
+
+private:
+    template<typename Func>
+    void for_each_piece(tr_bitfield const& peer_has, Func&& func);
+
+    std::vector<uint16_t> counts_;
+};
@@ -0,0 +1,64 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <algorithm> // std::push_heap, std::pop_heap
+#include <ctime>
+#include <utility>
+#include <vector>
+
+#define LIBTRANSMISSION_PEER_MODULE
+
+#include "libtransmission/peer-mgr-candidates.h"
+#include "libtransmission/tr-assert.h"
+
+namespace
+{
+// the standard heap algorithms keep the largest element on top,
+// so "less" here means "worse"
+auto constexpr IsWorse = [](OutboundCandidateQueue::Entry const& a, OutboundCandidateQueue::Entry const& b)
+{
+    return a.score > b.score;
+};
+
+auto constexpr IsLater = [](std::pair<time_t, OutboundCandidateQueue::Entry> const& a,
+                            std::pair<time_t, OutboundCandidateQueue::Entry> const& b)
+{
+    return a.first > b.first;
+};
+} // namespace
+
+void OutboundCandidateQueue::push(Entry const& entry)
+{
+    queue_.emplace_back(entry);
+    std::push_heap(std::begin(queue_), std::end(queue_), IsWorse);
+}
+
+void OutboundCandidateQueue::pop()
+{
+    TR_ASSERT(!std::empty(queue_));
+
+    std::pop_heap(std::begin(queue_), std::end(queue_), IsWorse);
+    queue_.pop_back();
+}
+
+void OutboundCandidateQueue::defer_top(time_t const ready_at)
+{
+    TR_ASSERT(!std::empty(queue_));
+
+    std::pop_heap(std::begin(queue_), std::end(queue_), IsWorse);
+    deferred_.emplace_back(ready_at, queue_.back());
+    queue_.pop_back();
+    std::push_heap(std::begin(deferred_), std::end(deferred_), IsLater);
+}
+
+void OutboundCandidateQueue::wake(time_t const now)
+{
+    while (!std::empty(deferred_) && deferred_.front().first <= now)
+    {
+        std::pop_heap(std::begin(deferred_), std::end(deferred_), IsLater);
+        push(deferred_.back().second);
+        deferred_.pop_back();
+    }
+}
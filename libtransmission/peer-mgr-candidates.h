@@ -0,0 +1,84 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#pragma once
+
+#ifndef LIBTRANSMISSION_PEER_MODULE
+#error only the libtransmission peer module should #include this header.
+#endif
+
+#include <cstddef> // size_t
+#include <cstdint> // uint32_t, uint64_t
+#include <ctime> // time_t
+#include <utility> // std::pair
+#include <vector>
+
+#include "libtransmission/net.h" // tr_socket_address
+
+/**
+ * A swarm's known peers that we might open an outbound connection to,
+ * best first.
+ *
+ * Entries are pushed when a peer might have become worth connecting to,
+ * e.g. when we learn about it or when a connection to it ends, so that
+ * picking the next peers to connect to is O(log n) per peer instead of
+ * rescoring every known peer in the session.
+ *
+ * Entries are never updated in place. Instead, pushing a peer again
+ * with a higher generation number makes its older entries stale, and
+ * the caller discards stale entries as they reach the top.
+ *
+ * Peers that we tried recently enough that we shouldn't retry them yet
+ * can be deferred until they're ready, to keep them from blocking the
+ * peers behind them.
+ */
+class OutboundCandidateQueue
+{
+public:
+    struct Entry
+    {
+        // smaller is better
+        uint64_t score = {};
+
+        tr_socket_address socket_address;
+
+        uint32_t generation = {};
+    };
+
+    void push(Entry const& entry);
+
+    // the best entry, or nullptr if the queue is empty
+    [[nodiscard]] Entry const* top() const noexcept
+    {
+        return std::empty(queue_) ? nullptr : &queue_.front();
+    }
+
+    void pop();
+
+    // set aside the top entry until `ready_at`
+    void defer_top(time_t ready_at);
+
+    // put deferred entries that are ready by `now` back in the queue
+    void wake(time_t now);
+
+    void clear() noexcept
+    {
+        queue_.clear();
+        deferred_.clear();
+    }
+
+    // the number of entries, including the stale and deferred ones
+    [[nodiscard]] size_t size() const noexcept
+    {
+        return std::size(queue_) + std::size(deferred_);
+    }
+
+private:
+    // min-heap by score
+    std::vector<Entry> queue_;
+
+    // min-heap by the time that each entry is ready
+    std::vector<std::pair<time_t, Entry>> deferred_;
+};
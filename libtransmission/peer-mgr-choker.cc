@@ -0,0 +1,121 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <algorithm> // std::clamp, std::min, std::sort, std::stable_sort
+#include <cstddef>
+#include <cstdint>
+#include <utility> // std::pair
+#include <vector>
+
+#define LIBTRANSMISSION_PEER_MODULE
+
+#include "libtransmission/peer-mgr-choker.h"
+
+bool SeedChoker::is_snubbed(Candidate const& candidate, uint64_t const now_msec) noexcept
+{
+    return candidate.is_unchoked && candidate.unchoked_at_msec != 0U &&
+        now_msec >= candidate.unchoked_at_msec + SnubMsec && candidate.recent_blocks_sent == 0U;
+}
+
+uint64_t SeedChoker::unchoke_duration_msec(uint64_t const bytes_per_second, uint64_t const mean_bytes_per_second) noexcept
+{
+    if (bytes_per_second == 0U || mean_bytes_per_second == 0U)
+    {
+        return BaseUnchokeMsec;
+    }
+
+    return std::clamp(BaseUnchokeMsec * bytes_per_second / mean_bytes_per_second, MinUnchokeMsec, MaxUnchokeMsec);
+}
+
+std::vector<bool> SeedChoker::rechoke(
+    std::vector<Candidate> const& candidates,
+    size_t const n_slots,
+    uint64_t const now_msec,
+    bool const allow_new_unchokes)
+{
+    auto const n_candidates = std::size(candidates);
+    auto ret = std::vector<bool>(n_candidates, false);
+
+    // unchoke durations are weighed against the average of the peers holding a slot
+    auto rate_sum = uint64_t{};
+    auto n_rated = uint64_t{};
+    for (auto const& candidate : candidates)
+    {
+        if (candidate.is_unchoked && candidate.upload_bytes_per_second != 0U)
+        {
+            rate_sum += candidate.upload_bytes_per_second;
+            ++n_rated;
+        }
+    }
+    auto const mean_rate = n_rated == 0U ? uint64_t{} : rate_sum / n_rated;
+
+    // peers whose turn isn't over yet keep their slots. Everyone else
+    // waits in line, longest wait first. Redistributing pieces counts
+    // as having waited longer. Peers whose turn just ended go to the
+    // back of the line, and peers that snubbed their slot sit this one out.
+    auto keepers = std::vector<size_t>{};
+    auto waiting = std::vector<std::pair<uint64_t /*score*/, size_t /*idx*/>>{};
+
+    for (size_t idx = 0U; idx < n_candidates; ++idx)
+    {
+        auto const& candidate = candidates[idx];
+
+        if (!candidate.is_interested || is_snubbed(candidate, now_msec))
+        {
+            continue;
+        }
+
+        if (candidate.is_unchoked)
+        {
+            auto const held_msec = now_msec - std::min(now_msec, candidate.unchoked_at_msec);
+            if (held_msec < unchoke_duration_msec(candidate.upload_bytes_per_second, mean_rate))
+            {
+                keepers.emplace_back(idx);
+            }
+            else
+            {
+                waiting.emplace_back(0U, idx);
+            }
+
+            continue;
+        }
+
+        auto const waited_msec = now_msec - std::min(now_msec, candidate.unchoked_at_msec);
+        auto const bonus = std::min(candidate.recent_redistributions, MaxRedistributionBonus);
+        waiting.emplace_back(waited_msec * (1U + bonus), idx);
+    }
+
+    // if there are fewer slots than before, keep the most recently unchoked
+    if (std::size(keepers) > n_slots)
+    {
+        std::sort(
+            std::begin(keepers),
+            std::end(keepers),
+            [&candidates](size_t a, size_t b) { return candidates[a].unchoked_at_msec > candidates[b].unchoked_at_msec; });
+        keepers.resize(n_slots);
+    }
+
+    for (auto const idx : keepers)
+    {
+        ret[idx] = true;
+    }
+
+    if (!allow_new_unchokes)
+    {
+        return ret;
+    }
+
+    std::stable_sort(
+        std::begin(waiting),
+        std::end(waiting),
+        [](auto const& a, auto const& b) { return a.first > b.first; });
+
+    for (size_t i = 0U, n = std::min(std::size(waiting), n_slots - std::size(keepers)); i < n; ++i)
+    {
+        ret[waiting[i].second] = true;
+    }
+
+    return ret;
+}
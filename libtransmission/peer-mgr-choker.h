@@ -0,0 +1,74 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#pragma once
+
+#ifndef LIBTRANSMISSION_PEER_MODULE
+#error only the libtransmission peer module should #include this header.
+#endif
+
+#include <cstddef> // size_t
+#include <cstdint> // uint64_t
+#include <vector>
+
+/**
+ * Decides which peers get our upload slots while seeding
+ * when `seed-choking-algorithm` is "round-robin".
+ *
+ * Every interested peer gets a turn. A peer keeps its slot for a
+ * while that grows with how fast we upload to it, then goes to the
+ * back of the line. Peers that pass the pieces we gave them on to
+ * the rest of the swarm move up the line faster.
+ *
+ * Anti-snub: a peer that stops requesting blocks while unchoked is
+ * wasting a slot, so it loses the slot early and sits out a turn.
+ */
+class SeedChoker
+{
+public:
+    // how long a peer keeps its slot when uploading at the average rate
+    static auto constexpr BaseUnchokeMsec = uint64_t{ 30000U };
+    static auto constexpr MinUnchokeMsec = BaseUnchokeMsec / 2U;
+    static auto constexpr MaxUnchokeMsec = BaseUnchokeMsec * 4U;
+
+    // an unchoked peer that hasn't been sent a block in this long is snubbing us
+    static auto constexpr SnubMsec = uint64_t{ 20000U };
+
+    // cap on how much redistribution can shorten a peer's wait
+    static auto constexpr MaxRedistributionBonus = size_t{ 8U };
+
+    struct Candidate
+    {
+        // when we last unchoked this peer, or 0 if we never have
+        uint64_t unchoked_at_msec = {};
+
+        uint64_t upload_bytes_per_second = {};
+
+        // how many blocks we've sent this peer in the last `SnubMsec`
+        size_t recent_blocks_sent = {};
+
+        // how many pieces we gave this peer have recently
+        // shown up at peers that didn't get them from us
+        size_t recent_redistributions = {};
+
+        bool is_interested = false;
+        bool is_unchoked = false;
+    };
+
+    // Returns whether each candidate should be unchoked.
+    // If `allow_new_unchokes` is false, e.g. because our upload bandwidth
+    // is maxed out, currently-unchoked peers may be choked but no new
+    // ones are unchoked.
+    [[nodiscard]] static std::vector<bool> rechoke(
+        std::vector<Candidate> const& candidates,
+        size_t n_slots,
+        uint64_t now_msec,
+        bool allow_new_unchokes = true);
+
+    [[nodiscard]] static bool is_snubbed(Candidate const& candidate, uint64_t now_msec) noexcept;
+
+    // how long a peer uploading at `bytes_per_second` keeps its slot
+    [[nodiscard]] static uint64_t unchoke_duration_msec(uint64_t bytes_per_second, uint64_t mean_bytes_per_second) noexcept;
+};
@@ -0,0 +1,94 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <algorithm> // std::min, std::nth_element
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+
+#include <small/vector.hpp>
+
+#define LIBTRANSMISSION_PEER_MODULE
+
+#include "libtransmission/net.h"
+#include "libtransmission/peer-io.h"
+#include "libtransmission/peer-mgr-connect.h"
+#include "libtransmission/tr-assert.h"
+
+ConnectAttempts plan_connect_attempts(ConnectPlanOptions const& opts)
+{
+    // which transports to try, best first
+    auto transports = small::max_size_vector<bool, 2U>{};
+    auto const utp_ok = opts.allows_utp && opts.supports_utp.value_or(true);
+    if (auto const last = opts.last_transport;
+        last && (*last == TR_PREFER_UTP ? utp_ok : opts.allows_tcp))
+    {
+        // stick with what worked last time
+        transports.emplace_back(*last == TR_PREFER_UTP);
+    }
+    else
+    {
+        auto const utp_first = opts.preferred_transport == TR_PREFER_UTP;
+        for (auto const utp : { utp_first, !utp_first })
+        {
+            if (utp ? utp_ok : opts.allows_tcp)
+            {
+                transports.emplace_back(utp);
+            }
+        }
+    }
+
+    // which addresses to try, best first
+    auto addresses = small::max_size_vector<tr_socket_address, 2U>{ opts.socket_address };
+    if (auto const& alt = opts.alt_socket_address;
+        alt && alt->is_valid() && alt->address().type != opts.socket_address.address().type)
+    {
+        addresses.emplace_back(*alt);
+    }
+
+    // Alternate between address families before falling back to the
+    // less preferred transport, so that a broken address family or a
+    // broken transport alone doesn't keep us from connecting.
+    auto ret = ConnectAttempts{};
+    for (auto const utp : transports)
+    {
+        for (auto const& socket_address : addresses)
+        {
+            if (std::size(ret) < MaxConnectAttempts)
+            {
+                ret.push_back({ socket_address, utp });
+            }
+        }
+    }
+
+    return ret;
+}
+
+// ---
+
+void ConnectLatencyStats::add(uint64_t const msec) noexcept
+{
+    samples_[next_] = static_cast<uint32_t>(std::min(msec, uint64_t{ std::numeric_limits<uint32_t>::max() }));
+    next_ = (next_ + 1U) % Capacity;
+    size_ = std::min(size_ + 1U, Capacity);
+}
+
+uint64_t ConnectLatencyStats::percentile(unsigned int const pct) const
+{
+    TR_ASSERT(pct <= 100U);
+
+    if (size_ == 0U)
+    {
+        return {};
+    }
+
+    auto sorted = samples_;
+    auto const begin = std::begin(sorted);
+    auto const end = begin + size_;
+    auto const nth = begin + std::min(size_ - 1U, size_ * pct / 100U);
+    std::nth_element(begin, nth, end);
+    return *nth;
+}
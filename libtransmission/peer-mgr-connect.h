@@ -0,0 +1,89 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#pragma once
+
+#ifndef LIBTRANSMISSION_PEER_MODULE
+#error only the libtransmission peer module should #include this header.
+#endif
+
+#include <array>
+#include <cstddef> // size_t
+#include <cstdint> // uint32_t, uint64_t
+#include <optional>
+
+#include <small/vector.hpp>
+
+#include "libtransmission/net.h" // tr_socket_address
+#include "libtransmission/peer-io.h" // tr_preferred_transport
+
+/**
+ * Happy-eyeballs connection planning.
+ *
+ * When we don't know how best to reach a peer, we race connections to it
+ * over every transport and address that might work, keep whichever one
+ * finishes its handshake first, and cancel the rest. Once a transport has
+ * worked for a peer, later connections only use that transport.
+ */
+struct ConnectAttempt
+{
+    tr_socket_address socket_address;
+    bool utp = false;
+};
+
+// the most connections we'll race to a single peer
+inline auto constexpr MaxConnectAttempts = size_t{ 4U };
+
+using ConnectAttempts = small::max_size_vector<ConnectAttempt, MaxConnectAttempts>;
+
+struct ConnectPlanOptions
+{
+    // the peer's listening address
+    tr_socket_address socket_address;
+
+    // the peer's listening address in the other address family, if it told us one
+    std::optional<tr_socket_address> alt_socket_address;
+
+    // whether the peer is known to support µTP
+    std::optional<bool> supports_utp;
+
+    // the transport of the last connection that worked, if any
+    std::optional<tr_preferred_transport> last_transport;
+
+    tr_preferred_transport preferred_transport = TR_PREFER_UTP;
+
+    bool allows_utp = true;
+    bool allows_tcp = true;
+};
+
+// The connections to start for one peer, best first.
+[[nodiscard]] ConnectAttempts plan_connect_attempts(ConnectPlanOptions const& opts);
+
+/**
+ * A sliding window of how long our recent outbound connections
+ * took to finish their handshakes.
+ */
+class ConnectLatencyStats
+{
+public:
+    void add(uint64_t msec) noexcept;
+
+    // the number of samples in the window
+    [[nodiscard]] constexpr auto size() const noexcept
+    {
+        return size_;
+    }
+
+    // the latency that `pct` percent of the samples are at or below,
+    // or 0 if there are no samples
+    [[nodiscard]] uint64_t percentile(unsigned int pct) const;
+
+private:
+    static auto constexpr Capacity = size_t{ 1024U };
+
+    std::array<uint32_t, Capacity> samples_ = {};
+    size_t size_ = {};
+    size_t next_ = {};
+};
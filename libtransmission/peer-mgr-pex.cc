@@ -0,0 +1,186 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <algorithm> // std::is_sorted, std::lower_bound, std::min, std::set_difference
+#include <array>
+#include <cstddef>
+#include <iterator> // std::back_inserter
+#include <string>
+#include <string_view>
+#include <utility> // std::move
+#include <vector>
+
+#include <small/vector.hpp>
+
+#define LIBTRANSMISSION_PEER_MODULE
+
+#include "libtransmission/net.h"
+#include "libtransmission/peer-mgr-pex.h"
+#include "libtransmission/peer-mgr.h"
+#include "libtransmission/quark.h"
+#include "libtransmission/tr-assert.h"
+#include "libtransmission/variant.h"
+
+namespace
+{
+[[nodiscard]] auto find_sorted(std::vector<tr_pex>& pex, tr_pex const& key)
+{
+    auto const it = std::lower_bound(std::begin(pex), std::end(pex), key);
+    return std::pair{ it, it != std::end(pex) && *it == key };
+}
+
+// add `key` to `pex` unless it cancels out an entry in `opposite`
+void apply(std::vector<tr_pex>& pex, std::vector<tr_pex>& opposite, tr_pex const& key)
+{
+    if (auto const [opposite_it, found] = find_sorted(opposite, key); found)
+    {
+        opposite.erase(opposite_it);
+    }
+    else if (auto const [it, exists] = find_sorted(pex, key); !exists)
+    {
+        pex.insert(it, key);
+    }
+}
+} // namespace
+
+void PexDeltaLog::update(Snapshot snapshot)
+{
+    auto delta = Delta{};
+    auto changed = false;
+
+    for (size_t i = 0; i < NUM_TR_AF_INET_TYPES; ++i)
+    {
+        auto const& old_pex = snapshot_[i];
+        auto const& new_pex = snapshot[i];
+        TR_ASSERT(std::is_sorted(std::begin(new_pex), std::end(new_pex)));
+
+        std::set_difference(
+            std::begin(new_pex),
+            std::end(new_pex),
+            std::begin(old_pex),
+            std::end(old_pex),
+            std::back_inserter(delta.added[i]));
+        std::set_difference(
+            std::begin(old_pex),
+            std::end(old_pex),
+            std::begin(new_pex),
+            std::end(new_pex),
+            std::back_inserter(delta.dropped[i]));
+
+        changed = changed || !std::empty(delta.added[i]) || !std::empty(delta.dropped[i]);
+    }
+
+    if (!changed)
+    {
+        return;
+    }
+
+    snapshot_ = std::move(snapshot);
+    log_.push_back({ ++version_, std::move(delta) });
+    if (std::size(log_) > MaxLogSize)
+    {
+        log_.pop_front();
+    }
+    messages_.clear();
+}
+
+PexDeltaLog::Delta PexDeltaLog::delta_since(Version const since) const
+{
+    TR_ASSERT(since <= version_);
+
+    auto ret = Delta{};
+
+    if (since == version_)
+    {
+        return ret;
+    }
+
+    // if the log doesn't go back that far, start from the empty list
+    if (std::empty(log_) || since + 1U < log_.front().version)
+    {
+        ret.added = snapshot_;
+        return ret;
+    }
+
+    for (auto const& [version, delta] : log_)
+    {
+        if (version <= since)
+        {
+            continue;
+        }
+
+        for (size_t i = 0; i < NUM_TR_AF_INET_TYPES; ++i)
+        {
+            for (auto const& pex : delta.added[i])
+            {
+                apply(ret.added[i], ret.dropped[i], pex);
+            }
+
+            for (auto const& pex : delta.dropped[i])
+            {
+                apply(ret.dropped[i], ret.added[i], pex);
+            }
+        }
+    }
+
+    return ret;
+}
+
+std::string const& PexDeltaLog::message_since(Version const since)
+{
+    if (auto const it = messages_.find(since); it != std::end(messages_))
+    {
+        return it->second;
+    }
+
+    return messages_.try_emplace(since, encode(delta_since(since))).first->second;
+}
+
+std::string PexDeltaLog::encode(Delta const& delta)
+{
+    static auto constexpr AddedMap = std::array{ TR_KEY_added, TR_KEY_added6 };
+    static auto constexpr AddedFMap = std::array{ TR_KEY_added_f, TR_KEY_added6_f };
+    static auto constexpr DroppedMap = std::array{ TR_KEY_dropped, TR_KEY_dropped6 };
+
+    auto map = tr_variant::Map{ 4U };
+    auto tmpbuf = small::vector<std::byte, MaxPeers * tr_socket_address::CompactSockAddrMaxBytes>{};
+    for (size_t i = 0; i < NUM_TR_AF_INET_TYPES; ++i)
+    {
+        auto const n_added = std::min(std::size(delta.added[i]), MaxPeers);
+        auto const n_dropped = std::min(std::size(delta.dropped[i]), MaxPeers);
+
+        if (n_added != 0U)
+        {
+            auto const& added = delta.added[i];
+
+            // "added"
+            tmpbuf.clear();
+            tmpbuf.reserve(n_added * tr_socket_address::CompactSockAddrBytes[i]);
+            tr_pex::to_compact(std::back_inserter(tmpbuf), std::data(added), n_added);
+            TR_ASSERT(std::size(tmpbuf) == n_added * tr_socket_address::CompactSockAddrBytes[i]);
+            map.try_emplace(AddedMap[i], std::string_view{ reinterpret_cast<char*>(std::data(tmpbuf)), std::size(tmpbuf) });
+
+            // "added.f"
+            tmpbuf.resize(n_added);
+            for (size_t j = 0; j < n_added; ++j)
+            {
+                tmpbuf[j] = std::byte{ added[j].flags };
+            }
+            map.try_emplace(AddedFMap[i], std::string_view{ reinterpret_cast<char*>(std::data(tmpbuf)), n_added });
+        }
+
+        if (n_dropped != 0U)
+        {
+            // "dropped"
+            tmpbuf.clear();
+            tmpbuf.reserve(n_dropped * tr_socket_address::CompactSockAddrBytes[i]);
+            tr_pex::to_compact(std::back_inserter(tmpbuf), std::data(delta.dropped[i]), n_dropped);
+            TR_ASSERT(std::size(tmpbuf) == n_dropped * tr_socket_address::CompactSockAddrBytes[i]);
+            map.try_emplace(DroppedMap[i], std::string_view{ reinterpret_cast<char*>(std::data(tmpbuf)), std::size(tmpbuf) });
+        }
+    }
+
+    return tr_variant_serde::benc().to_string(tr_variant{ std::move(map) });
+}
@@ -0,0 +1,94 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#pragma once
+
+#ifndef LIBTRANSMISSION_PEER_MODULE
+#error only the libtransmission peer module should #include this header.
+#endif
+
+#include <array>
+#include <cstddef> // size_t
+#include <cstdint> // uint32_t
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "libtransmission/net.h" // NUM_TR_AF_INET_TYPES
+#include "libtransmission/peer-mgr.h" // tr_pex
+
+/**
+ * A swarm's connected peers as we advertise them in ut_pex messages,
+ * plus a log of how that list has changed.
+ *
+ * Each time the list changes, the difference is logged under a new
+ * version number. A peer only has to remember the last version that it
+ * was sent, and its next message is derived from the log entries after
+ * that version. The bencoded messages are cached per starting version,
+ * so peers that are at the same version share one message.
+ *
+ * Version 0 is the empty list. Peers that fall behind the log's history
+ * are sent the whole list again, as if they were starting from scratch.
+ */
+class PexDeltaLog
+{
+public:
+    using Version = uint32_t;
+
+    // one sorted list per address type
+    using Snapshot = std::array<std::vector<tr_pex>, NUM_TR_AF_INET_TYPES>;
+
+    struct Delta
+    {
+        Snapshot added;
+        Snapshot dropped;
+    };
+
+    // How many peers of each address type to advertise.
+    // Some peers give us error messages if we send more than this
+    // many peers in a single pex message.
+    // https://wiki.theory.org/BitTorrentPeerExchangeConventions
+    static auto constexpr MaxPeers = size_t{ 50U };
+
+    // Replace the list with `snapshot`, whose lists must be sorted.
+    // If anything changed, the difference is logged as a new version.
+    void update(Snapshot snapshot);
+
+    [[nodiscard]] constexpr auto version() const noexcept
+    {
+        return version_;
+    }
+
+    [[nodiscard]] constexpr auto const& snapshot() const noexcept
+    {
+        return snapshot_;
+    }
+
+    // what changed between version `since` and now
+    [[nodiscard]] Delta delta_since(Version since) const;
+
+    // the bencoded ut_pex payload for a peer that was last sent version `since`
+    [[nodiscard]] std::string const& message_since(Version since);
+
+    [[nodiscard]] static std::string encode(Delta const& delta);
+
+private:
+    // enough history for peers whose pex timers run a few updates apart
+    static auto constexpr MaxLogSize = size_t{ 8U };
+
+    struct Entry
+    {
+        Version version = {};
+        Delta delta;
+    };
+
+    Snapshot snapshot_;
+    std::deque<Entry> log_;
+    Version version_ = {};
+
+    // cleared whenever the version changes
+    std::map<Version, std::string> messages_;
+};
@@ -0,0 +1,150 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <algorithm> // std::max
+#include <cstddef>
+#include <cstdint>
+#include <functional> // std::hash
+#include <memory>
+#include <utility> // std::move, std::swap
+#include <vector>
+
+#define LIBTRANSMISSION_PEER_MODULE
+
+#include "libtransmission/net.h"
+#include "libtransmission/peer-mgr-pool.h"
+#include "libtransmission/peer-mgr.h"
+#include "libtransmission/tr-assert.h"
+
+size_t PeerInfoPool::hash_of(tr_socket_address const& socket_address) noexcept
+{
+    return std::hash<tr_socket_address>{}(socket_address);
+}
+
+size_t PeerInfoPool::probe(tr_socket_address const& socket_address, size_t const hash) const noexcept
+{
+    TR_ASSERT(!std::empty(slots_));
+
+    for (auto idx = home_of(hash);; idx = (idx + 1U) & mask())
+    {
+        auto const& slot = slots_[idx];
+        if (!slot.info || (slot.hash == hash && slot.info->listen_socket_address() == socket_address))
+        {
+            return idx;
+        }
+    }
+}
+
+std::shared_ptr<tr_peer_info> PeerInfoPool::find(tr_socket_address const& socket_address) const noexcept
+{
+    if (size_ == 0U)
+    {
+        return {};
+    }
+
+    return slots_[probe(socket_address, hash_of(socket_address))].info;
+}
+
+bool PeerInfoPool::insert_or_assign(std::shared_ptr<tr_peer_info> info)
+{
+    TR_ASSERT(info);
+
+    // keep the load factor at or below 3/4
+    if ((size_ + 1U) * 4U > std::size(slots_) * 3U)
+    {
+        rehash(bits_ == 0U ? MinBits : bits_ + 1U);
+    }
+
+    auto const& socket_address = info->listen_socket_address();
+    auto const hash = hash_of(socket_address);
+    auto& slot = slots_[probe(socket_address, hash)];
+    auto const is_new = !slot.info;
+
+    slot.info = std::move(info);
+    slot.hash = hash;
+
+    if (is_new)
+    {
+        ++size_;
+    }
+
+    return is_new;
+}
+
+size_t PeerInfoPool::erase(tr_socket_address const& socket_address) noexcept
+{
+    if (size_ == 0U)
+    {
+        return 0U;
+    }
+
+    auto const idx = probe(socket_address, hash_of(socket_address));
+    if (!slots_[idx].info)
+    {
+        return 0U;
+    }
+
+    erase_slot(idx);
+    --size_;
+    return 1U;
+}
+
+// Linear probing without tombstones: after emptying a slot, shift back
+// any later entries in the same run that would otherwise become
+// unreachable from their home slot.
+void PeerInfoPool::erase_slot(size_t idx) noexcept
+{
+    for (auto next = (idx + 1U) & mask(); slots_[next].info; next = (next + 1U) & mask())
+    {
+        auto const home = home_of(slots_[next].hash);
+        if (((next - home) & mask()) >= ((next - idx) & mask()))
+        {
+            slots_[idx] = std::move(slots_[next]);
+            idx = next;
+        }
+    }
+
+    slots_[idx] = {};
+}
+
+void PeerInfoPool::reserve(size_t const n_entries)
+{
+    auto bits = std::max(bits_, MinBits);
+    while (n_entries * 4U > (size_t{ 1U } << bits) * 3U)
+    {
+        ++bits;
+    }
+
+    if (bits != bits_)
+    {
+        rehash(bits);
+    }
+}
+
+void PeerInfoPool::rehash(uint8_t const bits)
+{
+    auto old_slots = std::vector<Slot>(size_t{ 1U } << bits);
+    std::swap(old_slots, slots_);
+    bits_ = bits;
+
+    for (auto& old_slot : old_slots)
+    {
+        if (old_slot.info)
+        {
+            auto idx = home_of(old_slot.hash);
+            while (slots_[idx].info)
+            {
+                idx = (idx + 1U) & mask();
+            }
+
+            slots_[idx] = std::move(old_slot);
+        }
+    }
+}
+
+size_t PeerInfoPool::memory_usage() const noexcept
+{
+    return sizeof(*this) + std::size(slots_) * sizeof(Slot) + size_ * (sizeof(tr_peer_info) + ControlBlockBytes);
+}
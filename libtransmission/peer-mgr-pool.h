@@ -0,0 +1,218 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#pragma once
+
+#ifndef LIBTRANSMISSION_PEER_MODULE
+#error only the libtransmission peer module should #include this header.
+#endif
+
+#include <algorithm> // std::min, std::nth_element
+#include <cstddef> // size_t, ptrdiff_t
+#include <cstdint> // uint8_t
+#include <iterator> // std::forward_iterator_tag
+#include <memory>
+#include <vector>
+
+#include "libtransmission/net.h" // tr_socket_address
+#include "libtransmission/peer-mgr.h" // tr_peer_info
+
+/**
+ * A swarm's known peers, keyed by each peer's listening address.
+ *
+ * This is an open-addressing hash table with linear probing. Each slot
+ * holds just the `tr_peer_info` and its hash; the key is read from the
+ * peer info itself, so it isn't stored twice. Lookups and insertions are
+ * O(1) instead of the O(n) shifting that a sorted flat map needs, which
+ * matters when PEX, DHT, and trackers tell us about thousands of peers.
+ *
+ * A peer info's listen address must not change while it's in the pool.
+ * Erase it first, change the address, then add it back.
+ */
+class PeerInfoPool
+{
+    struct Slot
+    {
+        std::shared_ptr<tr_peer_info> info;
+        size_t hash = {};
+    };
+
+public:
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::shared_ptr<tr_peer_info>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = value_type const*;
+        using reference = value_type const&;
+
+        [[nodiscard]] reference operator*() const noexcept
+        {
+            return it_->info;
+        }
+
+        [[nodiscard]] pointer operator->() const noexcept
+        {
+            return &it_->info;
+        }
+
+        const_iterator& operator++() noexcept
+        {
+            ++it_;
+            skip_empty();
+            return *this;
+        }
+
+        [[nodiscard]] constexpr bool operator==(const_iterator const& that) const noexcept
+        {
+            return it_ == that.it_;
+        }
+
+        [[nodiscard]] constexpr bool operator!=(const_iterator const& that) const noexcept
+        {
+            return it_ != that.it_;
+        }
+
+    private:
+        friend class PeerInfoPool;
+
+        const_iterator(Slot const* it, Slot const* end) noexcept
+            : it_{ it }
+            , end_{ end }
+        {
+            skip_empty();
+        }
+
+        void skip_empty() noexcept
+        {
+            while (it_ != end_ && !it_->info)
+            {
+                ++it_;
+            }
+        }
+
+        Slot const* it_;
+        Slot const* end_;
+    };
+
+    [[nodiscard]] constexpr auto size() const noexcept
+    {
+        return size_;
+    }
+
+    [[nodiscard]] constexpr auto empty() const noexcept
+    {
+        return size_ == 0U;
+    }
+
+    [[nodiscard]] const_iterator begin() const noexcept
+    {
+        return { std::data(slots_), std::data(slots_) + std::size(slots_) };
+    }
+
+    [[nodiscard]] const_iterator end() const noexcept
+    {
+        auto const* const end = std::data(slots_) + std::size(slots_);
+        return { end, end };
+    }
+
+    [[nodiscard]] std::shared_ptr<tr_peer_info> find(tr_socket_address const& socket_address) const noexcept;
+
+    // Add `info` under its listen address, replacing any info that's already there.
+    // Returns true if a new entry was added, or false if an old one was replaced.
+    bool insert_or_assign(std::shared_ptr<tr_peer_info> info);
+
+    // Returns the number of entries removed: 0 or 1.
+    size_t erase(tr_socket_address const& socket_address) noexcept;
+
+    void clear() noexcept
+    {
+        slots_.clear();
+        size_ = 0U;
+        bits_ = 0U;
+    }
+
+    void reserve(size_t n_entries);
+
+    // Evict the least useful peer infos that aren't in use until at most
+    // `target` entries remain. Peer infos that are in use are never evicted.
+    // `is_more_useful(a, b)` takes two `tr_peer_info const*` and returns
+    // true if `a` is more worth keeping than `b`. `on_evict` is called with
+    // each `tr_peer_info const&` just before it's evicted.
+    // Returns the number of entries evicted.
+    template<typename Compare, typename OnEvict>
+    size_t prune(size_t target, Compare const& is_more_useful, OnEvict const& on_evict)
+    {
+        if (size_ <= target)
+        {
+            return 0U;
+        }
+
+        auto candidates = std::vector<tr_peer_info const*>{};
+        candidates.reserve(size_);
+        for (auto const& slot : slots_)
+        {
+            if (slot.info && !slot.info->is_in_use())
+            {
+                candidates.emplace_back(slot.info.get());
+            }
+        }
+
+        // move the least useful ones to the front
+        auto const n_evict = std::min(size_ - target, std::size(candidates));
+        std::nth_element(
+            std::begin(candidates),
+            std::begin(candidates) + n_evict,
+            std::end(candidates),
+            [&is_more_useful](auto const* a, auto const* b) { return is_more_useful(b, a); });
+
+        for (size_t i = 0U; i < n_evict; ++i)
+        {
+            on_evict(*candidates[i]);
+
+            // copy the key: erasing may free the peer info that holds it
+            auto const socket_address = candidates[i]->listen_socket_address();
+            erase(socket_address);
+        }
+
+        return n_evict;
+    }
+
+    // An estimate of how many bytes of memory the pool uses,
+    // including the peer infos themselves.
+    [[nodiscard]] size_t memory_usage() const noexcept;
+
+private:
+    static auto constexpr MinBits = uint8_t{ 4U };
+
+    // the size of a std::make_shared() control block: a vtable and two counts
+    static auto constexpr ControlBlockBytes = sizeof(void*) + 2U * sizeof(int);
+
+    [[nodiscard]] static size_t hash_of(tr_socket_address const& socket_address) noexcept;
+
+    // the slot that `hash` should be in if there are no collisions
+    [[nodiscard]] constexpr size_t home_of(size_t const hash) const noexcept
+    {
+        // Fibonacci hashing, to spread out hashes that only differ in the low bits
+        return static_cast<size_t>((static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ULL) >> (64U - bits_));
+    }
+
+    [[nodiscard]] size_t mask() const noexcept
+    {
+        return std::size(slots_) - 1U;
+    }
+
+    // Returns the index of the slot holding `socket_address`,
+    // or of the empty slot where it would go.
+    [[nodiscard]] size_t probe(tr_socket_address const& socket_address, size_t hash) const noexcept;
+
+    void rehash(uint8_t bits);
+    void erase_slot(size_t idx) noexcept;
+
+    std::vector<Slot> slots_;
+    size_t size_ = 0U;
+    uint8_t bits_ = 0U;
+};
@@ -0,0 +1,66 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility> // std::pair
+#include <vector>
+
+#define LIBTRANSMISSION_PEER_MODULE
+
+#include "libtransmission/transmission.h"
+
+#include "libtransmission/bitfield.h"
+#include "libtransmission/peer-mgr-super-seed.h"
+
+std::optional<tr_piece_index_t> SuperSeeder::pick(tr_bitfield const& peer_has, std::vector<uint16_t> const& availability)
+{
+    auto const n_pieces = std::size(offers_);
+    if (n_pieces == 0U || peer_has.has_all())
+    {
+        return {};
+    }
+
+    auto best = std::optional<tr_piece_index_t>{};
+    auto best_key = std::pair<uint16_t, uint16_t>{};
+
+    for (size_t i = 0U; i < n_pieces; ++i)
+    {
+        auto const piece = static_cast<tr_piece_index_t>((cursor_ + i) % n_pieces);
+        if (peer_has.test(piece))
+        {
+            continue;
+        }
+
+        auto const key = std::pair{ offers_[piece], piece < std::size(availability) ? availability[piece] : uint16_t{} };
+        if (!best || key < best_key)
+        {
+            best = piece;
+            best_key = key;
+
+            // nobody has it and nobody's been offered it; can't do better
+            if (key == std::pair<uint16_t, uint16_t>{})
+            {
+                break;
+            }
+        }
+    }
+
+    if (best)
+    {
+        cursor_ = (*best + 1U) % n_pieces;
+    }
+
+    return best;
+}
+
+bool SuperSeeder::has_propagated(
+    tr_bitfield const& peer_has,
+    tr_piece_index_t const piece,
+    std::vector<uint16_t> const& availability)
+{
+    return peer_has.test(piece) && piece < std::size(availability) && availability[piece] >= 2U;
+}
@@ -0,0 +1,88 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#pragma once
+
+#ifndef LIBTRANSMISSION_PEER_MODULE
+#error only the libtransmission peer module should #include this header.
+#endif
+
+#include <cstddef> // size_t
+#include <cstdint> // uint16_t
+#include <optional>
+#include <vector>
+
+#include "libtransmission/transmission.h" // tr_piece_index_t
+
+struct tr_bitfield;
+
+/**
+ * Picks which pieces to advertise to peers in super-seeding mode (BEP 16).
+ *
+ * A super-seeder hides its bitfield and tells each peer about one piece
+ * at a time. The peer only learns about another piece once the one it
+ * was offered shows up at some other peer, i.e. once it has been passed
+ * on. That way we upload each piece roughly once until the swarm has a
+ * full copy, instead of uploading the popular pieces over and over.
+ */
+class SuperSeeder
+{
+public:
+    explicit SuperSeeder(size_t piece_count = 0U)
+        : offers_(piece_count)
+    {
+    }
+
+    void reset(size_t piece_count)
+    {
+        offers_.assign(piece_count, 0U);
+        cursor_ = 0U;
+    }
+
+    // Pick a piece that `peer_has` lacks to offer next: the one that has
+    // been offered to the fewest peers, breaking ties by rarity. Callers
+    // should `add_offer()` the piece once they've sent it.
+    [[nodiscard]] std::optional<tr_piece_index_t> pick(
+        tr_bitfield const& peer_has,
+        std::vector<uint16_t> const& availability);
+
+    void add_offer(tr_piece_index_t piece) noexcept
+    {
+        if (piece < std::size(offers_))
+        {
+            ++offers_[piece];
+        }
+    }
+
+    void remove_offer(tr_piece_index_t piece) noexcept
+    {
+        if (piece < std::size(offers_) && offers_[piece] > 0U)
+        {
+            --offers_[piece];
+        }
+    }
+
+    // how many peers currently have `piece` as their offer
+    [[nodiscard]] uint16_t offer_count(tr_piece_index_t piece) const noexcept
+    {
+        return piece < std::size(offers_) ? offers_[piece] : 0U;
+    }
+
+    // Whether a peer that was offered `piece` has passed it on, so it
+    // can be offered another one: the peer has the piece, and so does
+    // at least one other peer.
+    [[nodiscard]] static bool has_propagated(
+        tr_bitfield const& peer_has,
+        tr_piece_index_t piece,
+        std::vector<uint16_t> const& availability);
+
+private:
+    // how many peers are currently offered each piece
+    std::vector<uint16_t> offers_;
+
+    // where the next pick() starts looking, so that
+    // equally good pieces are handed out in turn
+    size_t cursor_ = 0U;
+};
@@ -3,9 +3,14 @@
 // or any future license endorsed by Mnemosyne LLC.
 // License text can be found in the licenses/ folder.
 
-#include <algorithm> // std::adjacent_find, std::sort
+#include <algorithm> // std::adjacent_find, std::inplace_merge, std::lower_bound, std::nth_element, std::sort
+#include <array>
 #include <cstddef>
+#include <cstdint> // int64_t
 #include <functional>
+#include <iterator> // std::back_inserter
+#include <limits>
+#include <map>
 #include <utility>
 #include <vector>
 
@@ -16,8 +21,10 @@
 #include "libtransmission/transmission.h"
 
 #include "libtransmission/bitfield.h"
+#include "libtransmission/block-info.h"
 #include "libtransmission/crypto-utils.h" // for tr_salt_shaker
 #include "libtransmission/peer-mgr-wishlist.h"
+#include "libtransmission/tr-assert.h"
 
 namespace
 {
@@ -53,57 +60,62 @@ std::vector<tr_block_span_t> make_spans(small::vector<tr_block_index_t> const& b
 
 class Wishlist::Impl
 {
-    struct Candidate
+    // Candidates are grouped into buckets of pieces that are equally
+    // desirable, and the buckets are kept in the order that we want to
+    // request them in. Moving a piece between buckets when its missing
+    // block count or replication changes is a lookup in the (small) map
+    // of non-empty buckets, plus a binary search and an insertion into
+    // the sorted array of the bucket's pieces.
+    struct BucketKey
     {
-        Candidate(
-            tr_piece_index_t piece_in,
-            size_t replication_in,
-            tr_priority_t priority_in,
-            tr_piece_index_t salt_in,
-            Mediator const* mediator)
-            : piece{ piece_in }
-            , replication{ replication_in }
-            , priority{ priority_in }
-            , salt{ salt_in }
-            , mediator_{ mediator }
-        {
-        }
+        size_t n_missing;
+        tr_priority_t priority;
+
+        // Only the relative values matter, so events that change every
+        // piece's replication by the same amount (e.g. "have all") are
+        // ignored. That means these can drift below zero.
+        int64_t replication;
 
-        [[nodiscard]] int compare(Candidate const& that) const noexcept; // <=>
+        [[nodiscard]] int compare(BucketKey const& that) const noexcept; // <=>
 
-        [[nodiscard]] auto operator<(Candidate const& that) const // less than
+        [[nodiscard]] auto operator<(BucketKey const& that) const noexcept
         {
             return compare(that) < 0;
         }
+    };
 
-        tr_piece_index_t piece;
-
-        // Caching the following 2 values are highly beneficial, because:
-        // - they are often used (mainly because resort_piece() is called
-        //   every time we receive a block)
-        // - does not change as often compared to missing blocks
-        // - calculating their values involves sifting through bitfield(s),
-        //   which is expensive.
-        size_t replication;
-        tr_priority_t priority;
+    // The pieces in a bucket as (salt, piece) pairs, sorted by salt.
+    // Each piece keeps the same random salt until the next rebuild, so
+    // ties are broken the same way no matter how often a piece moves.
+    // Sequential downloads use the piece index as the salt.
+    using Bucket = std::vector<std::pair<tr_piece_index_t, tr_piece_index_t>>;
 
-        tr_piece_index_t salt;
+    using Buckets = std::map<BucketKey, Bucket>;
 
-    private:
-        Mediator const* mediator_;
+    struct Candidate
+    {
+        BucketKey key = {};
+        tr_piece_index_t salt = {};
     };
 
-    using CandidateVec = std::vector<Candidate>;
-
 public:
     explicit Impl(std::unique_ptr<Mediator> mediator_in);
 
     std::vector<tr_block_span_t> next(
         size_t n_wanted_blocks,
         std::function<bool(tr_piece_index_t)> const& peer_has_piece,
-        std::function<bool(tr_block_index_t)> const& has_active_pending_to_peer);
+        std::function<bool(tr_block_index_t)> const& has_active_pending_to_peer,
+        PeerSpeed const& peer_speed);
 
 private:
+    void add_deadline_blocks(
+        std::vector<tr_stream_deadline> const& deadlines,
+        size_t n_wanted_blocks,
+        std::function<bool(tr_piece_index_t)> const& peer_has_piece,
+        std::function<bool(tr_block_index_t)> const& has_active_pending_to_peer,
+        PeerSpeed const& peer_speed,
+        small::vector<tr_block_index_t>& blocks) const;
+
     constexpr void set_candidates_dirty() noexcept
     {
         candidates_dirty_ = true;
@@ -111,110 +123,151 @@ private:
 
     // ---
 
-    TR_CONSTEXPR20 void dec_replication() noexcept
+    [[nodiscard]] bool is_listed(tr_piece_index_t const piece) const noexcept
     {
-        if (!candidates_dirty_)
-        {
-            std::for_each(
-                std::begin(candidates_),
-                std::end(candidates_),
-                [](Candidate& candidate) { --candidate.replication; });
-        }
+        return !candidates_dirty_ && piece < std::size(listed_) && listed_.test(piece);
     }
 
-    TR_CONSTEXPR20 void dec_replication_from_bitfield(tr_bitfield const& bitfield)
+    void link(tr_piece_index_t const piece)
     {
-        if (candidates_dirty_)
-        {
-            return;
-        }
+        auto const& candidate = candidates_[piece];
+        auto& bucket = buckets_[candidate.key];
+        auto const entry = std::pair{ candidate.salt, piece };
+        bucket.insert(std::upper_bound(std::begin(bucket), std::end(bucket), entry), entry);
+        listed_.set(piece);
+    }
 
-        if (bitfield.has_none())
-        {
-            return;
-        }
+    void unlink(tr_piece_index_t const piece)
+    {
+        auto const& candidate = candidates_[piece];
+        auto const iter = buckets_.find(candidate.key);
+        TR_ASSERT(iter != std::end(buckets_));
+        auto& bucket = iter->second;
 
-        if (bitfield.has_all())
-        {
-            dec_replication();
-            return;
-        }
+        auto const it = std::lower_bound(std::begin(bucket), std::end(bucket), std::pair{ candidate.salt, piece });
+        TR_ASSERT(it != std::end(bucket) && it->second == piece);
+        bucket.erase(it);
+        listed_.unset(piece);
 
-        for (auto& candidate : candidates_)
+        if (std::empty(bucket))
         {
-            if (bitfield.test(candidate.piece))
-            {
-                --candidate.replication;
-            }
+            buckets_.erase(iter);
         }
-
-        std::sort(std::begin(candidates_), std::end(candidates_));
     }
 
-    TR_CONSTEXPR20 void inc_replication() noexcept
+    template<typename Mutator>
+    void move_piece(tr_piece_index_t const piece, Mutator mutator)
     {
-        if (!candidates_dirty_)
+        if (!is_listed(piece))
         {
-            std::for_each(
-                std::begin(candidates_),
-                std::end(candidates_),
-                [](Candidate& candidate) { ++candidate.replication; });
+            return;
         }
+
+        unlink(piece);
+        mutator(candidates_[piece].key);
+        link(piece);
     }
 
-    void inc_replication_from_bitfield(tr_bitfield const& bitfield)
+    // ---
+
+    // A peer's bitfield changes the replication of each piece it has.
+    // Only the relative values matter, so that's the same as changing
+    // the replication of each piece it doesn't have the other way.
+    // Move whichever of those two groups of listed pieces is smaller.
+    //
+    // This takes one pass over the buckets instead of a bucket lookup
+    // per piece. Every piece in a bucket moves to the same new bucket,
+    // so the moved pieces are gathered first and then added to their
+    // new buckets a bucket at a time.
+    void add_replication_from_bitfield(tr_bitfield const& bitfield, int64_t delta)
     {
-        if (candidates_dirty_)
+        if (candidates_dirty_ || bitfield.has_none() || bitfield.has_all())
         {
             return;
         }
 
-        if (bitfield.has_none())
+        auto const move_haves = listed_.count_intersection(bitfield) * 2U <= listed_.count();
+        if (!move_haves)
         {
-            return;
+            delta = -delta;
         }
 
-        if (bitfield.has_all())
+        auto moves = std::vector<std::pair<BucketKey, Bucket>>{};
+        for (auto iter = std::begin(buckets_); iter != std::end(buckets_);)
         {
-            inc_replication();
-            return;
+            auto& [key, bucket] = *iter;
+
+            // both halves stay sorted by salt
+            auto moving = Bucket{};
+            auto n_kept = size_t{};
+            for (auto const& entry : bucket)
+            {
+                if (bitfield.test(entry.second) == move_haves)
+                {
+                    moving.emplace_back(entry);
+                }
+                else
+                {
+                    bucket[n_kept++] = entry;
+                }
+            }
+            bucket.resize(n_kept);
+
+            if (!std::empty(moving))
+            {
+                auto next_key = key;
+                next_key.replication += delta;
+                moves.emplace_back(next_key, std::move(moving));
+            }
+
+            iter = std::empty(bucket) ? buckets_.erase(iter) : std::next(iter);
         }
 
-        for (auto& candidate : candidates_)
+        for (auto const& [key, entries] : moves)
         {
-            if (bitfield.test(candidate.piece))
+            for (auto const& [salt, piece] : entries)
             {
-                ++candidate.replication;
+                candidates_[piece].key = key;
             }
+
+            auto& bucket = buckets_[key];
+            auto const n_old = std::size(bucket);
+            bucket.insert(std::end(bucket), std::begin(entries), std::end(entries));
+            std::inplace_merge(std::begin(bucket), std::begin(bucket) + n_old, std::end(bucket));
         }
+    }
 
-        std::sort(std::begin(candidates_), std::end(candidates_));
+    void dec_replication_from_bitfield(tr_bitfield const& bitfield)
+    {
+        add_replication_from_bitfield(bitfield, -1);
     }
 
-    TR_CONSTEXPR20 void inc_replication_piece(tr_piece_index_t piece)
+    void inc_replication_from_bitfield(tr_bitfield const& bitfield)
     {
-        if (candidates_dirty_)
-        {
-            return;
-        }
+        add_replication_from_bitfield(bitfield, 1);
+    }
 
-        if (auto iter = piece_lookup(piece); iter != std::end(candidates_))
-        {
-            ++iter->replication;
-            resort_piece(iter);
-        }
+    void inc_replication_piece(tr_piece_index_t const piece)
+    {
+        move_piece(piece, [](BucketKey& key) { ++key.replication; });
     }
 
-    // ---
+    void update_missing_blocks(tr_piece_index_t const piece)
+    {
+        auto const n_missing = mediator_->count_missing_blocks(piece);
+        move_piece(piece, [n_missing](BucketKey& key) { key.n_missing = n_missing; });
+    }
 
-    TR_CONSTEXPR20 CandidateVec::iterator piece_lookup(tr_piece_index_t const piece)
+    void remove_piece(tr_piece_index_t const piece)
     {
-        return std::find_if(
-            std::begin(candidates_),
-            std::end(candidates_),
-            [piece](auto const& candidate) { return candidate.piece == piece; });
+        if (is_listed(piece))
+        {
+            unlink(piece);
+        }
     }
 
+    // ---
+
     void maybe_rebuild_candidate_list()
     {
         if (!candidates_dirty_)
@@ -222,80 +275,45 @@ private:
             return;
         }
         candidates_dirty_ = false;
-        candidates_.clear();
+        buckets_.clear();
 
         auto salter = tr_salt_shaker<tr_piece_index_t>{};
         auto const is_sequential = mediator_->is_sequential_download();
         auto const n_pieces = mediator_->piece_count();
-        candidates_.reserve(n_pieces);
+        candidates_.assign(n_pieces, Candidate{});
+        listed_ = tr_bitfield{ n_pieces };
+
+        auto wanted = std::vector<std::pair<tr_piece_index_t, tr_piece_index_t>>{};
+        wanted.reserve(n_pieces);
         for (tr_piece_index_t piece = 0U; piece < n_pieces; ++piece)
         {
-            if (mediator_->count_missing_blocks(piece) <= 0U || !mediator_->client_wants_piece(piece))
+            auto const n_missing = mediator_->count_missing_blocks(piece);
+            if (n_missing <= 0U || !mediator_->client_wants_piece(piece))
             {
                 continue;
             }
 
-            auto const salt = is_sequential ? piece : salter();
-            candidates_.emplace_back(
-                piece,
-                mediator_->count_piece_replication(piece),
-                mediator_->priority(piece),
-                salt,
-                mediator_.get());
-        }
-        std::sort(std::begin(candidates_), std::end(candidates_));
-    }
-
-    TR_CONSTEXPR20 void remove_piece(tr_piece_index_t const piece)
-    {
-        if (candidates_dirty_)
-        {
-            return;
-        }
-
-        if (auto iter = piece_lookup(piece); iter != std::end(candidates_))
-        {
-            candidates_.erase(iter);
-        }
-    }
-
-    TR_CONSTEXPR20 void resort_piece(tr_piece_index_t const piece)
-    {
-        if (candidates_dirty_)
-        {
-            return;
+            auto& candidate = candidates_[piece];
+            candidate.key.n_missing = n_missing;
+            candidate.key.priority = mediator_->priority(piece);
+            candidate.key.replication = static_cast<int64_t>(mediator_->count_piece_replication(piece));
+            candidate.salt = is_sequential ? piece : salter();
+            wanted.emplace_back(candidate.salt, piece);
         }
 
-        if (auto iter = piece_lookup(piece); iter != std::end(candidates_))
+        // add them in salt order so that each bucket is sorted without any searching
+        std::sort(std::begin(wanted), std::end(wanted));
+        for (auto const& entry : wanted)
         {
-            resort_piece(iter);
+            buckets_[candidates_[entry.second].key].emplace_back(entry);
+            listed_.set(entry.second);
         }
     }
 
-    TR_CONSTEXPR20 void resort_piece(CandidateVec::iterator const pos_old)
-    {
-        if (candidates_dirty_)
-        {
-            return;
-        }
-
-        auto const pos_begin = std::begin(candidates_);
-
-        // Candidate needs to be moved towards the front of the list
-        if (auto const pos_next = std::next(pos_old); pos_old > pos_begin && *pos_old < *std::prev(pos_old))
-        {
-            auto const pos_new = std::lower_bound(pos_begin, pos_old, *pos_old);
-            std::rotate(pos_new, pos_old, pos_next);
-        }
-        // Candidate needs to be moved towards the end of the list
-        else if (auto const pos_end = std::end(candidates_); pos_next < pos_end && *pos_next < *pos_old)
-        {
-            auto const pos_new = std::lower_bound(pos_next, pos_end, *pos_old);
-            std::rotate(pos_old, pos_next, pos_new);
-        }
-    }
-
-    CandidateVec candidates_;
+    // Indexed by piece. Unwanted pieces are never listed in a bucket.
+    std::vector<Candidate> candidates_;
+    tr_bitfield listed_{ 0U };
+    Buckets buckets_;
     bool candidates_dirty_ = true;
 
     std::array<libtransmission::ObserverTag, 8U> const tags_;
@@ -307,9 +325,10 @@ Wishlist::Impl::Impl(std::unique_ptr<Mediator> mediator_in)
     : tags_{ {
           mediator_in->observe_peer_disconnect([this](tr_torrent*, tr_bitfield const& b) { dec_replication_from_bitfield(b); }),
           mediator_in->observe_got_bitfield([this](tr_torrent*, tr_bitfield const& b) { inc_replication_from_bitfield(b); }),
-          mediator_in->observe_got_block([this](tr_torrent*, tr_piece_index_t p, tr_block_index_t) { resort_piece(p); }),
+          mediator_in->observe_got_block([this](tr_torrent*, tr_piece_index_t p, tr_block_index_t) { update_missing_blocks(p); }),
           mediator_in->observe_got_have([this](tr_torrent*, tr_piece_index_t p) { inc_replication_piece(p); }),
-          mediator_in->observe_got_have_all([this](tr_torrent*) { inc_replication(); }),
+          // a "have all" makes every piece one more replicated, which doesn't change their order
+          mediator_in->observe_got_have_all([](tr_torrent*) {}),
           mediator_in->observe_piece_completed([this](tr_torrent*, tr_piece_index_t p) { remove_piece(p); }),
           mediator_in->observe_priority_changed([this](tr_torrent*, tr_file_index_t const*, tr_file_index_t, tr_priority_t)
                                                 { set_candidates_dirty(); }),
@@ -319,10 +338,68 @@ Wishlist::Impl::Impl(std::unique_ptr<Mediator> mediator_in)
 {
 }
 
+void Wishlist::Impl::add_deadline_blocks(
+    std::vector<tr_stream_deadline> const& deadlines,
+    size_t n_wanted_blocks,
+    std::function<bool(tr_piece_index_t)> const& peer_has_piece,
+    std::function<bool(tr_block_index_t)> const& has_active_pending_to_peer,
+    PeerSpeed const& peer_speed,
+    small::vector<tr_block_index_t>& blocks) const
+{
+    auto const max_peers = mediator_->is_endgame() ? EndgameMaxPeers : NormalMaxPeers;
+
+    // how long until this peer could deliver one more block
+    auto const peer_eta_msec = [&peer_speed, &blocks]()
+    {
+        if (peer_speed.bytes_per_second == 0U)
+        {
+            return std::numeric_limits<int64_t>::max();
+        }
+
+        auto const n_queued = peer_speed.active_requests + std::size(blocks) + 1U;
+        return static_cast<int64_t>(n_queued * tr_block_info::BlockSize * 1000U / peer_speed.bytes_per_second);
+    };
+
+    for (auto const& [piece, deadline_msec] : deadlines)
+    {
+        if (std::size(blocks) >= n_wanted_blocks)
+        {
+            break;
+        }
+
+        if (!peer_has_piece(piece))
+        {
+            continue;
+        }
+
+        auto const at_risk = deadline_msec <= StreamAtRiskMsec;
+        for (auto [block, end] = mediator_->block_span(piece); block < end && std::size(blocks) < n_wanted_blocks; ++block)
+        {
+            if (mediator_->client_has_block(block) || has_active_pending_to_peer(block))
+            {
+                continue;
+            }
+
+            // Leave blocks for peers that can deliver them in time. Once a
+            // deadline is at risk, any peer may take an unrequested block
+            // and a peer that can make it may duplicate another's request.
+            auto const can_make_it = peer_eta_msec() <= deadline_msec;
+            auto const n_active = mediator_->count_active_requests(block);
+            auto const wanted = n_active == 0U ? can_make_it || at_risk :
+                                                 n_active < max_peers || (at_risk && can_make_it && n_active < StreamMaxPeers);
+            if (wanted)
+            {
+                blocks.emplace_back(block);
+            }
+        }
+    }
+}
+
 std::vector<tr_block_span_t> Wishlist::Impl::next(
     size_t n_wanted_blocks,
     std::function<bool(tr_piece_index_t)> const& peer_has_piece,
-    std::function<bool(tr_block_index_t)> const& has_active_pending_to_peer)
+    std::function<bool(tr_block_index_t)> const& has_active_pending_to_peer,
+    PeerSpeed const& peer_speed)
 {
     if (n_wanted_blocks == 0U)
     {
@@ -331,42 +408,72 @@ std::vector<tr_block_span_t> Wishlist::Impl::next(
 
     maybe_rebuild_candidate_list();
 
+    auto const max_peers = mediator_->is_endgame() ? EndgameMaxPeers : NormalMaxPeers;
     auto blocks = small::vector<tr_block_index_t>{};
     blocks.reserve(n_wanted_blocks);
-    for (auto const& candidate : candidates_)
+
+    // when streaming, the pieces in the deadline window come first
+    auto window = small::vector<tr_piece_index_t>{};
+    if (auto const deadlines = mediator_->stream_deadlines(); !std::empty(deadlines))
     {
-        // do we have enough?
-        if (std::size(blocks) >= n_wanted_blocks)
-        {
-            break;
-        }
+        add_deadline_blocks(deadlines, n_wanted_blocks, peer_has_piece, has_active_pending_to_peer, peer_speed, blocks);
 
-        // if the peer doesn't have this piece that we want...
-        if (!peer_has_piece(candidate.piece))
+        window.reserve(std::size(deadlines));
+        for (auto const& deadline : deadlines)
         {
-            continue;
+            window.emplace_back(deadline.piece);
         }
+        std::sort(std::begin(window), std::end(window));
+    }
 
-        // walk the blocks in this piece
-        for (auto [block, end] = mediator_->block_span(candidate.piece); block < end && std::size(blocks) < n_wanted_blocks;
-             ++block)
+    for (auto const& [key, bucket] : buckets_)
+    {
+        for (auto const& [salt, piece] : bucket)
         {
-            // don't request blocks that:
-            // 1. we've already got, or
-            // 2. already has an active request to that peer
-            if (mediator_->client_has_block(block) || has_active_pending_to_peer(block))
+            // do we have enough?
+            if (std::size(blocks) >= n_wanted_blocks)
+            {
+                break;
+            }
+
+            // if the peer doesn't have this piece that we want...
+            if (!peer_has_piece(piece))
             {
                 continue;
             }
 
-            // don't request from too many peers
-            auto const n_peers = mediator_->count_active_requests(block);
-            if (auto const max_peers = mediator_->is_endgame() ? EndgameMaxPeers : NormalMaxPeers; n_peers >= max_peers)
+            // the deadline pass has already decided about these
+            if (!std::empty(window) && std::binary_search(std::begin(window), std::end(window), piece))
             {
                 continue;
             }
 
-            blocks.emplace_back(block);
+            // walk the blocks in this piece
+            for (auto [block, end] = mediator_->block_span(piece); block < end && std::size(blocks) < n_wanted_blocks; ++block)
+            {
+                // don't request blocks that:
+                // 1. we've already got, or
+                // 2. already has an active request to that peer
+                if (mediator_->client_has_block(block) || has_active_pending_to_peer(block))
+                {
+                    continue;
+                }
+
+                // don't request from too many peers, and in endgame
+                // leave the duplicates to the fastest ones
+                if (auto const n_active = mediator_->count_active_requests(block);
+                    n_active >= max_peers || (n_active != 0U && !peer_speed.is_fast))
+                {
+                    continue;
+                }
+
+                blocks.emplace_back(block);
+            }
+        }
+
+        if (std::size(blocks) >= n_wanted_blocks)
+        {
+            break;
         }
     }
 
@@ -376,11 +483,10 @@ std::vector<tr_block_span_t> Wishlist::Impl::next(
     return make_spans(blocks);
 }
 
-int Wishlist::Impl::Candidate::compare(Wishlist::Impl::Candidate const& that) const noexcept
+int Wishlist::Impl::BucketKey::compare(Wishlist::Impl::BucketKey const& that) const noexcept
 {
     // prefer pieces closer to completion
-    if (auto const val = tr_compare_3way(mediator_->count_missing_blocks(piece), mediator_->count_missing_blocks(that.piece));
-        val != 0)
+    if (auto const val = tr_compare_3way(n_missing, that.n_missing); val != 0)
     {
         return val;
     }
@@ -392,12 +498,7 @@ int Wishlist::Impl::Candidate::compare(Wishlist::Impl::Candidate const& that) co
     }
 
     // prefer rarer pieces
-    if (auto const val = tr_compare_3way(replication, that.replication); val != 0)
-    {
-        return val;
-    }
-
-    return tr_compare_3way(salt, that.salt);
+    return tr_compare_3way(replication, that.replication);
 }
 
 // ---
@@ -412,7 +513,41 @@ Wishlist::~Wishlist() = default;
 std::vector<tr_block_span_t> Wishlist::next(
     size_t n_wanted_blocks,
     std::function<bool(tr_piece_index_t)> const& peer_has_piece,
-    std::function<bool(tr_block_index_t)> const& has_active_pending_to_peer)
+    std::function<bool(tr_block_index_t)> const& has_active_pending_to_peer,
+    PeerSpeed const& peer_speed)
+{
+    return impl_->next(n_wanted_blocks, peer_has_piece, has_active_pending_to_peer, peer_speed);
+}
+
+std::vector<bool> Wishlist::pick_endgame_fast_peers(std::vector<uint32_t> const& latencies_msec)
 {
-    return impl_->next(n_wanted_blocks, peer_has_piece, has_active_pending_to_peer);
+    auto ret = std::vector<bool>(std::size(latencies_msec), true);
+
+    auto measured = std::vector<uint32_t>{};
+    measured.reserve(std::size(latencies_msec));
+    std::copy_if(
+        std::begin(latencies_msec),
+        std::end(latencies_msec),
+        std::back_inserter(measured),
+        [](uint32_t latency) { return latency != 0U; });
+    if (std::empty(measured))
+    {
+        return ret;
+    }
+
+    auto const n_fast = std::min(EndgameFastPeers, std::size(measured));
+    auto const nth = std::begin(measured) + (n_fast - 1U);
+    std::nth_element(std::begin(measured), nth, std::end(measured));
+    auto const best = *std::min_element(std::begin(measured), nth + 1);
+    auto const cutoff = std::min(*nth, best * EndgameFastLatencyFactor);
+
+    for (size_t i = 0, n = std::size(latencies_msec); i < n; ++i)
+    {
+        if (latencies_msec[i] > cutoff)
+        {
+            ret[i] = false;
+        }
+    }
+
+    return ret;
 }
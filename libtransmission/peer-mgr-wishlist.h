@@ -10,6 +10,7 @@
 #endif
 
 #include <cstddef> // size_t
+#include <cstdint> // uint64_t
 #include <functional>
 #include <memory>
 #include <vector>
@@ -17,6 +18,7 @@
 #include "libtransmission/transmission.h"
 
 #include "libtransmission/observable.h"
+#include "libtransmission/torrent-stream.h" // tr_stream_deadline
 #include "libtransmission/utils.h"
 
 class tr_bitfield;
@@ -30,6 +32,29 @@ public:
     static auto constexpr EndgameMaxPeers = size_t{ 2U };
     static auto constexpr NormalMaxPeers = size_t{ 1U };
 
+    // in endgame, only this many of the peers with the best recent block
+    // latency get duplicate requests, and only if they're within a factor
+    // of the best one; slow peers would just sit on the last blocks
+    static auto constexpr EndgameFastPeers = size_t{ 4U };
+    static auto constexpr EndgameFastLatencyFactor = uint32_t{ 2U };
+
+    // when a streaming deadline is this close, a block may be requested
+    // from a second peer, or from a peer that can't deliver it in time
+    static auto constexpr StreamAtRiskMsec = int64_t{ 3000 };
+    static auto constexpr StreamMaxPeers = size_t{ 2U };
+
+    // how fast the peer that we're picking blocks for sends them to us.
+    // used to leave urgent streaming blocks to peers that can meet their deadline.
+    struct PeerSpeed
+    {
+        uint64_t bytes_per_second = {};
+        size_t active_requests = {};
+
+        // in endgame, whether this peer may duplicate a request that's
+        // already out to someone else. see pick_endgame_fast_peers()
+        bool is_fast = true;
+    };
+
     struct Mediator
     {
         [[nodiscard]] virtual bool client_has_block(tr_block_index_t block) const = 0;
@@ -42,6 +67,7 @@ public:
         [[nodiscard]] virtual tr_block_span_t block_span(tr_piece_index_t piece) const = 0;
         [[nodiscard]] virtual tr_piece_index_t piece_count() const = 0;
         [[nodiscard]] virtual tr_priority_t priority(tr_piece_index_t piece) const = 0;
+        [[nodiscard]] virtual std::vector<tr_stream_deadline> stream_deadlines() const = 0;
 
         [[nodiscard]] virtual libtransmission::ObserverTag observe_peer_disconnect(
             libtransmission::SimpleObservable<tr_torrent*, tr_bitfield const&>::Observer observer) = 0;
@@ -71,7 +97,21 @@ public:
     [[nodiscard]] std::vector<tr_block_span_t> next(
         size_t n_wanted_blocks,
         std::function<bool(tr_piece_index_t)> const& peer_has_piece,
-        std::function<bool(tr_block_index_t)> const& has_active_pending_to_peer);
+        std::function<bool(tr_block_index_t)> const& has_active_pending_to_peer,
+        PeerSpeed const& peer_speed);
+
+    [[nodiscard]] std::vector<tr_block_span_t> next(
+        size_t n_wanted_blocks,
+        std::function<bool(tr_piece_index_t)> const& peer_has_piece,
+        std::function<bool(tr_block_index_t)> const& has_active_pending_to_peer)
+    {
+        return next(n_wanted_blocks, peer_has_piece, has_active_pending_to_peer, PeerSpeed{});
+    }
+
+    // Given each peer's recent request -> block latency, or zero if it
+    // hasn't been measured yet, returns which ones count as fast in endgame.
+    // Unmeasured peers get the benefit of the doubt.
+    [[nodiscard]] static std::vector<bool> pick_endgame_fast_peers(std::vector<uint32_t> const& latencies_msec);
 
 private:
     class Impl;
@@ -11,16 +11,18 @@
 #include <cstddef> // std::byte
 #include <cstdint>
 #include <ctime> // time_t
+#include <functional>
 #include <iterator> // std::back_inserter
+#include <limits>
 #include <memory>
 #include <optional>
+#include <string>
 #include <tuple> // std::tie
 #include <type_traits>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
-#include <small/map.hpp>
 #include <small/vector.hpp>
 
 #include <fmt/core.h>
@@ -40,6 +42,13 @@
 #include "libtransmission/peer-common.h"
 #include "libtransmission/peer-io.h"
 #include "libtransmission/peer-mgr-active-requests.h"
+#include "libtransmission/peer-mgr-availability.h"
+#include "libtransmission/peer-mgr-candidates.h"
+#include "libtransmission/peer-mgr-choker.h"
+#include "libtransmission/peer-mgr-connect.h"
+#include "libtransmission/peer-mgr-pex.h"
+#include "libtransmission/peer-mgr-pool.h"
+#include "libtransmission/peer-mgr-super-seed.h"
 #include "libtransmission/peer-mgr-wishlist.h"
 #include "libtransmission/peer-mgr.h"
 #include "libtransmission/peer-msgs.h"
@@ -51,6 +60,7 @@
 #include "libtransmission/torrent.h"
 #include "libtransmission/torrents.h"
 #include "libtransmission/tr-assert.h"
+#include "libtransmission/tr-buffer.h"
 #include "libtransmission/tr-macros.h"
 #include "libtransmission/utils.h"
 #include "libtransmission/values.h"
@@ -86,7 +96,7 @@ private:
 
 public:
     explicit HandshakeMediator(
-        tr_session const& session,
+        tr_session& session,
         libtransmission::TimerMaker& timer_maker,
         tr_torrents& torrents) noexcept
         : session_{ session }
@@ -116,8 +126,6 @@ public:
         return session_.allowsTCP();
     }
 
-    void set_utp_failed(tr_sha1_digest_t const& info_hash, tr_socket_address const& socket_address) override;
-
     [[nodiscard]] libtransmission::TimerMaker& timer_maker() override
     {
         return timer_maker_;
@@ -130,8 +138,18 @@ public:
         return len;
     }
 
+    void run_in_worker(std::function<void()> work, std::function<void()> on_done) override
+    {
+        session_.worker_pool().add(
+            [&session = session_, work = std::move(work), on_done = std::move(on_done)]() mutable
+            {
+                work();
+                session.queue_session_thread(std::move(on_done));
+            });
+    }
+
 private:
-    tr_session const& session_;
+    tr_session& session_;
     libtransmission::TimerMaker& timer_maker_;
     tr_torrents& torrents_;
 };
@@ -229,15 +247,25 @@ void tr_peer_info::merge(tr_peer_info& that) noexcept
     /* is_connected_ should already be set */
     set_seed(is_seed() || that.is_seed());
 
-    if (that.outgoing_handshake_)
+    if (!last_transport_)
+    {
+        last_transport_ = that.last_transport_;
+    }
+
+    if (!alt_socket_address_)
     {
-        if (outgoing_handshake_)
+        alt_socket_address_ = that.alt_socket_address_;
+    }
+
+    if (!std::empty(that.outgoing_handshakes_))
+    {
+        if (!std::empty(outgoing_handshakes_))
         {
             that.destroy_handshake();
         }
         else
         {
-            outgoing_handshake_ = std::move(that.outgoing_handshake_);
+            outgoing_handshakes_ = std::move(that.outgoing_handshakes_);
         }
     }
 }
@@ -279,6 +307,148 @@ constexpr struct
     }
 } CompareAtomsByUsefulness{};
 
+// how many peer infos a swarm keeps after pruning
+auto get_max_peer_info_count(tr_torrent const& tor)
+{
+    return tor.is_done() ? tor.peer_limit() : tor.peer_limit() * 3U;
+}
+
+struct ComparePeerInfo
+{
+    [[nodiscard]] int compare(tr_peer_info const& a, tr_peer_info const& b) const noexcept
+    {
+        auto const is_a_inactive = a.is_inactive(now_);
+        auto const is_b_inactive = b.is_inactive(now_);
+        if (is_a_inactive != is_b_inactive)
+        {
+            return is_a_inactive ? 1 : -1;
+        }
+
+        return CompareAtomsByUsefulness.compare(a, b);
+    }
+
+    template<typename T>
+    [[nodiscard]] std::enable_if_t<std::is_same_v<std::decay_t<decltype(*std::declval<T>())>, tr_peer_info>, bool> operator()(
+        T const& a,
+        T const& b) const noexcept
+    {
+        return compare(*a, *b) < 0;
+    }
+
+    time_t const now_ = tr_time();
+};
+
+/* is this atom someone that we'd want to initiate a connection to? */
+[[nodiscard]] bool is_peer_candidate(tr_torrent const* tor, tr_peer_info const& peer_info, time_t const now)
+{
+    // have we already tried and failed to connect?
+    if (auto const conn = peer_info.is_connectable(); conn && !*conn)
+    {
+        return false;
+    }
+
+    // not if we're both seeds
+    if (tor->is_done() && peer_info.is_seed())
+    {
+        return false;
+    }
+
+    // not if we've already got a connection to them...
+    if (peer_info.is_in_use())
+    {
+        return false;
+    }
+
+    // not if we just tried them already
+    if (!peer_info.reconnect_interval_has_passed(now))
+    {
+        return false;
+    }
+
+    // not if they're blocklisted
+    if (peer_info.is_blocklisted(tor->session->blocklist()))
+    {
+        return false;
+    }
+
+    // not if they're banned...
+    if (peer_info.is_banned())
+    {
+        return false;
+    }
+
+    return true;
+}
+
+[[nodiscard]] constexpr uint64_t addValToKey(uint64_t value, unsigned int width, uint64_t addme)
+{
+    value <<= width;
+    value |= addme;
+    return value;
+}
+
+/* smaller value is better */
+[[nodiscard]] uint64_t getPeerCandidateScore(tr_torrent const* tor, tr_peer_info const& peer_info, uint8_t salt)
+{
+    auto i = uint64_t{};
+    auto score = uint64_t{};
+
+    /* prefer peers we've connected to, or never tried, over peers we failed to connect to. */
+    i = peer_info.connection_failure_count() != 0U ? 1U : 0U;
+    score = addValToKey(score, 1U, i);
+
+    /* prefer the one we attempted least recently (to cycle through all peers) */
+    i = peer_info.connection_attempt_time();
+    score = addValToKey(score, 32U, i);
+
+    /* prefer peers belonging to a torrent of a higher priority */
+    switch (tor->get_priority())
+    {
+    case TR_PRI_HIGH:
+        i = 0;
+        break;
+
+    case TR_PRI_NORMAL:
+        i = 1;
+        break;
+
+    case TR_PRI_LOW:
+        i = 2;
+        break;
+
+    default:
+        TR_ASSERT_MSG(false, "invalid priority");
+        break;
+    }
+
+    score = addValToKey(score, 4U, i);
+
+    // prefer recently-started torrents
+    i = tor->started_recently(tr_time()) ? 0 : 1;
+    score = addValToKey(score, 1U, i);
+
+    /* prefer torrents we're downloading with */
+    i = tor->is_done() ? 1 : 0;
+    score = addValToKey(score, 1U, i);
+
+    /* prefer peers that are known to be connectible */
+    i = peer_info.is_connectable().value_or(false) ? 0 : 1;
+    score = addValToKey(score, 1U, i);
+
+    /* prefer peers that we might be able to upload to */
+    i = peer_info.is_seed() ? 0 : 1;
+    score = addValToKey(score, 1U, i);
+
+    /* Prefer peers that we got from more trusted sources.
+     * lower `fromBest` values indicate more trusted sources */
+    score = addValToKey(score, 4U, peer_info.from_best());
+
+    /* salt */
+    score = addValToKey(score, 8U, salt);
+
+    return score;
+}
+
 } // namespace
 
 /** @brief Opaque, per-torrent data structure for peer connection information */
@@ -286,7 +456,7 @@ class tr_swarm
 {
 public:
     using Peers = std::vector<tr_peerMsgs*>;
-    using Pool = small::map<tr_socket_address, std::shared_ptr<tr_peer_info>>;
+    using Pool = PeerInfoPool;
 
     class WishlistMediator final : public Wishlist::Mediator
     {
@@ -301,6 +471,7 @@ public:
         [[nodiscard]] bool client_wants_piece(tr_piece_index_t piece) const override;
         [[nodiscard]] bool is_endgame() const override;
         [[nodiscard]] bool is_sequential_download() const override;
+        [[nodiscard]] std::vector<tr_stream_deadline> stream_deadlines() const override;
         [[nodiscard]] size_t count_active_requests(tr_block_index_t block) const override;
         [[nodiscard]] size_t count_missing_blocks(tr_piece_index_t piece) const override;
         [[nodiscard]] size_t count_piece_replication(tr_piece_index_t piece) const override;
@@ -342,13 +513,18 @@ public:
         , tags_{ {
               tor_in->done_.observe([this](tr_torrent*, bool) { on_torrent_done(); }),
               tor_in->doomed_.observe([this](tr_torrent*) { on_torrent_doomed(); }),
+              tor_in->files_wanted_changed_.observe([this](tr_torrent*) { on_files_wanted_changed(); }),
               tor_in->got_bad_piece_.observe([this](tr_torrent*, tr_piece_index_t p) { on_got_bad_piece(p); }),
               tor_in->got_metainfo_.observe([this](tr_torrent*) { on_got_metainfo(); }),
               tor_in->piece_completed_.observe([this](tr_torrent*, tr_piece_index_t p) { on_piece_completed(p); }),
               tor_in->started_.observe([this](tr_torrent*) { on_torrent_started(); }),
               tor_in->stopped_.observe([this](tr_torrent*) { on_torrent_stopped(); }),
+              tor_in->super_seeding_changed_.observe([this](tr_torrent*, bool enabled) { on_super_seeding_changed(enabled); }),
               tor_in->swarm_is_all_seeds_.observe([this](tr_torrent* /*tor*/) { on_swarm_is_all_seeds(); }),
           } }
+        , availability_(tor_in->piece_count())
+        , seeded_to_(tor_in->piece_count())
+        , super_seeder_{ tor_in->piece_count() }
     {
         rebuild_webseeds();
     }
@@ -395,10 +571,113 @@ public:
         return std::size(peers);
     }
 
+    // show interest in `peer` iff it has pieces that we want
+    void update_interest(tr_peerMsgs* const peer) const
+    {
+        if (!tor->is_done() && tor->client_can_download())
+        {
+            peer->set_interested(peer->wanted_piece_count != 0U);
+        }
+    }
+
+    // Offer super-seeded peers their next piece if they don't have one
+    // yet, e.g. because they never sent a bitfield, or if they've been
+    // sitting on a piece that nobody else has picked up for too long.
+    void super_seed_pulse(time_t const now)
+    {
+        for (auto* const peer : peers)
+        {
+            if (!peer->is_super_seeding())
+            {
+                continue;
+            }
+
+            if (auto const piece = peer->super_seed_piece;
+                !piece || (peer->has_piece(*piece) && now >= peer->super_seed_offered_at + SuperSeedStallSecs))
+            {
+                super_seed_next(peer, now);
+            }
+        }
+    }
+
+    // The ut_pex payload for a peer that was last sent `since`.
+    // Sets `setme_version` to the version that the payload brings it up to.
+    std::string const& pex_message_since(PexDeltaLog::Version const since, PexDeltaLog::Version* setme_version)
+    {
+        // rebuild the list at most once per interval, no matter how many peers ask for it
+        if (auto const now = tr_time(); pex_log_updated_at_ == 0 || now - pex_log_updated_at_ >= PexLogTtlSecs)
+        {
+            auto snapshot = PexDeltaLog::Snapshot{};
+            for (uint8_t i = 0; i < NUM_TR_AF_INET_TYPES; ++i)
+            {
+                snapshot[i] = tr_peerMgrGetPeers(tor, i, TR_PEERS_CONNECTED, PexDeltaLog::MaxPeers);
+            }
+
+            pex_log_.update(std::move(snapshot));
+            pex_log_updated_at_ = now;
+        }
+
+        *setme_version = pex_log_.version();
+        return pex_log_.message_since(since);
+    }
+
+    // evict the least useful peer infos until at most `target` are left
+    void prune_pool(size_t const target)
+    {
+        connectable_pool.prune(
+            target,
+            ComparePeerInfo{},
+            [this](tr_peer_info const& info) { --stats.known_peer_from_count[info.from_first()]; });
+        mark_all_seeds_flag_dirty();
+    }
+
+    // Queue `peer_info` as a possible outbound connection. Call this
+    // whenever it might have become worth connecting to, e.g. when we
+    // first hear about it or when a connection to it ends.
+    void enqueue_candidate(tr_peer_info& peer_info)
+    {
+        if (!is_running || connectable_pool.find(peer_info.listen_socket_address()).get() != &peer_info)
+        {
+            return;
+        }
+
+        outbound_candidates.push({ getPeerCandidateScore(tor, peer_info, candidate_salter_()),
+                                   peer_info.listen_socket_address(),
+                                   peer_info.next_candidate_generation() });
+
+        // stale entries are normally discarded as they reach the top,
+        // but don't let a churning swarm grow the queue without bound
+        if (std::size(outbound_candidates) > std::size(connectable_pool) * 2U + MinCandidateQueueSlack)
+        {
+            rebuild_candidates();
+        }
+    }
+
+    // Rescore and requeue every known peer. This is only needed when
+    // something changes that affects many peers at once, e.g. when the
+    // torrent starts or when the blocklist changes.
+    void rebuild_candidates()
+    {
+        outbound_candidates.clear();
+
+        if (!is_running)
+        {
+            return;
+        }
+
+        for (auto const& peer_info : connectable_pool)
+        {
+            outbound_candidates.push({ getPeerCandidateScore(tor, *peer_info, candidate_salter_()),
+                                       peer_info->listen_socket_address(),
+                                       peer_info->next_candidate_generation() });
+        }
+    }
+
     void remove_peer(tr_peerMsgs* peer)
     {
         auto const lock = unique_lock();
 
+        availability_.remove(peer->has());
         peer_disconnect.emit(tor, peer->has());
 
         auto const& peer_info = peer->peer_info;
@@ -413,7 +692,32 @@ public:
             TR_ASSERT(stats.peer_count == peerCount());
         }
 
+        if (auto iter = std::find(std::begin(endgame_slow_peers_), std::end(endgame_slow_peers_), peer);
+            iter != std::end(endgame_slow_peers_))
+        {
+            endgame_slow_peers_.erase(iter);
+        }
+
+        peer->served.for_each_set_bit(
+            [this, peer](size_t piece)
+            {
+                if (piece < std::size(seeded_to_) && seeded_to_[piece] == peer)
+                {
+                    seeded_to_[piece] = nullptr;
+                }
+            });
+
+        if (auto const piece = peer->super_seed_piece; piece)
+        {
+            super_seeder_.remove_offer(*piece);
+        }
+
+        // keep the info alive: deleting the peer drops its reference
+        auto const info = peer_info;
         delete peer;
+
+        // now that it's not in use, we might want to reconnect later
+        enqueue_candidate(*info);
     }
 
     void remove_all_peers()
@@ -433,6 +737,39 @@ public:
         /* we consider ourselves to be in endgame if the number of bytes
            we've got requested is >= the number of bytes left to download */
         is_endgame_ = uint64_t(std::size(active_requests)) * tr_block_info::BlockSize >= tor->left_until_done();
+
+        if (!is_endgame_)
+        {
+            endgame_slow_peers_.clear();
+            endgame_ranked_at_ = {};
+            return;
+        }
+
+        // in endgame, blocks that are already being fetched are only
+        // duplicated to the peers with the best recent block latency
+        auto const now = tr_time_msec();
+        if (endgame_ranked_at_ != 0U && now - endgame_ranked_at_ < EndgameRankIntervalMsec)
+        {
+            return;
+        }
+        endgame_ranked_at_ = now;
+
+        auto latencies = std::vector<uint32_t>{};
+        latencies.reserve(std::size(peers));
+        for (auto const* const peer : peers)
+        {
+            latencies.emplace_back(peer->request_pipeline().rtt_msec());
+        }
+
+        auto const is_fast = Wishlist::pick_endgame_fast_peers(latencies);
+        endgame_slow_peers_.clear();
+        for (size_t i = 0, n = std::size(peers); i < n; ++i)
+        {
+            if (!is_fast[i])
+            {
+                endgame_slow_peers_.emplace_back(peers[i]);
+            }
+        }
     }
 
     [[nodiscard]] constexpr auto is_endgame() const noexcept
@@ -440,6 +777,19 @@ public:
         return is_endgame_;
     }
 
+    // Webseeds and peers we haven't timed yet are never ranked, so they count as fast.
+    [[nodiscard]] bool is_endgame_fast(tr_peer const* peer) const noexcept
+    {
+        return std::find(std::begin(endgame_slow_peers_), std::end(endgame_slow_peers_), peer) ==
+            std::end(endgame_slow_peers_);
+    }
+
+    // How many connected peers have `piece`.
+    [[nodiscard]] size_t piece_availability(tr_piece_index_t piece) const noexcept
+    {
+        return availability_.count(piece);
+    }
+
     [[nodiscard]] TR_CONSTEXPR20 auto is_all_seeds() const noexcept
     {
         if (!pool_is_all_seeds_)
@@ -447,7 +797,7 @@ public:
             pool_is_all_seeds_ = std::all_of(
                 std::begin(connectable_pool),
                 std::end(connectable_pool),
-                [](auto const& key_val) { return key_val.second->is_seed(); });
+                [](auto const& peer_info) { return peer_info->is_seed(); });
         }
 
         return *pool_is_all_seeds_;
@@ -455,12 +805,7 @@ public:
 
     [[nodiscard]] std::shared_ptr<tr_peer_info> get_existing_peer_info(tr_socket_address const& socket_address) const noexcept
     {
-        if (auto it = connectable_pool.find(socket_address); it != std::end(connectable_pool))
-        {
-            return it->second;
-        }
-
-        return {};
+        return connectable_pool.find(socket_address);
     }
 
     std::shared_ptr<tr_peer_info> ensure_info_exists(
@@ -479,10 +824,18 @@ public:
         }
         else
         {
-            peer_info = connectable_pool
-                            .try_emplace(socket_address, std::make_shared<tr_peer_info>(socket_address, flags, from))
-                            .first->second;
+            // make room by evicting the least useful peers in one go,
+            // so that a flood of PEX doesn't rescan the pool every time
+            if (auto const limit = std::max(tor->session->peerPoolLimitPerTorrent(), size_t{ get_max_peer_info_count(*tor) });
+                std::size(connectable_pool) >= limit)
+            {
+                prune_pool(limit - limit / PoolPruneFraction);
+            }
+
+            peer_info = std::make_shared<tr_peer_info>(socket_address, flags, from);
+            connectable_pool.insert_or_assign(peer_info);
             ++stats.known_peer_from_count[from];
+            enqueue_candidate(*peer_info);
         }
 
         mark_all_seeds_flag_dirty();
@@ -523,19 +876,33 @@ public:
 
             break;
 
+        case tr_peer_event::Type::ClientGotWastedData:
+            s->tor->bytes_wasted_ += event.length;
+            break;
+
         case tr_peer_event::Type::ClientGotHave:
+            s->availability_.add(event.pieceIndex);
+            s->on_peer_got_piece(msgs, event.pieceIndex);
+            s->on_peer_finished_piece(msgs, event.pieceIndex);
+            s->on_super_seed_have(msgs, event.pieceIndex);
             s->got_have.emit(s->tor, event.pieceIndex);
             break;
 
         case tr_peer_event::Type::ClientGotHaveAll:
+            s->availability_.add(msgs->has());
+            s->recount_interest(msgs);
             s->got_have_all.emit(s->tor);
             break;
 
         case tr_peer_event::Type::ClientGotHaveNone:
-            // no-op
+            s->recount_interest(msgs);
+            s->maybe_super_seed(msgs);
             break;
 
         case tr_peer_event::Type::ClientGotBitfield:
+            s->availability_.add(msgs->has());
+            s->recount_interest(msgs);
+            s->maybe_super_seed(msgs);
             s->got_bitfield.emit(s->tor, msgs->has());
             break;
 
@@ -543,6 +910,10 @@ public:
             s->active_requests.remove(msgs);
             break;
 
+        case tr_peer_event::Type::ClientSentBlock:
+            s->on_sent_block(msgs, event.pieceIndex);
+            break;
+
         case tr_peer_event::Type::ClientGotPort:
             // We have 2 cases:
             // 1. We don't know the listening port of this peer (i.e. incoming connection and first time ClientGotPort)
@@ -594,6 +965,9 @@ public:
 
     Pool connectable_pool;
 
+    // depends-on: connectable_pool
+    OutboundCandidateQueue outbound_candidates;
+
     tr_peerMsgs* optimistic = nullptr; /* the optimistic peer, or nullptr if none */
 
 private:
@@ -639,8 +1013,9 @@ private:
 
         is_running = false;
         remove_all_peers();
+        outbound_candidates.clear();
         wishlist.reset();
-        for (auto& [sockaddr, peer_info] : connectable_pool)
+        for (auto const& peer_info : connectable_pool)
         {
             peer_info->destroy_handshake();
         }
@@ -667,6 +1042,141 @@ private:
         pool_is_all_seeds_.reset();
     }
 
+    void rebuild_availability()
+    {
+        availability_.reset(tor->piece_count());
+
+        for (auto const* const peer : peers)
+        {
+            availability_.add(peer->has());
+        }
+    }
+
+    // Recount every peer's `wanted_piece_count` from scratch.
+    // Only needed when the set of pieces we want changes wholesale,
+    // e.g. when files are (un)wanted or the torrent is (re)started.
+    void rebuild_interest()
+    {
+        client_wants_ = tor->wanted_missing_pieces();
+
+        for (auto* const peer : peers)
+        {
+            recount_interest(peer);
+        }
+    }
+
+    void recount_interest(tr_peerMsgs* const peer)
+    {
+        peer->wanted_piece_count = peer->has().count_intersection(client_wants_);
+        update_interest(peer);
+    }
+
+    void on_peer_got_piece(tr_peerMsgs* const peer, tr_piece_index_t const piece)
+    {
+        if (piece < std::size(client_wants_) && client_wants_.test(piece) && peer->wanted_piece_count++ == 0U)
+        {
+            update_interest(peer);
+        }
+    }
+
+    void on_sent_block(tr_peerMsgs* const peer, tr_piece_index_t const piece)
+    {
+        if (piece < std::size(seeded_to_) && piece < std::size(peer->served))
+        {
+            peer->served.set(piece);
+            seeded_to_[piece] = peer;
+        }
+    }
+
+    // `peer` just told us that it finished `piece`. If we served it
+    // that piece, that's another copy of our data out in the swarm.
+    // Otherwise, credit the last peer we served it to for passing it on.
+    void on_peer_finished_piece(tr_peerMsgs* const peer, tr_piece_index_t const piece)
+    {
+        if (piece >= std::size(seeded_to_))
+        {
+            return;
+        }
+
+        if (piece < std::size(peer->served) && peer->served.test(piece))
+        {
+            ++stats.distributed_pieces;
+        }
+        else if (auto* const source = seeded_to_[piece]; source != nullptr && source != peer)
+        {
+            source->pieces_redistributed.add(tr_time(), 1U);
+        }
+    }
+
+    // Offer a super-seeded peer a new piece, withdrawing the old one.
+    void super_seed_next(tr_peerMsgs* const peer, time_t const now)
+    {
+        if (auto const old_piece = std::exchange(peer->super_seed_piece, std::nullopt); old_piece)
+        {
+            super_seeder_.remove_offer(*old_piece);
+        }
+
+        if (!tor->has_all() || peer->is_seed())
+        {
+            return;
+        }
+
+        if (auto const piece = super_seeder_.pick(peer->has(), availability_.counts()); piece)
+        {
+            super_seeder_.add_offer(*piece);
+            peer->super_seed_piece = piece;
+            peer->super_seed_offered_at = now;
+            peer->super_seed_offer(*piece);
+        }
+    }
+
+    void maybe_super_seed(tr_peerMsgs* const peer)
+    {
+        if (peer->is_super_seeding() && !peer->super_seed_piece)
+        {
+            super_seed_next(peer, tr_time());
+        }
+    }
+
+    // `peer` told us it has `piece`. Any super-seeded peer that we
+    // offered `piece` to and that has since passed it on gets a new one.
+    void on_super_seed_have(tr_peerMsgs* const peer, tr_piece_index_t const piece)
+    {
+        maybe_super_seed(peer);
+
+        if (super_seeder_.offer_count(piece) == 0U)
+        {
+            return;
+        }
+
+        auto const now = tr_time();
+        for (auto* const other : peers)
+        {
+            if (other->super_seed_piece == piece && SuperSeeder::has_propagated(other->has(), piece, availability_.counts()))
+            {
+                super_seed_next(other, now);
+            }
+        }
+    }
+
+    void on_super_seeding_changed(bool const enabled)
+    {
+        if (enabled)
+        {
+            // peers that are already connected have seen our bitfield,
+            // so super-seeding only applies to new connections
+            return;
+        }
+
+        for (auto* const peer : peers)
+        {
+            peer->super_seed_piece.reset();
+            peer->stop_super_seeding();
+        }
+
+        super_seeder_.reset(tor->piece_count());
+    }
+
     void on_torrent_doomed()
     {
         auto const lock = unique_lock();
@@ -681,11 +1191,22 @@ private:
         wishlist.reset();
     }
 
+    void on_files_wanted_changed()
+    {
+        rebuild_interest();
+
+        // seeds we skipped while we were done are worth connecting to again
+        if (!tor->is_done())
+        {
+            rebuild_candidates();
+        }
+    }
+
     void on_swarm_is_all_seeds()
     {
         auto const lock = unique_lock();
 
-        for (auto const& [socket_address, peer_info] : connectable_pool)
+        for (auto const& peer_info : connectable_pool)
         {
             mark_peer_as_seed(*peer_info);
         }
@@ -697,11 +1218,27 @@ private:
     {
         bool piece_came_from_peers = false;
 
+        auto const was_wanted = piece < std::size(client_wants_) && client_wants_.test(piece);
+        if (was_wanted)
+        {
+            client_wants_.unset(piece);
+        }
+
         for (auto* const peer : peers)
         {
             // notify the peer that we now have this piece
             peer->on_piece_completed(piece);
 
+            if (was_wanted && peer->has_piece(piece))
+            {
+                TR_ASSERT(peer->wanted_piece_count > 0U);
+
+                if (--peer->wanted_piece_count == 0U)
+                {
+                    update_interest(peer);
+                }
+            }
+
             if (!piece_came_from_peers)
             {
                 piece_came_from_peers = peer->blame.test(piece);
@@ -741,6 +1278,11 @@ private:
         // the webseed list may have changed...
         rebuild_webseeds();
 
+        // we couldn't count the peers' pieces before we knew how many there are
+        rebuild_availability();
+        seeded_to_.assign(tor->piece_count(), nullptr);
+        super_seeder_.reset(tor->piece_count());
+
         // some peer_msgs' progress fields may not be accurate if we
         // didn't have the metadata before now... so refresh them all...
         for (auto* peer : peers)
@@ -752,6 +1294,8 @@ private:
                 mark_peer_as_seed(*peer->peer_info);
             }
         }
+
+        rebuild_interest();
     }
 
     void on_torrent_started();
@@ -789,9 +1333,11 @@ private:
             {
                 auto* const tor = s->tor;
                 auto const loc = tor->piece_loc(event.pieceIndex, event.offset);
-                s->cancel_all_requests_for_block(loc.block, peer);
                 peer->blocks_sent_to_client.add(tr_time(), 1);
                 tor->on_block_received(loc.block);
+                // cancel after we've marked the block as received, since sending
+                // the cancels can let those peers ask us for more blocks
+                s->cancel_all_requests_for_block(loc.block, peer);
                 s->got_block.emit(tor, event.pieceIndex, loc.block);
             }
 
@@ -837,13 +1383,10 @@ private:
         TR_ASSERT(info_this->listen_port() != event.port);
 
         // we already know about this peer
-        if (auto it_that = connectable_pool.find({ info_this->listen_address(), event.port });
-            it_that != std::end(connectable_pool))
+        if (auto const info_that = connectable_pool.find({ info_this->listen_address(), event.port }); info_that)
         {
-            auto const info_that = it_that->second;
-            TR_ASSERT(it_that->first == info_that->listen_socket_address());
-            TR_ASSERT(it_that->first.address() == info_this->listen_address());
-            TR_ASSERT(it_that->first.port() != info_this->listen_port());
+            TR_ASSERT(info_that->listen_address() == info_this->listen_address());
+            TR_ASSERT(info_that->listen_port() != info_this->listen_port());
 
             // if there is an existing connection to this peer, keep the better one
             if (info_that->is_connected() && on_got_port_duplicate_connection(msgs, info_that))
@@ -871,7 +1414,7 @@ private:
 
         // insert or replace the peer info ptr at the target location
         ++stats.known_peer_from_count[info_this->from_first()];
-        connectable_pool.insert_or_assign(info_this->listen_socket_address(), std::move(info_this));
+        connectable_pool.insert_or_assign(std::move(info_this));
 
 EXIT:
         mark_all_seeds_flag_dirty();
@@ -910,11 +1453,53 @@ EXIT:
     // how long we'll let requests we've made linger before we cancel them
     static auto constexpr RequestTtlSecs = 90;
 
-    std::array<libtransmission::ObserverTag, 8> const tags_;
+    // If nobody else picks up a piece that a super-seeded peer has finished
+    // after this long, offer it another one anyway. It might be the only
+    // peer that's downloading, and the swarm shouldn't stall on it.
+    static auto constexpr SuperSeedStallSecs = time_t{ 120 };
+
+    // when the pool is full, evict this fraction of it
+    static auto constexpr PoolPruneFraction = size_t{ 8U };
+
+    // how many stale entries a small swarm's candidate queue may hold
+    static auto constexpr MinCandidateQueueSlack = size_t{ 64U };
+
+    // how long to reuse the connected-peers list for ut_pex messages.
+    // This is a third of peer-msgs' pex interval, so each peer's
+    // message is built from at most a few log entries.
+    static auto constexpr PexLogTtlSecs = time_t{ 30 };
+
+    // how often to re-rank the peers by block latency during endgame
+    static auto constexpr EndgameRankIntervalMsec = uint64_t{ 1000U };
+
+    std::array<libtransmission::ObserverTag, 10> const tags_;
 
     mutable std::optional<bool> pool_is_all_seeds_;
 
+    // How many connected peers have each piece. Updated incrementally
+    // from have, bitfield, have-all, and disconnect events so that
+    // nobody needs to poll every peer's bitfield for each piece.
+    PieceAvailability availability_;
+
+    // The pieces we want but don't have yet. Kept in step with each
+    // peer's `wanted_piece_count` so that interest checks are O(1).
+    tr_bitfield client_wants_{ 0U };
+
+    // the last peer that we sent each piece to, if it's still connected
+    std::vector<tr_peerMsgs*> seeded_to_;
+
+    SuperSeeder super_seeder_;
+
+    tr_salt_shaker<> candidate_salter_;
+
+    PexDeltaLog pex_log_;
+    time_t pex_log_updated_at_ = {};
+
     bool is_endgame_ = false;
+
+    // peers that shouldn't get duplicate requests in endgame
+    std::vector<tr_peer const*> endgame_slow_peers_;
+    uint64_t endgame_ranked_at_ = {};
 };
 
 bool tr_swarm::WishlistMediator::client_has_block(tr_block_index_t block) const
@@ -937,6 +1522,11 @@ bool tr_swarm::WishlistMediator::is_sequential_download() const
     return tor_.is_sequential_download();
 }
 
+std::vector<tr_stream_deadline> tr_swarm::WishlistMediator::stream_deadlines() const
+{
+    return tor_.stream_deadlines();
+}
+
 size_t tr_swarm::WishlistMediator::count_active_requests(tr_block_index_t block) const
 {
     return swarm_.active_requests.count(block);
@@ -949,11 +1539,7 @@ size_t tr_swarm::WishlistMediator::count_missing_blocks(tr_piece_index_t piece)
 
 size_t tr_swarm::WishlistMediator::count_piece_replication(tr_piece_index_t piece) const
 {
-    return std::accumulate(
-        std::begin(swarm_.peers),
-        std::end(swarm_.peers),
-        size_t{},
-        [piece](size_t acc, tr_peer* peer) { return acc + (peer->has_piece(piece) ? 1U : 0U); });
+    return swarm_.piece_availability(piece);
 }
 
 tr_block_span_t tr_swarm::WishlistMediator::block_span(tr_piece_index_t piece) const
@@ -1034,31 +1620,17 @@ private:
     static auto constexpr MaxConnectionsPerSecond = size_t{ 18U };
     static auto constexpr MaxConnectionsPerPulse = size_t(MaxConnectionsPerSecond * BandwidthTimerPeriod / 1s);
 
-    // Building a peer candidate list is expensive, so cache it across pulses.
-    // We want to cache it long enough to avoid excess CPU cycles,
-    // but short enough that the data isn't too stale.
-    static auto constexpr OutboundCandidatesListTtl = BandwidthTimerPeriod * 4U;
-
-    // How big the candidate list should be when we create it.
-    static auto constexpr OutboundCandidateListCapacity = MaxConnectionsPerPulse * OutboundCandidatesListTtl /
-        BandwidthTimerPeriod;
-
 public:
-    // The peers we might try connecting to in the next few seconds.
-    // This list is cached between pulses so use resilient keys, e.g.
-    // a `tr_torrent_id_t` instead of a `tr_torrent*` that can be freed.
-    using OutboundCandidates = small::
-        max_size_vector<std::pair<tr_torrent_id_t, tr_socket_address>, OutboundCandidateListCapacity>;
-
     explicit tr_peerMgr(
         tr_session* session_in,
         libtransmission::TimerMaker& timer_maker,
+        libtransmission::TimerMaker& coarse_timer_maker,
         tr_torrents& torrents,
         libtransmission::Blocklists& blocklist)
         : session{ session_in }
         , torrents_{ torrents }
         , blocklists_{ blocklist }
-        , handshake_mediator_{ *session, timer_maker, torrents }
+        , handshake_mediator_{ *session, coarse_timer_maker, torrents }
         , bandwidth_timer_{ timer_maker.create([this]() { bandwidth_pulse(); }) }
         , peer_info_timer_{ timer_maker.create([this]() { peer_info_pulse(); }) }
         , rechoke_timer_{ timer_maker.create([this]() { rechoke_pulse_marshall(); }) }
@@ -1105,6 +1677,8 @@ public:
 
     HandshakeMediator handshake_mediator_;
 
+    ConnectLatencyStats connect_latency;
+
 private:
     void bandwidth_pulse();
     void make_new_peer_connections();
@@ -1125,7 +1699,7 @@ private:
            since the blocklist has changed, erase that cached value */
         for (auto* const tor : torrents_)
         {
-            for (auto const& [socket_address, peer_info] : tor->swarm->connectable_pool)
+            for (auto const& peer_info : tor->swarm->connectable_pool)
             {
                 peer_info->set_blocklisted_dirty();
             }
@@ -1134,11 +1708,12 @@ private:
             {
                 peer->peer_info->set_blocklisted_dirty();
             }
+
+            // peers that were blocked before might not be now
+            tor->swarm->rebuild_candidates();
         }
     }
 
-    OutboundCandidates outbound_candidates_;
-
     std::unique_ptr<libtransmission::Timer> const bandwidth_timer_;
     std::unique_ptr<libtransmission::Timer> const peer_info_timer_;
     std::unique_ptr<libtransmission::Timer> const rechoke_timer_;
@@ -1153,6 +1728,7 @@ tr_peer::tr_peer(tr_torrent const& tor)
     : session{ tor.session }
     , swarm{ tor.swarm }
     , blame{ tor.block_count() }
+    , served{ tor.piece_count() }
 {
 }
 
@@ -1168,7 +1744,9 @@ tr_peer::~tr_peer()
 
 tr_peerMgr* tr_peerMgrNew(tr_session* session)
 {
-    return new tr_peerMgr{ session, session->timerMaker(), session->torrents(), session->blocklist() };
+    return new tr_peerMgr{
+        session, session->timerMaker(), session->coarseTimerMaker(), session->torrents(), session->blocklist()
+    };
 }
 
 void tr_peerMgrFree(tr_peerMgr* manager)
@@ -1200,9 +1778,17 @@ void tr_peerMgrClientSentRequests(tr_torrent* torrent, tr_peer* peer, tr_block_s
 {
     auto const now = tr_time();
 
+    auto& active_requests = torrent->swarm->active_requests;
+    auto const count_duplicates = torrent->is_streaming() && !torrent->swarm->is_endgame();
+
     for (tr_block_index_t block = span.begin; block < span.end; ++block)
     {
-        torrent->swarm->active_requests.add(block, peer, now);
+        if (count_duplicates && active_requests.count(block) != 0U)
+        {
+            torrent->on_stream_duplicate_request();
+        }
+
+        active_requests.add(block, peer, now);
     }
 }
 
@@ -1215,10 +1801,20 @@ std::vector<tr_block_span_t> tr_peerMgrGetNextRequests(tr_torrent* torrent, tr_p
         swarm.wishlist = std::make_unique<Wishlist>(std::make_unique<tr_swarm::WishlistMediator>(swarm));
     }
     swarm.update_endgame();
+
+    auto peer_speed = Wishlist::PeerSpeed{};
+    if (torrent->is_streaming())
+    {
+        peer_speed.bytes_per_second = peer->get_piece_speed(tr_time_msec(), TR_PEER_TO_CLIENT).base_quantity();
+        peer_speed.active_requests = swarm.active_requests.count(peer);
+    }
+    peer_speed.is_fast = !swarm.is_endgame() || swarm.is_endgame_fast(peer);
+
     return swarm.wishlist->next(
         numwant,
         [peer](tr_piece_index_t p) { return peer->has_piece(p); },
-        [peer, &swarm](tr_block_index_t b) { return swarm.active_requests.has(b, peer); });
+        [peer, &swarm](tr_block_index_t b) { return swarm.active_requests.has(b, peer); },
+        peer_speed);
 }
 
 // --- Piece List Manipulation / Accessors
@@ -1269,24 +1865,57 @@ void create_bit_torrent_peer(
     TR_ASSERT(swarm->stats.peer_from_count[msgs->peer_info->from_first()] <= swarm->stats.peer_count);
 }
 
+// an outgoing connection attempt, possibly one of several racing to the same peer
+struct OutgoingAttempt
+{
+    // the listen address of the peer info that started the attempt.
+    // This differs from the peer io's address when we're trying
+    // the peer's address in the other address family.
+    tr_socket_address socket_address;
+
+    uint64_t started_at_msec = {};
+};
+
 /* FIXME: this is kind of a mess. */
-[[nodiscard]] bool on_handshake_done(tr_peerMgr* const manager, tr_handshake::Result const& result)
+[[nodiscard]] bool on_handshake_done(
+    tr_peerMgr* const manager,
+    tr_handshake::Result const& result,
+    std::optional<OutgoingAttempt> const& attempt = {})
 {
     auto const lock = manager->unique_lock();
 
     TR_ASSERT(result.io != nullptr);
     auto const& socket_address = result.io->socket_address();
     auto* const swarm = manager->get_existing_swarm(result.io->torrent_hash());
-    auto info = swarm != nullptr ? swarm->get_existing_peer_info(socket_address) : std::shared_ptr<tr_peer_info>{};
+    auto info = swarm != nullptr ? swarm->get_existing_peer_info(attempt ? attempt->socket_address : socket_address) :
+                                   std::shared_ptr<tr_peer_info>{};
+
+    // Remember this against the peer that owns the attempt, since
+    // the attempt might be to the peer's other address family.
+    if (info && result.utp_failed)
+    {
+        info->set_utp_supported(false);
+    }
 
     if (result.io->is_incoming())
     {
         manager->incoming_handshakes.erase(socket_address);
     }
-    else if (info)
+    else if (info && result.is_connected)
     {
+        // we have a winner; cancel the rest of the race
         info->destroy_handshake();
     }
+    else if (info)
+    {
+        info->destroy_handshake(result.io.get());
+
+        // the other connections in the race might still work
+        if (info->has_handshake())
+        {
+            return false;
+        }
+    }
 
     if (!result.is_connected || swarm == nullptr || !swarm->is_running)
     {
@@ -1304,6 +1933,11 @@ void create_bit_torrent_peer(
                         info->connection_failure_count()));
                 info->set_connectable(false);
             }
+
+            if (swarm != nullptr)
+            {
+                swarm->enqueue_candidate(*info);
+            }
         }
 
         return false;
@@ -1322,6 +1956,12 @@ void create_bit_torrent_peer(
     if (!result.io->is_incoming())
     {
         info->set_connectable();
+        info->set_last_transport(result.io->is_utp() ? TR_PREFER_UTP : TR_PREFER_TCP);
+    }
+
+    if (attempt)
+    {
+        manager->connect_latency.add(tr_time_msec() - attempt->started_at_msec);
     }
 
     // If we're connected via µTP, then we know the peer supports µTP...
@@ -1338,6 +1978,11 @@ void create_bit_torrent_peer(
 
     if (swarm->peerCount() >= swarm->tor->peer_limit()) // too many peers already
     {
+        if (!info->is_in_use())
+        {
+            swarm->enqueue_candidate(*info);
+        }
+
         return false;
     }
 
@@ -1359,9 +2004,65 @@ void create_bit_torrent_peer(
 
     return true;
 }
+
+// LAN peers skip the encryption overhead unless encryption is required
+[[nodiscard]] constexpr tr_encryption_mode encryption_mode_for(tr_session const& session, tr_peerIo const& io) noexcept
+{
+    auto const mode = session.encryptionMode();
+    return io.is_lan() && mode != TR_ENCRYPTION_REQUIRED ? TR_CLEAR_PREFERRED : mode;
+}
 } // namespace handshake_helpers
 } // namespace
 
+tr_peer_connect_latency tr_peerMgrConnectLatency(tr_peerMgr const* manager)
+{
+    auto const lock = manager->unique_lock();
+
+    auto const& stats = manager->connect_latency;
+    auto ret = tr_peer_connect_latency{};
+    ret.samples = std::size(stats);
+    ret.p50_msec = stats.percentile(50U);
+    ret.p90_msec = stats.percentile(90U);
+    ret.p99_msec = stats.percentile(99U);
+    return ret;
+}
+
+tr_peer_memory_report tr_peerMgrMemoryReport(tr_peerMgr const* manager)
+{
+    auto const lock = manager->unique_lock();
+
+    auto ret = tr_peer_memory_report{};
+    for (auto const* const tor : manager->torrents_)
+    {
+        for (auto const* const peer : tor->swarm->peers)
+        {
+            auto const usage = peer->memory_usage();
+            ++ret.peer_count;
+            ret.msgs_bytes += usage.msgs_bytes;
+            ret.io_bytes += usage.io_bytes;
+            ret.buffer_bytes += usage.buffer_bytes;
+
+            auto const total = uint64_t{ usage.msgs_bytes } + usage.io_bytes + usage.buffer_bytes;
+            (peer->is_encrypted() ? ret.encrypted_bytes : ret.plaintext_bytes) += total;
+            (peer->is_utp_connection() ? ret.utp_bytes : ret.tcp_bytes) += total;
+            if (peer->is_lan())
+            {
+                ret.lan_bytes += total;
+            }
+        }
+    }
+
+    ret.buffer_pool_bytes = libtransmission::BufferPool<std::byte>::shared().idle_bytes();
+    return ret;
+}
+
+size_t tr_peerMgrPendingIncomingHandshakes(tr_peerMgr const* manager)
+{
+    auto const lock = manager->unique_lock();
+
+    return std::size(manager->incoming_handshakes);
+}
+
 void tr_peerMgrAddIncoming(tr_peerMgr* manager, tr_peer_socket&& socket)
 {
     using namespace handshake_helpers;
@@ -1381,11 +2082,13 @@ void tr_peerMgrAddIncoming(tr_peerMgr* manager, tr_peer_socket&& socket)
     {
         auto const socket_address = socket.socket_address();
         auto* const session = manager->session;
+        auto peer_io = tr_peerIo::new_incoming(session, &session->top_bandwidth_, std::move(socket));
+        auto const encryption_mode = encryption_mode_for(*session, *peer_io);
         manager->incoming_handshakes.try_emplace(
             socket_address,
             &manager->handshake_mediator_,
-            tr_peerIo::new_incoming(session, &session->top_bandwidth_, std::move(socket)),
-            session->encryptionMode(),
+            std::move(peer_io),
+            encryption_mode,
             [manager](tr_handshake::Result const& result) { return on_handshake_done(manager, result); });
     }
 }
@@ -1524,10 +2227,9 @@ std::vector<tr_pex> tr_peerMgrGetPeers(tr_torrent const* tor, uint8_t address_ty
     {
         auto const& pool = s->connectable_pool;
         infos.reserve(std::size(pool));
-        for (auto const& [socket_address, peer_info] : pool)
+        for (auto const& peer_info : pool)
         {
-            TR_ASSERT(socket_address == peer_info->listen_socket_address());
-            if (socket_address.address().type == address_type && is_peer_interesting(tor, *peer_info))
+            if (peer_info->listen_address().type == address_type && is_peer_interesting(tor, *peer_info))
             {
                 infos.emplace_back(peer_info.get());
             }
@@ -1557,10 +2259,21 @@ std::vector<tr_pex> tr_peerMgrGetPeers(tr_torrent const* tor, uint8_t address_ty
     return pex;
 }
 
+std::string tr_peerMgrGetPexMessage(tr_torrent const* tor, uint32_t since_version, uint32_t* setme_version)
+{
+    TR_ASSERT(tr_isTorrent(tor));
+    TR_ASSERT(setme_version != nullptr);
+    auto const lock = tor->unique_lock();
+
+    return tor->swarm->pex_message_since(since_version, setme_version);
+}
+
 void tr_swarm::on_torrent_started()
 {
     auto const lock = unique_lock();
     is_running = true;
+    rebuild_interest();
+    rebuild_candidates();
     manager->rechokeSoon();
 }
 
@@ -1590,8 +2303,8 @@ int8_t tr_peerMgrPieceAvailability(tr_torrent const* tor, tr_piece_index_t piece
         return -1;
     }
 
-    auto const& peers = tor->swarm->peers;
-    return std::count_if(std::begin(peers), std::end(peers), [piece](auto const* peer) { return peer->has_piece(piece); });
+    auto const n = tor->swarm->piece_availability(piece);
+    return static_cast<int8_t>(std::min(n, size_t{ std::numeric_limits<int8_t>::max() }));
 }
 
 void tr_peerMgrTorrentAvailability(tr_torrent const* tor, int8_t* tab, unsigned int n_tabs)
@@ -1626,6 +2339,7 @@ tr_swarm_stats tr_swarmGetStats(tr_swarm const* const swarm)
     stats.active_peer_count[TR_UP] = count_active_peers(TR_UP);
     stats.active_peer_count[TR_DOWN] = count_active_peers(TR_DOWN);
     stats.active_webseed_count = swarm->count_active_webseeds(tr_time_msec());
+    stats.peer_pool_bytes = swarm->connectable_pool.memory_usage();
     return stats;
 }
 
@@ -1647,26 +2361,16 @@ uint64_t tr_peerMgrGetDesiredAvailable(tr_torrent const* tor)
         return 0;
     }
 
-    auto available = swarm->peers.front()->has();
-    for (auto const* const peer : swarm->peers)
-    {
-        available |= peer->has();
-    }
-
-    if (available.has_all())
-    {
-        return tor->left_until_done();
-    }
-
     auto desired_available = uint64_t{};
 
-    for (tr_piece_index_t i = 0, n = tor->piece_count(); i < n; ++i)
-    {
-        if (tor->piece_is_wanted(i) && available.test(i))
+    tor->wanted_missing_pieces().for_each_set_bit(
+        [tor, swarm, &desired_available](size_t piece)
         {
-            desired_available += tor->count_missing_bytes_in_piece(i);
-        }
-    }
+            if (swarm->piece_availability(piece) != 0U)
+            {
+                desired_available += tor->count_missing_bytes_in_piece(piece);
+            }
+        });
 
     TR_ASSERT(desired_available <= tor->total_size());
     return desired_available;
@@ -1719,6 +2423,17 @@ namespace peer_stat_helpers
     stats.activeReqsToPeer = peer->active_req_count(TR_CLIENT_TO_PEER);
     stats.activeReqsToClient = peer->active_req_count(TR_PEER_TO_CLIENT);
 
+    auto const buffers = peer->io_buffers();
+    stats.socketRcvBuf = buffers.socket_rcvbuf;
+    stats.socketSndBuf = buffers.socket_sndbuf;
+    stats.notsentLowat = buffers.notsent_lowat;
+    stats.readSize = buffers.read_size;
+    stats.rttUsec = buffers.rtt_usec;
+
+    auto const& pipeline = peer->request_pipeline();
+    stats.requestDepth = pipeline.depth();
+    stats.requestRttMsec = pipeline.rtt_msec();
+
     char* pch = stats.flagStr;
 
     if (stats.isUTP)
@@ -1818,59 +2533,16 @@ tr_peer_stat* tr_peerMgrPeerStats(tr_torrent const* tor, size_t* setme_count)
 
 namespace
 {
-namespace update_interest_helpers
-{
-/* does this peer have any pieces that we want? */
-[[nodiscard]] bool isPeerInteresting(
-    tr_torrent const* const tor,
-    std::vector<bool> const& piece_is_interesting,
-    tr_peerMsgs const* const peer)
-{
-    /* these cases should have already been handled by the calling code... */
-    TR_ASSERT(!tor->is_done());
-    TR_ASSERT(tor->client_can_download());
-
-    if (peer->is_seed())
-    {
-        return true;
-    }
-
-    for (tr_piece_index_t i = 0; i < tor->piece_count(); ++i)
-    {
-        if (piece_is_interesting[i] && peer->has_piece(i))
-        {
-            return true;
-        }
-    }
-
-    return false;
-}
-
-// determine which peers to show interest in
+namespace update_interest_helpers
+{
+// determine which peers to show interest in.
+// The swarm keeps each peer's `wanted_piece_count` current as
+// haves and completed pieces come in, so this is O(peers).
 void updateInterest(tr_swarm* swarm)
 {
-    // sometimes this function isn't necessary
-    auto const* const tor = swarm->tor;
-    if (tor->is_done() || !tor->client_can_download())
-    {
-        return;
-    }
-
-    if (auto const& peers = swarm->peers; !std::empty(peers))
+    for (auto* const peer : swarm->peers)
     {
-        auto const n = tor->piece_count();
-
-        // build a bitfield of interesting pieces...
-        auto piece_is_interesting = std::vector<bool>(n);
-        for (tr_piece_index_t i = 0U; i < n; ++i)
-        {
-            piece_is_interesting[i] = tor->piece_is_wanted(i) && !tor->has_piece(i);
-        }
-
-        for (auto* const peer : peers)
-        {
-            peer->set_interested(isPeerInteresting(tor, piece_is_interesting, peer));
-        }
+        swarm->update_interest(peer);
     }
 }
 } // namespace update_interest_helpers
@@ -1946,6 +2618,64 @@ struct ChokeData
 // for this many calls to rechokeUploads().
 auto constexpr OptimisticUnchokeMultiplier = uint8_t{ 4 };
 
+// how far back to look when counting a peer's redistributed pieces
+auto constexpr RedistributionWindowSecs = 60U;
+
+void set_choke(tr_peerMsgs* const peer, bool const choke, uint64_t const now)
+{
+    if (!choke && peer->peer_is_choked())
+    {
+        peer->unchoked_at_msec = now;
+    }
+
+    peer->set_choke(choke);
+}
+
+// the "round-robin" seed-choking-algorithm. See SeedChoker.
+void rechokeSeeding(tr_swarm* s, uint64_t const now, bool const is_maxed_out)
+{
+    auto const now_sec = tr_time();
+    auto const& peers = s->peers;
+
+    auto leechers = std::vector<tr_peerMsgs*>{};
+    auto candidates = std::vector<SeedChoker::Candidate>{};
+    leechers.reserve(std::size(peers));
+    candidates.reserve(std::size(peers));
+
+    for (auto* const peer : peers)
+    {
+        if (peer->is_seed())
+        {
+            peer->set_choke(true);
+            continue;
+        }
+
+        auto& candidate = candidates.emplace_back();
+        candidate.unchoked_at_msec = peer->unchoked_at_msec;
+        candidate.upload_bytes_per_second = peer->get_piece_speed(now, TR_CLIENT_TO_PEER).base_quantity();
+        candidate.recent_blocks_sent = peer->blocks_sent_to_peer.count(now_sec, SeedChoker::SnubMsec / 1000U);
+        candidate.recent_redistributions = peer->pieces_redistributed.count(now_sec, RedistributionWindowSecs);
+        candidate.is_interested = peer->peer_is_interested();
+        candidate.is_unchoked = !peer->peer_is_choked();
+        leechers.emplace_back(peer);
+    }
+
+    auto const n_slots = s->manager->session->uploadSlotsPerTorrent();
+    auto const unchoke = SeedChoker::rechoke(candidates, n_slots, now, !is_maxed_out);
+    for (size_t i = 0, n = std::size(leechers); i < n; ++i)
+    {
+        set_choke(leechers[i], !unchoke[i], now);
+    }
+
+    tr_logAddTraceSwarm(
+        s,
+        fmt::format(
+            "round-robin rechoke: {} of {} leechers unchoked; {} distributed pieces so far",
+            std::count(std::begin(unchoke), std::end(unchoke), true),
+            std::size(leechers),
+            s->stats.distributed_pieces));
+}
+
 void rechokeUploads(tr_swarm* s, uint64_t const now)
 {
     auto const lock = s->unique_lock();
@@ -1958,6 +2688,15 @@ void rechokeUploads(tr_swarm* s, uint64_t const now)
     bool const choke_all = !s->tor->client_can_upload();
     bool const is_maxed_out = s->tor->bandwidth().is_maxed_out(TR_UP, now);
 
+    if (!choke_all && s->tor->is_done() && session->seed_choker() == TR_SEED_CHOKER_ROUND_ROBIN)
+    {
+        // every leecher gets a turn, so there's no need for an optimistic slot
+        s->optimistic = nullptr;
+        s->optimistic_unchoke_time_scaler = 0;
+        rechokeSeeding(s, now, is_maxed_out);
+        return;
+    }
+
     /* an optimistic unchoke peer's "optimistic"
      * state lasts for N calls to rechokeUploads(). */
     if (s->optimistic_unchoke_time_scaler > 0)
@@ -2056,7 +2795,7 @@ void rechokeUploads(tr_swarm* s, uint64_t const now)
 
     for (auto& item : choked)
     {
-        item.msgs_->set_choke(item.is_choked_);
+        set_choke(item.msgs_, item.is_choked_, now);
     }
 }
 } // namespace rechoke_uploads_helpers
@@ -2084,6 +2823,7 @@ void tr_peerMgr::rechoke_pulse() const
             {
                 rechokeUploads(swarm, now);
                 updateInterest(swarm);
+                swarm->super_seed_pulse(tr_time());
             }
         }
     }
@@ -2293,88 +3033,28 @@ void tr_peerMgr::reconnect_pulse()
 
 // --- Peer Pool Size
 
-namespace
-{
-namespace peer_info_pulse_helpers
-{
-auto get_max_peer_info_count(tr_torrent const& tor)
-{
-    return tor.is_done() ? tor.peer_limit() : tor.peer_limit() * 3U;
-}
-
-struct ComparePeerInfo
-{
-    [[nodiscard]] int compare(tr_peer_info const& a, tr_peer_info const& b) const noexcept
-    {
-        auto const is_a_inactive = a.is_inactive(now_);
-        auto const is_b_inactive = b.is_inactive(now_);
-        if (is_a_inactive != is_b_inactive)
-        {
-            return is_a_inactive ? 1 : -1;
-        }
-
-        return CompareAtomsByUsefulness.compare(a, b);
-    }
-
-    template<typename T>
-    [[nodiscard]] std::enable_if_t<std::is_same_v<std::decay_t<decltype(*std::declval<T>())>, tr_peer_info>, bool> operator()(
-        T const& a,
-        T const& b) const noexcept
-    {
-        return compare(*a, *b) < 0;
-    }
-
-    time_t const now_ = tr_time();
-};
-} // namespace peer_info_pulse_helpers
-} // namespace
-
 void tr_peerMgr::peer_info_pulse()
 {
-    using namespace peer_info_pulse_helpers;
-
     auto const lock = unique_lock();
-    for (auto const* tor : torrents_)
+    for (auto* const tor : torrents_)
     {
-        auto& pool = tor->swarm->connectable_pool;
+        auto* const swarm = tor->swarm;
         auto const max = get_max_peer_info_count(*tor);
-        auto const pool_size = std::size(pool);
+        auto const pool_size = std::size(swarm->connectable_pool);
         if (pool_size <= max)
         {
             continue;
         }
 
-        auto infos = std::vector<std::shared_ptr<tr_peer_info>>{};
-        infos.reserve(pool_size);
-        std::transform(
-            std::begin(pool),
-            std::end(pool),
-            std::back_inserter(infos),
-            [](auto const& keyval) { return keyval.second; });
-        pool.clear();
-
-        // Keep all peer info objects before test_begin unconditionally
-        auto const test_begin = std::partition(
-            std::begin(infos),
-            std::end(infos),
-            [](auto const& info) { return info->is_in_use(); });
-
-        auto const iter_max = std::begin(infos) + max;
-        if (iter_max > test_begin)
-        {
-            std::partial_sort(test_begin, iter_max, std::end(infos), ComparePeerInfo{});
-        }
-        infos.erase(std::max(test_begin, iter_max), std::end(infos));
-
-        pool.reserve(std::size(infos));
-        for (auto& info : infos)
-        {
-            pool.try_emplace(info->listen_socket_address(), std::move(info));
-        }
+        swarm->prune_pool(max);
 
         tr_logAddTraceSwarm(
-            tor->swarm,
-            fmt::format("max peer info count is {}... pruned from {} to {}", max, pool_size, std::size(pool)));
+            swarm,
+            fmt::format(
+                "max peer info count is {}... pruned from {} to {}",
+                max,
+                pool_size,
+                std::size(swarm->connectable_pool)));
     }
 }
 
@@ -2424,41 +3104,32 @@ namespace
 {
 namespace connect_helpers
 {
-/* is this atom someone that we'd want to initiate a connection to? */
-[[nodiscard]] bool is_peer_candidate(tr_torrent const* tor, tr_peer_info const& peer_info, time_t const now)
+// should we try to open more connections for this torrent?
+[[nodiscard]] bool wants_outbound_peers(tr_torrent* const tor, uint64_t const now_msec)
 {
-    // have we already tried and failed to connect?
-    if (auto const conn = peer_info.is_connectable(); conn && !*conn)
-    {
-        return false;
-    }
-
-    // not if we're both seeds
-    if (tor->is_done() && peer_info.is_seed())
-    {
-        return false;
-    }
+    auto* const swarm = tor->swarm;
 
-    // not if we've already got a connection to them...
-    if (peer_info.is_in_use())
+    if (!swarm->is_running)
     {
         return false;
     }
 
-    // not if we just tried them already
-    if (!peer_info.reconnect_interval_has_passed(now))
+    /* if everyone in the swarm is seeds and pex is disabled,
+     * then don't initiate connections */
+    bool const seeding = tor->is_done();
+    if (seeding && swarm->is_all_seeds() && !tor->allows_pex())
     {
         return false;
     }
 
-    // not if they're blocklisted
-    if (peer_info.is_blocklisted(tor->session->blocklist()))
+    /* if we've already got enough peers in this torrent... */
+    if (tor->peer_limit() <= swarm->peerCount())
     {
         return false;
     }
 
-    // not if they're banned...
-    if (peer_info.is_banned())
+    /* if we've already got enough speed in this torrent... */
+    if (seeding && tor->bandwidth().is_maxed_out(TR_UP, now_msec))
     {
         return false;
     }
@@ -2466,163 +3137,40 @@ namespace connect_helpers
     return true;
 }
 
-[[nodiscard]] constexpr uint64_t addValToKey(uint64_t value, unsigned int width, uint64_t addme)
-{
-    value <<= width;
-    value |= addme;
-    return value;
-}
-
-/* smaller value is better */
-[[nodiscard]] uint64_t getPeerCandidateScore(tr_torrent const* tor, tr_peer_info const& peer_info, uint8_t salt)
-{
-    auto i = uint64_t{};
-    auto score = uint64_t{};
-
-    /* prefer peers we've connected to, or never tried, over peers we failed to connect to. */
-    i = peer_info.connection_failure_count() != 0U ? 1U : 0U;
-    score = addValToKey(score, 1U, i);
-
-    /* prefer the one we attempted least recently (to cycle through all peers) */
-    i = peer_info.connection_attempt_time();
-    score = addValToKey(score, 32U, i);
-
-    /* prefer peers belonging to a torrent of a higher priority */
-    switch (tor->get_priority())
-    {
-    case TR_PRI_HIGH:
-        i = 0;
-        break;
-
-    case TR_PRI_NORMAL:
-        i = 1;
-        break;
-
-    case TR_PRI_LOW:
-        i = 2;
-        break;
-
-    default:
-        TR_ASSERT_MSG(false, "invalid priority");
-        break;
-    }
-
-    score = addValToKey(score, 4U, i);
-
-    // prefer recently-started torrents
-    i = tor->started_recently(tr_time()) ? 0 : 1;
-    score = addValToKey(score, 1U, i);
-
-    /* prefer torrents we're downloading with */
-    i = tor->is_done() ? 1 : 0;
-    score = addValToKey(score, 1U, i);
-
-    /* prefer peers that are known to be connectible */
-    i = peer_info.is_connectable().value_or(false) ? 0 : 1;
-    score = addValToKey(score, 1U, i);
-
-    /* prefer peers that we might be able to upload to */
-    i = peer_info.is_seed() ? 0 : 1;
-    score = addValToKey(score, 1U, i);
-
-    /* Prefer peers that we got from more trusted sources.
-     * lower `fromBest` values indicate more trusted sources */
-    score = addValToKey(score, 4U, peer_info.from_best());
-
-    /* salt */
-    score = addValToKey(score, 8U, salt);
-
-    return score;
-}
-
-void get_peer_candidates(size_t global_peer_limit, tr_torrents& torrents, tr_peerMgr::OutboundCandidates& setme)
+// Returns the swarm's best candidate for an outbound connection,
+// or nullptr if it has none. Entries for peers that aren't
+// candidates right now are dropped or deferred along the way.
+[[nodiscard]] tr_peer_info* best_candidate(tr_swarm* const swarm, time_t const now)
 {
-    struct peer_candidate
-    {
-        peer_candidate() = default;
-
-        peer_candidate(uint64_t score_in, tr_torrent const* const tor_in, tr_peer_info const* const peer_info_in)
-            : score{ score_in }
-            , tor{ tor_in }
-            , peer_info{ peer_info_in }
-        {
-        }
-
-        uint64_t score;
-        tr_torrent const* tor;
-        tr_peer_info const* peer_info;
-    };
-
-    setme.clear();
-
-    auto const now = tr_time();
-    auto const now_msec = tr_time_msec();
-
-    // leave 5% of connection slots for incoming connections -- ticket #2609
-    if (auto const max_candidates = static_cast<size_t>(global_peer_limit * 0.95); max_candidates <= tr_peerMsgs::size())
-    {
-        return;
-    }
-
-    auto candidates = std::vector<peer_candidate>{};
-    candidates.reserve(tr_peer_info::known_connectable_count());
+    auto& queue = swarm->outbound_candidates;
+    queue.wake(now);
 
-    /* populate the candidate array */
-    auto salter = tr_salt_shaker{};
-    for (auto* const tor : torrents)
+    while (auto const* const entry = queue.top())
     {
-        auto* const swarm = tor->swarm;
-
-        if (!swarm->is_running)
+        auto const peer_info = swarm->get_existing_peer_info(entry->socket_address);
+        if (!peer_info || peer_info->candidate_generation() != entry->generation)
         {
-            continue;
-        }
-
-        /* if everyone in the swarm is seeds and pex is disabled,
-         * then don't initiate connections */
-        bool const seeding = tor->is_done();
-        if (seeding && swarm->is_all_seeds() && !tor->allows_pex())
-        {
-            continue;
+            // stale entry
+            queue.pop();
         }
-
-        /* if we've already got enough peers in this torrent... */
-        if (tor->peer_limit() <= swarm->peerCount())
+        else if (is_peer_candidate(swarm->tor, *peer_info, now))
         {
-            continue;
+            return peer_info.get();
         }
-
-        /* if we've already got enough speed in this torrent... */
-        if (seeding && tor->bandwidth().is_maxed_out(TR_UP, now_msec))
+        else if (!peer_info->is_in_use() && !peer_info->reconnect_interval_has_passed(now))
         {
-            continue;
+            // too soon to retry; look at it again later
+            queue.defer_top(peer_info->reconnect_time(now));
         }
-
-        for (auto const& [socket_address, peer_info] : swarm->connectable_pool)
+        else
         {
-            if (is_peer_candidate(tor, *peer_info, now))
-            {
-                candidates.emplace_back(getPeerCandidateScore(tor, *peer_info, salter()), tor, peer_info.get());
-            }
+            // it'll be queued again if it becomes a candidate,
+            // e.g. when the connection that it's using closes
+            queue.pop();
         }
     }
 
-    // only keep the best `max` candidates
-    if (static auto constexpr Max = tr_peerMgr::OutboundCandidates::requested_inline_size; Max < std::size(candidates))
-    {
-        std::partial_sort(
-            std::begin(candidates),
-            std::begin(candidates) + Max,
-            std::end(candidates),
-            [](auto const& a, auto const& b) { return a.score < b.score; });
-        candidates.resize(Max);
-    }
-
-    // put the best candidates at the end of the list
-    for (auto it = std::crbegin(candidates), end = std::crend(candidates); it != end; ++it)
-    {
-        setme.emplace_back(it->tor->id(), it->peer_info->listen_socket_address());
-    }
+    return nullptr;
 }
 
 void initiate_connection(tr_peerMgr* mgr, tr_swarm* s, tr_peer_info& peer_info)
@@ -2630,40 +3178,67 @@ void initiate_connection(tr_peerMgr* mgr, tr_swarm* s, tr_peer_info& peer_info)
     using namespace handshake_helpers;
 
     auto const now = tr_time();
-    auto const utp = mgr->session->allowsUTP() && peer_info.supports_utp().value_or(true);
     auto* const session = mgr->session;
 
-    if (tr_peer_socket::limit_reached(session) || (!utp && !session->allowsTCP()))
+    auto opts = ConnectPlanOptions{};
+    opts.socket_address = peer_info.listen_socket_address();
+    opts.alt_socket_address = peer_info.alt_socket_address();
+    opts.supports_utp = peer_info.supports_utp();
+    opts.last_transport = peer_info.last_transport();
+    opts.preferred_transport = session->preferred_transport();
+    opts.allows_utp = session->allowsUTP();
+    opts.allows_tcp = session->allowsTCP();
+    auto const attempts = plan_connect_attempts(opts);
+
+    // If we return here, the peer is no longer queued as a candidate.
+    // It gets queued again when the swarm's candidates are rebuilt.
+    if (tr_peer_socket::limit_reached(session) || std::empty(attempts))
     {
         return;
     }
 
-    tr_logAddTraceSwarm(
-        s,
-        fmt::format("Starting an OUTGOING {} connection with {}", utp ? " µTP" : "TCP", peer_info.display_name()));
+    auto const started = OutgoingAttempt{ peer_info.listen_socket_address(), tr_time_msec() };
+    for (auto const& [socket_address, utp] : attempts)
+    {
+        if (peer_info.has_handshake() && tr_peer_socket::limit_reached(session))
+        {
+            break;
+        }
+
+        tr_logAddTraceSwarm(
+            s,
+            fmt::format(
+                "Starting an OUTGOING {} connection with {} at {}",
+                utp ? " µTP" : "TCP",
+                peer_info.display_name(),
+                socket_address.display_name()));
+
+        auto peer_io = tr_peerIo::new_outgoing(
+            session,
+            &session->top_bandwidth_,
+            socket_address,
+            s->tor->info_hash(),
+            s->tor->is_seed(),
+            utp,
+            !utp);
 
-    auto peer_io = tr_peerIo::new_outgoing(
-        session,
-        &session->top_bandwidth_,
-        peer_info.listen_socket_address(),
-        s->tor->info_hash(),
-        s->tor->is_seed(),
-        utp);
+        if (peer_io)
+        {
+            peer_info.start_handshake(
+                &mgr->handshake_mediator_,
+                peer_io,
+                handshake_helpers::encryption_mode_for(*session, *peer_io),
+                [mgr, started](tr_handshake::Result const& result) { return on_handshake_done(mgr, result, started); },
+                std::size(attempts) > 1U);
+        }
+    }
 
-    if (!peer_io)
+    if (!peer_info.has_handshake())
     {
         tr_logAddTraceSwarm(s, fmt::format("peerIo not created; marking peer {} as unreachable", peer_info.display_name()));
         peer_info.set_connectable(false);
         peer_info.on_connection_failed();
     }
-    else
-    {
-        peer_info.start_handshake(
-            &mgr->handshake_mediator_,
-            peer_io,
-            session->encryptionMode(),
-            [mgr](tr_handshake::Result const& result) { return on_handshake_done(mgr, result); });
-    }
 
     peer_info.set_connection_attempt_time(now);
 }
@@ -2676,39 +3251,61 @@ void tr_peerMgr::make_new_peer_connections()
 
     auto const lock = unique_lock();
 
-    // get the candidates if we need to
-    auto& candidates = outbound_candidates_;
-    if (std::empty(candidates))
+    // leave 5% of connection slots for incoming connections -- ticket #2609
+    if (auto const max_candidates = static_cast<size_t>(session->peerLimit() * 0.95); max_candidates <= tr_peerMsgs::size())
     {
-        get_peer_candidates(session->peerLimit(), torrents_, candidates);
+        return;
     }
 
-    // initiate connections to the last N candidates
-    auto const n_this_pass = std::min(std::size(candidates), MaxConnectionsPerPulse);
-    for (auto it = std::crbegin(candidates), end = std::crbegin(candidates) + n_this_pass; it != end; ++it)
+    auto const now = tr_time();
+    auto const now_msec = tr_time_msec();
+
+    // Each swarm keeps its own candidates sorted, so we only need to
+    // merge the swarms' best candidates here instead of scoring every
+    // peer we know about. Rescore the heads because the torrent-level
+    // parts of the score, e.g. its priority, may have changed since
+    // they were queued.
+    auto const is_worse = [](auto const& a, auto const& b)
+    {
+        return a.first > b.first;
+    };
+    auto salter = tr_salt_shaker{};
+    auto heads = std::vector<std::pair<uint64_t, tr_swarm*>>{};
+    auto const push_head = [&](tr_swarm* const swarm)
     {
-        auto const& [tor_id, sock_addr] = *it;
+        if (auto const* const peer_info = best_candidate(swarm, now); peer_info != nullptr)
+        {
+            heads.emplace_back(getPeerCandidateScore(swarm->tor, *peer_info, salter()), swarm);
+            std::push_heap(std::begin(heads), std::end(heads), is_worse);
+        }
+    };
 
-        if (auto* const tor = torrents_.get(tor_id); tor != nullptr)
+    heads.reserve(std::size(torrents_));
+    for (auto* const tor : torrents_)
+    {
+        if (wants_outbound_peers(tor, now_msec))
         {
-            if (auto const& peer_info = tor->swarm->get_existing_peer_info(sock_addr))
-            {
-                initiate_connection(this, tor->swarm, *peer_info);
-            }
+            push_head(tor->swarm);
         }
     }
 
-    // remove the N candidates that we just consumed
-    candidates.resize(std::size(candidates) - n_this_pass);
-}
-
-void HandshakeMediator::set_utp_failed(tr_sha1_digest_t const& info_hash, tr_socket_address const& socket_address)
-{
-    if (auto* const tor = torrents_.get(info_hash); tor != nullptr)
+    for (size_t i = 0U; i < MaxConnectionsPerPulse && !std::empty(heads); ++i)
     {
-        if (auto const& peer_info = tor->swarm->get_existing_peer_info(socket_address))
+        if (tr_peer_socket::limit_reached(session))
         {
-            peer_info->set_utp_supported(false);
+            break;
         }
+
+        std::pop_heap(std::begin(heads), std::end(heads), is_worse);
+        auto* const swarm = heads.back().second;
+        heads.pop_back();
+
+        // best_candidate() left the peer at the top of the swarm's queue
+        auto* const peer_info = best_candidate(swarm, now);
+        TR_ASSERT(peer_info != nullptr);
+        swarm->outbound_candidates.pop();
+        initiate_connection(this, swarm, *peer_info);
+
+        push_head(swarm);
     }
 }
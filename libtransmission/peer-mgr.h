@@ -9,10 +9,12 @@
 #error only libtransmission should #include this header.
 #endif
 
+#include <algorithm> // std::any_of, std::find_if, std::max
 #include <cstddef> // size_t
-#include <cstdint> // uint8_t, uint64_t
+#include <cstdint> // uint8_t, uint32_t, uint64_t
 #include <ctime>
 #include <limits>
+#include <memory>
 #include <optional>
 #include <string>
 #include <vector>
@@ -22,6 +24,7 @@
 #include "libtransmission/blocklist.h"
 #include "libtransmission/handshake.h"
 #include "libtransmission/net.h" /* tr_address */
+#include "libtransmission/peer-io.h" // tr_preferred_transport
 #include "libtransmission/tr-assert.h"
 #include "libtransmission/utils.h" /* tr_compare_3way */
 
@@ -185,6 +188,28 @@ public:
         return is_utp_supported_;
     }
 
+    // the transport of the last outgoing connection that worked
+    constexpr void set_last_transport(tr_preferred_transport const transport) noexcept
+    {
+        last_transport_ = transport;
+    }
+
+    [[nodiscard]] constexpr auto last_transport() const noexcept
+    {
+        return last_transport_;
+    }
+
+    // the peer's listening address in the other address family, if it told us one
+    void set_alt_socket_address(tr_socket_address const& socket_address) noexcept
+    {
+        alt_socket_address_ = socket_address;
+    }
+
+    [[nodiscard]] constexpr auto const& alt_socket_address() const noexcept
+    {
+        return alt_socket_address_;
+    }
+
     // ---
 
     [[nodiscard]] constexpr auto compare_by_failure_count(tr_peer_info const& that) const noexcept
@@ -219,22 +244,44 @@ public:
 
     [[nodiscard]] auto has_handshake() const noexcept
     {
-        return static_cast<bool>(outgoing_handshake_);
+        return !std::empty(outgoing_handshakes_);
     }
 
+    // true if one of our outgoing handshakes to this peer is using `io`
+    [[nodiscard]] auto has_handshake(tr_peerIo const* const io) const noexcept
+    {
+        return std::any_of(
+            std::begin(outgoing_handshakes_),
+            std::end(outgoing_handshakes_),
+            [io](auto const& handshake) { return handshake->peer_io().get() == io; });
+    }
+
+    // Start an outgoing handshake. There can be several at once when
+    // we're racing connections to the peer over different transports
+    // or address families.
     template<typename... Args>
     void start_handshake(Args&&... args)
     {
-        TR_ASSERT(!outgoing_handshake_);
-        if (!outgoing_handshake_)
-        {
-            outgoing_handshake_ = std::make_unique<tr_handshake>(std::forward<Args>(args)...);
-        }
+        outgoing_handshakes_.emplace_back(std::make_unique<tr_handshake>(std::forward<Args>(args)...));
     }
 
+    // cancel all of our outgoing handshakes to this peer
     void destroy_handshake() noexcept
     {
-        outgoing_handshake_.reset();
+        outgoing_handshakes_.clear();
+    }
+
+    // cancel the outgoing handshake that's using `io`
+    void destroy_handshake(tr_peerIo const* const io) noexcept
+    {
+        auto const it = std::find_if(
+            std::begin(outgoing_handshakes_),
+            std::end(outgoing_handshakes_),
+            [io](auto const& handshake) { return handshake->peer_io().get() == io; });
+        if (it != std::end(outgoing_handshakes_))
+        {
+            outgoing_handshakes_.erase(it);
+        }
     }
 
     [[nodiscard]] auto is_in_use() const noexcept
@@ -299,6 +346,26 @@ public:
         return interval >= get_reconnect_interval_secs(now);
     }
 
+    // the earliest time that `reconnect_interval_has_passed()` might be true
+    [[nodiscard]] constexpr time_t reconnect_time(time_t const now) const noexcept
+    {
+        return std::max(connection_attempted_at_, connection_changed_at_) + get_reconnect_interval_secs(now);
+    }
+
+    // ---
+
+    // Bumped each time the peer is queued as an outbound connection
+    // candidate, so that its older queue entries can be told apart.
+    [[nodiscard]] constexpr auto candidate_generation() const noexcept
+    {
+        return candidate_generation_;
+    }
+
+    constexpr auto next_candidate_generation() noexcept
+    {
+        return ++candidate_generation_;
+    }
+
     [[nodiscard]] constexpr std::optional<time_t> idle_secs(time_t now) const noexcept
     {
         if (!is_connected_)
@@ -442,13 +509,18 @@ private:
     time_t connection_changed_at_ = {};
     time_t piece_data_at_ = {};
 
+    std::optional<tr_socket_address> alt_socket_address_;
+
     mutable std::optional<bool> blocklisted_;
     std::optional<bool> is_connectable_;
     std::optional<bool> is_utp_supported_;
+    std::optional<tr_preferred_transport> last_transport_;
 
     tr_peer_from from_first_; // where the peer was first found
     tr_peer_from from_best_; // the "best" place where this peer was found
 
+    uint32_t candidate_generation_ = {};
+
     uint8_t num_consecutive_fails_ = {};
     uint8_t pex_flags_ = {};
 
@@ -456,7 +528,7 @@ private:
     bool is_connected_ = false;
     bool is_seed_ = false;
 
-    std::unique_ptr<tr_handshake> outgoing_handshake_;
+    std::vector<std::unique_ptr<tr_handshake>> outgoing_handshakes_;
 };
 
 struct tr_pex
@@ -551,6 +623,45 @@ void tr_peerMgrClientSentRequests(tr_torrent* torrent, tr_peer* peer, tr_block_s
 
 void tr_peerMgrAddIncoming(tr_peerMgr* manager, tr_peer_socket&& socket);
 
+// the number of incoming connections that are still handshaking
+[[nodiscard]] size_t tr_peerMgrPendingIncomingHandshakes(tr_peerMgr const* manager);
+
+// how long our recent outgoing connections took to finish their handshakes
+struct tr_peer_connect_latency
+{
+    size_t samples = 0;
+    uint64_t p50_msec = 0;
+    uint64_t p90_msec = 0;
+    uint64_t p99_msec = 0;
+};
+
+[[nodiscard]] tr_peer_connect_latency tr_peerMgrConnectLatency(tr_peerMgr const* manager);
+
+// approximately how much memory our connected peers are using
+struct tr_peer_memory_report
+{
+    size_t peer_count = 0;
+
+    // totals of tr_peer_memory_usage across all the connected peers
+    uint64_t msgs_bytes = 0;
+    uint64_t io_bytes = 0;
+    uint64_t buffer_bytes = 0;
+
+    // idle buffer storage that's waiting to be reused by any peer
+    uint64_t buffer_pool_bytes = 0;
+
+    // The same memory, i.e. msgs + io + buffers, by connection type.
+    // Each peer is counted as either encrypted or plaintext and as
+    // either TCP or µTP. LAN peers are also counted in `lan_bytes`.
+    uint64_t encrypted_bytes = 0;
+    uint64_t plaintext_bytes = 0;
+    uint64_t tcp_bytes = 0;
+    uint64_t utp_bytes = 0;
+    uint64_t lan_bytes = 0;
+};
+
+[[nodiscard]] tr_peer_memory_report tr_peerMgrMemoryReport(tr_peerMgr const* manager);
+
 size_t tr_peerMgrAddPex(tr_torrent* tor, tr_peer_from from, tr_pex const* pex, size_t n_pex);
 
 enum
@@ -565,6 +676,12 @@ enum
     uint8_t peer_list_mode,
     size_t max_peer_count);
 
+// Get the ut_pex payload for a peer that was last sent PEX version `since_version`,
+// or 0 if it hasn't been sent one yet. The connected-peer list and the encoded
+// messages are shared by all of the torrent's peers.
+// Sets `setme_version` to the version that this payload brings the peer up to.
+[[nodiscard]] std::string tr_peerMgrGetPexMessage(tr_torrent const* tor, uint32_t since_version, uint32_t* setme_version);
+
 void tr_peerMgrAddTorrent(tr_peerMgr* manager, struct tr_torrent* tor);
 
 // return the number of connected peers that have `piece`, or -1 if we already have it
@@ -6,11 +6,8 @@
 #include <array>
 #include <cstddef> // std::byte
 #include <cstdint>
-#include <limits> // std::numeric_limits
 #include <string_view>
 
-#include <math/wide_integer/uintwide_t.h>
-
 #include "libtransmission/crypto-utils.h" // tr_sha1
 #include "libtransmission/peer-mse.h"
 #include "libtransmission/tr-arc4.h"
@@ -20,51 +17,239 @@ using namespace std::literals;
 
 namespace
 {
-namespace wi
+namespace dh_math
 {
-using key_t = math::wide_integer::uintwide_t<
-    tr_message_stream_encryption::DH::KeySize * std::numeric_limits<unsigned char>::digits>;
-
-using private_key_t = math::wide_integer::uintwide_t<
-    tr_message_stream_encryption::DH::PrivateKeySize * std::numeric_limits<unsigned char>::digits>;
+// The keys are 768-bit numbers. Here they're stored as
+// little-endian arrays of 32-bit limbs to make the math easy.
+auto constexpr NumLimbs = tr_message_stream_encryption::DH::KeySize / sizeof(uint32_t);
+using limbs_t = std::array<uint32_t, NumLimbs>;
 
-template<typename UIntWide>
-auto import_bits(std::array<std::byte, UIntWide::my_width2 / std::numeric_limits<uint8_t>::digits> const& bigend_bin)
+template<size_t N>
+[[nodiscard]] constexpr limbs_t import_bits(std::array<std::byte, N> const& bigend_bin) noexcept
 {
-    auto ret = UIntWide{};
-    static_assert(sizeof(UIntWide) == sizeof(bigend_bin));
+    static_assert(N % sizeof(uint32_t) == 0U && N <= NumLimbs * sizeof(uint32_t));
 
-    for (auto const walk : bigend_bin)
+    auto ret = limbs_t{};
+    for (size_t i = 0; i < N; ++i)
     {
-        ret <<= 8;
-        ret += static_cast<uint8_t>(walk);
+        // i-th least significant byte
+        auto const byte = uint32_t{ static_cast<uint8_t>(bigend_bin[N - 1U - i]) };
+        ret[i / 4U] |= byte << (8U * (i % 4U));
     }
 
     return ret;
 }
 
-template<typename UIntWide>
-auto export_bits(UIntWide i)
+[[nodiscard]] constexpr auto export_bits(limbs_t const& limbs) noexcept
 {
-    auto ret = std::array<std::byte, UIntWide::my_width2 / std::numeric_limits<uint8_t>::digits>{};
-
-    for (auto walk = std::rbegin(ret), end = std::rend(ret); walk != end; ++walk)
+    auto ret = tr_message_stream_encryption::DH::key_bigend_t{};
+    for (size_t i = 0; i < std::size(ret); ++i)
     {
-        *walk = std::byte(static_cast<uint8_t>(i & 0xFF));
-        i >>= 8;
+        ret[std::size(ret) - 1U - i] = std::byte(static_cast<uint8_t>(limbs[i / 4U] >> (8U * (i % 4U))));
     }
 
     return ret;
 }
 
-// NOLINTBEGIN(readability-identifier-naming)
-auto WIDE_INTEGER_CONSTEXPR const generator = wi::key_t{ "2" };
-auto WIDE_INTEGER_CONSTEXPR const prime = wi::key_t{
-    "0xFFFFFFFFFFFFFFFFC90FDAA22168C234C4C6628B80DC1CD129024E088A67CC74020BBEA63B139B22514A08798E3404DDEF9519B3CD3A431B302B0A6DF25F14374FE1356D6D51C245E485B576625E7EC6F44C42E9A63A36210000000000090563"
+// @return true iff a >= b
+[[nodiscard]] constexpr bool is_at_least(limbs_t const& a, limbs_t const& b) noexcept
+{
+    for (size_t i = NumLimbs; i-- > 0U;)
+    {
+        if (a[i] != b[i])
+        {
+            return a[i] > b[i];
+        }
+    }
+
+    return true;
+}
+
+// a -= b, ignoring any borrow out of the top limb
+constexpr void subtract(limbs_t& a, limbs_t const& b) noexcept
+{
+    auto borrow = uint64_t{};
+    for (size_t i = 0; i < NumLimbs; ++i)
+    {
+        auto const diff = uint64_t{ a[i] } - b[i] - borrow;
+        a[i] = static_cast<uint32_t>(diff);
+        borrow = (diff >> 63U) & 1U;
+    }
+}
+
+// Modular exponentiation using Montgomery multiplication, which avoids
+// the long division that a naive `(a * b) % m` needs for every step.
+class Montgomery
+{
+public:
+    explicit constexpr Montgomery(limbs_t const& modulus) noexcept
+        : m_{ modulus }
+        , m_inv_{ negative_inverse(modulus[0]) }
+        , r2_{ r_squared(modulus) }
+    {
+    }
+
+    // @return base**exponent mod m, where `exponent` is a big-endian byte array
+    template<size_t N>
+    [[nodiscard]] constexpr limbs_t powm(limbs_t const& base, std::array<std::byte, N> const& exponent) const noexcept
+    {
+        // fixed 4-bit window: table[i] holds base**i in Montgomery form
+        auto table = std::array<limbs_t, 16U>{};
+        table[0] = to_montgomery(limbs_t{ 1U });
+        table[1] = to_montgomery(base);
+        for (size_t i = 2; i < std::size(table); ++i)
+        {
+            table[i] = multiply(table[i - 1U], table[1]);
+        }
+
+        auto result = table[0];
+        for (auto const byte : exponent)
+        {
+            for (auto const shift : { 4U, 0U })
+            {
+                for (auto i = 0; i < 4; ++i)
+                {
+                    result = multiply(result, result);
+                }
+
+                if (auto const nibble = (static_cast<uint8_t>(byte) >> shift) & 0x0FU; nibble != 0U)
+                {
+                    result = multiply(result, table[nibble]);
+                }
+            }
+        }
+
+        // multiplying by 1 converts back out of Montgomery form
+        return multiply(result, limbs_t{ 1U });
+    }
+
+private:
+    // @return -1/x mod 2**32. `x` must be odd.
+    [[nodiscard]] static constexpr uint32_t negative_inverse(uint32_t const x) noexcept
+    {
+        // Newton's method; each iteration doubles the number of correct bits
+        auto inv = uint32_t{ 1U };
+        for (auto i = 0; i < 5; ++i)
+        {
+            inv *= 2U - x * inv;
+        }
+
+        return ~inv + 1U;
+    }
+
+    // @return R**2 mod m, where R = 2**768
+    [[nodiscard]] static constexpr limbs_t r_squared(limbs_t const& m) noexcept
+    {
+        // R mod m is just R - m, since m > R / 2
+        auto r = limbs_t{};
+        subtract(r, m);
+
+        // double it 768 more times
+        for (size_t i = 0; i < NumLimbs * 32U; ++i)
+        {
+            auto carry = uint32_t{};
+            for (auto& limb : r)
+            {
+                auto const next_carry = limb >> 31U;
+                limb = (limb << 1U) | carry;
+                carry = next_carry;
+            }
+
+            if (carry != 0U || is_at_least(r, m))
+            {
+                subtract(r, m);
+            }
+        }
+
+        return r;
+    }
+
+    [[nodiscard]] constexpr limbs_t to_montgomery(limbs_t const& a) const noexcept
+    {
+        return multiply(a, r2_);
+    }
+
+    // Coarsely Integrated Operand Scanning (CIOS)
+    // @return a * b / R mod m
+    [[nodiscard]] constexpr limbs_t multiply(limbs_t const& a, limbs_t const& b) const noexcept
+    {
+        auto t = std::array<uint32_t, NumLimbs + 2U>{};
+
+        for (size_t i = 0; i < NumLimbs; ++i)
+        {
+            auto carry = uint64_t{};
+            for (size_t j = 0; j < NumLimbs; ++j)
+            {
+                auto const sum = uint64_t{ t[j] } + uint64_t{ a[j] } * b[i] + carry;
+                t[j] = static_cast<uint32_t>(sum);
+                carry = sum >> 32U;
+            }
+
+            auto sum = uint64_t{ t[NumLimbs] } + carry;
+            t[NumLimbs] = static_cast<uint32_t>(sum);
+            t[NumLimbs + 1U] = static_cast<uint32_t>(sum >> 32U);
+
+            auto const q = t[0] * m_inv_;
+            carry = (uint64_t{ t[0] } + uint64_t{ q } * m_[0]) >> 32U;
+            for (size_t j = 1; j < NumLimbs; ++j)
+            {
+                sum = uint64_t{ t[j] } + uint64_t{ q } * m_[j] + carry;
+                t[j - 1U] = static_cast<uint32_t>(sum);
+                carry = sum >> 32U;
+            }
+
+            sum = uint64_t{ t[NumLimbs] } + carry;
+            t[NumLimbs - 1U] = static_cast<uint32_t>(sum);
+            t[NumLimbs] = t[NumLimbs + 1U] + static_cast<uint32_t>(sum >> 32U);
+        }
+
+        auto ret = limbs_t{};
+        for (size_t i = 0; i < NumLimbs; ++i)
+        {
+            ret[i] = t[i];
+        }
+
+        if (t[NumLimbs] != 0U || is_at_least(ret, m_))
+        {
+            subtract(ret, m_);
+        }
+
+        return ret;
+    }
+
+    limbs_t m_;
+    uint32_t m_inv_;
+    limbs_t r2_;
 };
-// NOLINTEND(readability-identifier-naming)
 
-} // namespace wi
+// MSE spec: "P is a safe prime, G is 2"
+auto constexpr Generator = limbs_t{ 2U };
+auto constexpr Prime = import_bits(std::array<std::byte, tr_message_stream_encryption::DH::KeySize>{
+    std::byte{ 0xFF }, std::byte{ 0xFF }, std::byte{ 0xFF }, std::byte{ 0xFF }, std::byte{ 0xFF }, std::byte{ 0xFF },
+    std::byte{ 0xFF }, std::byte{ 0xFF }, std::byte{ 0xC9 }, std::byte{ 0x0F }, std::byte{ 0xDA }, std::byte{ 0xA2 },
+    std::byte{ 0x21 }, std::byte{ 0x68 }, std::byte{ 0xC2 }, std::byte{ 0x34 }, std::byte{ 0xC4 }, std::byte{ 0xC6 },
+    std::byte{ 0x62 }, std::byte{ 0x8B }, std::byte{ 0x80 }, std::byte{ 0xDC }, std::byte{ 0x1C }, std::byte{ 0xD1 },
+    std::byte{ 0x29 }, std::byte{ 0x02 }, std::byte{ 0x4E }, std::byte{ 0x08 }, std::byte{ 0x8A }, std::byte{ 0x67 },
+    std::byte{ 0xCC }, std::byte{ 0x74 }, std::byte{ 0x02 }, std::byte{ 0x0B }, std::byte{ 0xBE }, std::byte{ 0xA6 },
+    std::byte{ 0x3B }, std::byte{ 0x13 }, std::byte{ 0x9B }, std::byte{ 0x22 }, std::byte{ 0x51 }, std::byte{ 0x4A },
+    std::byte{ 0x08 }, std::byte{ 0x79 }, std::byte{ 0x8E }, std::byte{ 0x34 }, std::byte{ 0x04 }, std::byte{ 0xDD },
+    std::byte{ 0xEF }, std::byte{ 0x95 }, std::byte{ 0x19 }, std::byte{ 0xB3 }, std::byte{ 0xCD }, std::byte{ 0x3A },
+    std::byte{ 0x43 }, std::byte{ 0x1B }, std::byte{ 0x30 }, std::byte{ 0x2B }, std::byte{ 0x0A }, std::byte{ 0x6D },
+    std::byte{ 0xF2 }, std::byte{ 0x5F }, std::byte{ 0x14 }, std::byte{ 0x37 }, std::byte{ 0x4F }, std::byte{ 0xE1 },
+    std::byte{ 0x35 }, std::byte{ 0x6D }, std::byte{ 0x6D }, std::byte{ 0x51 }, std::byte{ 0xC2 }, std::byte{ 0x45 },
+    std::byte{ 0xE4 }, std::byte{ 0x85 }, std::byte{ 0xB5 }, std::byte{ 0x76 }, std::byte{ 0x62 }, std::byte{ 0x5E },
+    std::byte{ 0x7E }, std::byte{ 0xC6 }, std::byte{ 0xF4 }, std::byte{ 0x4C }, std::byte{ 0x42 }, std::byte{ 0xE9 },
+    std::byte{ 0xA6 }, std::byte{ 0x3A }, std::byte{ 0x36 }, std::byte{ 0x21 }, std::byte{ 0x00 }, std::byte{ 0x00 },
+    std::byte{ 0x00 }, std::byte{ 0x00 }, std::byte{ 0x00 }, std::byte{ 0x09 }, std::byte{ 0x05 }, std::byte{ 0x63 },
+});
+
+[[nodiscard]] Montgomery const& montgomery()
+{
+    static auto const instance = Montgomery{ Prime };
+    return instance;
+}
+
+} // namespace dh_math
 } // namespace
 
 namespace tr_message_stream_encryption
@@ -79,9 +264,7 @@ namespace tr_message_stream_encryption
 
 [[nodiscard]] auto generatePublicKey(DH::private_key_bigend_t const& private_key) noexcept
 {
-    auto const private_key_wi = wi::import_bits<wi::private_key_t>(private_key);
-    auto const public_key_wi = math::wide_integer::powm(wi::generator, private_key_wi, wi::prime);
-    return wi::export_bits(public_key_wi);
+    return dh_math::export_bits(dh_math::montgomery().powm(dh_math::Generator, private_key));
 }
 
 DH::key_bigend_t DH::publicKey() noexcept
@@ -96,11 +279,8 @@ DH::key_bigend_t DH::publicKey() noexcept
 
 void DH::setPeerPublicKey(key_bigend_t const& peer_public_key)
 {
-    auto const secret = math::wide_integer::powm(
-        wi::import_bits<wi::key_t>(peer_public_key),
-        wi::import_bits<wi::private_key_t>(private_key_),
-        wi::prime);
-    secret_ = wi::export_bits(secret);
+    auto const secret = dh_math::montgomery().powm(dh_math::import_bits(peer_public_key), private_key_);
+    secret_ = dh_math::export_bits(secret);
 }
 
 // --- Filter
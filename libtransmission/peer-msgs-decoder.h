@@ -0,0 +1,236 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#pragma once
+
+#ifndef __TRANSMISSION__
+#error only libtransmission should #include this header.
+#endif
+
+#include <algorithm> // std::min
+#include <cstddef> // size_t, std::byte
+#include <cstdint> // uint8_t, uint32_t
+#include <optional>
+#include <utility> // std::pair
+
+#include "libtransmission/block-info.h"
+#include "libtransmission/peer-io.h" // ReadState
+#include "libtransmission/tr-buffer.h"
+
+/**
+ * Splits the BitTorrent peer wire stream into messages.
+ *
+ * https://www.bittorrent.org/beps/bep_0003.html
+ * After the handshake comes an alternating stream of length prefixes
+ * and messages. Messages of length zero are keepalives, and ignored.
+ * All other messages start with a single byte which gives their type.
+ *
+ * Most messages are tiny, so they're only read once they've arrived in
+ * full, and then from a buffer on the stack. Piece messages are the
+ * exception: the Mediator says where their block data should go, and
+ * it's streamed straight there as it arrives, without being staged in
+ * a message buffer first.
+ *
+ * `Source` is anything with tr_peerIo's read_buffer_size(), read_bytes(),
+ * read_uint8(), and read_uint32() methods.
+ */
+class tr_peer_msgs_decoder
+{
+public:
+    using MessageReader = libtransmission::BufferReader<std::byte>;
+
+    // the state to continue in, and how many bytes of piece data were read
+    using ReadResult = std::pair<ReadState, size_t>;
+
+    static auto constexpr PieceMessageId = uint8_t{ 7 };
+
+    // Payloads this small are read in one go, once they've fully arrived.
+    static auto constexpr SmallPayloadSize = size_t{ 64U };
+
+    class Mediator
+    {
+    public:
+        virtual ~Mediator() = default;
+
+        // Called with each complete message other than piece data.
+        // Must not destroy the decoder.
+        virtual ReadState on_message(uint8_t id, MessageReader& payload) = 0;
+
+        // Called when the header of a piece message has arrived.
+        // Sets `setme_dst` to where the `len` bytes of block data should be
+        // written, or to nullptr to discard them. Must not destroy the decoder.
+        virtual ReadState on_piece_begin(uint32_t piece, uint32_t offset, uint32_t len, uint8_t** setme_dst) = 0;
+
+        // Called when all of the current piece message's block data has been
+        // written to the destination picked in on_piece_begin().
+        // This may destroy the decoder.
+        virtual ReadState on_piece_end() = 0;
+    };
+
+    explicit tr_peer_msgs_decoder(Mediator& mediator) noexcept
+        : mediator_{ mediator }
+    {
+    }
+
+    // Reads at most one message from `src`, or as much of one as has arrived.
+    // Returns READ_LATER if the message is still incomplete.
+    template<typename Source>
+    ReadResult read_one(Source& src)
+    {
+        // <length prefix>
+        if (!length_)
+        {
+            auto len = uint32_t{};
+            if (src.read_buffer_size() < sizeof(len))
+            {
+                return { READ_LATER, 0U };
+            }
+
+            src.read_uint32(&len);
+
+            // keepalive
+            if (len == 0U)
+            {
+                return { READ_NOW, 0U };
+            }
+
+            length_ = len;
+        }
+
+        // <message ID>
+        if (!id_)
+        {
+            auto id = uint8_t{};
+            if (src.read_buffer_size() < sizeof(id))
+            {
+                return { READ_LATER, 0U };
+            }
+
+            src.read_uint8(&id);
+            id_ = id;
+        }
+
+        auto const payload_len = size_t{ *length_ } - sizeof(uint8_t);
+
+        if (*id_ == PieceMessageId && payload_len >= PieceHeaderSize)
+        {
+            return read_piece(src, payload_len);
+        }
+
+        // <payload>
+        if (payload_len <= SmallPayloadSize)
+        {
+            if (src.read_buffer_size() < payload_len)
+            {
+                return { READ_LATER, 0U };
+            }
+
+            auto const id = *id_;
+            reset();
+
+            auto payload = SmallBuffer{};
+            auto const [buf, n_bytes] = payload.reserve_space(payload_len);
+            src.read_bytes(buf, n_bytes);
+            payload.commit_space(n_bytes);
+            return { mediator_.on_message(id, payload), 0U };
+        }
+
+        auto const n_left = payload_len - std::size(payload_);
+        auto const [buf, n_this_pass] = payload_.reserve_space(std::min(n_left, src.read_buffer_size()));
+        src.read_bytes(buf, n_this_pass);
+        payload_.commit_space(n_this_pass);
+
+        if (n_this_pass < n_left)
+        {
+            return { READ_LATER, 0U };
+        }
+
+        auto const id = *id_;
+        reset();
+
+        auto const state = mediator_.on_message(id, payload_);
+        payload_.clear();
+        return { state, 0U };
+    }
+
+    // how much memory is holding partially-read messages
+    [[nodiscard]] size_t memory_usage() const noexcept
+    {
+        return payload_.capacity_bytes();
+    }
+
+private:
+    using SmallBuffer = libtransmission::StackBuffer<SmallPayloadSize, std::byte>;
+    using PayloadBuffer = libtransmission::PooledBuffer<tr_block_info::BlockSize + 16U, std::byte>;
+
+    // <index><begin>
+    static auto constexpr PieceHeaderSize = sizeof(uint32_t) * 2U;
+
+    template<typename Source>
+    ReadResult read_piece(Source& src, size_t const payload_len)
+    {
+        // <index><begin>
+        if (!piece_left_)
+        {
+            if (src.read_buffer_size() < PieceHeaderSize)
+            {
+                return { READ_LATER, 0U };
+            }
+
+            auto piece = uint32_t{};
+            auto offset = uint32_t{};
+            src.read_uint32(&piece);
+            src.read_uint32(&offset);
+
+            auto const len = static_cast<uint32_t>(payload_len - PieceHeaderSize);
+            piece_dst_ = nullptr;
+            if (auto const state = mediator_.on_piece_begin(piece, offset, len, &piece_dst_); state != READ_NOW)
+            {
+                reset();
+                return { state, 0U };
+            }
+
+            piece_left_ = len;
+        }
+
+        // <block>, straight to its destination
+        auto const n_this_pass = std::min(size_t{ *piece_left_ }, src.read_buffer_size());
+        src.read_bytes(piece_dst_, n_this_pass);
+        *piece_left_ -= static_cast<uint32_t>(n_this_pass);
+        if (piece_dst_ != nullptr)
+        {
+            piece_dst_ += n_this_pass;
+        }
+
+        if (*piece_left_ > 0U)
+        {
+            return { READ_LATER, n_this_pass };
+        }
+
+        reset();
+        return { mediator_.on_piece_end(), n_this_pass };
+    }
+
+    void reset() noexcept
+    {
+        length_.reset();
+        id_.reset();
+        piece_left_.reset();
+        piece_dst_ = nullptr;
+    }
+
+    Mediator& mediator_;
+
+    // the message that's partially read, if any
+    std::optional<uint32_t> length_;
+    std::optional<uint8_t> id_;
+
+    // the current piece message's remaining block bytes and where they go
+    std::optional<uint32_t> piece_left_;
+    uint8_t* piece_dst_ = nullptr;
+
+    // holds a large message's payload until it's all arrived
+    PayloadBuffer payload_;
+};
@@ -10,11 +10,9 @@
 #include <cstddef>
 #include <cstdint> // uint8_t, uint32_t, int64_t
 #include <ctime>
-#include <deque>
 #include <iterator>
 #include <memory> // std::unique_ptr
 #include <optional>
-#include <queue>
 #include <ratio>
 #include <string>
 #include <string_view>
@@ -25,21 +23,23 @@
 
 #include <fmt/core.h>
 
-#include <small/vector.hpp>
-
 #include "libtransmission/transmission.h"
 
 #include "libtransmission/bitfield.h"
 #include "libtransmission/block-info.h"
 #include "libtransmission/cache.h"
 #include "libtransmission/crypto-utils.h"
+#include "libtransmission/file.h" // tr_sys_file_t
+#include "libtransmission/inout.h" // tr_ioFindFileSpan()
 #include "libtransmission/interned-string.h"
 #include "libtransmission/log.h"
 #include "libtransmission/peer-common.h"
 #include "libtransmission/peer-io.h"
 #include "libtransmission/peer-mgr.h"
 #include "libtransmission/peer-msgs.h"
+#include "libtransmission/peer-msgs-decoder.h"
 #include "libtransmission/quark.h"
+#include "libtransmission/ring.h"
 #include "libtransmission/session.h"
 #include "libtransmission/timer.h"
 #include "libtransmission/torrent-magnet.h"
@@ -178,12 +178,15 @@ auto constexpr KeepaliveIntervalSecs = time_t{ 100 };
 
 auto constexpr MetadataReqQ = size_t{ 64U };
 
-auto constexpr ReqQ = 512;
+auto constexpr ReqQ = size_t{ 512U };
+
+// LAN peers can keep more requests in flight, since they're fast
+// enough to get through them before they go stale
+auto constexpr LanReqQ = size_t{ 2048U };
 
-// when we're making requests from another peer,
-// batch them together to send enough requests to
-// meet our bandwidth goals for the next N seconds
-auto constexpr RequestBufSecs = time_t{ 10 };
+// how many requests we keep in flight to a peer that doesn't
+// advertise a reqq. This is libtorrent's default.
+auto constexpr DefaultPeerReqQ = size_t{ 250U };
 
 // ---
 
@@ -220,13 +223,18 @@ struct peer_request
 
 // ---
 
-/* this is raw, unchanged data from the peer regarding
- * the current message that it's sending us. */
+/* block data that the peer is sending us */
 struct tr_incoming
 {
-    std::optional<uint32_t> length; // the full message payload length. Includes the +1 for id length
-    std::optional<uint8_t> id; // the protocol message, e.g. BtPeerMsgs::Piece
-    MessageBuffer payload;
+    // the piece message whose block data is being read, if any
+    struct current_piece
+    {
+        std::optional<tr_block_index_t> block; // unset if we didn't ask for it
+        uint32_t len = {};
+        std::unique_ptr<Cache::BlockData> whole_block; // set if this message has the entire block
+    };
+
+    current_piece piece;
 
     struct incoming_piece_data
     {
@@ -284,8 +292,6 @@ struct tr_incoming
 #define logtrace(msgs, text) myLogMacro(msgs, TR_LOG_TRACE, text)
 #define logwarn(msgs, text) myLogMacro(msgs, TR_LOG_WARN, text)
 
-using ReadResult = std::pair<ReadState, size_t /*n_piece_data_bytes_read*/>;
-
 /**
  * Low-level communication state information about a connected peer.
  *
@@ -319,7 +325,7 @@ public:
     {
         if (tor_.allows_pex())
         {
-            pex_timer_ = session->timerMaker().create([this]() { send_ut_pex(); });
+            pex_timer_ = session->coarseTimerMaker().create([this]() { send_ut_pex(); });
             pex_timer_->start_repeating(SendPexInterval);
         }
 
@@ -328,6 +334,7 @@ public:
             send_ltep_handshake();
         }
 
+        super_seeding_ = tor_.is_super_seeding() && tor_.has_all();
         protocol_send_bitfield();
 
         if (session->allowsDHT() && io_->supports_dht())
@@ -385,6 +392,23 @@ public:
         return io_->socket_address();
     }
 
+    [[nodiscard]] bool is_lan() const noexcept override
+    {
+        return io_->is_lan();
+    }
+
+    [[nodiscard]] tr_peer_io_buffers io_buffers() const override
+    {
+        return io_->applied_buffers();
+    }
+
+    [[nodiscard]] tr_peer_memory_usage memory_usage() const override;
+
+    [[nodiscard]] tr_request_pipeline const& request_pipeline() const noexcept override
+    {
+        return request_pipeline_;
+    }
+
     [[nodiscard]] std::string display_name() const override
     {
         return socket_address().display_name();
@@ -404,8 +428,13 @@ public:
 
     void cancel_block_request(tr_block_index_t block) override
     {
+        request_pipeline_.on_request_dropped(block);
         cancels_sent_to_peer.add(tr_time(), 1);
         protocol_send_cancel(peer_request::from_block(tor_, block));
+
+        // don't wait for the next bandwidth pulse; every moment the cancel
+        // sits in our outbuf is a chance for the peer to send the block anyway
+        io_->flush_outgoing_protocol_msgs();
     }
 
     void set_choke(bool peer_is_choked) override
@@ -439,12 +468,49 @@ public:
 
     void on_piece_completed(tr_piece_index_t piece) override
     {
-        protocol_send_have(piece);
+        // Lazy HAVE: a peer that already has this piece is never
+        // going to ask us for it, so we needn't tell it.
+        if (!session->lazy_have_enabled() || !have_.test(piece))
+        {
+            queue_have(piece);
+        }
 
         // since we have more pieces now, we might not be interested in this peer
         update_interest();
     }
 
+    [[nodiscard]] bool is_super_seeding() const noexcept override
+    {
+        return super_seeding_;
+    }
+
+    void super_seed_offer(tr_piece_index_t piece) override
+    {
+        if (super_seeding_)
+        {
+            logtrace(this, fmt::format("super-seeding: offering piece {}", piece));
+            protocol_send_have(piece);
+        }
+    }
+
+    void stop_super_seeding() override
+    {
+        if (!std::exchange(super_seeding_, false) || have_.has_all())
+        {
+            return;
+        }
+
+        // we can't send a bitfield this late in the connection,
+        // so tell the peer about each piece it doesn't have yet
+        for (tr_piece_index_t piece = 0, n = tor_.piece_count(); piece < n; ++piece)
+        {
+            if (!have_.test(piece) && tor_.has_piece(piece))
+            {
+                protocol_send_have(piece);
+            }
+        }
+    }
+
     void set_interested(bool interested) override
     {
         if (client_is_interested() != interested)
@@ -463,6 +529,11 @@ public:
         TR_ASSERT(client_is_interested());
         TR_ASSERT(!client_is_choked());
 
+        if (n_spans > 0U)
+        {
+            request_pipeline_.on_request_sent(block_spans->begin, tr_time_msec());
+        }
+
         for (auto const *span = block_spans, *span_end = span + n_spans; span != span_end; ++span)
         {
             for (auto [block, block_end] = *span; block < block_end; ++block)
@@ -562,7 +633,13 @@ private:
     }
 
     // how many blocks could we request from this peer right now?
-    [[nodiscard]] size_t max_available_reqs() const;
+    [[nodiscard]] size_t max_available_reqs();
+
+    // how many of the peer's requests we'll queue up at once
+    [[nodiscard]] size_t max_peer_requests() const noexcept
+    {
+        return io_->is_lan() ? LanReqQ : ReqQ;
+    }
 
     void update_desired_request_count()
     {
@@ -583,7 +660,7 @@ private:
         }
 
         auto next = reqs.front();
-        reqs.pop();
+        reqs.pop_front();
         return next;
     }
 
@@ -603,8 +680,9 @@ private:
     void send_ut_pex();
 
     int client_got_block(std::unique_ptr<Cache::BlockData> block_data, tr_block_index_t block);
-    ReadResult read_piece_data(MessageReader& payload);
-    ReadResult process_peer_message(uint8_t id, MessageReader& payload);
+    ReadState process_peer_message(uint8_t id, MessageReader& payload);
+    ReadState on_piece_begin(uint32_t piece, uint32_t offset, uint32_t len, uint8_t** setme_dst);
+    ReadState on_piece_end();
 
     // ---
 
@@ -613,6 +691,9 @@ private:
     template<typename... Args>
     size_t protocol_send_message(uint8_t type, Args const&... args) const;
 
+    [[nodiscard]] size_t protocol_send_piece(peer_request const& req) const;
+    size_t protocol_send_piece_header(peer_request const& req) const;
+
     size_t protocol_send_reject(peer_request const& req) const // NOLINT(modernize-use-nodiscard)
     {
         TR_ASSERT(io_->supports_fext());
@@ -653,6 +734,9 @@ private:
 
     void protocol_send_bitfield();
 
+    void queue_have(tr_piece_index_t piece);
+    size_t flush_haves(); // NOLINT(modernize-use-nodiscard)
+
     // ---
 
     void publish(tr_peer_event const& peer_event)
@@ -666,7 +750,7 @@ private:
     // ---
 
     static void did_write(tr_peerIo* /*io*/, size_t bytes_written, bool was_piece_data, void* vmsgs);
-    static ReadState can_read(tr_peerIo* io, void* vmsgs, size_t* piece);
+    static ReadState can_read(tr_peerIo* io, void* vmsgs, size_t max_bytes, size_t* piece);
     static void got_error(tr_peerIo* /*io*/, tr_error const& /*error*/, void* vmsgs);
 
     // ---
@@ -675,8 +759,13 @@ private:
     bool peer_supports_metadata_xfer_ = false;
     bool client_sent_ltep_handshake_ = false;
 
+    // true if we hid our bitfield from this peer to super-seed it
+    bool super_seeding_ = false;
+
     size_t desired_request_count_ = 0;
 
+    tr_request_pipeline request_pipeline_;
+
     uint8_t ut_pex_id_ = 0;
     uint8_t ut_metadata_id_ = 0;
 
@@ -688,11 +777,12 @@ private:
 
     std::shared_ptr<tr_peerIo> const io_;
 
-    std::deque<peer_request> peer_requested_;
+    tr_ring<peer_request> peer_requested_;
 
-    std::array<std::vector<tr_pex>, NUM_TR_AF_INET_TYPES> pex_;
+    // the last ut_pex version that we sent, from tr_peerMgrGetPexMessage()
+    uint32_t pex_version_ = {};
 
-    std::queue<int64_t> peer_requested_metadata_pieces_;
+    tr_ring<int64_t> peer_requested_metadata_pieces_;
 
     time_t client_sent_at_ = 0;
 
@@ -700,12 +790,49 @@ private:
 
     tr_incoming incoming_ = {};
 
+    // piece messages for blocks that we hadn't requested, or had cancelled
+    tr_recentHistory<uint16_t> unrequested_blocks_from_peer_;
+
+    class DecoderMediator final : public tr_peer_msgs_decoder::Mediator
+    {
+    public:
+        explicit DecoderMediator(tr_peerMsgsImpl& msgs) noexcept
+            : msgs_{ msgs }
+        {
+        }
+
+        ReadState on_message(uint8_t id, MessageReader& payload) override
+        {
+            return msgs_.process_peer_message(id, payload);
+        }
+
+        ReadState on_piece_begin(uint32_t piece, uint32_t offset, uint32_t len, uint8_t** setme_dst) override
+        {
+            return msgs_.on_piece_begin(piece, offset, len, setme_dst);
+        }
+
+        ReadState on_piece_end() override
+        {
+            return msgs_.on_piece_end();
+        }
+
+    private:
+        tr_peerMsgsImpl& msgs_;
+    };
+
+    DecoderMediator decoder_mediator_{ *this };
+    tr_peer_msgs_decoder decoder_{ decoder_mediator_ };
+
     // if the peer supports the Extension Protocol in BEP 10 and
     // supplied a reqq argument, it's stored here.
     std::optional<size_t> reqq_;
 
     std::unique_ptr<libtransmission::Timer> pex_timer_;
 
+    // pieces that we've completed but haven't sent HAVEs for yet
+    std::vector<tr_piece_index_t> pending_haves_;
+    std::unique_ptr<libtransmission::Timer> have_timer_;
+
     tr_bitfield have_;
 
     tr_peer_callback_bt const callback_;
@@ -713,10 +840,42 @@ private:
 
     // seconds between periodic send_ut_pex() calls
     static auto constexpr SendPexInterval = 90s;
+
+    // the longest that a HAVE waits for others to go out with
+    static auto constexpr MaxHaveDelay = 200ms;
+
+    // A peer may send a block after we cancel it, since the cancel and the
+    // block can cross on the wire. Allow that, plus this many blocks of slack,
+    // over this many seconds before deciding that the peer is misbehaving.
+    static auto constexpr UnrequestedBlockSlack = size_t{ 2U };
+    static auto constexpr UnrequestedBlockWindowSec = 60U;
 };
 
 // ---
 
+tr_peer_memory_usage tr_peerMsgsImpl::memory_usage() const
+{
+    auto ret = io_->memory_usage();
+
+    ret.msgs_bytes = sizeof(*this) + have_.memory_usage() + blame.memory_usage() + served.memory_usage() +
+        peer_requested_.capacity() * sizeof(peer_request) + peer_requested_metadata_pieces_.capacity() * sizeof(int64_t) +
+        pending_haves_.capacity() * sizeof(tr_piece_index_t);
+
+    ret.buffer_bytes += decoder_.memory_usage();
+    if (incoming_.piece.whole_block)
+    {
+        ret.buffer_bytes += tr_block_info::BlockSize;
+    }
+    for (auto const& [block, data] : incoming_.blocks)
+    {
+        ret.buffer_bytes += sizeof(block) + sizeof(data) + tr_block_info::BlockSize;
+    }
+
+    return ret;
+}
+
+// ---
+
 [[nodiscard]] constexpr bool is_message_length_correct(tr_torrent const& tor, uint8_t id, uint32_t len)
 {
     switch (id)
@@ -862,11 +1021,85 @@ size_t tr_peerMsgsImpl::protocol_send_message(uint8_t type, Args const&... args)
     return n_bytes_added;
 }
 
+// Send a piece message without copying its payload into the write buffer.
+// Returns the number of bytes queued, or 0 if the block couldn't be read.
+size_t tr_peerMsgsImpl::protocol_send_piece(peer_request const& req) const
+{
+    auto const loc = tor_.piece_loc(req.index, req.offset);
+    auto const last_loc = tor_.piece_loc(req.index, req.offset + req.length - 1U);
+    auto& cache = *session->cache;
+
+    // let the kernel send the block straight from disk,
+    // unless part of it is in the cache and not on disk yet
+    if (io_->supports_sendfile() && !cache.contains(tor_, loc) && !cache.contains(tor_, last_loc))
+    {
+        auto file = tr_open_files::SharedFd{};
+        auto file_offset = uint64_t{};
+        if (tr_ioFindFileSpan(tor_, loc, req.length, &file, &file_offset) == 0)
+        {
+            auto const n_bytes = protocol_send_piece_header(req);
+            io_->write_file(std::move(file), file_offset, req.length, true);
+            return n_bytes + req.length;
+        }
+    }
+
+    // plaintext peers can share the cache's copy of the block
+    if (!io_->is_encrypted() && loc.block == last_loc.block)
+    {
+        if (auto block = cache.get_shared_block(tor_, loc); block && loc.block_offset + req.length <= std::size(*block))
+        {
+            auto const* const begin = reinterpret_cast<std::byte const*>(std::data(*block)) + loc.block_offset;
+            auto const n_bytes = protocol_send_piece_header(req);
+            io_->write_chunk(std::shared_ptr<std::byte const>{ std::move(block), begin }, req.length, true);
+            return n_bytes + req.length;
+        }
+    }
+
+    // otherwise, read a private copy that peer-io is free to encrypt in place
+    auto block = std::make_shared<Cache::BlockData>();
+    block->resize(req.length);
+    if (cache.read_block(tor_, loc, req.length, std::data(*block)) != 0)
+    {
+        return {};
+    }
+
+    auto* const begin = reinterpret_cast<std::byte*>(std::data(*block));
+    auto const n_bytes = protocol_send_piece_header(req);
+    io_->write_owned_chunk(std::shared_ptr<std::byte>{ std::move(block), begin }, req.length, true);
+    return n_bytes + req.length;
+}
+
+// Send everything in a piece message except for its payload.
+size_t tr_peerMsgsImpl::protocol_send_piece_header(peer_request const& req) const
+{
+    logtrace(this, fmt::format("sending 'piece' {:d} {:d} []", req.index, req.offset));
+
+    auto out = MessageBuffer{};
+    auto const msg_len = static_cast<uint32_t>(sizeof(uint8_t) + sizeof(uint32_t) * 2U + req.length);
+    TR_ASSERT(is_message_length_correct(tor_, BtPeerMsgs::Piece, msg_len));
+    out.add_uint32(msg_len);
+    out.add_uint8(BtPeerMsgs::Piece);
+    out.add_uint32(req.index);
+    out.add_uint32(req.offset);
+    auto const n_bytes_added = std::size(out);
+    io_->write(out, true);
+    return n_bytes_added;
+}
+
 void tr_peerMsgsImpl::protocol_send_bitfield()
 {
     bool const fext = io_->supports_fext();
 
-    if (fext && tor_.has_all())
+    if (super_seeding_)
+    {
+        // BEP 16: pretend to have nothing. Pieces are advertised
+        // one at a time with `super_seed_offer()` instead.
+        if (fext)
+        {
+            protocol_send_message(BtPeerMsgs::FextHaveNone);
+        }
+    }
+    else if (fext && tor_.has_all())
     {
         protocol_send_message(BtPeerMsgs::FextHaveAll);
     }
@@ -882,6 +1115,50 @@ void tr_peerMsgsImpl::protocol_send_bitfield()
     }
 }
 
+// Pieces often complete in bursts, and every peer needs to hear about
+// each one. Rather than writing each HAVE as soon as its piece completes,
+// collect them and send them together, either with the next pulse()
+// or after `MaxHaveDelay`, whichever comes first.
+void tr_peerMsgsImpl::queue_have(tr_piece_index_t const piece)
+{
+    pending_haves_.emplace_back(piece);
+
+    if (std::size(pending_haves_) == 1U)
+    {
+        if (!have_timer_)
+        {
+            have_timer_ = session->coarseTimerMaker().create([this]() { flush_haves(); });
+        }
+
+        have_timer_->start_single_shot(MaxHaveDelay);
+    }
+}
+
+size_t tr_peerMsgsImpl::flush_haves()
+{
+    using namespace protocol_send_message_helpers;
+
+    if (std::empty(pending_haves_))
+    {
+        return {};
+    }
+
+    have_timer_->stop();
+
+    auto out = MessageBuffer{};
+    for (auto const piece : pending_haves_)
+    {
+        static_assert(sizeof(tr_piece_index_t) == sizeof(uint32_t));
+        logtrace(this, build_log_message(BtPeerMsgs::Have, piece));
+        build_peer_message(out, BtPeerMsgs::Have, piece);
+    }
+    pending_haves_.clear();
+
+    auto const n_bytes_added = std::size(out);
+    io_->write(out, false);
+    return n_bytes_added;
+}
+
 size_t tr_peerMsgsImpl::protocol_send_keepalive() const
 {
     logtrace(this, "sending 'keepalive'");
@@ -982,98 +1259,14 @@ void tr_peerMsgsImpl::send_ut_pex()
         return;
     }
 
-    static auto constexpr MaxPexAdded = size_t{ 50U };
-    static auto constexpr MaxPexDropped = size_t{ 50U };
-
-    auto map = tr_variant::Map{ 4U };
-    auto tmpbuf = small::vector<std::byte, std::max(MaxPexAdded, MaxPexDropped) * tr_socket_address::CompactSockAddrMaxBytes>{};
-    for (uint8_t i = 0; i < NUM_TR_AF_INET_TYPES; ++i)
-    {
-        static auto constexpr AddedMap = std::array{ TR_KEY_added, TR_KEY_added6 };
-        static auto constexpr AddedFMap = std::array{ TR_KEY_added_f, TR_KEY_added6_f };
-        static auto constexpr DroppedMap = std::array{ TR_KEY_dropped, TR_KEY_dropped6 };
-        auto const ip_type = static_cast<tr_address_type>(i);
-
-        auto& old_pex = pex_[i];
-        auto new_pex = tr_peerMgrGetPeers(&tor_, ip_type, TR_PEERS_CONNECTED, MaxPexPeerCount);
-        auto added = std::vector<tr_pex>{};
-        added.reserve(std::size(new_pex));
-        std::set_difference(
-            std::begin(new_pex),
-            std::end(new_pex),
-            std::begin(old_pex),
-            std::end(old_pex),
-            std::back_inserter(added));
-        auto dropped = std::vector<tr_pex>{};
-        dropped.reserve(std::size(old_pex));
-        std::set_difference(
-            std::begin(old_pex),
-            std::end(old_pex),
-            std::begin(new_pex),
-            std::end(new_pex),
-            std::back_inserter(dropped));
-
-        // Some peers give us error messages if we send
-        // more than this many peers in a single pex message.
-        // https://wiki.theory.org/BitTorrentPeerExchangeConventions
-        added.resize(std::min(std::size(added), MaxPexAdded));
-        dropped.resize(std::min(std::size(dropped), MaxPexDropped));
-
-        logtrace(
-            this,
-            fmt::format(
-                "pex: old {:s} peer count {:d}, new peer count {:d}, added {:d}, dropped {:d}",
-                tr_ip_protocol_to_sv(ip_type),
-                std::size(old_pex),
-                std::size(new_pex),
-                std::size(added),
-                std::size(dropped)));
-
-        // if there's nothing to send, then we're done
-        if (std::empty(added) && std::empty(dropped))
-        {
-            continue;
-        }
-
-        // update msgs
-        std::swap(old_pex, new_pex);
-
-        // build the pex payload
-        if (!std::empty(added))
-        {
-            // "added"
-            tmpbuf.clear();
-            tmpbuf.reserve(std::size(added) * tr_socket_address::CompactSockAddrBytes[i]);
-            tr_pex::to_compact(std::back_inserter(tmpbuf), std::data(added), std::size(added));
-            TR_ASSERT(std::size(tmpbuf) == std::size(added) * tr_socket_address::CompactSockAddrBytes[i]);
-            map.try_emplace(AddedMap[i], std::string_view{ reinterpret_cast<char*>(std::data(tmpbuf)), std::size(tmpbuf) });
-
-            // "added.f"
-            tmpbuf.resize(std::size(added));
-            auto* begin = std::data(tmpbuf);
-            auto* walk = begin;
-            for (auto const& p : added)
-            {
-                *walk++ = std::byte{ p.flags };
-            }
-
-            auto const f_len = static_cast<size_t>(walk - begin);
-            TR_ASSERT(f_len == std::size(added));
-            map.try_emplace(AddedFMap[i], std::string_view{ reinterpret_cast<char*>(begin), f_len });
-        }
-
-        if (!std::empty(dropped))
-        {
-            // "dropped"
-            tmpbuf.clear();
-            tmpbuf.reserve(std::size(dropped) * tr_socket_address::CompactSockAddrBytes[i]);
-            tr_pex::to_compact(std::back_inserter(tmpbuf), std::data(dropped), std::size(dropped));
-            TR_ASSERT(std::size(tmpbuf) == std::size(dropped) * tr_socket_address::CompactSockAddrBytes[i]);
-            map.try_emplace(DroppedMap[i], std::string_view{ reinterpret_cast<char*>(std::data(tmpbuf)), std::size(tmpbuf) });
-        }
-    }
+    // the swarm builds the connected-peer list and the message once for
+    // all of its peers; we only need to remember what we've sent so far
+    auto version = uint32_t{};
+    auto payload = tr_peerMgrGetPexMessage(&tor_, pex_version_, &version);
+    logtrace(this, fmt::format("pex: sending changes from version {:d} to {:d}", pex_version_, version));
+    pex_version_ = version;
 
-    protocol_send_message(BtPeerMsgs::Ltep, ut_pex_id_, tr_variant_serde::benc().to_string(tr_variant{ std::move(map) }));
+    protocol_send_message(BtPeerMsgs::Ltep, ut_pex_id_, payload);
 }
 
 void tr_peerMsgsImpl::send_ltep_handshake()
@@ -1133,7 +1326,7 @@ void tr_peerMsgsImpl::send_ltep_handshake()
     // An integer, the number of outstanding request messages this
     // client supports without dropping any. The default in in
     // libtorrent is 250.
-    tr_variantDictAddInt(&val, TR_KEY_reqq, ReqQ);
+    tr_variantDictAddInt(&val, TR_KEY_reqq, static_cast<int64_t>(max_peer_requests()));
 
     // https://www.bittorrent.org/beps/bep_0010.html
     // A string containing the compact representation of the ip address this peer sees
@@ -1270,20 +1463,46 @@ void tr_peerMsgsImpl::parse_ltep_handshake(MessageReader& payload)
         logtrace(this, fmt::format("peer's port is now {:d}", p));
     }
 
+    // If the peer tells us its address in the other address family,
+    // remember it so that we can race connections to both next time.
+    auto const maybe_set_alt_address = [this, &pex]()
+    {
+        auto alt = pex.socket_address;
+        if (std::empty(alt.port()))
+        {
+            alt = { alt.address(), peer_info->listen_port() };
+        }
+
+        if (alt.address().type != io_->socket_address().address().type && alt.is_valid_for_peers(TR_PEER_FROM_LTEP))
+        {
+            peer_info->set_alt_socket_address(alt);
+        }
+    };
+
     std::byte const* addr_compact = nullptr;
     auto addr_len = size_t{};
-    if (io_->is_incoming() && tr_variantDictFindRaw(&*var, TR_KEY_ipv4, &addr_compact, &addr_len) &&
+    if (tr_variantDictFindRaw(&*var, TR_KEY_ipv4, &addr_compact, &addr_len) &&
         addr_len == tr_address::CompactAddrBytes[TR_AF_INET])
     {
         std::tie(addr, std::ignore) = tr_address::from_compact_ipv4(addr_compact);
-        tr_peerMgrAddPex(&tor_, TR_PEER_FROM_LTEP, &pex, 1);
+        maybe_set_alt_address();
+
+        if (io_->is_incoming())
+        {
+            tr_peerMgrAddPex(&tor_, TR_PEER_FROM_LTEP, &pex, 1);
+        }
     }
 
-    if (io_->is_incoming() && tr_variantDictFindRaw(&*var, TR_KEY_ipv6, &addr_compact, &addr_len) &&
+    if (tr_variantDictFindRaw(&*var, TR_KEY_ipv6, &addr_compact, &addr_len) &&
         addr_len == tr_address::CompactAddrBytes[TR_AF_INET6])
     {
         std::tie(addr, std::ignore) = tr_address::from_compact_ipv6(addr_compact);
-        tr_peerMgrAddPex(&tor_, TR_PEER_FROM_LTEP, &pex, 1);
+        maybe_set_alt_address();
+
+        if (io_->is_incoming())
+        {
+            tr_peerMgrAddPex(&tor_, TR_PEER_FROM_LTEP, &pex, 1);
+        }
     }
 
     /* get peer's maximum request queue size */
@@ -1327,7 +1546,7 @@ void tr_peerMsgsImpl::parse_ut_metadata(MessageReader& payload_in)
     {
         if (piece >= 0 && tor_.has_metainfo() && tor_.is_public() && std::size(peer_requested_metadata_pieces_) < MetadataReqQ)
         {
-            peer_requested_metadata_pieces_.push(piece);
+            peer_requested_metadata_pieces_.emplace_back(piece);
         }
         else
         {
@@ -1343,7 +1562,7 @@ void tr_peerMsgsImpl::parse_ut_metadata(MessageReader& payload_in)
 
 // ---
 
-ReadResult tr_peerMsgsImpl::process_peer_message(uint8_t id, MessageReader& payload)
+ReadState tr_peerMsgsImpl::process_peer_message(uint8_t id, MessageReader& payload)
 {
     bool const fext = io_->supports_fext();
 
@@ -1367,7 +1586,7 @@ ReadResult tr_peerMsgsImpl::process_peer_message(uint8_t id, MessageReader& payl
                 static_cast<int>(id),
                 std::size(payload)));
         publish(tr_peer_event::GotError(EMSGSIZE));
-        return { READ_ERR, {} };
+        return READ_ERR;
     }
 
     switch (id)
@@ -1375,6 +1594,7 @@ ReadResult tr_peerMsgsImpl::process_peer_message(uint8_t id, MessageReader& payl
     case BtPeerMsgs::Choke:
         logtrace(this, "got Choke");
         set_client_choked(true);
+        request_pipeline_.on_requests_cleared();
 
         if (!fext)
         {
@@ -1410,7 +1630,7 @@ ReadResult tr_peerMsgsImpl::process_peer_message(uint8_t id, MessageReader& payl
         if (tor_.has_metainfo() && ui32 >= tor_.piece_count())
         {
             publish(tr_peer_event::GotError(ERANGE));
-            return { READ_ERR, {} };
+            return READ_ERR;
         }
 
         /* a peer can send the same HAVE message twice... */
@@ -1424,6 +1644,16 @@ ReadResult tr_peerMsgsImpl::process_peer_message(uint8_t id, MessageReader& payl
 
     case BtPeerMsgs::Bitfield:
         logtrace(this, "got a bitfield");
+
+        // BEP 3 only allows the bitfield as the first message, and the
+        // swarm's piece availability counts rely on that, so don't let
+        // a misbehaving peer replace the pieces it's already told us about
+        if (!have_.has_none())
+        {
+            logtrace(this, "ignoring a bitfield that came after other have messages");
+            break;
+        }
+
         have_ = tr_bitfield{ tor_.has_metainfo() ? tor_.piece_count() : std::size(payload) * 8 };
         have_.set_raw(reinterpret_cast<uint8_t const*>(std::data(payload)), std::size(payload));
         publish(tr_peer_event::GotBitfield(&have_));
@@ -1466,7 +1696,10 @@ ReadResult tr_peerMsgsImpl::process_peer_message(uint8_t id, MessageReader& payl
         }
 
     case BtPeerMsgs::Piece:
-        return read_piece_data(payload);
+        // the decoder streams block data to on_piece_begin() and
+        // on_piece_end(), so this is only reached by a piece message
+        // that's too short to hold its own header
+        return READ_ERR;
 
     case BtPeerMsgs::DhtPort:
         // https://www.bittorrent.org/beps/bep_0005.html
@@ -1498,7 +1731,7 @@ ReadResult tr_peerMsgsImpl::process_peer_message(uint8_t id, MessageReader& payl
         else
         {
             publish(tr_peer_event::GotError(EMSGSIZE));
-            return { READ_ERR, {} };
+            return READ_ERR;
         }
 
         break;
@@ -1514,7 +1747,7 @@ ReadResult tr_peerMsgsImpl::process_peer_message(uint8_t id, MessageReader& payl
         else
         {
             publish(tr_peer_event::GotError(EMSGSIZE));
-            return { READ_ERR, {} };
+            return READ_ERR;
         }
 
         break;
@@ -1524,13 +1757,20 @@ ReadResult tr_peerMsgsImpl::process_peer_message(uint8_t id, MessageReader& payl
 
         if (fext)
         {
+            // see the note in BtPeerMsgs::Bitfield
+            if (!have_.has_none())
+            {
+                logtrace(this, "ignoring a have-all that came after other have messages");
+                break;
+            }
+
             have_.set_has_all();
             publish(tr_peer_event::GotHaveAll());
         }
         else
         {
             publish(tr_peer_event::GotError(EMSGSIZE));
-            return { READ_ERR, {} };
+            return READ_ERR;
         }
 
         break;
@@ -1540,13 +1780,20 @@ ReadResult tr_peerMsgsImpl::process_peer_message(uint8_t id, MessageReader& payl
 
         if (fext)
         {
+            // see the note in BtPeerMsgs::Bitfield
+            if (!have_.has_none())
+            {
+                logtrace(this, "ignoring a have-none that came after other have messages");
+                break;
+            }
+
             have_.set_has_none();
             publish(tr_peer_event::GotHaveNone());
         }
         else
         {
             publish(tr_peer_event::GotError(EMSGSIZE));
-            return { READ_ERR, {} };
+            return READ_ERR;
         }
 
         break;
@@ -1560,12 +1807,14 @@ ReadResult tr_peerMsgsImpl::process_peer_message(uint8_t id, MessageReader& payl
 
             if (fext)
             {
-                publish(tr_peer_event::GotRejected(tor_.block_info(), tor_.piece_loc(r.index, r.offset).block));
+                auto const block = tor_.piece_loc(r.index, r.offset).block;
+                request_pipeline_.on_request_dropped(block);
+                publish(tr_peer_event::GotRejected(tor_.block_info(), block));
             }
             else
             {
                 publish(tr_peer_event::GotError(EMSGSIZE));
-                return { READ_ERR, {} };
+                return READ_ERR;
             }
 
             break;
@@ -1581,62 +1830,106 @@ ReadResult tr_peerMsgsImpl::process_peer_message(uint8_t id, MessageReader& payl
         break;
     }
 
-    return { READ_NOW, {} };
+    return READ_NOW;
 }
 
-ReadResult tr_peerMsgsImpl::read_piece_data(MessageReader& payload)
+ReadState tr_peerMsgsImpl::on_piece_begin(uint32_t const piece, uint32_t const offset, uint32_t const len, uint8_t** setme_dst)
 {
+    static_assert(tr_peer_msgs_decoder::PieceMessageId == BtPeerMsgs::Piece);
+
     // <index><begin><block>
-    auto const piece = payload.to_uint32();
-    auto const offset = payload.to_uint32();
-    auto const len = std::size(payload);
+    logtrace(this, fmt::format("got {:d} bytes for req {:d}:{:d}->{:d}", len, piece, offset, len));
+
+    if (len > tr_block_info::BlockSize)
+    {
+        logdbg(this, fmt::format("bad msg: piece {:d}:{:d} with payload len {:d}", piece, offset, len));
+        publish(tr_peer_event::GotError(EMSGSIZE));
+        return READ_ERR;
+    }
 
     auto const loc = tor_.piece_loc(piece, offset);
     auto const block = loc.block;
     auto const block_size = tor_.block_size(block);
 
-    logtrace(this, fmt::format("got {:d} bytes for req {:d}:{:d}->{:d}", len, piece, offset, len));
-
     if (loc.block_offset + len > block_size)
     {
         logwarn(this, fmt::format("got unaligned piece {:d}:{:d}->{:d}", piece, offset, len));
-        return { READ_ERR, len };
+        return READ_ERR;
     }
 
+    auto& current = incoming_.piece;
+    current = {};
+    current.len = len;
+
     if (!tr_peerMgrDidPeerRequest(&tor_, this, block))
     {
-        logwarn(this, fmt::format("got unrequested piece {:d}:{:d}->{:d}", piece, offset, len));
-        return { READ_ERR, len };
+        // usually a block that we cancelled because another peer sent it first
+        logdbg(this, fmt::format("got unrequested piece {:d}:{:d}->{:d}", piece, offset, len));
+
+        auto const now = tr_time();
+        unrequested_blocks_from_peer_.add(now, 1);
+        auto const n_allowed = size_t{ cancels_sent_to_peer.count(now, UnrequestedBlockWindowSec) } + UnrequestedBlockSlack;
+        if (size_t{ unrequested_blocks_from_peer_.count(now, UnrequestedBlockWindowSec) } > n_allowed)
+        {
+            logdbg(this, "peer keeps sending blocks that we didn't ask for");
+            publish(tr_peer_event::GotError(ERANGE));
+            return READ_ERR;
+        }
+
+        *setme_dst = nullptr;
+        return READ_NOW;
     }
 
-    publish(tr_peer_event::GotPieceData(len));
+    current.block = block;
 
     if (loc.block_offset == 0U && len == block_size) // simple case: one message has entire block
     {
-        auto buf = std::make_unique<Cache::BlockData>(block_size);
-        payload.to_buf(std::data(*buf), len);
-        auto const ok = client_got_block(std::move(buf), block) == 0;
-        return { ok ? READ_NOW : READ_ERR, len };
+        current.whole_block = std::make_unique<Cache::BlockData>(block_size);
+        *setme_dst = std::data(*current.whole_block);
+        return READ_NOW;
     }
 
-    auto& blocks = incoming_.blocks;
-    auto& incoming_block = blocks.try_emplace(block, block_size).first->second;
-    payload.to_buf(std::data(*incoming_block.buf) + loc.block_offset, len);
-
+    auto& incoming_block = incoming_.blocks.try_emplace(block, block_size).first->second;
     if (!incoming_block.add_span(loc.block_offset, loc.block_offset + len))
     {
-        return { READ_ERR, len }; // invalid span
+        return READ_ERR; // invalid span
     }
 
-    if (!incoming_block.has_all())
+    *setme_dst = std::data(*incoming_block.buf) + loc.block_offset;
+    return READ_NOW;
+}
+
+ReadState tr_peerMsgsImpl::on_piece_end()
+{
+    auto current = std::move(incoming_.piece);
+    incoming_.piece = {};
+
+    if (!current.block)
     {
-        return { READ_LATER, len }; // we don't have the full block yet
+        publish(tr_peer_event::GotWastedData(current.len));
+        return READ_NOW;
     }
 
-    auto block_buf = std::move(incoming_block.buf);
-    blocks.erase(block); // note: invalidates `incoming_block` local
-    auto const ok = client_got_block(std::move(block_buf), block) == 0;
-    return { ok ? READ_NOW : READ_ERR, len };
+    publish(tr_peer_event::GotPieceData(current.len));
+
+    auto const block = *current.block;
+    auto block_buf = std::move(current.whole_block);
+    auto& blocks = incoming_.blocks;
+
+    if (!block_buf)
+    {
+        auto const iter = blocks.find(block);
+        TR_ASSERT(iter != std::end(blocks));
+        if (iter == std::end(blocks) || !iter->second.has_all())
+        {
+            return READ_NOW; // we don't have the full block yet
+        }
+
+        block_buf = std::move(iter->second.buf);
+    }
+
+    blocks.erase(block);
+    return client_got_block(std::move(block_buf), block) == 0 ? READ_NOW : READ_ERR;
 }
 
 // returns 0 on success, or an errno on failure
@@ -1660,14 +1953,24 @@ int tr_peerMsgsImpl::client_got_block(std::unique_ptr<Cache::BlockData> block_da
 
     if (!tr_peerMgrDidPeerRequest(&tor_, this, block))
     {
+        // we cancelled the request while the block was still arriving
         logdbg(this, "we didn't ask for this message...");
+        publish(tr_peer_event::GotWastedData(n_expected));
         return 0;
     }
 
+    request_pipeline_.on_block_received(block, tr_time_msec());
+    if (request_pipeline_.is_slow_start())
+    {
+        // ramp up now instead of waiting for the next pulse
+        update_desired_request_count();
+    }
+
     auto const loc = tor_.block_loc(block);
     if (tor_.has_piece(loc.piece))
     {
         logtrace(this, "we did ask for this message, but the piece is already complete...");
+        publish(tr_peer_event::GotWastedData(n_expected));
         return 0;
     }
 
@@ -1698,85 +2001,31 @@ void tr_peerMsgsImpl::did_write(tr_peerIo* /*io*/, size_t bytes_written, bool wa
     msgs->pulse();
 }
 
-ReadState tr_peerMsgsImpl::can_read(tr_peerIo* io, void* vmsgs, size_t* piece)
+ReadState tr_peerMsgsImpl::can_read(tr_peerIo* io, void* vmsgs, size_t max_bytes, size_t* piece)
 {
     auto* const msgs = static_cast<tr_peerMsgsImpl*>(vmsgs);
 
-    // https://www.bittorrent.org/beps/bep_0003.html
-    // Next comes an alternating stream of length prefixes and messages.
-    // Messages of length zero are keepalives, and ignored.
-    // All non-keepalive messages start with a single byte which gives their type.
-    //
-    // https://wiki.theory.org/BitTorrentSpecification
-    // All of the remaining messages in the protocol take the form of
-    // <length prefix><message ID><payload>. The length prefix is a four byte
-    // big-endian value. The message ID is a single decimal byte.
-    // The payload is message dependent.
+    // Decode as many messages as the budget allows in one pass,
+    // rather than returning to tr_peerIo after each one.
+    auto const n_start = io->read_buffer_size();
+    auto n_piece = size_t{};
+    auto read_state = READ_NOW;
 
-    // read <length prefix>
-    auto& current_message_len = msgs->incoming_.length; // the full message payload length. Includes the +1 for id length
-    if (!current_message_len)
+    while (read_state == READ_NOW && io->read_buffer_size() != 0U && n_start - io->read_buffer_size() < max_bytes)
     {
-        auto message_len = uint32_t{};
-        if (io->read_buffer_size() < sizeof(message_len))
-        {
-            return READ_LATER;
-        }
-
-        io->read_uint32(&message_len);
+        auto const [state, n_piece_bytes_read] = msgs->decoder_.read_one(*io);
+        read_state = state;
+        n_piece += n_piece_bytes_read;
 
-        // The keep-alive message is a message with zero bytes,
-        // specified with the length prefix set to zero.
-        // There is no message ID and no payload.
-        if (message_len == 0U)
+        // Handing a block to the cache can stop the torrent, which destroys
+        // `msgs` and clears the io's callbacks. If so, stop here.
+        if (!io->has_callbacks())
         {
-            logtrace(msgs, "got KeepAlive");
-            return READ_NOW;
+            read_state = READ_ERR;
         }
-
-        current_message_len = message_len;
-    }
-
-    // read <message ID>
-    auto& current_message_type = msgs->incoming_.id;
-    if (!current_message_type)
-    {
-        auto message_type = uint8_t{};
-        if (io->read_buffer_size() < sizeof(message_type))
-        {
-            return READ_LATER;
-        }
-
-        io->read_uint8(&message_type);
-        current_message_type = message_type;
     }
 
-    // read <payload>
-    auto& current_payload = msgs->incoming_.payload;
-    auto const full_payload_len = *current_message_len - sizeof(*current_message_type);
-    auto n_left = full_payload_len - std::size(current_payload);
-    auto const [buf, n_this_pass] = current_payload.reserve_space(std::min(n_left, io->read_buffer_size()));
-    io->read_bytes(buf, n_this_pass);
-    current_payload.commit_space(n_this_pass);
-    n_left -= n_this_pass;
-    logtrace(msgs, fmt::format("read {:d} payload bytes; {:d} left to go", n_this_pass, n_left));
-
-    if (n_left > 0U)
-    {
-        return READ_LATER;
-    }
-
-    // The incoming message is now complete. After processing the message
-    // with `process_peer_message()`, reset the peerMsgs' incoming
-    // field so it's ready to receive the next message.
-
-    auto const [read_state, n_piece_bytes_read] = msgs->process_peer_message(*current_message_type, current_payload);
-    *piece = n_piece_bytes_read;
-
-    current_message_len.reset();
-    current_message_type.reset();
-    current_payload.clear();
-
+    *piece = n_piece;
     return read_state;
 }
 
@@ -1792,6 +2041,7 @@ void tr_peerMsgsImpl::pulse()
     auto const now_sec = tr_time();
     auto const now_msec = tr_time_msec();
 
+    io_->tune_buffers(now_msec);
     update_desired_request_count();
     update_block_requests();
     update_metadata_requests(now_sec);
@@ -1847,7 +2097,7 @@ void tr_peerMsgsImpl::update_block_requests()
 
 [[nodiscard]] size_t tr_peerMsgsImpl::fill_output_buffer(time_t now_sec, uint64_t now_msec)
 {
-    auto n_bytes_written = size_t{};
+    auto n_bytes_written = flush_haves();
 
     // fulfill metadata requests
     for (;;)
@@ -1918,7 +2168,6 @@ void tr_peerMsgsImpl::update_block_requests()
     auto const req = peer_requested_.front();
     peer_requested_.pop_front();
 
-    auto buf = std::array<uint8_t, tr_block_info::BlockSize>{};
     auto ok = is_valid_request(req) && tor_.has_piece(req.index);
 
     if (ok)
@@ -1933,14 +2182,12 @@ void tr_peerMsgsImpl::update_block_requests()
 
     if (ok)
     {
-        ok = session->cache->read_block(tor_, tor_.piece_loc(req.index, req.offset), req.length, std::data(buf)) == 0;
-    }
-
-    if (ok)
-    {
-        blocks_sent_to_peer.add(now_sec, 1);
-        auto const piece_data = std::string_view{ reinterpret_cast<char const*>(std::data(buf)), req.length };
-        return protocol_send_message(BtPeerMsgs::Piece, req.index, req.offset, piece_data);
+        if (auto const n_bytes = protocol_send_piece(req); n_bytes != 0U)
+        {
+            blocks_sent_to_peer.add(now_sec, 1);
+            publish(tr_peer_event::SentBlock(req.index, req.length));
+            return n_bytes;
+        }
     }
 
     if (io_->supports_fext())
@@ -1994,7 +2241,7 @@ bool tr_peerMsgsImpl::is_valid_request(peer_request const& req) const
         return false;
     }
 
-    if (std::size(peer_requested_) >= ReqQ)
+    if (std::size(peer_requested_) >= max_peer_requests())
     {
         logtrace(this, "rejecting request ... reqq is full");
         return false;
@@ -2015,7 +2262,7 @@ bool tr_peerMsgsImpl::is_valid_request(peer_request const& req) const
     return true;
 }
 
-size_t tr_peerMsgsImpl::max_available_reqs() const
+size_t tr_peerMsgsImpl::max_available_reqs()
 {
     if (tor_.is_done() || !tor_.has_metainfo() || client_is_choked() || !client_is_interested())
     {
@@ -2026,13 +2273,14 @@ size_t tr_peerMsgsImpl::max_available_reqs() const
     // TODO: this needs to consider all the other peers as well...
     uint64_t const now = tr_time_msec();
     auto rate = get_piece_speed(now, TR_PEER_TO_CLIENT);
-    if (tor_.uses_speed_limit(TR_PEER_TO_CLIENT))
+    auto const is_unlimited = io_->is_lan() && session->lan_peers_unlimited();
+    if (tor_.uses_speed_limit(TR_PEER_TO_CLIENT) && !is_unlimited)
     {
         rate = std::min(rate, tor_.speed_limit(TR_PEER_TO_CLIENT));
     }
 
     // honor the session limits, if enabled
-    if (tor_.uses_session_limits())
+    if (tor_.uses_session_limits() && !is_unlimited)
     {
         if (auto const limit = session->active_speed_limit(TR_PEER_TO_CLIENT))
         {
@@ -2040,14 +2288,11 @@ size_t tr_peerMsgsImpl::max_available_reqs() const
         }
     }
 
-    // use this desired rate to figure out how
-    // many requests we should send to this peer
-    static auto constexpr Floor = size_t{ 32 };
-    static size_t constexpr Seconds = RequestBufSecs;
-    size_t const estimated_blocks_in_period = (rate.base_quantity() * Seconds) / tr_block_info::BlockSize;
-    auto const ceil = reqq_.value_or(250);
-
-    return std::clamp(estimated_blocks_in_period, Floor, ceil);
+    // use this desired rate and the peer's round-trip time
+    // to figure out how many requests we should send to this peer.
+    // LAN peers get a deeper queue only if they say they can take it.
+    auto const ceil = reqq_.value_or(DefaultPeerReqQ);
+    return request_pipeline_.update(rate.base_quantity(), ceil, now);
 }
 
 } // namespace
@@ -9,13 +9,16 @@
 #error only libtransmission should #include this header.
 #endif
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <cstddef> // for size_t
+#include <cstdint> // for uint32_t, uint64_t
 #include <memory>
 
 #include "libtransmission/transmission.h" // for tr_direction, tr_block_ind...
 
+#include "libtransmission/block-info.h"
 #include "libtransmission/interned-string.h"
 #include "libtransmission/net.h" // tr_socket_address
 #include "libtransmission/peer-common.h" // for tr_peer
@@ -23,6 +26,8 @@
 class tr_peerIo;
 class tr_peerMsgs;
 class tr_peer_info;
+struct tr_peer_io_buffers;
+struct tr_peer_memory_usage;
 struct tr_torrent;
 
 /**
@@ -32,6 +37,160 @@ struct tr_torrent;
 
 using tr_peer_callback_bt = void (*)(tr_peerMsgs* peer, tr_peer_event const& event, void* client_data);
 
+/**
+ * Picks how many block requests to keep outstanding to a peer.
+ *
+ * It starts out like TCP slow start: every block received raises the
+ * depth by one, so it doubles once per round trip. Slow start ends when
+ * the request -> piece round trip climbs well above the lowest one seen,
+ * which means that our requests have started queueing at the peer.
+ * After that, a peer gets `MaxQueueSecs` worth of blocks at its measured
+ * speed, which also keeps a slow peer from sitting on blocks we need.
+ * Only while the smoothed round trip shows that our requests are still
+ * queueing at the peer does the depth drop towards two bandwidth-delay
+ * products. It never drops below `FloorDepth`.
+ */
+class tr_request_pipeline
+{
+public:
+    static constexpr auto MinDepth = size_t{ 2U };
+    static constexpr auto FloorDepth = size_t{ 32U };
+    static constexpr auto InitialDepth = FloorDepth;
+    static constexpr auto MaxQueueSecs = uint64_t{ 10U };
+    static constexpr auto DefaultRttMsec = uint32_t{ 100U };
+    static constexpr auto SlowStartSlackMsec = uint32_t{ 25U };
+    static constexpr auto MaxProbeAgeMsec = uint64_t{ 60000U };
+
+    // a request for `block` was just sent to the peer
+    void on_request_sent(tr_block_index_t block, uint64_t now_msec) noexcept
+    {
+        // time one request at a time, like TCP does without timestamps
+        if (probe_sent_at_ == 0U)
+        {
+            probe_block_ = block;
+            probe_sent_at_ = now_msec;
+        }
+    }
+
+    // a block that we requested from the peer just arrived
+    void on_block_received(tr_block_index_t block, uint64_t now_msec) noexcept
+    {
+        if (slow_start_ && depth_ < ceil_)
+        {
+            ++depth_;
+        }
+
+        if (probe_sent_at_ != 0U && probe_block_ == block)
+        {
+            add_rtt_sample(static_cast<uint32_t>(std::clamp(now_msec - probe_sent_at_, uint64_t{ 1U }, MaxProbeAgeMsec)));
+            probe_sent_at_ = 0U;
+        }
+    }
+
+    // the request for `block` was cancelled or rejected
+    void on_request_dropped(tr_block_index_t block) noexcept
+    {
+        if (probe_block_ == block)
+        {
+            probe_sent_at_ = 0U;
+        }
+    }
+
+    // the peer choked us, so all of our requests are gone
+    void on_requests_cleared() noexcept
+    {
+        probe_sent_at_ = 0U;
+    }
+
+    // Recalculate the depth for a peer that sends us `bytes_per_second`,
+    // never exceeding `ceil` (the peer's reqq or our own limit).
+    size_t update(uint64_t bytes_per_second, size_t ceil, uint64_t now_msec) noexcept
+    {
+        ceil_ = std::max(ceil, MinDepth);
+
+        if (probe_sent_at_ != 0U && now_msec - probe_sent_at_ > MaxProbeAgeMsec)
+        {
+            probe_sent_at_ = 0U;
+        }
+
+        if (slow_start_)
+        {
+            depth_ = std::min(depth_, ceil_);
+            slow_start_ = depth_ < ceil_;
+            return depth_;
+        }
+
+        auto const rtt_msec = min_rtt_msec_ != 0U ? min_rtt_msec_ : DefaultRttMsec;
+        auto const bdp_blocks = bytes_per_second * rtt_msec / 1000U / tr_block_info::BlockSize;
+        auto const target = static_cast<size_t>(bdp_blocks * 2U) + MinDepth;
+        auto const max_queued = static_cast<size_t>(bytes_per_second * MaxQueueSecs / tr_block_info::BlockSize);
+
+        // Don't let a brief stall, or a peer that just unchoked us and
+        // hasn't sent anything yet, shrink the pipeline so far that its
+        // speed can only recover a couple of requests at a time.
+        auto const floor = std::min(FloorDepth, ceil_);
+        auto const cap = std::clamp(max_queued, floor, ceil_);
+        depth_ = is_queueing() ? std::clamp(target, floor, cap) : cap;
+        return depth_;
+    }
+
+    [[nodiscard]] constexpr auto depth() const noexcept
+    {
+        return depth_;
+    }
+
+    [[nodiscard]] constexpr auto is_slow_start() const noexcept
+    {
+        return slow_start_;
+    }
+
+    // smoothed request -> piece round trip, or zero if there are no samples yet
+    [[nodiscard]] constexpr auto rtt_msec() const noexcept
+    {
+        return srtt_msec_;
+    }
+
+    [[nodiscard]] constexpr auto min_rtt_msec() const noexcept
+    {
+        return min_rtt_msec_;
+    }
+
+    // true if the round trip has climbed enough to show that our
+    // requests are waiting in a queue at the peer
+    [[nodiscard]] constexpr bool is_queueing() const noexcept
+    {
+        return min_rtt_msec_ != 0U && is_inflated(srtt_msec_);
+    }
+
+private:
+    void add_rtt_sample(uint32_t rtt_msec) noexcept
+    {
+        srtt_msec_ = srtt_msec_ == 0U ? rtt_msec : (srtt_msec_ * 7U + rtt_msec) / 8U;
+        min_rtt_msec_ = min_rtt_msec_ == 0U ? rtt_msec : std::min(min_rtt_msec_, rtt_msec);
+
+        if (slow_start_ && is_inflated(rtt_msec))
+        {
+            slow_start_ = false;
+        }
+    }
+
+    [[nodiscard]] constexpr bool is_inflated(uint32_t rtt_msec) const noexcept
+    {
+        return rtt_msec > min_rtt_msec_ * 2U + SlowStartSlackMsec;
+    }
+
+    size_t depth_ = InitialDepth;
+    size_t ceil_ = InitialDepth;
+
+    uint64_t probe_sent_at_ = 0U;
+    tr_block_index_t probe_block_ = {};
+
+    uint32_t srtt_msec_ = 0U;
+    uint32_t min_rtt_msec_ = 0U;
+
+    bool slow_start_ = true;
+};
+
 class tr_peerMsgs : public tr_peer
 {
 public:
@@ -97,6 +256,14 @@ public:
 
     [[nodiscard]] virtual tr_socket_address socket_address() const = 0;
 
+    [[nodiscard]] virtual bool is_lan() const noexcept = 0;
+
+    [[nodiscard]] virtual tr_peer_io_buffers io_buffers() const = 0;
+
+    [[nodiscard]] virtual tr_peer_memory_usage memory_usage() const = 0;
+
+    [[nodiscard]] virtual tr_request_pipeline const& request_pipeline() const noexcept = 0;
+
     virtual void set_choke(bool peer_is_choked) = 0;
     virtual void set_interested(bool client_is_interested) = 0;
 
@@ -106,6 +273,17 @@ public:
 
     virtual void on_piece_completed(tr_piece_index_t) = 0;
 
+    // Whether we hid our bitfield from this peer to super-seed it (BEP 16).
+    // Decided when the connection is made, so it's only true if the
+    // torrent was super-seeding a complete torrent at that time.
+    [[nodiscard]] virtual bool is_super_seeding() const noexcept = 0;
+
+    // tell a super-seeded peer that we have `piece`
+    virtual void super_seed_offer(tr_piece_index_t piece) = 0;
+
+    // stop super-seeding this peer and tell it about all our pieces
+    virtual void stop_super_seeding() = 0;
+
     static tr_peerMsgs* create(
         tr_torrent& torrent,
         std::shared_ptr<tr_peer_info> peer_info,
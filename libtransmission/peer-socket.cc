@@ -4,11 +4,27 @@
 // License text can be found in the licenses/ folder.
 
 #include <algorithm> // std::min
+#include <array>
 #include <cerrno>
 #include <cstddef> // std::byte
+#include <optional>
+#include <utility> // std::make_pair, std::pair
 
 #include <fmt/core.h>
 
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <netinet/in.h> // IPPROTO_TCP
+#include <netinet/tcp.h> // TCP_INFO, TCP_NOTSENT_LOWAT
+#include <sys/socket.h> // getsockopt(), sendmsg(), setsockopt()
+#include <sys/uio.h> // iovec
+#endif
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
 #include <libutp/utp.h>
 
 #include "libtransmission/error.h"
@@ -73,7 +89,7 @@ void tr_peer_socket::close()
     handle = {};
 }
 
-size_t tr_peer_socket::try_write(OutBuf& buf, size_t max, tr_error* error) const
+size_t tr_peer_socket::try_write(OutBuf& buf, size_t max, tr_error* error, bool more) const
 {
     if (max == size_t{})
     {
@@ -82,7 +98,7 @@ size_t tr_peer_socket::try_write(OutBuf& buf, size_t max, tr_error* error) const
 
     if (is_tcp())
     {
-        return buf.to_socket(handle.tcp, max, error);
+        return buf.to_socket(handle.tcp, max, error, more);
     }
 
 #ifdef WITH_UTP
@@ -110,6 +126,139 @@ size_t tr_peer_socket::try_write(OutBuf& buf, size_t max, tr_error* error) const
     return {};
 }
 
+size_t tr_peer_socket::try_writev(ConstSpan const* spans, size_t n_spans, tr_error* error, [[maybe_unused]] bool more) const
+{
+    n_spans = std::min(n_spans, MaxWritevSpans);
+
+    if (n_spans == 0U)
+    {
+        return {};
+    }
+
+    if (is_tcp())
+    {
+#ifdef _WIN32
+        auto bufs = std::array<WSABUF, MaxWritevSpans>{};
+        for (size_t i = 0; i < n_spans; ++i)
+        {
+            bufs[i].buf = reinterpret_cast<CHAR*>(const_cast<std::byte*>(spans[i].first));
+            bufs[i].len = static_cast<ULONG>(spans[i].second);
+        }
+
+        auto n_sent = DWORD{};
+        if (WSASend(handle.tcp, std::data(bufs), static_cast<DWORD>(n_spans), &n_sent, 0, nullptr, nullptr) == 0)
+        {
+            return static_cast<size_t>(n_sent);
+        }
+#else
+        auto iov = std::array<iovec, MaxWritevSpans>{};
+        for (size_t i = 0; i < n_spans; ++i)
+        {
+            iov[i].iov_base = const_cast<std::byte*>(spans[i].first);
+            iov[i].iov_len = spans[i].second;
+        }
+
+        auto msg = msghdr{};
+        msg.msg_iov = std::data(iov);
+        msg.msg_iovlen = n_spans;
+
+        auto flags = 0;
+#ifdef MSG_MORE
+        if (more)
+        {
+            flags |= MSG_MORE;
+        }
+#endif
+
+        if (auto const n_sent = sendmsg(handle.tcp, &msg, flags); n_sent >= 0)
+        {
+            return static_cast<size_t>(n_sent);
+        }
+#endif
+
+        if (error != nullptr)
+        {
+            auto const err = sockerrno;
+            error->set(err, tr_net_strerror(err));
+        }
+
+        return {};
+    }
+
+#ifdef WITH_UTP
+    if (is_utp())
+    {
+        auto iov = std::array<utp_iovec, MaxWritevSpans>{};
+        for (size_t i = 0; i < n_spans; ++i)
+        {
+            // NB: like utp_write(), utp_writev() doesn't modify the data
+            iov[i].iov_base = const_cast<std::byte*>(spans[i].first);
+            iov[i].iov_len = spans[i].second;
+        }
+
+        errno = 0;
+        auto const n_written = utp_writev(handle.utp, std::data(iov), n_spans);
+        auto const error_code = errno;
+
+        if (n_written > 0)
+        {
+            return static_cast<size_t>(n_written);
+        }
+
+        if (error != nullptr && n_written < 0 && error_code != 0)
+        {
+            error->set_from_errno(error_code);
+        }
+    }
+#endif
+
+    return {};
+}
+
+size_t tr_peer_socket::try_write_file(
+    [[maybe_unused]] tr_sys_file_t fd,
+    [[maybe_unused]] uint64_t& offset,
+    size_t max,
+    [[maybe_unused]] tr_error* error) const
+{
+    if (max == size_t{})
+    {
+        return {};
+    }
+
+    TR_ASSERT(can_send_files());
+
+#ifdef __linux__
+    if (is_tcp())
+    {
+        auto file_offset = static_cast<off_t>(offset);
+        auto const n_sent = sendfile(handle.tcp, fd, &file_offset, max);
+        auto const error_code = errno;
+
+        if (n_sent > 0)
+        {
+            offset = static_cast<uint64_t>(file_offset);
+            return static_cast<size_t>(n_sent);
+        }
+
+        if (error != nullptr)
+        {
+            if (n_sent == 0)
+            {
+                // the file is shorter than we expected
+                error->set_from_errno(EIO);
+            }
+            else
+            {
+                error->set(error_code, tr_net_strerror(error_code));
+            }
+        }
+    }
+#endif
+
+    return {};
+}
+
 size_t tr_peer_socket::try_read(InBuf& buf, size_t max, [[maybe_unused]] bool buf_is_empty, tr_error* error) const
 {
     if (max == size_t{})
@@ -129,6 +278,84 @@ size_t tr_peer_socket::try_read(InBuf& buf, size_t max, [[maybe_unused]] bool bu
     return {};
 }
 
+std::optional<uint32_t> tr_peer_socket::rtt_usec() const
+{
+#if defined(__linux__) || defined(__FreeBSD__)
+    if (is_tcp())
+    {
+        auto info = tcp_info{};
+        auto len = socklen_t{ sizeof(info) };
+        if (getsockopt(handle.tcp, IPPROTO_TCP, TCP_INFO, &info, &len) == 0 && info.tcpi_rtt != 0U)
+        {
+            return info.tcpi_rtt;
+        }
+    }
+#endif
+
+    return {};
+}
+
+void tr_peer_socket::set_buffer_sizes([[maybe_unused]] size_t rcvbuf, [[maybe_unused]] size_t sndbuf) const
+{
+#ifdef WITH_UTP
+    if (is_utp())
+    {
+        utp_setsockopt(handle.utp, UTP_RCVBUF, static_cast<int>(rcvbuf));
+        utp_setsockopt(handle.utp, UTP_SNDBUF, static_cast<int>(sndbuf));
+    }
+#endif
+}
+
+std::optional<std::pair<size_t, size_t>> tr_peer_socket::buffer_sizes() const
+{
+    if (is_tcp())
+    {
+        auto const get = [this](int optname) -> std::optional<size_t>
+        {
+            auto optval = int{};
+            auto len = socklen_t{ sizeof(optval) };
+            if (getsockopt(handle.tcp, SOL_SOCKET, optname, reinterpret_cast<char*>(&optval), &len) == -1 || optval < 0)
+            {
+                return {};
+            }
+
+            return static_cast<size_t>(optval);
+        };
+
+        if (auto const rcvbuf = get(SO_RCVBUF), sndbuf = get(SO_SNDBUF); rcvbuf && sndbuf)
+        {
+            return std::make_pair(*rcvbuf, *sndbuf);
+        }
+    }
+
+#ifdef WITH_UTP
+    if (is_utp())
+    {
+        auto const rcvbuf = utp_getsockopt(handle.utp, UTP_RCVBUF);
+        auto const sndbuf = utp_getsockopt(handle.utp, UTP_SNDBUF);
+        if (rcvbuf >= 0 && sndbuf >= 0)
+        {
+            return std::make_pair(static_cast<size_t>(rcvbuf), static_cast<size_t>(sndbuf));
+        }
+    }
+#endif
+
+    return {};
+}
+
+bool tr_peer_socket::set_notsent_lowat([[maybe_unused]] size_t n_bytes) const
+{
+#ifdef TCP_NOTSENT_LOWAT
+    if (is_tcp())
+    {
+        auto const optval = static_cast<int>(n_bytes);
+        return setsockopt(handle.tcp, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &optval, sizeof(optval)) == 0;
+    }
+#endif
+
+    return false;
+}
+
 bool tr_peer_socket::limit_reached(tr_session const* const session) noexcept
 {
     return n_open_sockets_.load() >= session->peerLimit();
@@ -11,9 +11,12 @@
 
 #include <atomic>
 #include <cstddef> // size_t
+#include <cstdint> // uint32_t, uint64_t
+#include <optional>
 #include <string>
-#include <utility> // for std::make_pair()
+#include <utility> // for std::make_pair(), std::pair
 
+#include "libtransmission/file.h" // tr_sys_file_t
 #include "libtransmission/net.h"
 #include "libtransmission/tr-buffer.h"
 
@@ -53,7 +56,40 @@ public:
     void close();
 
     size_t try_read(InBuf& buf, size_t max, bool buf_is_empty, tr_error* error) const;
-    size_t try_write(OutBuf& buf, size_t max, tr_error* error) const;
+    size_t try_write(OutBuf& buf, size_t max, tr_error* error, bool more = false) const;
+
+    // A run of bytes for try_writev() to send.
+    using ConstSpan = std::pair<std::byte const*, size_t>;
+
+    // The most spans that try_writev() will send in a single call.
+    static constexpr auto MaxWritevSpans = size_t{ 16U };
+
+    // Send as much of `spans` as possible, in order, in a single call.
+    // Unlike try_write(), the caller is responsible for draining whatever
+    // buffers the spans came from.
+    size_t try_writev(ConstSpan const* spans, size_t n_spans, tr_error* error, bool more = false) const;
+
+    // Send up to `max` bytes from `fd`, starting at `offset`, without
+    // copying them through userspace. `offset` is advanced past the sent
+    // bytes. Only available for TCP sockets where can_send_files() is true.
+    size_t try_write_file(tr_sys_file_t fd, uint64_t& offset, size_t max, tr_error* error) const;
+
+    // The connection's smoothed round-trip time, if the transport knows it.
+    // TCP reports it via TCP_INFO on some platforms; libutp doesn't expose it.
+    [[nodiscard]] std::optional<uint32_t> rtt_usec() const;
+
+    // Set libutp's buffer sizes. TCP sockets are left alone: setting
+    // SO_RCVBUF or SO_SNDBUF turns off the kernel's buffer autotuning,
+    // and the kernel caps the sizes at its own limits anyway.
+    void set_buffer_sizes(size_t rcvbuf, size_t sndbuf) const;
+
+    // The receive and send buffer sizes that are actually in effect,
+    // as reported by the kernel (for TCP) or libutp (for µTP).
+    [[nodiscard]] std::optional<std::pair<size_t, size_t>> buffer_sizes() const;
+
+    // Set TCP_NOTSENT_LOWAT so that unsent data waits in our own buffers
+    // instead of in the kernel's. Returns false if it's not supported.
+    [[nodiscard]] bool set_notsent_lowat(size_t n_bytes) const;
 
     [[nodiscard]] constexpr auto const& socket_address() const noexcept
     {
@@ -94,6 +130,15 @@ public:
 #endif
     }
 
+    [[nodiscard]] constexpr bool can_send_files() const noexcept
+    {
+#ifdef __linux__
+        return is_tcp();
+#else
+        return false;
+#endif
+    }
+
     [[nodiscard]] constexpr size_t guess_packet_overhead(size_t n_bytes) const noexcept
     {
         if (is_tcp())
@@ -68,6 +68,9 @@ auto constexpr MyStatic = std::array<std::string_view, TR_N_KEYS>{
     "compact-view"sv,
     "complete"sv,
     "config-dir"sv,
+    "connectLatencyP50"sv,
+    "connectLatencyP90"sv,
+    "connectLatencyP99"sv,
     "cookies"sv,
     "corrupt"sv,
     "corruptEver"sv,
@@ -86,6 +89,7 @@ auto constexpr MyStatic = std::array<std::string_view, TR_N_KEYS>{
     "details-window-height"sv,
     "details-window-width"sv,
     "dht-enabled"sv,
+    "distributedCopiesPerSlot"sv,
     "dnd"sv,
     "done-date"sv,
     "doneDate"sv,
@@ -153,6 +157,10 @@ auto constexpr MyStatic = std::array<std::string_view, TR_N_KEYS>{
     "idle-seeding-limit"sv,
     "idle-seeding-limit-enabled"sv,
     "ids"sv,
+    "incomingDroppedPeerLimit"sv,
+    "incomingDroppedPendingHandshakes"sv,
+    "incomingDroppedPerAddress"sv,
+    "incomingDroppedPerSubnet"sv,
     "incomplete"sv,
     "incomplete-dir"sv,
     "incomplete-dir-enabled"sv,
@@ -171,6 +179,8 @@ auto constexpr MyStatic = std::array<std::string_view, TR_N_KEYS>{
     "isUTP"sv,
     "isUploadingTo"sv,
     "labels"sv,
+    "lan-peer-subnets"sv,
+    "lan-peers-unlimited"sv,
     "lastAnnouncePeerCount"sv,
     "lastAnnounceResult"sv,
     "lastAnnounceStartTime"sv,
@@ -182,6 +192,7 @@ auto constexpr MyStatic = std::array<std::string_view, TR_N_KEYS>{
     "lastScrapeSucceeded"sv,
     "lastScrapeTime"sv,
     "lastScrapeTimedOut"sv,
+    "lazy-have-enabled"sv,
     "leecherCount"sv,
     "leftUntilDone"sv,
     "length"sv,
@@ -225,6 +236,7 @@ auto constexpr MyStatic = std::array<std::string_view, TR_N_KEYS>{
     "peer-limit"sv,
     "peer-limit-global"sv,
     "peer-limit-per-torrent"sv,
+    "peer-pool-limit-per-torrent"sv,
     "peer-port"sv,
     "peer-port-random-high"sv,
     "peer-port-random-low"sv,
@@ -232,6 +244,16 @@ auto constexpr MyStatic = std::array<std::string_view, TR_N_KEYS>{
     "peer-socket-tos"sv,
     "peerIsChoked"sv,
     "peerIsInterested"sv,
+    "peerMemoryBufferPoolBytes"sv,
+    "peerMemoryBuffersBytes"sv,
+    "peerMemoryEncryptedBytes"sv,
+    "peerMemoryIoBytes"sv,
+    "peerMemoryLanBytes"sv,
+    "peerMemoryMsgsBytes"sv,
+    "peerMemoryPlaintextBytes"sv,
+    "peerMemoryTcpBytes"sv,
+    "peerMemoryUtpBytes"sv,
+    "peerPoolBytes"sv,
     "peers"sv,
     "peers2"sv,
     "peers2-6"sv,
@@ -326,6 +348,7 @@ auto constexpr MyStatic = std::array<std::string_view, TR_N_KEYS>{
     "secondsActive"sv,
     "secondsDownloading"sv,
     "secondsSeeding"sv,
+    "seed-choking-algorithm"sv,
     "seed-queue-enabled"sv,
     "seed-queue-size"sv,
     "seedIdleLimit"sv,
@@ -369,6 +392,13 @@ auto constexpr MyStatic = std::array<std::string_view, TR_N_KEYS>{
     "start_paused"sv,
     "status"sv,
     "statusbar-stats"sv,
+    "streamingDeadlineSlack"sv,
+    "streamingDuplicateRequests"sv,
+    "streamingPiecesLate"sv,
+    "streamingPiecesOnTime"sv,
+    "streamingPositions"sv,
+    "streamingRate"sv,
+    "superSeeding"sv,
     "tag"sv,
     "tcp-enabled"sv,
     "tier"sv,
@@ -423,6 +453,8 @@ auto constexpr MyStatic = std::array<std::string_view, TR_N_KEYS>{
     "v"sv,
     "version"sv,
     "wanted"sv,
+    "wasted"sv,
+    "wastedEver"sv,
     "watch-dir"sv,
     "watch-dir-enabled"sv,
     "watch-dir-force-generic"sv,
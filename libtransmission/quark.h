@@ -70,6 +70,9 @@ enum
     TR_KEY_compact_view,
     TR_KEY_complete,
     TR_KEY_config_dir,
+    TR_KEY_connectLatencyP50,
+    TR_KEY_connectLatencyP90,
+    TR_KEY_connectLatencyP99,
     TR_KEY_cookies,
     TR_KEY_corrupt,
     TR_KEY_corruptEver,
@@ -88,6 +91,7 @@ enum
     TR_KEY_details_window_height,
     TR_KEY_details_window_width,
     TR_KEY_dht_enabled,
+    TR_KEY_distributedCopiesPerSlot,
     TR_KEY_dnd,
     TR_KEY_done_date,
     TR_KEY_doneDate,
@@ -155,6 +159,10 @@ enum
     TR_KEY_idle_seeding_limit,
     TR_KEY_idle_seeding_limit_enabled,
     TR_KEY_ids,
+    TR_KEY_incomingDroppedPeerLimit,
+    TR_KEY_incomingDroppedPendingHandshakes,
+    TR_KEY_incomingDroppedPerAddress,
+    TR_KEY_incomingDroppedPerSubnet,
     TR_KEY_incomplete,
     TR_KEY_incomplete_dir,
     TR_KEY_incomplete_dir_enabled,
@@ -173,6 +181,8 @@ enum
     TR_KEY_isUTP,
     TR_KEY_isUploadingTo,
     TR_KEY_labels,
+    TR_KEY_lan_peer_subnets,
+    TR_KEY_lan_peers_unlimited,
     TR_KEY_lastAnnouncePeerCount,
     TR_KEY_lastAnnounceResult,
     TR_KEY_lastAnnounceStartTime,
@@ -184,6 +194,7 @@ enum
     TR_KEY_lastScrapeSucceeded,
     TR_KEY_lastScrapeTime,
     TR_KEY_lastScrapeTimedOut,
+    TR_KEY_lazy_have_enabled,
     TR_KEY_leecherCount,
     TR_KEY_leftUntilDone,
     TR_KEY_length,
@@ -227,6 +238,7 @@ enum
     TR_KEY_peer_limit,
     TR_KEY_peer_limit_global,
     TR_KEY_peer_limit_per_torrent,
+    TR_KEY_peer_pool_limit_per_torrent,
     TR_KEY_peer_port,
     TR_KEY_peer_port_random_high,
     TR_KEY_peer_port_random_low,
@@ -234,6 +246,16 @@ enum
     TR_KEY_peer_socket_tos,
     TR_KEY_peerIsChoked,
     TR_KEY_peerIsInterested,
+    TR_KEY_peerMemoryBufferPoolBytes,
+    TR_KEY_peerMemoryBuffersBytes,
+    TR_KEY_peerMemoryEncryptedBytes,
+    TR_KEY_peerMemoryIoBytes,
+    TR_KEY_peerMemoryLanBytes,
+    TR_KEY_peerMemoryMsgsBytes,
+    TR_KEY_peerMemoryPlaintextBytes,
+    TR_KEY_peerMemoryTcpBytes,
+    TR_KEY_peerMemoryUtpBytes,
+    TR_KEY_peerPoolBytes,
     TR_KEY_peers,
     TR_KEY_peers2,
     TR_KEY_peers2_6,
@@ -328,6 +350,7 @@ enum
     TR_KEY_secondsActive,
     TR_KEY_secondsDownloading,
     TR_KEY_secondsSeeding,
+    TR_KEY_seed_choking_algorithm,
     TR_KEY_seed_queue_enabled,
     TR_KEY_seed_queue_size,
     TR_KEY_seedIdleLimit,
@@ -371,6 +394,13 @@ enum
     TR_KEY_start_paused,
     TR_KEY_status,
     TR_KEY_statusbar_stats,
+    TR_KEY_streamingDeadlineSlack,
+    TR_KEY_streamingDuplicateRequests,
+    TR_KEY_streamingPiecesLate,
+    TR_KEY_streamingPiecesOnTime,
+    TR_KEY_streamingPositions,
+    TR_KEY_streamingRate,
+    TR_KEY_superSeeding,
     TR_KEY_tag,
     TR_KEY_tcp_enabled,
     TR_KEY_tier,
@@ -425,6 +455,8 @@ enum
     TR_KEY_v,
     TR_KEY_version,
     TR_KEY_wanted,
+    TR_KEY_wasted,
+    TR_KEY_wastedEver,
     TR_KEY_watch_dir,
     TR_KEY_watch_dir_enabled,
     TR_KEY_watch_dir_force_generic,
@@ -641,6 +641,12 @@ tr_resume::fields_t load_from_file(tr_torrent* tor, tr_torrent::ResumeHelper& he
         fields_loaded |= tr_resume::Corrupt;
     }
 
+    if ((fields_to_load & tr_resume::Wasted) != 0 && tr_variantDictFindInt(&top, TR_KEY_wasted, &i))
+    {
+        tor->bytes_wasted_.set_prev(i);
+        fields_loaded |= tr_resume::Wasted;
+    }
+
     if ((fields_to_load & (tr_resume::Progress | tr_resume::DownloadDir)) != 0 &&
         tr_variantDictFindStrView(&top, TR_KEY_destination, &sv) && !std::empty(sv))
     {
@@ -723,6 +729,13 @@ tr_resume::fields_t load_from_file(tr_torrent* tor, tr_torrent::ResumeHelper& he
         fields_loaded |= tr_resume::SequentialDownload;
     }
 
+    if (auto val = bool{};
+        (fields_to_load & tr_resume::SuperSeeding) != 0 && tr_variantDictFindBool(&top, TR_KEY_superSeeding, &val))
+    {
+        tor->set_super_seeding(val);
+        fields_loaded |= tr_resume::SuperSeeding;
+    }
+
     if ((fields_to_load & tr_resume::Peers) != 0)
     {
         fields_loaded |= loadPeers(&top, tor);
@@ -876,6 +889,7 @@ void save(tr_torrent* const tor, tr_torrent::ResumeHelper const& helper)
     tr_variantDictAddInt(&top, TR_KEY_added_date, helper.date_added());
     tr_variantDictAddInt(&top, TR_KEY_corrupt, tor->bytes_corrupt_.ever());
     tr_variantDictAddInt(&top, TR_KEY_done_date, helper.date_done());
+    tr_variantDictAddInt(&top, TR_KEY_wasted, tor->bytes_wasted_.ever());
     tr_variantDictAddStrView(&top, TR_KEY_destination, tor->download_dir().sv());
 
     if (!std::empty(tor->incomplete_dir()))
@@ -889,6 +903,7 @@ void save(tr_torrent* const tor, tr_torrent::ResumeHelper const& helper)
     tr_variantDictAddInt(&top, TR_KEY_bandwidth_priority, tor->get_priority());
     tr_variantDictAddBool(&top, TR_KEY_paused, !helper.start_when_stable());
     tr_variantDictAddBool(&top, TR_KEY_sequentialDownload, tor->is_sequential_download());
+    tr_variantDictAddBool(&top, TR_KEY_superSeeding, tor->is_super_seeding());
     savePeers(&top, tor);
 
     if (tor->has_metainfo())
@@ -45,6 +45,8 @@ auto inline constexpr Name = fields_t{ 1 << 21 };
 auto inline constexpr Labels = fields_t{ 1 << 22 };
 auto inline constexpr Group = fields_t{ 1 << 23 };
 auto inline constexpr SequentialDownload = fields_t{ 1 << 24 };
+auto inline constexpr Wasted = fields_t{ 1 << 25 };
+auto inline constexpr SuperSeeding = fields_t{ 1 << 26 };
 
 auto inline constexpr All = ~fields_t{ 0 };
 
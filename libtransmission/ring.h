@@ -0,0 +1,239 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#pragma once
+
+#ifndef __TRANSMISSION__
+#error only libtransmission should #include this header.
+#endif
+
+#include <algorithm> // std::max
+#include <cstddef> // size_t, ptrdiff_t
+#include <iterator> // std::forward_iterator_tag
+#include <memory> // std::allocator
+#include <new> // placement new
+#include <utility> // std::forward, std::move
+
+#include "libtransmission/tr-assert.h"
+
+/**
+ * A FIFO queue stored in a single ring of memory.
+ *
+ * Unlike std::deque, an empty tr_ring allocates nothing, and a busy
+ * one keeps reusing the same ring instead of allocating and freeing
+ * chunks as items are pushed and popped. The ring only reallocates
+ * when it's full, doubling its capacity.
+ */
+template<typename T>
+class tr_ring
+{
+public:
+    template<typename RingT, typename ValueT>
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = ValueT*;
+        using reference = ValueT&;
+
+        Iterator(RingT* ring, size_t pos) noexcept
+            : ring_{ ring }
+            , pos_{ pos }
+        {
+        }
+
+        [[nodiscard]] reference operator*() const noexcept
+        {
+            return (*ring_)[pos_];
+        }
+
+        [[nodiscard]] pointer operator->() const noexcept
+        {
+            return &(*ring_)[pos_];
+        }
+
+        Iterator& operator++() noexcept
+        {
+            ++pos_;
+            return *this;
+        }
+
+        [[nodiscard]] bool operator==(Iterator const& that) const noexcept
+        {
+            return pos_ == that.pos_;
+        }
+
+        [[nodiscard]] bool operator!=(Iterator const& that) const noexcept
+        {
+            return pos_ != that.pos_;
+        }
+
+        [[nodiscard]] constexpr auto position() const noexcept
+        {
+            return pos_;
+        }
+
+    private:
+        RingT* ring_;
+        size_t pos_;
+    };
+
+    using iterator = Iterator<tr_ring, T>;
+    using const_iterator = Iterator<tr_ring const, T const>;
+
+    tr_ring() = default;
+    tr_ring(tr_ring&&) = delete;
+    tr_ring(tr_ring const&) = delete;
+    tr_ring& operator=(tr_ring&&) = delete;
+    tr_ring& operator=(tr_ring const&) = delete;
+
+    ~tr_ring()
+    {
+        clear();
+        std::allocator<T>{}.deallocate(items_, capacity_);
+    }
+
+    [[nodiscard]] constexpr auto size() const noexcept
+    {
+        return size_;
+    }
+
+    [[nodiscard]] constexpr auto empty() const noexcept
+    {
+        return size_ == 0U;
+    }
+
+    [[nodiscard]] constexpr auto capacity() const noexcept
+    {
+        return capacity_;
+    }
+
+    [[nodiscard]] T& operator[](size_t pos) noexcept
+    {
+        TR_ASSERT(pos < size_);
+        return items_[(head_ + pos) % capacity_];
+    }
+
+    [[nodiscard]] T const& operator[](size_t pos) const noexcept
+    {
+        TR_ASSERT(pos < size_);
+        return items_[(head_ + pos) % capacity_];
+    }
+
+    [[nodiscard]] T& front() noexcept
+    {
+        return (*this)[0U];
+    }
+
+    [[nodiscard]] T const& front() const noexcept
+    {
+        return (*this)[0U];
+    }
+
+    [[nodiscard]] T& back() noexcept
+    {
+        return (*this)[size_ - 1U];
+    }
+
+    [[nodiscard]] T const& back() const noexcept
+    {
+        return (*this)[size_ - 1U];
+    }
+
+    [[nodiscard]] auto begin() noexcept
+    {
+        return iterator{ this, 0U };
+    }
+
+    [[nodiscard]] auto end() noexcept
+    {
+        return iterator{ this, size_ };
+    }
+
+    [[nodiscard]] auto begin() const noexcept
+    {
+        return const_iterator{ this, 0U };
+    }
+
+    [[nodiscard]] auto end() const noexcept
+    {
+        return const_iterator{ this, size_ };
+    }
+
+    template<typename... Args>
+    T& emplace_back(Args&&... args)
+    {
+        if (size_ == capacity_)
+        {
+            grow();
+        }
+
+        auto* const item = &items_[(head_ + size_) % capacity_];
+        new (item) T(std::forward<Args>(args)...);
+        ++size_;
+        return *item;
+    }
+
+    void pop_front()
+    {
+        TR_ASSERT(!empty());
+
+        items_[head_].~T();
+        head_ = (head_ + 1U) % capacity_;
+        --size_;
+    }
+
+    // Removes the item at `pos`, moving the items behind it forward.
+    iterator erase(iterator pos)
+    {
+        TR_ASSERT(pos.position() < size_);
+
+        for (auto i = pos.position(); i + 1U < size_; ++i)
+        {
+            (*this)[i] = std::move((*this)[i + 1U]);
+        }
+
+        back().~T();
+        --size_;
+        return pos;
+    }
+
+    void clear()
+    {
+        while (!empty())
+        {
+            pop_front();
+        }
+    }
+
+private:
+    static auto constexpr MinCapacity = size_t{ 4U };
+
+    void grow()
+    {
+        auto alloc = std::allocator<T>{};
+        auto const new_capacity = std::max(MinCapacity, capacity_ * 2U);
+        auto* const new_items = alloc.allocate(new_capacity);
+
+        for (size_t i = 0U; i < size_; ++i)
+        {
+            auto& item = (*this)[i];
+            new (&new_items[i]) T(std::move(item));
+            item.~T();
+        }
+
+        alloc.deallocate(items_, capacity_);
+        items_ = new_items;
+        capacity_ = new_capacity;
+        head_ = 0U;
+    }
+
+    T* items_ = nullptr;
+    size_t capacity_ = {};
+    size_t head_ = {};
+    size_t size_ = {};
+};
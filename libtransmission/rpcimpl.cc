@@ -496,6 +496,31 @@ namespace make_torrent_field_helpers
 
     return tr_variant::unmanaged_string(""sv);
 }
+
+[[nodiscard]] auto make_stream_positions_vec(tr_torrent const& tor)
+{
+    auto const& positions = tor.stream().positions();
+    auto vec = tr_variant::Vector{};
+    vec.reserve(std::size(positions) * 2U);
+    for (auto const& pos : positions)
+    {
+        vec.emplace_back(pos.file);
+        vec.emplace_back(pos.offset);
+    }
+    return tr_variant{ std::move(vec) };
+}
+
+[[nodiscard]] int64_t get_stream_slack_msec(tr_torrent const& tor)
+{
+    if (!tor.is_streaming())
+    {
+        return 0;
+    }
+
+    // nothing in the window is missing, so a miss is at least a window away
+    static auto constexpr WindowMsec = static_cast<int64_t>(tr_torrent_stream::WindowSecs * 1000U);
+    return tor.stream_slack_msec().value_or(WindowMsec);
+}
 } // namespace make_torrent_field_helpers
 
 [[nodiscard]] auto constexpr isSupportedTorrentGetField(tr_quark key)
@@ -511,6 +536,7 @@ namespace make_torrent_field_helpers
     case TR_KEY_creator:
     case TR_KEY_dateCreated:
     case TR_KEY_desiredAvailable:
+    case TR_KEY_distributedCopiesPerSlot:
     case TR_KEY_doneDate:
     case TR_KEY_downloadDir:
     case TR_KEY_downloadLimit:
@@ -541,6 +567,7 @@ namespace make_torrent_field_helpers
     case TR_KEY_metadataPercentComplete:
     case TR_KEY_name:
     case TR_KEY_peer_limit:
+    case TR_KEY_peerPoolBytes:
     case TR_KEY_peers:
     case TR_KEY_peersConnected:
     case TR_KEY_peersFrom:
@@ -568,6 +595,13 @@ namespace make_torrent_field_helpers
     case TR_KEY_source:
     case TR_KEY_startDate:
     case TR_KEY_status:
+    case TR_KEY_streamingDeadlineSlack:
+    case TR_KEY_streamingDuplicateRequests:
+    case TR_KEY_streamingPiecesLate:
+    case TR_KEY_streamingPiecesOnTime:
+    case TR_KEY_streamingPositions:
+    case TR_KEY_streamingRate:
+    case TR_KEY_superSeeding:
     case TR_KEY_torrentFile:
     case TR_KEY_totalSize:
     case TR_KEY_trackerList:
@@ -578,6 +612,7 @@ namespace make_torrent_field_helpers
     case TR_KEY_uploadRatio:
     case TR_KEY_uploadedEver:
     case TR_KEY_wanted:
+    case TR_KEY_wastedEver:
     case TR_KEY_webseeds:
     case TR_KEY_webseedsSendingToUs:
         return true;
@@ -605,6 +640,7 @@ namespace make_torrent_field_helpers
     case TR_KEY_creator: return tor.creator();
     case TR_KEY_dateCreated: return tor.date_created();
     case TR_KEY_desiredAvailable: return st.desiredAvailable;
+    case TR_KEY_distributedCopiesPerSlot: return st.distributedCopiesPerSlot;
     case TR_KEY_doneDate: return st.doneDate;
     case TR_KEY_downloadDir: return tr_variant::unmanaged_string(tor.download_dir().sv());
     case TR_KEY_downloadLimit: return tr_torrentGetSpeedLimit_KBps(&tor, TR_DOWN);
@@ -635,6 +671,7 @@ namespace make_torrent_field_helpers
     case TR_KEY_metadataPercentComplete: return st.metadataPercentComplete;
     case TR_KEY_name: return tor.name();
     case TR_KEY_peer_limit: return tor.peer_limit();
+    case TR_KEY_peerPoolBytes: return st.peerPoolBytes;
     case TR_KEY_peers: return make_peer_vec(tor);
     case TR_KEY_peersConnected: return st.peersConnected;
     case TR_KEY_peersFrom: return make_peer_counts_map(st);
@@ -662,6 +699,13 @@ namespace make_torrent_field_helpers
     case TR_KEY_source: return tor.source();
     case TR_KEY_startDate: return st.startDate;
     case TR_KEY_status: return st.activity;
+    case TR_KEY_streamingDeadlineSlack: return get_stream_slack_msec(tor);
+    case TR_KEY_streamingDuplicateRequests: return tor.stream().stats().duplicate_requests;
+    case TR_KEY_streamingPiecesLate: return tor.stream().stats().pieces_late;
+    case TR_KEY_streamingPiecesOnTime: return tor.stream().stats().pieces_on_time;
+    case TR_KEY_streamingPositions: return make_stream_positions_vec(tor);
+    case TR_KEY_streamingRate: return tor.stream().rate();
+    case TR_KEY_superSeeding: return tor.is_super_seeding();
     case TR_KEY_torrentFile: return tor.torrent_file();
     case TR_KEY_totalSize: return tor.total_size();
     case TR_KEY_trackerList: return tor.announce_list().to_string();
@@ -672,6 +716,7 @@ namespace make_torrent_field_helpers
     case TR_KEY_uploadRatio: return st.ratio;
     case TR_KEY_uploadedEver: return st.uploadedEver;
     case TR_KEY_wanted: return make_file_wanted_vec(tor);
+    case TR_KEY_wastedEver: return st.wastedEver;
     case TR_KEY_webseeds: return make_webseed_vec(tor);
     case TR_KEY_webseedsSendingToUs: return st.webseedsSendingToUs;
     default: return tr_variant{};
@@ -927,6 +972,33 @@ char const* replace_trackers(tr_torrent* tor, tr_variant::Vector const& urls_vec
     return nullptr;
 }
 
+char const* set_stream_positions(tr_torrent* tor, tr_variant::Vector const& positions_vec)
+{
+    if (std::size(positions_vec) % 2U != 0U)
+    {
+        return "streaming positions must be pairs of file index and byte offset";
+    }
+
+    auto positions = std::vector<std::pair<tr_file_index_t, uint64_t>>{};
+    positions.reserve(std::size(positions_vec) / 2U);
+
+    for (size_t i = 0, vec_size = std::size(positions_vec); i + 1 < vec_size; i += 2U)
+    {
+        auto const file = positions_vec[i].value_if<int64_t>();
+        auto const offset = positions_vec[i + 1U].value_if<int64_t>();
+
+        if (!file || !offset || *file < 0 || static_cast<uint64_t>(*file) >= tor->file_count() || *offset < 0)
+        {
+            return "invalid streaming position";
+        }
+
+        positions.emplace_back(static_cast<tr_file_index_t>(*file), static_cast<uint64_t>(*offset));
+    }
+
+    tor->set_stream_positions(positions);
+    return nullptr;
+}
+
 char const* remove_trackers(tr_torrent* tor, tr_variant::Vector const& ids_vec)
 {
     auto ann = tor->announce_list();
@@ -1013,6 +1085,22 @@ char const* torrentSet(tr_session* session, tr_variant::Map const& args_in, tr_v
             tor->set_sequential_download(*val);
         }
 
+        if (auto const val = args_in.value_if<bool>(TR_KEY_superSeeding))
+        {
+            tor->set_super_seeding(*val);
+        }
+
+        if (auto const val = args_in.value_if<int64_t>(TR_KEY_streamingRate); val && *val >= 0)
+        {
+            tor->set_stream_rate(static_cast<uint64_t>(*val));
+        }
+
+        if (auto const* val = args_in.find_if<tr_variant::Vector>(TR_KEY_streamingPositions);
+            val != nullptr && errmsg == nullptr)
+        {
+            errmsg = set_stream_positions(tor, *val);
+        }
+
         if (auto const val = args_in.value_if<bool>(TR_KEY_downloadLimited))
         {
             tor->use_speed_limit(TR_DOWN, *val);
@@ -1859,12 +1947,34 @@ char const* sessionStats(tr_session* session, tr_variant::Map const& /*args_in*/
         std::end(torrents),
         [](auto const* tor) { return tor->is_running(); });
 
-    args_out.reserve(std::size(args_out) + 7U);
+    auto const latency = tr_peerMgrConnectLatency(session->peer_mgr());
+    auto const& admission = session->incoming_admission();
+    using Verdict = tr_incoming_admission::Verdict;
+    auto const memory = tr_peerMgrMemoryReport(session->peer_mgr());
+
+    args_out.reserve(std::size(args_out) + 24U);
     args_out.try_emplace(TR_KEY_activeTorrentCount, n_running);
+    args_out.try_emplace(TR_KEY_connectLatencyP50, latency.p50_msec);
+    args_out.try_emplace(TR_KEY_connectLatencyP90, latency.p90_msec);
+    args_out.try_emplace(TR_KEY_connectLatencyP99, latency.p99_msec);
     args_out.try_emplace(TR_KEY_cumulative_stats, make_stats_map(session->stats().cumulative()));
     args_out.try_emplace(TR_KEY_current_stats, make_stats_map(session->stats().current()));
     args_out.try_emplace(TR_KEY_downloadSpeed, session->piece_speed(TR_DOWN).base_quantity());
+    args_out.try_emplace(TR_KEY_incomingDroppedPeerLimit, admission.n_dropped(Verdict::PeerLimit));
+    args_out.try_emplace(TR_KEY_incomingDroppedPendingHandshakes, admission.n_dropped(Verdict::PendingHandshakes));
+    args_out.try_emplace(TR_KEY_incomingDroppedPerAddress, admission.n_dropped(Verdict::PerAddress));
+    args_out.try_emplace(TR_KEY_incomingDroppedPerSubnet, admission.n_dropped(Verdict::PerSubnet));
     args_out.try_emplace(TR_KEY_pausedTorrentCount, total - n_running);
+    args_out.try_emplace(TR_KEY_peerMemoryBufferPoolBytes, memory.buffer_pool_bytes);
+    args_out.try_emplace(TR_KEY_peerMemoryBuffersBytes, memory.buffer_bytes);
+    args_out.try_emplace(TR_KEY_peerMemoryEncryptedBytes, memory.encrypted_bytes);
+    args_out.try_emplace(TR_KEY_peerMemoryIoBytes, memory.io_bytes);
+    args_out.try_emplace(TR_KEY_peerMemoryLanBytes, memory.lan_bytes);
+    args_out.try_emplace(TR_KEY_peerMemoryMsgsBytes, memory.msgs_bytes);
+    args_out.try_emplace(TR_KEY_peerMemoryPlaintextBytes, memory.plaintext_bytes);
+    args_out.try_emplace(TR_KEY_peerMemoryTcpBytes, memory.tcp_bytes);
+    args_out.try_emplace(TR_KEY_peerMemoryUtpBytes, memory.utp_bytes);
+    args_out.try_emplace(TR_KEY_peersConnected, memory.peer_count);
     args_out.try_emplace(TR_KEY_torrentCount, total);
     args_out.try_emplace(TR_KEY_uploadSpeed, session->piece_speed(TR_UP).base_quantity());
 
@@ -39,6 +39,7 @@
 #include "libtransmission/interned-string.h"
 #include "libtransmission/log.h"
 #include "libtransmission/net.h"
+#include "libtransmission/peer-io.h"
 #include "libtransmission/peer-mgr.h"
 #include "libtransmission/peer-socket.h"
 #include "libtransmission/port-forwarding.h"
@@ -47,6 +48,7 @@
 #include "libtransmission/session.h"
 #include "libtransmission/session-alt-speeds.h"
 #include "libtransmission/timer-ev.h"
+#include "libtransmission/timer-wheel.h"
 #include "libtransmission/torrent.h"
 #include "libtransmission/torrent-ctor.h"
 #include "libtransmission/tr-assert.h"
@@ -385,13 +387,50 @@ void tr_sessionSetEncryption(tr_session* session, tr_encryption_mode mode)
 
 // ---
 
+size_t tr_session::IncomingAdmissionMediator::pending_handshakes() const
+{
+    return tr_peerMgrPendingIncomingHandshakes(session_.peer_mgr());
+}
+
+bool tr_session::IncomingAdmissionMediator::peer_limit_reached() const
+{
+    return tr_peer_socket::limit_reached(&session_);
+}
+
+uint64_t tr_session::IncomingAdmissionMediator::now_msec() const
+{
+    return tr_time_msec();
+}
+
 void tr_session::onIncomingPeerConnection(tr_socket_t fd, void* vsession)
 {
     auto* session = static_cast<tr_session*>(vsession);
 
-    if (auto const incoming_info = tr_netAccept(session, fd); incoming_info)
+    // Drain the listen queue, but don't starve the rest of the event loop
+    // during a flood. If there are more waiting, libevent will call us again.
+    static auto constexpr MaxAcceptsPerCallback = size_t{ 256U };
+
+    for (size_t i = 0; i < MaxAcceptsPerCallback; ++i)
     {
+        auto const incoming_info = tr_netAccept(fd);
+        if (!incoming_info)
+        {
+            break;
+        }
+
         auto const& [socket_address, sock] = *incoming_info;
+        if (auto const verdict = session->incoming_admission_.check(socket_address.address());
+            verdict != tr_incoming_admission::Verdict::Admit)
+        {
+            tr_logAddTrace(fmt::format(
+                "dropping incoming connection {} ({}): {}",
+                sock,
+                socket_address.display_name(),
+                tr_incoming_admission::verdict_name(verdict)));
+            tr_net_close_socket(sock);
+            continue;
+        }
+
         tr_logAddTrace(fmt::format("new incoming connection {} ({})", sock, socket_address.display_name()));
         session->addIncoming({ session, socket_address, sock });
     }
@@ -795,6 +834,19 @@ void tr_session::setSettings(tr_session::Settings&& settings_in, bool force)
         setDefaultTrackers(val);
     }
 
+    if (auto const& val = new_settings.lan_peer_subnets; force || val != old_settings.lan_peer_subnets)
+    {
+        lan_peers_.set_subnets(val);
+    }
+
+    // peers decide whether they're on the LAN when their socket is set,
+    // so let the ones that are already connected know if that's changed
+    if (new_settings.lan_peer_subnets != old_settings.lan_peer_subnets ||
+        new_settings.lan_peers_unlimited != old_settings.lan_peers_unlimited)
+    {
+        top_bandwidth_.for_each_peer([](tr_peerIo& io) { io.update_lan_status(); });
+    }
+
     bool const utp_changed = new_settings.utp_enabled != old_settings.utp_enabled;
 
     set_blocklist_enabled(new_settings.blocklist_enabled);
@@ -2119,6 +2171,7 @@ tr_session::tr_session(std::string_view config_dir, tr_variant const& settings_d
     , blocklist_dir_{ makeBlocklistDir(config_dir) }
     , session_thread_{ tr_session_thread::create() }
     , timer_maker_{ std::make_unique<libtransmission::EvTimerMaker>(event_base()) }
+    , coarse_timer_maker_{ std::make_unique<libtransmission::WheelTimerMaker>(*timer_maker_) }
     , settings_{ settings_dict }
     , session_id_{ tr_time }
     , peer_mgr_{ tr_peerMgrNew(this), &tr_peerMgrFree }
@@ -42,8 +42,10 @@
 #include "libtransmission/bandwidth.h"
 #include "libtransmission/blocklist.h"
 #include "libtransmission/cache.h"
+#include "libtransmission/incoming-admission.h"
 #include "libtransmission/interned-string.h"
 #include "libtransmission/ip-cache.h"
+#include "libtransmission/lan-peers.h"
 #include "libtransmission/log.h" // for tr_log_level
 #include "libtransmission/net.h" // for tr_port, tr_tos_t
 #include "libtransmission/open-files.h"
@@ -65,6 +67,7 @@
 #include "libtransmission/utils-ev.h"
 #include "libtransmission/verify.h"
 #include "libtransmission/web.h"
+#include "libtransmission/worker-pool.h"
 
 tr_peer_id_t tr_peerIdInit();
 
@@ -326,6 +329,24 @@ private:
         tr_session& session_;
     };
 
+    class IncomingAdmissionMediator final : public tr_incoming_admission::Mediator
+    {
+    public:
+        explicit IncomingAdmissionMediator(tr_session const& session) noexcept
+            : session_{ session }
+        {
+        }
+
+        [[nodiscard]] size_t pending_handshakes() const override;
+
+        [[nodiscard]] bool peer_limit_reached() const override;
+
+        [[nodiscard]] uint64_t now_msec() const override;
+
+    private:
+        tr_session const& session_;
+    };
+
     // UDP connectivity used for the DHT and µTP
     class tr_udp_core
     {
@@ -374,6 +395,8 @@ public:
         bool idle_seeding_limit_enabled = false;
         bool incomplete_dir_enabled = false;
         bool is_incomplete_file_naming_enabled = true;
+        bool lan_peers_unlimited = false;
+        bool lazy_have_enabled = false;
         bool lpd_enabled = true;
         bool peer_port_random_on_start = false;
         bool pex_enabled = true;
@@ -397,6 +420,7 @@ public:
         size_t idle_seeding_limit_minutes = 30U;
         size_t peer_limit_global = TR_DEFAULT_PEER_LIMIT_GLOBAL;
         size_t peer_limit_per_torrent = TR_DEFAULT_PEER_LIMIT_TORRENT;
+        size_t peer_pool_limit_per_torrent = 1000U;
         size_t queue_stalled_minutes = 30U;
         size_t seed_queue_size = 10U;
         size_t speed_limit_down = 100U;
@@ -410,6 +434,7 @@ public:
         std::string default_trackers_str;
         std::string download_dir = tr_getDefaultDownloadDir();
         std::string incomplete_dir = tr_getDefaultDownloadDir();
+        std::string lan_peer_subnets;
         std::string peer_congestion_algorithm;
         std::string script_torrent_added_filename;
         std::string script_torrent_done_filename;
@@ -422,6 +447,7 @@ public:
         tr_port peer_port_random_low = tr_port::from_host(49152);
         tr_port peer_port = tr_port::from_host(TR_DEFAULT_PEER_PORT);
         tr_preferred_transport preferred_transport = TR_PREFER_UTP;
+        tr_seed_choker seed_choker = TR_SEED_CHOKER_FASTEST_UPLOAD;
         tr_tos_t peer_socket_tos{ 0x04 };
         tr_verify_added_mode torrent_added_verify_mode = TR_VERIFY_ADDED_FAST;
 
@@ -446,11 +472,15 @@ public:
                 { TR_KEY_idle_seeding_limit_enabled, &idle_seeding_limit_enabled },
                 { TR_KEY_incomplete_dir, &incomplete_dir },
                 { TR_KEY_incomplete_dir_enabled, &incomplete_dir_enabled },
+                { TR_KEY_lan_peer_subnets, &lan_peer_subnets },
+                { TR_KEY_lan_peers_unlimited, &lan_peers_unlimited },
+                { TR_KEY_lazy_have_enabled, &lazy_have_enabled },
                 { TR_KEY_lpd_enabled, &lpd_enabled },
                 { TR_KEY_message_level, &log_level },
                 { TR_KEY_peer_congestion_algorithm, &peer_congestion_algorithm },
                 { TR_KEY_peer_limit_global, &peer_limit_global },
                 { TR_KEY_peer_limit_per_torrent, &peer_limit_per_torrent },
+                { TR_KEY_peer_pool_limit_per_torrent, &peer_pool_limit_per_torrent },
                 { TR_KEY_peer_port, &peer_port },
                 { TR_KEY_peer_port_random_high, &peer_port_random_high },
                 { TR_KEY_peer_port_random_low, &peer_port_random_low },
@@ -472,6 +502,7 @@ public:
                 { TR_KEY_script_torrent_done_filename, &script_torrent_done_filename },
                 { TR_KEY_script_torrent_done_seeding_enabled, &script_torrent_done_seeding_enabled },
                 { TR_KEY_script_torrent_done_seeding_filename, &script_torrent_done_seeding_filename },
+                { TR_KEY_seed_choking_algorithm, &seed_choker },
                 { TR_KEY_seed_queue_enabled, &seed_queue_enabled },
                 { TR_KEY_seed_queue_size, &seed_queue_size },
                 { TR_KEY_sleep_per_seconds_during_verify, &sleep_per_seconds_during_verify },
@@ -502,6 +533,14 @@ public:
         return *timer_maker_;
     }
 
+    // For timers that don't mind firing up to 100ms late, e.g. per-peer
+    // timeouts. There can be tens of thousands of these, so they share
+    // a single libevent timer instead of each getting their own.
+    [[nodiscard]] libtransmission::TimerMaker& coarseTimerMaker() noexcept
+    {
+        return *coarse_timer_maker_;
+    }
+
     [[nodiscard]] auto am_in_session_thread() const noexcept
     {
         return session_thread_->am_in_session_thread();
@@ -524,6 +563,11 @@ public:
         return session_thread_->event_base();
     }
 
+    [[nodiscard]] constexpr auto& worker_pool() noexcept
+    {
+        return worker_pool_;
+    }
+
     [[nodiscard]] constexpr auto& torrents()
     {
         return torrents_;
@@ -534,6 +578,21 @@ public:
         return torrents_;
     }
 
+    [[nodiscard]] struct tr_peerMgr const* peer_mgr() const noexcept
+    {
+        return peer_mgr_.get();
+    }
+
+    [[nodiscard]] constexpr auto const& incoming_admission() const noexcept
+    {
+        return incoming_admission_;
+    }
+
+    [[nodiscard]] constexpr auto const& lan_peers() const noexcept
+    {
+        return lan_peers_;
+    }
+
     [[nodiscard]] auto unique_lock() const
     {
         return std::unique_lock(session_mutex_);
@@ -693,6 +752,12 @@ public:
         return settings().peer_limit_per_torrent;
     }
 
+    // how many known peers each torrent remembers before evicting the least useful
+    [[nodiscard]] constexpr auto peerPoolLimitPerTorrent() const noexcept
+    {
+        return settings().peer_pool_limit_per_torrent;
+    }
+
     // bandwidth
 
     [[nodiscard]] tr_bandwidth& getBandwidthGroup(std::string_view name);
@@ -921,6 +986,17 @@ public:
         return settings().pex_enabled;
     }
 
+    [[nodiscard]] constexpr auto lazy_have_enabled() const noexcept
+    {
+        return settings().lazy_have_enabled;
+    }
+
+    // true if LAN peers ignore the speed limits
+    [[nodiscard]] constexpr auto lan_peers_unlimited() const noexcept
+    {
+        return settings().lan_peers_unlimited;
+    }
+
     [[nodiscard]] constexpr auto allowsTCP() const noexcept
     {
         return settings().tcp_enabled;
@@ -933,6 +1009,11 @@ public:
         return settings().preferred_transport;
     }
 
+    [[nodiscard]] constexpr auto seed_choker() const noexcept
+    {
+        return settings().seed_choker;
+    }
+
     [[nodiscard]] constexpr auto isIdleLimited() const noexcept
     {
         return settings().idle_seeding_limit_enabled;
@@ -1198,6 +1279,9 @@ private:
     // depends-on: session_thread_
     std::unique_ptr<libtransmission::TimerMaker> const timer_maker_;
 
+    // depends-on: timer_maker_
+    std::unique_ptr<libtransmission::TimerMaker> const coarse_timer_maker_;
+
     /// trivial type fields
 
     Settings settings_;
@@ -1246,6 +1330,8 @@ private:
 
     tr_announce_list default_trackers_;
 
+    tr_lan_peers lan_peers_;
+
     tr_session_id session_id_;
 
     tr_open_files open_files_;
@@ -1302,9 +1388,17 @@ public:
     std::unique_ptr<Cache> cache = std::make_unique<Cache>(torrents_, Memory{ 2U, Memory::Units::MBytes });
 
 private:
-    // depends-on: timer_maker_, blocklists_, top_bandwidth_, utp_context, torrents_, web_
+    // depends-on: session_thread_
+    // Declared before peer_mgr_ so that it outlives the handshakes that use it.
+    tr_worker_pool worker_pool_;
+
+    // depends-on: timer_maker_, blocklists_, top_bandwidth_, utp_context, torrents_, web_, worker_pool_
     std::unique_ptr<struct tr_peerMgr, void (*)(struct tr_peerMgr*)> peer_mgr_;
 
+    // depends-on: peer_mgr_
+    IncomingAdmissionMediator incoming_admission_mediator_{ *this };
+    tr_incoming_admission incoming_admission_{ incoming_admission_mediator_ };
+
     // depends-on: peer_mgr_, advertised_peer_port_, torrents_
     LpdMediator lpd_mediator_{ *this };
 
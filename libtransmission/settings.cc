@@ -349,6 +349,59 @@ tr_variant save_size_t(size_t const& val)
 
 // ---
 
+auto constexpr SeedChokerKeys = Lookup<tr_seed_choker, 2U>{ {
+    { "fastest-upload", TR_SEED_CHOKER_FASTEST_UPLOAD },
+    { "round-robin", TR_SEED_CHOKER_ROUND_ROBIN },
+} };
+
+bool load_seed_choker(tr_variant const& src, tr_seed_choker* tgt)
+{
+    static constexpr auto& Keys = SeedChokerKeys;
+
+    if (auto const val = src.value_if<std::string_view>())
+    {
+        auto const needle = tr_strlower(tr_strv_strip(*val));
+
+        for (auto const& [name, value] : Keys)
+        {
+            if (name == needle)
+            {
+                *tgt = value;
+                return true;
+            }
+        }
+    }
+
+    if (auto const val = src.value_if<int64_t>())
+    {
+        for (auto const& [name, value] : Keys)
+        {
+            if (value == *val)
+            {
+                *tgt = value;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+tr_variant save_seed_choker(tr_seed_choker const& val)
+{
+    for (auto const& [key, value] : SeedChokerKeys)
+    {
+        if (value == val)
+        {
+            return key;
+        }
+    }
+
+    return static_cast<int64_t>(val);
+}
+
+// ---
+
 bool load_string(tr_variant const& src, std::string* tgt)
 {
     if (auto const val = src.value_if<std::string_view>())
@@ -459,6 +512,7 @@ Settings::Settings()
     add_type_handler(load_port, save_port);
     add_type_handler(load_preallocation_mode, save_preallocation_mode);
     add_type_handler(load_preferred_transport, save_preferred_transport);
+    add_type_handler(load_seed_choker, save_seed_choker);
     add_type_handler(load_size_t, save_size_t);
     add_type_handler(load_string, save_string);
     add_type_handler(load_tos_t, save_tos_t);
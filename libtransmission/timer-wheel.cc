@@ -0,0 +1,313 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <algorithm> // std::max
+#include <chrono>
+#include <cstddef> // size_t
+#include <cstdint> // uint64_t
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "libtransmission/timer.h"
+#include "libtransmission/timer-wheel.h"
+#include "libtransmission/tr-assert.h"
+
+namespace libtransmission
+{
+
+class WheelTimerMaker::WheelTimer final
+    : public Timer
+    , public WheelTimerMaker::Node
+{
+public:
+    explicit WheelTimer(WheelTimerMaker& wheel) noexcept
+        : wheel_{ wheel }
+    {
+    }
+
+    WheelTimer(WheelTimer&&) = delete;
+    WheelTimer(WheelTimer const&) = delete;
+    WheelTimer& operator=(WheelTimer&&) = delete;
+    WheelTimer& operator=(WheelTimer const&) = delete;
+
+    ~WheelTimer() override
+    {
+        stop();
+    }
+
+    void stop() override
+    {
+        if (!is_running_)
+        {
+            return;
+        }
+
+        wheel_.unschedule(this);
+        is_running_ = false;
+    }
+
+    void start() override
+    {
+        if (is_running_)
+        {
+            return;
+        }
+
+        wheel_.schedule(this);
+        is_running_ = true;
+    }
+
+    void set_callback(std::function<void()> callback) override
+    {
+        callback_ = std::move(callback);
+    }
+
+    [[nodiscard]] std::chrono::milliseconds interval() const noexcept override
+    {
+        return interval_;
+    }
+
+    void set_interval(std::chrono::milliseconds interval) override
+    {
+        TR_ASSERT_MSG(interval.count() > 0 || !is_repeating(), "repeating timers must have a positive interval");
+
+        if (interval_ == interval)
+        {
+            return;
+        }
+
+        interval_ = interval;
+        restart_if_running();
+    }
+
+    [[nodiscard]] bool is_repeating() const noexcept override
+    {
+        return is_repeating_;
+    }
+
+    void set_repeating(bool repeating) override
+    {
+        if (is_repeating_ == repeating)
+        {
+            return;
+        }
+
+        is_repeating_ = repeating;
+        restart_if_running();
+    }
+
+    // Called by the wheel after it's unlinked this timer.
+    // This may be the last thing that happens to `this`,
+    // since the callback is allowed to destroy the timer.
+    void fire()
+    {
+        is_running_ = is_repeating_;
+
+        if (is_running_)
+        {
+            wheel_.schedule(this);
+        }
+
+        TR_ASSERT(callback_);
+        callback_();
+    }
+
+    // the tick on which this timer is due
+    uint64_t deadline = {};
+
+private:
+    void restart_if_running()
+    {
+        if (is_running_)
+        {
+            stop();
+            start();
+        }
+    }
+
+    WheelTimerMaker& wheel_;
+    std::function<void()> callback_;
+    std::chrono::milliseconds interval_ = std::chrono::milliseconds{ 100 };
+    bool is_repeating_ = false;
+    bool is_running_ = false;
+};
+
+// ---
+
+namespace
+{
+[[nodiscard]] uint64_t steady_now_msec()
+{
+    using namespace std::chrono;
+    return static_cast<uint64_t>(duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+// move all the nodes in `from` to the empty list `to`
+template<typename Node>
+void splice(Node& from, Node& to) noexcept
+{
+    TR_ASSERT(!to.is_linked());
+
+    if (!from.is_linked())
+    {
+        return;
+    }
+
+    to.next = from.next;
+    to.prev = from.prev;
+    to.next->prev = &to;
+    to.prev->next = &to;
+    from.prev = from.next = &from;
+}
+} // namespace
+
+WheelTimerMaker::WheelTimerMaker(TimerMaker& parent, std::chrono::milliseconds tick, NowFunc now)
+    : now_{ now ? std::move(now) : NowFunc{ steady_now_msec } }
+    , tick_{ tick }
+    , tick_msec_{ static_cast<uint64_t>(std::max(tick.count(), decltype(tick.count()){ 1 })) }
+    , current_tick_{ now_msec() / tick_msec_ }
+    , tick_timer_{ parent.create([this]() { on_tick(); }) }
+{
+    tick_timer_->set_repeating();
+    tick_timer_->set_interval(tick_);
+}
+
+std::unique_ptr<Timer> WheelTimerMaker::create()
+{
+    return std::make_unique<WheelTimer>(*this);
+}
+
+uint64_t WheelTimerMaker::now_msec() const
+{
+    return now_();
+}
+
+uint64_t WheelTimerMaker::deadline_for(std::chrono::milliseconds const interval) const
+{
+    // round up so that timers never fire early
+    auto const msec = now_msec() + static_cast<uint64_t>(std::max(interval.count(), decltype(interval.count()){ 0 }));
+    auto const deadline = (msec + tick_msec_ - 1U) / tick_msec_;
+
+    // the current tick's slot has already been processed
+    return std::max(deadline, current_tick_ + 1U);
+}
+
+void WheelTimerMaker::schedule(WheelTimer* const timer)
+{
+    TR_ASSERT(!timer->is_linked());
+
+    if (n_scheduled_ == 0U)
+    {
+        // The wheel is empty, so no timers are waiting on the ticks
+        // that went by while it was idle. Skip straight to now.
+        current_tick_ = std::max(current_tick_, now_msec() / tick_msec_);
+        tick_timer_->start();
+    }
+
+    timer->deadline = deadline_for(timer->interval());
+    insert(timer);
+    ++n_scheduled_;
+}
+
+void WheelTimerMaker::unschedule(WheelTimer* const timer) noexcept
+{
+    TR_ASSERT(timer->is_linked());
+    TR_ASSERT(n_scheduled_ > 0U);
+
+    timer->unlink();
+
+    if (--n_scheduled_ == 0U)
+    {
+        tick_timer_->stop();
+    }
+}
+
+void WheelTimerMaker::insert(WheelTimer* const timer) noexcept
+{
+    static auto constexpr MaxDelta = uint64_t{ 1U } << (SlotBits * NumLevels);
+
+    auto expires = std::max(timer->deadline, current_tick_);
+    auto const delta = expires - current_tick_;
+
+    // Timers beyond the end of the wheel wait in the last level's
+    // furthest slot and get placed again when they cascade out of it.
+    if (delta >= MaxDelta)
+    {
+        expires = current_tick_ + MaxDelta - 1U;
+    }
+
+    auto level = size_t{};
+    while (level + 1U < NumLevels && delta >= (uint64_t{ 1U } << (SlotBits * (level + 1U))))
+    {
+        ++level;
+    }
+
+    auto const slot = (expires >> (SlotBits * level)) & SlotMask;
+    levels_[level][slot].push_back(timer);
+}
+
+void WheelTimerMaker::on_tick()
+{
+    // Catch up to the clock, one tick at a time, in case the
+    // event loop was too busy to call us on every tick.
+    auto const target = now_msec() / tick_msec_;
+    while (current_tick_ < target && n_scheduled_ > 0U)
+    {
+        advance();
+    }
+}
+
+void WheelTimerMaker::advance()
+{
+    ++current_tick_;
+
+    // whenever a level wraps around, move the next slot
+    // of the level above it down into the lower levels
+    for (size_t level = 1U; level < NumLevels; ++level)
+    {
+        if (((current_tick_ >> (SlotBits * (level - 1U))) & SlotMask) != 0U)
+        {
+            break;
+        }
+
+        cascade(level);
+    }
+
+    // Fire the timers that are due. Detach them from the slot first:
+    // their callbacks may start, stop, or destroy any timer, including
+    // the ones still waiting in `due`, which works because a timer
+    // unlinks itself from whatever list it's in.
+    auto due = Node{};
+    splice(levels_[0][current_tick_ & SlotMask], due);
+
+    while (due.is_linked())
+    {
+        auto* const timer = static_cast<WheelTimer*>(due.next);
+        timer->unlink();
+        --n_scheduled_;
+        timer->fire();
+    }
+
+    if (n_scheduled_ == 0U)
+    {
+        tick_timer_->stop();
+    }
+}
+
+void WheelTimerMaker::cascade(size_t const level) noexcept
+{
+    auto pending = Node{};
+    splice(levels_[level][(current_tick_ >> (SlotBits * level)) & SlotMask], pending);
+
+    while (pending.is_linked())
+    {
+        auto* const timer = static_cast<WheelTimer*>(pending.next);
+        timer->unlink();
+        insert(timer);
+    }
+}
+
+} // namespace libtransmission
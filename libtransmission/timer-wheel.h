@@ -0,0 +1,132 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef> // size_t
+#include <cstdint> // uint64_t
+#include <functional>
+#include <memory>
+
+#include "libtransmission/timer.h"
+
+namespace libtransmission
+{
+
+/**
+ * A TimerMaker for coarse-grained timers, such as timeouts that are
+ * measured in seconds and don't care if they fire a tick late.
+ *
+ * Its timers live in a hashed hierarchical timing wheel that's driven
+ * by a single repeating timer from `parent`, so starting, stopping, and
+ * firing them costs O(1) no matter how many there are. In exchange, they
+ * are rounded up to the next tick: a timer never fires early, but it may
+ * fire up to one tick late.
+ *
+ * Timers that need better precision should use the parent TimerMaker.
+ * The WheelTimerMaker must outlive the timers it creates.
+ */
+class WheelTimerMaker final : public TimerMaker
+{
+public:
+    // returns the current time in milliseconds from an arbitrary,
+    // monotonic epoch
+    using NowFunc = std::function<uint64_t()>;
+
+    static auto constexpr DefaultTick = std::chrono::milliseconds{ 100 };
+
+    explicit WheelTimerMaker(TimerMaker& parent, std::chrono::milliseconds tick = DefaultTick, NowFunc now = {});
+    ~WheelTimerMaker() override = default;
+
+    WheelTimerMaker(WheelTimerMaker&&) = delete;
+    WheelTimerMaker(WheelTimerMaker const&) = delete;
+    WheelTimerMaker& operator=(WheelTimerMaker&&) = delete;
+    WheelTimerMaker& operator=(WheelTimerMaker const&) = delete;
+
+    using TimerMaker::create;
+    [[nodiscard]] std::unique_ptr<Timer> create() override;
+
+    // the number of timers that are currently running
+    [[nodiscard]] constexpr auto size() const noexcept
+    {
+        return n_scheduled_;
+    }
+
+    [[nodiscard]] constexpr auto tick() const noexcept
+    {
+        return tick_;
+    }
+
+private:
+    class WheelTimer;
+    friend class WheelTimer;
+
+    // An intrusive, circular, doubly-linked list node. Each slot in the
+    // wheel is a sentinel node, so timers can unlink themselves in O(1)
+    // without knowing which slot they're in.
+    struct Node
+    {
+        Node* prev = this;
+        Node* next = this;
+
+        [[nodiscard]] constexpr bool is_linked() const noexcept
+        {
+            return next != this;
+        }
+
+        void unlink() noexcept
+        {
+            prev->next = next;
+            next->prev = prev;
+            prev = next = this;
+        }
+
+        void push_back(Node* node) noexcept
+        {
+            node->prev = prev;
+            node->next = this;
+            prev->next = node;
+            prev = node;
+        }
+    };
+
+    // Four levels of 64 slots apiece. With the default 100ms tick, that's
+    // 6.4s in the first level and about 19 days across the whole wheel.
+    // Timers further out than that wait in the last level and get
+    // rescheduled as they cascade down.
+    static auto constexpr SlotBits = 6U;
+    static auto constexpr NumSlots = size_t{ 1U } << SlotBits;
+    static auto constexpr SlotMask = uint64_t{ NumSlots - 1U };
+    static auto constexpr NumLevels = size_t{ 4U };
+
+    using Level = std::array<Node, NumSlots>;
+
+    [[nodiscard]] uint64_t now_msec() const;
+    [[nodiscard]] uint64_t deadline_for(std::chrono::milliseconds interval) const;
+
+    void schedule(WheelTimer* timer);
+    void unschedule(WheelTimer* timer) noexcept;
+    void insert(WheelTimer* timer) noexcept;
+
+    void on_tick();
+    void advance();
+    void cascade(size_t level) noexcept;
+
+    NowFunc const now_;
+    std::chrono::milliseconds const tick_;
+    uint64_t const tick_msec_;
+
+    // the last tick that's been processed
+    uint64_t current_tick_ = {};
+    size_t n_scheduled_ = {};
+
+    std::array<Level, NumLevels> levels_ = {};
+
+    std::unique_ptr<Timer> const tick_timer_;
+};
+
+} // namespace libtransmission
@@ -0,0 +1,159 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <algorithm>
+#include <cstddef> // for size_t
+#include <cstdint> // for int64_t, uint64_t
+#include <optional>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "libtransmission/transmission.h"
+
+#include "libtransmission/block-info.h"
+#include "libtransmission/torrent-stream.h"
+
+void tr_torrent_stream::set_positions(std::vector<Position> positions, uint64_t now_msec)
+{
+    positions_ = std::move(positions);
+    positions_set_at_ = now_msec;
+    candidates_at_.reset();
+}
+
+void tr_torrent_stream::set_rate(uint64_t bytes_per_second, uint64_t now_msec)
+{
+    // re-anchor the positions so that playback doesn't jump
+    for (auto& pos : positions_)
+    {
+        auto const byte = playback_byte(pos, now_msec);
+        pos.offset += byte - pos.byte;
+        pos.byte = byte;
+    }
+
+    positions_set_at_ = now_msec;
+    rate_ = bytes_per_second;
+    candidates_at_.reset();
+}
+
+uint64_t tr_torrent_stream::playback_byte(Position const& pos, uint64_t now_msec) const noexcept
+{
+    auto const elapsed_msec = now_msec > positions_set_at_ ? now_msec - positions_set_at_ : uint64_t{};
+    return std::min(pos.byte + elapsed_msec * rate() / 1000U, pos.file_end);
+}
+
+int64_t tr_torrent_stream::deadline_at(Position const& pos, uint64_t byte) const noexcept
+{
+    auto const ahead = byte > pos.byte ? byte - pos.byte : uint64_t{};
+    return static_cast<int64_t>(positions_set_at_ + ahead * 1000U / rate());
+}
+
+void tr_torrent_stream::build_candidates(tr_block_info const& block_info, uint64_t now_msec) const
+{
+    candidates_.clear();
+
+    for (size_t idx = 0; idx < std::size(positions_); ++idx)
+    {
+        auto const& pos = positions_[idx];
+        if (pos.byte >= pos.file_end)
+        {
+            continue;
+        }
+
+        // Start at the reported position rather than where playback should be
+        // by now, so that pieces the player is stalled on are still included.
+        auto const window_end = playback_byte(pos, now_msec) + rate() * WindowSecs;
+        auto const first = block_info.byte_loc(pos.byte).piece;
+        auto const last = std::max(
+            block_info.byte_loc(std::min(window_end, pos.file_end) - 1U).piece,
+            std::min(first + MinWindowPieces - 1U, block_info.byte_loc(pos.file_end - 1U).piece));
+
+        for (auto piece = first; piece <= last; ++piece)
+        {
+            candidates_.push_back({ piece, deadline_at(pos, block_info.piece_loc(piece).byte), idx });
+        }
+    }
+
+    // if several files share a piece, keep its earliest deadline
+    std::sort(
+        std::begin(candidates_),
+        std::end(candidates_),
+        [](auto const& lhs, auto const& rhs) { return std::tie(lhs.piece, lhs.at) < std::tie(rhs.piece, rhs.at); });
+    candidates_.erase(
+        std::unique(
+            std::begin(candidates_),
+            std::end(candidates_),
+            [](auto const& lhs, auto const& rhs) { return lhs.piece == rhs.piece; }),
+        std::end(candidates_));
+
+    // most urgent first
+    std::sort(
+        std::begin(candidates_),
+        std::end(candidates_),
+        [](auto const& lhs, auto const& rhs) { return std::tie(lhs.at, lhs.piece) < std::tie(rhs.at, rhs.piece); });
+
+    candidates_at_ = now_msec;
+}
+
+std::vector<tr_stream_deadline> tr_torrent_stream::deadlines(
+    tr_block_info const& block_info,
+    HasPiece const& has_piece,
+    uint64_t now_msec) const
+{
+    if (!candidates_at_ || now_msec < *candidates_at_ || now_msec - *candidates_at_ >= CandidatesTtlMsec)
+    {
+        build_candidates(block_info, now_msec);
+    }
+
+    auto ret = std::vector<tr_stream_deadline>{};
+    auto n_added = std::vector<size_t>(std::size(positions_));
+    for (auto const& candidate : candidates_)
+    {
+        if (n_added[candidate.position] >= MaxWindowPieces || has_piece(candidate.piece))
+        {
+            continue;
+        }
+
+        ret.push_back({ candidate.piece, candidate.at - static_cast<int64_t>(now_msec) });
+        ++n_added[candidate.position];
+    }
+
+    return ret;
+}
+
+void tr_torrent_stream::on_piece_completed(tr_block_info const& block_info, tr_piece_index_t piece, uint64_t now_msec)
+{
+    auto const [piece_begin, piece_end] = block_info.byte_span_for_piece(piece);
+
+    auto deadline = std::optional<int64_t>{};
+    for (auto const& pos : positions_)
+    {
+        // is the piece inside this position's window?
+        auto const window_end = std::max(
+            playback_byte(pos, now_msec) + rate() * WindowSecs,
+            block_info.piece_loc(block_info.byte_loc(pos.byte).piece + MinWindowPieces).byte);
+        if (piece_end <= pos.byte || piece_begin >= std::min(window_end, pos.file_end))
+        {
+            continue;
+        }
+
+        auto const at = deadline_at(pos, piece_begin);
+        deadline = deadline ? std::min(*deadline, at) : at;
+    }
+
+    if (!deadline)
+    {
+        return;
+    }
+
+    if (static_cast<int64_t>(now_msec) <= *deadline)
+    {
+        ++stats_.pieces_on_time;
+    }
+    else
+    {
+        ++stats_.pieces_late;
+    }
+}
@@ -0,0 +1,144 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#pragma once
+
+#ifndef __TRANSMISSION__
+#error only libtransmission should #include this header.
+#endif
+
+#include <cstddef> // for size_t
+#include <cstdint> // for int64_t, uint64_t
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "libtransmission/transmission.h"
+
+struct tr_block_info;
+
+struct tr_stream_deadline
+{
+    tr_piece_index_t piece;
+
+    // msec until playback needs this piece; negative if it's overdue
+    int64_t msec;
+};
+
+/**
+ * Deadlines for files that are being played while they download.
+ *
+ * Each streamed file has a playback position that was reported at some
+ * time. Playback is assumed to continue from there at `rate()` bytes per
+ * second, so every piece ahead of the position has a deadline. The pieces
+ * due in the next `WindowSecs` are the deadline window.
+ */
+class tr_torrent_stream
+{
+public:
+    static constexpr auto DefaultRate = uint64_t{ 1250000U }; // 10 Mbps
+    static constexpr auto WindowSecs = uint64_t{ 20U };
+    static constexpr auto MinWindowPieces = tr_piece_index_t{ 4U };
+    static constexpr auto MaxWindowPieces = size_t{ 256U };
+
+    // how long the deadline window is reused before it's rebuilt.
+    // deadlines() is called for every peer on every request pulse
+    static constexpr auto CandidatesTtlMsec = uint64_t{ 500U };
+
+    struct Position
+    {
+        tr_file_index_t file = {};
+
+        // playback position inside the file
+        uint64_t offset = {};
+
+        // the same position and the file's end, as offsets into the torrent
+        uint64_t byte = {};
+        uint64_t file_end = {};
+    };
+
+    struct Stats
+    {
+        // window pieces that completed before / after their deadline
+        uint64_t pieces_on_time = {};
+        uint64_t pieces_late = {};
+
+        // requests sent for window blocks that were already requested from another peer
+        uint64_t duplicate_requests = {};
+    };
+
+    using HasPiece = std::function<bool(tr_piece_index_t)>;
+
+    void set_positions(std::vector<Position> positions, uint64_t now_msec);
+
+    // zero means `DefaultRate`
+    void set_rate(uint64_t bytes_per_second, uint64_t now_msec);
+
+    [[nodiscard]] constexpr auto const& positions() const noexcept
+    {
+        return positions_;
+    }
+
+    [[nodiscard]] constexpr auto rate() const noexcept
+    {
+        return rate_ != 0U ? rate_ : DefaultRate;
+    }
+
+    [[nodiscard]] bool is_active() const noexcept
+    {
+        return !std::empty(positions_);
+    }
+
+    [[nodiscard]] constexpr auto const& stats() const noexcept
+    {
+        return stats_;
+    }
+
+    // the missing pieces in the deadline window, most urgent first.
+    // `has_piece` is checked on every call, so it may change freely; the
+    // window itself is cached for `CandidatesTtlMsec` or until the
+    // positions or rate change.
+    [[nodiscard]] std::vector<tr_stream_deadline> deadlines(
+        tr_block_info const& block_info,
+        HasPiece const& has_piece,
+        uint64_t now_msec) const;
+
+    void on_piece_completed(tr_block_info const& block_info, tr_piece_index_t piece, uint64_t now_msec);
+
+    constexpr void on_duplicate_request() noexcept
+    {
+        ++stats_.duplicate_requests;
+    }
+
+private:
+    struct Candidate
+    {
+        tr_piece_index_t piece;
+
+        // when playback reaches the piece, in tr_time_msec() time
+        int64_t at;
+
+        // index into `positions_` of the position that owns `at`
+        size_t position;
+    };
+
+    // every piece in the deadline window, deduped and most urgent first
+    void build_candidates(tr_block_info const& block_info, uint64_t now_msec) const;
+
+    // where playback should be now, as an offset into the torrent
+    [[nodiscard]] uint64_t playback_byte(Position const& pos, uint64_t now_msec) const noexcept;
+
+    // when playback reaches `byte`, in tr_time_msec() time
+    [[nodiscard]] int64_t deadline_at(Position const& pos, uint64_t byte) const noexcept;
+
+    std::vector<Position> positions_;
+    uint64_t positions_set_at_ = {};
+    uint64_t rate_ = {};
+
+    mutable std::vector<Candidate> candidates_;
+    mutable std::optional<uint64_t> candidates_at_;
+
+    Stats stats_;
+};
@@ -718,6 +718,7 @@ void tr_torrent::start_in_session_thread()
     bytes_uploaded_.start_new_session();
     bytes_downloaded_.start_new_session();
     bytes_corrupt_.start_new_session();
+    bytes_wasted_.start_new_session();
     set_dirty();
 
     session->announcer_->startTorrent(this);
@@ -1351,6 +1352,13 @@ tr_stat tr_torrent::stats() const
     stats.peersSendingToUs = swarm_stats.active_peer_count[TR_DOWN];
     stats.peersGettingFromUs = swarm_stats.active_peer_count[TR_UP];
     stats.webseedsSendingToUs = swarm_stats.active_webseed_count;
+    stats.peerPoolBytes = swarm_stats.peer_pool_bytes;
+
+    if (auto const n_slots = session->uploadSlotsPerTorrent(), n_pieces = size_t{ piece_count() };
+        n_slots != 0U && n_pieces != 0U)
+    {
+        stats.distributedCopiesPerSlot = static_cast<float>(swarm_stats.distributed_pieces) / n_pieces / n_slots;
+    }
 
     for (int i = 0; i < TR_PEER_FROM__MAX; i++)
     {
@@ -1383,6 +1391,7 @@ tr_stat tr_torrent::stats() const
     stats.corruptEver = this->bytes_corrupt_.ever();
     stats.downloadedEver = this->bytes_downloaded_.ever();
     stats.uploadedEver = this->bytes_uploaded_.ever();
+    stats.wastedEver = this->bytes_wasted_.ever();
     stats.haveValid = this->completion_.has_valid();
     stats.haveUnchecked = this->has_total() - stats.haveValid;
     stats.desiredAvailable = tr_peerMgrGetDesiredAvailable(this);
@@ -2201,6 +2210,60 @@ std::string_view tr_torrent::primary_mime_type() const
 
 // ---
 
+void tr_torrent::set_stream_positions(std::vector<std::pair<tr_file_index_t, uint64_t>> const& positions)
+{
+    auto stream_positions = std::vector<tr_torrent_stream::Position>{};
+    stream_positions.reserve(std::size(positions));
+
+    for (auto const& [file, offset] : positions)
+    {
+        if (file >= file_count())
+        {
+            continue;
+        }
+
+        auto const [file_begin, file_end] = fpm_.byte_span_for_file(file);
+        auto pos = tr_torrent_stream::Position{};
+        pos.file = file;
+        pos.offset = std::min(offset, file_end - file_begin);
+        pos.byte = file_begin + pos.offset;
+        pos.file_end = file_end;
+        stream_positions.emplace_back(pos);
+    }
+
+    stream_.set_positions(std::move(stream_positions), tr_time_msec());
+}
+
+void tr_torrent::set_stream_rate(uint64_t bytes_per_second)
+{
+    stream_.set_rate(bytes_per_second, tr_time_msec());
+}
+
+std::vector<tr_stream_deadline> tr_torrent::stream_deadlines() const
+{
+    if (!stream_.is_active() || !has_metainfo())
+    {
+        return {};
+    }
+
+    return stream_.deadlines(
+        block_info(),
+        [this](tr_piece_index_t piece) { return has_piece(piece) || !piece_is_wanted(piece); },
+        tr_time_msec());
+}
+
+std::optional<int64_t> tr_torrent::stream_slack_msec() const
+{
+    if (auto const deadlines = stream_deadlines(); !std::empty(deadlines))
+    {
+        return deadlines.front().msec;
+    }
+
+    return {};
+}
+
+// ---
+
 void tr_torrent::on_file_completed(tr_file_index_t const file)
 {
     /* close the file so that we can reopen in read-only mode as needed */
@@ -2220,6 +2283,11 @@ void tr_torrent::on_piece_completed(tr_piece_index_t const piece)
 {
     piece_completed_.emit(this, piece);
 
+    if (stream_.is_active())
+    {
+        stream_.on_piece_completed(block_info(), piece, tr_time_msec());
+    }
+
     // bookkeeping
     set_needs_completeness_check();
 
@@ -2252,6 +2320,7 @@ void tr_torrent::on_block_received(tr_block_index_t const block)
     {
         tr_logAddDebugTor(this, "we have this block already...");
         bytes_downloaded_.reduce(block_size(block));
+        bytes_wasted_ += block_size(block);
         return;
     }
 
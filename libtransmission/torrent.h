@@ -36,6 +36,7 @@
 #include "libtransmission/torrent-files.h"
 #include "libtransmission/torrent-magnet.h"
 #include "libtransmission/torrent-metainfo.h"
+#include "libtransmission/torrent-stream.h"
 #include "libtransmission/tr-assert.h"
 #include "libtransmission/tr-macros.h"
 #include "libtransmission/verify.h"
@@ -404,6 +405,14 @@ struct tr_torrent
         return files_wanted_.file_wanted(file);
     }
 
+    // the pieces that we want but don't have yet
+    [[nodiscard]] tr_bitfield wanted_missing_pieces() const
+    {
+        auto pieces = files_wanted_.pieces_wanted(piece_count());
+        pieces.and_not(completion_.pieces());
+        return pieces;
+    }
+
     void init_files_wanted(tr_file_index_t const* files, size_t n_files, bool wanted)
     {
         set_files_wanted(files, n_files, wanted, /*is_bootstrapping*/ true);
@@ -743,6 +752,54 @@ struct tr_torrent
         return sequential_download_;
     }
 
+    // BEP 16: while seeding, advertise one piece at a time to each
+    // new peer so that the swarm gets a full copy sooner
+    void set_super_seeding(bool is_super_seeding) noexcept
+    {
+        if (is_super_seeding != super_seeding_)
+        {
+            super_seeding_ = is_super_seeding;
+            super_seeding_changed_.emit(this, is_super_seeding);
+            set_dirty();
+        }
+    }
+
+    [[nodiscard]] constexpr auto is_super_seeding() const noexcept
+    {
+        return super_seeding_;
+    }
+
+    /// STREAMING
+
+    // Set the playback positions, as (file index, byte offset in file) pairs.
+    // An empty list stops streaming.
+    void set_stream_positions(std::vector<std::pair<tr_file_index_t, uint64_t>> const& positions);
+
+    // Set how fast playback consumes the files. Zero means the default rate.
+    void set_stream_rate(uint64_t bytes_per_second);
+
+    [[nodiscard]] constexpr auto const& stream() const noexcept
+    {
+        return stream_;
+    }
+
+    [[nodiscard]] bool is_streaming() const noexcept
+    {
+        return stream_.is_active();
+    }
+
+    // the missing pieces that playback needs soon, most urgent first
+    [[nodiscard]] std::vector<tr_stream_deadline> stream_deadlines() const;
+
+    // msec until the most urgent missing piece is overdue (negative if it
+    // already is), or nullopt if nothing we're streaming is missing.
+    [[nodiscard]] std::optional<int64_t> stream_slack_msec() const;
+
+    constexpr void on_stream_duplicate_request() noexcept
+    {
+        stream_.on_duplicate_request();
+    }
+
     [[nodiscard]] constexpr bool is_running() const noexcept
     {
         return is_running_;
@@ -958,16 +1015,19 @@ struct tr_torrent
     libtransmission::SimpleObservable<tr_torrent*, tr_piece_index_t> got_bad_piece_;
     libtransmission::SimpleObservable<tr_torrent*, tr_piece_index_t> piece_completed_;
     libtransmission::SimpleObservable<tr_torrent*> doomed_;
+    libtransmission::SimpleObservable<tr_torrent*> files_wanted_changed_;
     libtransmission::SimpleObservable<tr_torrent*> got_metainfo_;
     libtransmission::SimpleObservable<tr_torrent*> started_;
     libtransmission::SimpleObservable<tr_torrent*> stopped_;
     libtransmission::SimpleObservable<tr_torrent*> swarm_is_all_seeds_;
     libtransmission::SimpleObservable<tr_torrent*, tr_file_index_t const*, tr_file_index_t, tr_priority_t> priority_changed_;
     libtransmission::SimpleObservable<tr_torrent*, bool> sequential_download_changed_;
+    libtransmission::SimpleObservable<tr_torrent*, bool> super_seeding_changed_;
 
     CumulativeCount bytes_corrupt_;
     CumulativeCount bytes_downloaded_;
     CumulativeCount bytes_uploaded_;
+    CumulativeCount bytes_wasted_;
 
     tr_session* session = nullptr;
 
@@ -1198,6 +1258,7 @@ private:
         {
             set_dirty();
             recheck_completeness();
+            files_wanted_changed_.emit(this);
         }
     }
 
@@ -1384,6 +1445,10 @@ private:
 
     bool sequential_download_ = false;
 
+    bool super_seeding_ = false;
+
+    tr_torrent_stream stream_;
+
     // start the torrent after all the startup scaffolding is done,
     // e.g. fetching metadata from peers and/or verifying the torrent
     bool start_when_stable_ = false;
@@ -47,12 +47,29 @@ public:
         }
     }
 
+    // `src` and `tgt` may be the same buffer to process in place.
     constexpr void process(uint8_t const* const src, size_t n_bytes, uint8_t* const tgt)
     {
-        for (size_t i = 0; i != n_bytes; ++i)
+        // This is arc4_next() with the state indices kept in locals.
+        // Writes through `tgt` could alias the members, which would
+        // otherwise make the compiler reload them for every byte.
+        auto i = i_;
+        auto j = j_;
+
+        for (size_t k = 0; k != n_bytes; ++k)
         {
-            tgt[i] = src[i] ^ arc4_next();
+            i += 1;
+            auto const si = s_[i];
+            j += si;
+            auto const sj = s_[j];
+            s_[i] = sj;
+            s_[j] = si;
+
+            tgt[k] = src[k] ^ s_[static_cast<uint8_t>(si + sj)];
         }
+
+        i_ = i;
+        j_ = j;
     }
 
     constexpr void discard(size_t length)
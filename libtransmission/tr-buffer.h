@@ -8,9 +8,12 @@
 #include <algorithm> // for std::copy_n
 #include <cstddef> // size_t
 #include <memory> // std::allocator
+#include <mutex>
 #include <ratio>
 #include <string>
 #include <string_view>
+#include <utility> // std::move
+#include <vector>
 
 #include <small/vector.hpp>
 
@@ -102,7 +105,9 @@ public:
     }
 
     // Returns the number of bytes written. Check `error` for error.
-    size_t to_socket(tr_socket_t sockfd, size_t n_bytes, tr_error* error = nullptr)
+    // Set `more` if more data will be sent right after this, so that
+    // the kernel can coalesce them into fewer packets.
+    size_t to_socket(tr_socket_t sockfd, size_t n_bytes, tr_error* error = nullptr, [[maybe_unused]] bool more = false)
     {
         n_bytes = std::min(n_bytes, size());
 
@@ -111,7 +116,15 @@ public:
             return {};
         }
 
-        if (auto const n_sent = send(sockfd, reinterpret_cast<char const*>(data()), n_bytes, 0); n_sent >= 0U)
+        auto flags = 0;
+#ifdef MSG_MORE
+        if (more)
+        {
+            flags |= MSG_MORE;
+        }
+#endif
+
+        if (auto const n_sent = send(sockfd, reinterpret_cast<char const*>(data()), n_bytes, flags); n_sent >= 0U)
         {
             drain(n_sent);
             return n_sent;
@@ -318,4 +331,200 @@ private:
     size_t end_pos_ = {};
 };
 
+// A free list of buffer storage that PooledBuffers borrow while they
+// hold data and give back when they're drained, so that idle buffers
+// don't each keep their own storage.
+template<typename value_type>
+class BufferPool
+{
+public:
+    using Storage = std::vector<value_type>;
+
+    // Keeps at most `max_idle_bytes` of idle storage;
+    // anything returned beyond that is freed.
+    explicit BufferPool(size_t max_idle_bytes) noexcept
+        : max_idle_bytes_{ max_idle_bytes }
+    {
+    }
+
+    BufferPool(BufferPool&&) = delete;
+    BufferPool(BufferPool const&) = delete;
+    BufferPool& operator=(BufferPool&&) = delete;
+    BufferPool& operator=(BufferPool const&) = delete;
+    ~BufferPool() = default;
+
+    // the pool shared by all the PooledBuffers that don't specify one
+    [[nodiscard]] static BufferPool& shared()
+    {
+        static auto pool = BufferPool{ DefaultMaxIdleBytes };
+        return pool;
+    }
+
+    // Get storage that can hold at least `min_size` elements.
+    [[nodiscard]] Storage acquire(size_t min_size)
+    {
+        auto storage = Storage{};
+
+        {
+            auto const lock = std::lock_guard{ mutex_ };
+            if (!std::empty(idle_))
+            {
+                storage = std::move(idle_.back());
+                idle_.pop_back();
+                idle_bytes_ -= bytes(storage);
+            }
+        }
+
+        if (std::size(storage) < min_size)
+        {
+            storage.resize(min_size);
+        }
+
+        return storage;
+    }
+
+    void release(Storage&& storage)
+    {
+        if (std::empty(storage))
+        {
+            return;
+        }
+
+        auto const lock = std::lock_guard{ mutex_ };
+        if (idle_bytes_ + bytes(storage) <= max_idle_bytes_)
+        {
+            idle_bytes_ += bytes(storage);
+            idle_.emplace_back(std::move(storage));
+        }
+    }
+
+    // how many bytes of storage are waiting to be reused
+    [[nodiscard]] size_t idle_bytes() const
+    {
+        auto const lock = std::lock_guard{ mutex_ };
+        return idle_bytes_;
+    }
+
+private:
+    static auto constexpr DefaultMaxIdleBytes = size_t{ 8U * 1024U * 1024U };
+
+    [[nodiscard]] static constexpr size_t bytes(Storage const& storage) noexcept
+    {
+        return std::size(storage) * sizeof(value_type);
+    }
+
+    mutable std::mutex mutex_;
+    std::vector<Storage> idle_;
+    size_t idle_bytes_ = {};
+    size_t const max_idle_bytes_;
+};
+
+// A buffer that only holds storage while it has data in it.
+// Storage is borrowed from a BufferPool, starting with room for
+// `N` elements, and is given back as soon as the buffer is empty.
+template<size_t N, typename value_type = std::byte>
+class PooledBuffer final
+    : public BufferReader<value_type>
+    , public BufferWriter<value_type>
+{
+public:
+    using Pool = BufferPool<value_type>;
+
+    PooledBuffer()
+        : PooledBuffer{ Pool::shared() }
+    {
+    }
+
+    explicit PooledBuffer(Pool& pool) noexcept
+        : pool_{ pool }
+    {
+    }
+
+    PooledBuffer(PooledBuffer&&) = delete;
+    PooledBuffer(PooledBuffer const&) = delete;
+    PooledBuffer& operator=(PooledBuffer&&) = delete;
+    PooledBuffer& operator=(PooledBuffer const&) = delete;
+
+    ~PooledBuffer() override
+    {
+        pool_.release(std::move(buf_));
+    }
+
+    [[nodiscard]] size_t size() const noexcept override
+    {
+        return end_pos_ - begin_pos_;
+    }
+
+    [[nodiscard]] value_type const* data() const noexcept override
+    {
+        return std::data(buf_) + begin_pos_;
+    }
+
+    void drain(size_t n_bytes) override
+    {
+        begin_pos_ += std::min(n_bytes, size());
+        trim();
+    }
+
+    std::pair<value_type*, size_t> reserve_space(size_t n_bytes) override
+    {
+        if (n_bytes == 0U)
+        {
+            return { std::data(buf_) + end_pos_, 0U };
+        }
+
+        if (std::empty(buf_))
+        {
+            buf_ = pool_.acquire(std::max(N, n_bytes));
+        }
+        else if (auto const free_at_end = std::size(buf_) - end_pos_; free_at_end < n_bytes)
+        {
+            if (auto const total_free = begin_pos_ + free_at_end; total_free >= n_bytes)
+            {
+                // move data so that all free space is at the end
+                auto const size = this->size();
+                std::copy(data(), data() + size, std::data(buf_));
+                begin_pos_ = 0;
+                end_pos_ = size;
+            }
+            else // even `total_free` is not enough, so resize
+            {
+                buf_.resize(end_pos_ + n_bytes);
+            }
+        }
+
+        return { std::data(buf_) + end_pos_, n_bytes };
+    }
+
+    void commit_space(size_t n_bytes) override
+    {
+        end_pos_ += n_bytes;
+        trim();
+    }
+
+    // Give the storage back to the pool if the buffer is empty,
+    // e.g. after reserving space that didn't get used.
+    void trim()
+    {
+        if (begin_pos_ == end_pos_)
+        {
+            begin_pos_ = end_pos_ = 0U;
+            pool_.release(std::move(buf_));
+            buf_ = {};
+        }
+    }
+
+    // how many bytes of storage the buffer is holding
+    [[nodiscard]] size_t capacity_bytes() const noexcept
+    {
+        return std::size(buf_) * sizeof(value_type);
+    }
+
+private:
+    Pool& pool_;
+    typename Pool::Storage buf_;
+    size_t begin_pos_ = {};
+    size_t end_pos_ = {};
+};
+
 } // namespace libtransmission
@@ -65,6 +65,17 @@ enum tr_verify_added_mode
     TR_VERIFY_ADDED_FULL = 1
 };
 
+// How to pick which peers get upload slots while seeding
+enum tr_seed_choker
+{
+    // Unchoke the peers that we can upload to the fastest.
+    TR_SEED_CHOKER_FASTEST_UPLOAD = 0,
+
+    // Rotate the slots between all interested peers, favoring ones
+    // that pass our pieces on to the rest of the swarm.
+    TR_SEED_CHOKER_ROUND_ROBIN = 1
+};
+
 enum tr_encryption_mode
 {
     TR_CLEAR_PREFERRED,
@@ -1211,6 +1222,24 @@ struct tr_peer_stat
 
     /* how many requests we've made and are currently awaiting a response for */
     size_t activeReqsToPeer;
+
+    /* the socket buffer sizes in effect, as reported by the kernel
+     * (for TCP) or libutp (for uTP), or 0 if they're unknown */
+    size_t socketRcvBuf;
+    size_t socketSndBuf;
+    /* TCP_NOTSENT_LOWAT, or 0 if it's not supported */
+    size_t notsentLowat;
+    /* the most bytes that are read from the socket at once */
+    size_t readSize;
+    /* the measured round-trip time in microseconds, or 0 if the
+     * transport doesn't report one, e.g. for uTP */
+    uint32_t rttUsec;
+
+    /* how many block requests we try to keep outstanding to this peer */
+    size_t requestDepth;
+    /* the smoothed request -> block round-trip time, in milliseconds,
+     * or 0 if it hasn't been measured yet */
+    uint32_t requestRttMsec;
 };
 
 tr_peer_stat* tr_torrentPeers(tr_torrent const* torrent, size_t* peer_count);
@@ -1450,6 +1479,11 @@ struct tr_stat
         grow very large. */
     uint64_t corruptEver;
 
+    /** Byte count of all the piece data you've ever downloaded for
+        this torrent that was thrown away because it arrived after
+        another peer had already sent it, e.g. during endgame. */
+    uint64_t wastedEver;
+
     /** Byte count of all data you've ever uploaded for this torrent. */
     uint64_t uploadedEver;
 
@@ -1467,6 +1501,9 @@ struct tr_stat
         are moved to `corrupt` or `haveValid`. */
     uint64_t haveUnchecked;
 
+    /** Approximate bytes of memory used to remember this torrent's known peers. */
+    uint64_t peerPoolBytes;
+
     /** When the torrent was first added. */
     time_t addedDate;
 
@@ -1526,6 +1563,11 @@ struct tr_stat
         which caused edge cases when total download was less than sizeWhenDone. */
     float ratio;
 
+    /** How many full copies of the torrent peers have finished with data
+        that we uploaded to them in this session, per upload slot.
+        A seeding choker that spreads pieces well pushes this up. */
+    float distributedCopiesPerSlot;
+
     /** The torrent's unique Id.
         @see `tr_torrentId()` */
     tr_torrent_id_t id;
@@ -184,7 +184,7 @@ public:
         : tr_webseed{ tor_in }
         , tor{ tor_in }
         , base_url{ url }
-        , idle_timer_{ session->timerMaker().create([this]() { on_idle(); }) }
+        , idle_timer_{ session->coarseTimerMaker().create([this]() { on_idle(); }) }
         , have_{ tor_in.piece_count() }
         , bandwidth_{ &tor_in.bandwidth() }
         , callback_{ callback_in }
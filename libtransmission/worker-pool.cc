@@ -0,0 +1,73 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <algorithm> // std::clamp
+#include <cstddef> // size_t
+#include <mutex>
+#include <thread>
+#include <utility> // std::move
+
+#include "libtransmission/tr-assert.h"
+#include "libtransmission/worker-pool.h"
+
+tr_worker_pool::tr_worker_pool(size_t const max_threads)
+    : max_threads_{ max_threads }
+{
+    TR_ASSERT(max_threads_ > 0U);
+}
+
+tr_worker_pool::~tr_worker_pool()
+{
+    auto lock = std::unique_lock{ mutex_ };
+    stopping_ = true;
+    todo_.clear();
+    threads_done_cv_.wait(lock, [this]() { return n_threads_ == 0U; });
+}
+
+size_t tr_worker_pool::default_max_threads() noexcept
+{
+    // leave most of the cores for everything else
+    return std::clamp(std::thread::hardware_concurrency() / 2U, 1U, 4U);
+}
+
+void tr_worker_pool::add(Work&& work)
+{
+    auto const lock = std::scoped_lock{ mutex_ };
+
+    if (stopping_)
+    {
+        return;
+    }
+
+    todo_.emplace_back(std::move(work));
+
+    // start another thread if the existing ones are all busy
+    if (n_threads_ < max_threads_ && n_threads_ < n_busy_ + std::size(todo_))
+    {
+        ++n_threads_;
+        std::thread(&tr_worker_pool::thread_func, this).detach();
+    }
+}
+
+void tr_worker_pool::thread_func()
+{
+    auto lock = std::unique_lock{ mutex_ };
+
+    while (!stopping_ && !std::empty(todo_))
+    {
+        auto work = std::move(todo_.front());
+        todo_.pop_front();
+
+        ++n_busy_;
+        lock.unlock();
+        work();
+        work = {};
+        lock.lock();
+        --n_busy_;
+    }
+
+    --n_threads_;
+    threads_done_cv_.notify_all();
+}
@@ -0,0 +1,53 @@
+// This file Copyright © Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#pragma once
+
+#ifndef __TRANSMISSION__
+#error only libtransmission should #include this header.
+#endif
+
+#include <condition_variable>
+#include <cstddef> // size_t
+#include <deque>
+#include <functional>
+#include <mutex>
+
+// A small pool of threads for CPU-heavy work that shouldn't block
+// the session thread, e.g. the key exchange in encrypted handshakes.
+// Threads are started as needed and exit when there's nothing to do.
+class tr_worker_pool
+{
+public:
+    using Work = std::function<void()>;
+
+    explicit tr_worker_pool(size_t max_threads = default_max_threads());
+    ~tr_worker_pool();
+
+    tr_worker_pool(tr_worker_pool const&) = delete;
+    tr_worker_pool(tr_worker_pool&&) = delete;
+    tr_worker_pool& operator=(tr_worker_pool const&) = delete;
+    tr_worker_pool& operator=(tr_worker_pool&&) = delete;
+
+    // Run `work` on one of the pool's threads.
+    // Work that hasn't started when the pool is destroyed is discarded.
+    void add(Work&& work);
+
+    [[nodiscard]] static size_t default_max_threads() noexcept;
+
+private:
+    void thread_func();
+
+    std::mutex mutex_;
+    std::condition_variable threads_done_cv_;
+
+    std::deque<Work> todo_;
+
+    size_t const max_threads_;
+    size_t n_threads_ = {};
+    size_t n_busy_ = {};
+
+    bool stopping_ = false;
+};
@@ -0,0 +1,82 @@
+// This file Copyright (C) 2026 Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <cstddef> // size_t
+#include <cstdint>
+#include <limits>
+
+#include <libtransmission/transmission.h>
+
+#include <libtransmission/bandwidth.h>
+#include <libtransmission/values.h>
+
+#include "gtest/gtest.h"
+
+class BandwidthTest : public ::testing::Test
+{
+protected:
+    using Speed = libtransmission::Values::Speed;
+
+    static auto constexpr PeriodMsec = uint64_t{ 1000U };
+    static auto constexpr Now = uint64_t{ 100000U };
+    static auto constexpr Quota = size_t{ 100U * 1000U };
+    static auto constexpr Unclamped = std::numeric_limits<size_t>::max();
+
+    // a download-limited parent with a full quota for the next period
+    static void start_period(tr_bandwidth& parent)
+    {
+        parent.set_limited(TR_DOWN, true);
+        parent.set_desired_speed(TR_DOWN, Speed{ Quota, Speed::Units::Byps });
+        parent.allocate(PeriodMsec);
+    }
+};
+
+TEST_F(BandwidthTest, limitedChildUsesParentQuota)
+{
+    auto parent = tr_bandwidth{};
+    auto child = tr_bandwidth{ &parent };
+    start_period(parent);
+    EXPECT_EQ(Quota, parent.clamp(TR_DOWN, Unclamped));
+
+    child.notify_bandwidth_consumed(TR_DOWN, 1000U, true, Now);
+    EXPECT_EQ(Quota - 1000U, parent.clamp(TR_DOWN, Unclamped));
+    EXPECT_EQ(Quota - 1000U, child.clamp(TR_DOWN, Unclamped));
+}
+
+TEST_F(BandwidthTest, unlimitedChildDoesNotUseParentQuota)
+{
+    auto parent = tr_bandwidth{};
+    auto limited_child = tr_bandwidth{ &parent };
+    auto unlimited_child = tr_bandwidth{ &parent };
+    unlimited_child.honor_parent_limits(TR_DOWN, false);
+    start_period(parent);
+
+    unlimited_child.notify_bandwidth_consumed(TR_DOWN, Quota, true, Now);
+
+    // the children that honor the parent's limit still get its whole quota...
+    EXPECT_EQ(Quota, parent.clamp(TR_DOWN, Unclamped));
+    EXPECT_EQ(Quota, limited_child.clamp(TR_DOWN, Unclamped));
+    EXPECT_EQ(Unclamped, unlimited_child.clamp(TR_DOWN, Unclamped));
+
+    // ...but the bytes still count towards the parent's speed
+    auto const speed = parent.get_piece_speed(Now, TR_DOWN);
+    EXPECT_FALSE(speed.is_zero());
+    EXPECT_EQ(unlimited_child.get_piece_speed(Now, TR_DOWN), speed);
+    EXPECT_EQ(unlimited_child.get_raw_speed(Now, TR_DOWN), parent.get_raw_speed(Now, TR_DOWN));
+}
+
+TEST_F(BandwidthTest, unlimitedGrandchildDoesNotUseAncestorQuota)
+{
+    auto grandparent = tr_bandwidth{};
+    auto parent = tr_bandwidth{ &grandparent };
+    auto child = tr_bandwidth{ &parent };
+    parent.honor_parent_limits(TR_DOWN, false);
+    start_period(grandparent);
+
+    child.notify_bandwidth_consumed(TR_DOWN, 1000U, true, Now);
+
+    EXPECT_EQ(Quota, grandparent.clamp(TR_DOWN, Unclamped));
+    EXPECT_EQ(child.get_piece_speed(Now, TR_DOWN), grandparent.get_piece_speed(Now, TR_DOWN));
+}
@@ -5,9 +5,12 @@
 
 #include <algorithm>
 #include <array>
+#include <chrono>
 #include <cstddef> // size_t
 #include <cstdint> // uint8_t
+#include <iostream>
 #include <limits>
+#include <optional>
 #include <vector>
 
 #include <libtransmission/crypto-utils.h>
@@ -494,3 +497,299 @@ TEST(Bitfield, intersects)
     EXPECT_TRUE(a.intersects(b));
     EXPECT_TRUE(b.intersects(a));
 }
+
+namespace
+{
+[[nodiscard]] tr_bitfield make_random_bitfield(size_t bit_count, unsigned int one_in_n)
+{
+    auto bf = tr_bitfield{ bit_count };
+    for (size_t idx = 0U; idx < bit_count; ++idx)
+    {
+        bf.set(idx, tr_rand_int(one_in_n) == 0U);
+    }
+    return bf;
+}
+} // namespace
+
+TEST(Bitfield, bitwiseAndNot)
+{
+    auto a = tr_bitfield{ 100 };
+    auto b = tr_bitfield{ 100 };
+
+    a.set_has_all();
+    b.set_has_none();
+    a.and_not(b);
+    EXPECT_TRUE(a.has_all());
+
+    a.set_has_all();
+    b.set_has_all();
+    a.and_not(b);
+    EXPECT_TRUE(a.has_none());
+
+    a.set_has_all();
+    b.set_has_none();
+    b.set_span(0U, 50U);
+    a.and_not(b);
+    EXPECT_EQ(50U, a.count());
+    EXPECT_EQ(0U, a.count(0U, 50U));
+    EXPECT_EQ(50U, a.count(50U, 100U));
+
+    for (size_t i = 0; i < 100; ++i)
+    {
+        auto const bit_count = 1U + tr_rand_int(1000U);
+        a = make_random_bitfield(bit_count, 2U);
+        b = make_random_bitfield(bit_count, 2U);
+
+        auto expected = std::vector<bool>(bit_count);
+        for (size_t idx = 0U; idx < bit_count; ++idx)
+        {
+            expected[idx] = a.test(idx) && !b.test(idx);
+        }
+
+        a.and_not(b);
+        EXPECT_TRUE(a.is_valid());
+        EXPECT_EQ(static_cast<size_t>(std::count(std::begin(expected), std::end(expected), true)), a.count());
+        for (size_t idx = 0U; idx < bit_count; ++idx)
+        {
+            EXPECT_EQ(expected[idx], a.test(idx));
+        }
+    }
+}
+
+TEST(Bitfield, countIntersection)
+{
+    auto a = tr_bitfield{ 100 };
+    auto b = tr_bitfield{ 100 };
+
+    a.set_has_all();
+    b.set_has_none();
+    EXPECT_EQ(0U, a.count_intersection(b));
+    EXPECT_EQ(0U, b.count_intersection(a));
+
+    a.set_has_all();
+    b.set_has_all();
+    EXPECT_EQ(100U, a.count_intersection(b));
+
+    a.set_has_all();
+    b.set_has_none();
+    b.set_span(10U, 35U);
+    EXPECT_EQ(25U, a.count_intersection(b));
+    EXPECT_EQ(25U, b.count_intersection(a));
+
+    for (size_t i = 0; i < 100; ++i)
+    {
+        auto const bit_count = 1U + tr_rand_int(1000U);
+        a = make_random_bitfield(bit_count, 2U);
+        b = make_random_bitfield(bit_count, 3U);
+
+        auto expected = size_t{};
+        for (size_t idx = 0U; idx < bit_count; ++idx)
+        {
+            expected += a.test(idx) && b.test(idx) ? 1U : 0U;
+        }
+
+        EXPECT_EQ(expected, a.count_intersection(b));
+        EXPECT_EQ(expected, b.count_intersection(a));
+    }
+}
+
+TEST(Bitfield, findFirstAndNot)
+{
+    auto a = tr_bitfield{ 100 };
+    auto b = tr_bitfield{ 100 };
+
+    a.set_has_none();
+    b.set_has_none();
+    EXPECT_FALSE(a.find_first_and_not(b));
+
+    a.set_has_all();
+    EXPECT_EQ(0U, a.find_first_and_not(b));
+    EXPECT_EQ(42U, a.find_first_and_not(b, 42U));
+    EXPECT_FALSE(a.find_first_and_not(b, 100U));
+
+    b.set_span(0U, 70U);
+    EXPECT_EQ(70U, a.find_first_and_not(b));
+
+    b.set_has_all();
+    EXPECT_FALSE(a.find_first_and_not(b));
+
+    for (size_t i = 0; i < 100; ++i)
+    {
+        auto const bit_count = 1U + tr_rand_int(1000U);
+        a = make_random_bitfield(bit_count, 8U);
+        b = make_random_bitfield(bit_count, 2U);
+        auto const begin = tr_rand_int(bit_count);
+
+        auto expected = std::optional<size_t>{};
+        for (auto idx = begin; idx < bit_count && !expected; ++idx)
+        {
+            if (a.test(idx) && !b.test(idx))
+            {
+                expected = idx;
+            }
+        }
+
+        EXPECT_EQ(expected, a.find_first_and_not(b, begin));
+    }
+}
+
+TEST(Bitfield, forEachSetBit)
+{
+    auto const get_bits = [](tr_bitfield const& bf)
+    {
+        auto bits = std::vector<size_t>{};
+        bf.for_each_set_bit([&bits](size_t bit) { bits.emplace_back(bit); });
+        return bits;
+    };
+
+    auto bf = tr_bitfield{ 10 };
+    EXPECT_TRUE(std::empty(get_bits(bf)));
+
+    bf.set_has_all();
+    EXPECT_EQ((std::vector<size_t>{ 0U, 1U, 2U, 3U, 4U, 5U, 6U, 7U, 8U, 9U }), get_bits(bf));
+
+    for (size_t i = 0; i < 100; ++i)
+    {
+        auto const bit_count = 1U + tr_rand_int(1000U);
+        bf = make_random_bitfield(bit_count, 4U);
+
+        auto expected = std::vector<size_t>{};
+        for (size_t idx = 0U; idx < bit_count; ++idx)
+        {
+            if (bf.test(idx))
+            {
+                expected.emplace_back(idx);
+            }
+        }
+
+        EXPECT_EQ(expected, get_bits(bf));
+    }
+}
+
+// Not run by default. Use --gtest_also_run_disabled_tests to run it.
+TEST(Bitfield, DISABLED_bulkOperationsBenchmark)
+{
+    static auto constexpr BitCount = size_t{ 1024U * 1024U };
+    static auto constexpr Iterations = 20;
+
+    // a mostly-complete download: `b` is the 98% that we have,
+    // and `c` is a peer that has about half of the pieces
+    auto a = tr_bitfield{ BitCount };
+    a.set_has_all();
+    auto b = a;
+    b.and_not(make_random_bitfield(BitCount, 50U));
+    auto const c = make_random_bitfield(BitCount, 2U);
+
+    // a peer that only has pieces that we have too
+    auto boring = c;
+    boring &= b;
+
+    auto const time = [](char const* name, auto const& per_bit, auto const& bulk)
+    {
+        auto sink = size_t{};
+
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < Iterations; ++i)
+        {
+            sink += per_bit();
+        }
+        auto const per_bit_usec = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - begin);
+
+        begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < Iterations; ++i)
+        {
+            sink -= bulk();
+        }
+        auto const bulk_usec = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin);
+
+        EXPECT_EQ(0U, sink);
+        std::cout << name << ": per-bit " << per_bit_usec.count() / Iterations << " usec, bulk "
+                  << bulk_usec.count() / Iterations << " usec" << std::endl;
+    };
+
+    time(
+        "a & ~b, then count",
+        [&]()
+        {
+            auto n = size_t{};
+            for (size_t i = 0; i < BitCount; ++i)
+            {
+                n += a.test(i) && !b.test(i) ? 1U : 0U;
+            }
+            return n;
+        },
+        [&]()
+        {
+            auto tmp = a;
+            tmp.and_not(b);
+            return tmp.count();
+        });
+
+    auto missing = a;
+    missing.and_not(b);
+
+    time(
+        "count(begin, end)",
+        [&]()
+        {
+            auto n = size_t{};
+            for (size_t i = 1U; i < BitCount - 1U; ++i)
+            {
+                n += c.test(i) ? 1U : 0U;
+            }
+            return n;
+        },
+        [&]() { return c.count(1U, BitCount - 1U); });
+
+    time(
+        "intersects",
+        [&]()
+        {
+            for (size_t i = 0; i < BitCount; ++i)
+            {
+                if (b.test(i) && missing.test(i))
+                {
+                    return size_t{ 1U };
+                }
+            }
+            return size_t{ 0U };
+        },
+        [&]() { return b.intersects(missing) ? size_t{ 1U } : size_t{ 0U }; });
+
+    time(
+        "find first in boring & ~b",
+        [&]()
+        {
+            for (size_t i = 0U; i < BitCount; ++i)
+            {
+                if (boring.test(i) && !b.test(i))
+                {
+                    return i;
+                }
+            }
+            return BitCount;
+        },
+        [&]() { return boring.find_first_and_not(b).value_or(BitCount); });
+
+    time(
+        "iterate set bits",
+        [&]()
+        {
+            auto n = size_t{};
+            for (size_t i = 0; i < BitCount; ++i)
+            {
+                if (missing.test(i))
+                {
+                    n += i;
+                }
+            }
+            return n;
+        },
+        [&]()
+        {
+            auto n = size_t{};
+            missing.for_each_set_bit([&n](size_t bit) { n += bit; });
+            return n;
+        });
+}
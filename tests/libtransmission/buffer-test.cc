@@ -3,9 +3,11 @@
 // or any future license endorsed by Mnemosyne LLC.
 // License text can be found in the licenses/ folder.
 
+#include <array>
 #include <cstddef> // std::byte
 #include <cstdint> // uint16_t, uint32_t, uint64_t
 #include <memory>
+#include <string>
 #include <string_view>
 
 #include <libtransmission/crypto-utils.h>
@@ -98,3 +100,85 @@ TEST_F(BufferTest, Numbers)
         EXPECT_EQ(expected_u8, buf.to_uint8());
     }
 }
+
+TEST_F(BufferTest, pooledBufferOnlyHoldsStorageWhileNotEmpty)
+{
+    auto pool = libtransmission::BufferPool<std::byte>{ 1024U * 1024U };
+    auto buf = libtransmission::PooledBuffer<1024, std::byte>{ pool };
+    EXPECT_EQ(0U, buf.capacity_bytes());
+
+    buf.add("Hello, World!"sv);
+    EXPECT_EQ("Hello, World!"sv, buf.to_string_view());
+    EXPECT_LE(1024U, buf.capacity_bytes());
+    EXPECT_EQ(0U, pool.idle_bytes());
+
+    // partially draining keeps the storage...
+    buf.drain(7U);
+    EXPECT_EQ("World!"sv, buf.to_string_view());
+    EXPECT_LE(1024U, buf.capacity_bytes());
+
+    // ...but emptying the buffer returns it to the pool
+    buf.drain(6U);
+    EXPECT_TRUE(std::empty(buf));
+    EXPECT_EQ(0U, buf.capacity_bytes());
+    EXPECT_LE(1024U, pool.idle_bytes());
+
+    // and the next write reuses it
+    buf.add_uint32(1234U);
+    EXPECT_EQ(0U, pool.idle_bytes());
+    EXPECT_EQ(1234U, buf.to_uint32());
+}
+
+TEST_F(BufferTest, pooledBufferGivesBackUnusedSpace)
+{
+    auto pool = libtransmission::BufferPool<std::byte>{ 1024U * 1024U };
+    auto buf = libtransmission::PooledBuffer<1024, std::byte>{ pool };
+
+    // e.g. reserving space for a socket read that came back empty
+    [[maybe_unused]] auto const reserved = buf.reserve_space(4096U);
+    EXPECT_LE(4096U, buf.capacity_bytes());
+    buf.trim();
+    EXPECT_EQ(0U, buf.capacity_bytes());
+
+    // reserving nothing doesn't take anything from the pool
+    auto const idle = pool.idle_bytes();
+    buf.commit_space(buf.reserve_space(0U).second);
+    EXPECT_EQ(0U, buf.capacity_bytes());
+    EXPECT_EQ(idle, pool.idle_bytes());
+}
+
+TEST_F(BufferTest, pooledBufferGrows)
+{
+    auto pool = libtransmission::BufferPool<std::byte>{ 1024U * 1024U };
+    auto buf = libtransmission::PooledBuffer<16, std::byte>{ pool };
+
+    auto expected = std::string{};
+    for (auto i = 0; i < 100; ++i)
+    {
+        buf.add("0123456789"sv);
+        expected += "0123456789"sv;
+    }
+
+    EXPECT_EQ(expected, buf.to_string());
+}
+
+TEST_F(BufferTest, bufferPoolLimitsIdleBytes)
+{
+    auto pool = libtransmission::BufferPool<std::byte>{ 2048U };
+
+    {
+        auto bufs = std::array<libtransmission::PooledBuffer<1024, std::byte>, 4U>{
+            libtransmission::PooledBuffer<1024, std::byte>{ pool },
+            libtransmission::PooledBuffer<1024, std::byte>{ pool },
+            libtransmission::PooledBuffer<1024, std::byte>{ pool },
+            libtransmission::PooledBuffer<1024, std::byte>{ pool },
+        };
+        for (auto& buf : bufs)
+        {
+            buf.add("data"sv);
+        }
+    }
+
+    // only two of the four buffers' storage was kept
+    EXPECT_EQ(2048U, pool.idle_bytes());
+}
@@ -3,8 +3,10 @@
 // or any future license endorsed by Mnemosyne LLC.
 // License text can be found in the licenses/ folder.
 
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <chrono>
 #include <cstddef> // std::byte, size_t
 #include <cstdint> // uint8_t
 #include <cstring>
@@ -12,9 +14,11 @@
 #include <string>
 #include <string_view>
 #include <unordered_set>
+#include <vector>
 
 #include <libtransmission/peer-mse.h>
 #include <libtransmission/crypto-utils.h>
+#include <libtransmission/tr-arc4.h>
 #include <libtransmission/tr-macros.h>
 #include <libtransmission/utils.h>
 
@@ -63,6 +67,47 @@ TEST(Crypto, DH)
     EXPECT_NE(toString(a.secret()), toString(c.secret()));
 }
 
+TEST(Crypto, DHKnownAnswer)
+{
+    using DH = tr_message_stream_encryption::DH;
+
+    auto private_key_a = DH::private_key_bigend_t{};
+    for (size_t i = 0; i < std::size(private_key_a); ++i)
+    {
+        private_key_a[i] = std::byte(i + 1U);
+    }
+    auto private_key_b = DH::private_key_bigend_t{};
+    private_key_b.fill(std::byte{ 0xFF });
+
+    auto a = DH{ private_key_a };
+    auto b = DH{ private_key_b };
+    EXPECT_EQ("9fa4c50e31ec4635ddb9ef30405e9db341313ed2"sv, tr_sha1_to_string(tr_sha1::digest(a.publicKey())));
+    EXPECT_EQ("f8cd524bd753fb9110b4b4a96b51bb3ed258bb67"sv, tr_sha1_to_string(tr_sha1::digest(b.publicKey())));
+
+    a.setPeerPublicKey(b.publicKey());
+    b.setPeerPublicKey(a.publicKey());
+    EXPECT_EQ("96a8069789bdafca594032670943bbfa7de17de6"sv, tr_sha1_to_string(tr_sha1::digest(a.secret())));
+    EXPECT_EQ(a.secret(), b.secret());
+}
+
+// Not run by default. Use --gtest_also_run_disabled_tests to run it.
+TEST(Crypto, DISABLED_DHBenchmark)
+{
+    static auto constexpr Iterations = 500;
+
+    auto const begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < Iterations; ++i)
+    {
+        auto a = tr_message_stream_encryption::DH{};
+        auto b = tr_message_stream_encryption::DH{};
+        a.setPeerPublicKey(b.publicKey());
+    }
+    auto const elapsed = std::chrono::steady_clock::now() - begin;
+
+    auto const usec = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    std::cout << "DH: " << (usec / Iterations) << " usec per handshake (2 modular exponentiations)" << std::endl;
+}
+
 TEST(Crypto, encryptDecrypt)
 {
     auto a_dh = tr_message_stream_encryption::DH{};
@@ -94,6 +139,80 @@ TEST(Crypto, encryptDecrypt)
     EXPECT_EQ(Input2, std::data(decrypted2)) << "Input2 " << Input2 << " decrypted2 " << std::data(decrypted2);
 }
 
+TEST(Crypto, arc4KnownAnswer)
+{
+    // https://en.wikipedia.org/wiki/RC4#Test_vectors
+    auto constexpr Key = "Key"sv;
+    auto constexpr Plaintext = "Plaintext"sv;
+
+    auto buf = std::array<uint8_t, std::size(Plaintext)>{};
+    std::memcpy(std::data(buf), std::data(Plaintext), std::size(buf));
+
+    auto arc4 = tr_arc4{ std::data(Key), std::size(Key) };
+    arc4.process(std::data(buf), std::size(buf), std::data(buf));
+
+    auto constexpr Expected = std::array<uint8_t, 9>{ 0xBB, 0xF3, 0x16, 0xE8, 0xD9, 0x40, 0xAF, 0x0A, 0xD3 };
+    EXPECT_EQ(Expected, buf);
+}
+
+TEST(Crypto, encryptDecryptInPlace)
+{
+    auto a_dh = tr_message_stream_encryption::DH{};
+    auto b_dh = tr_message_stream_encryption::DH{};
+
+    a_dh.setPeerPublicKey(b_dh.publicKey());
+    b_dh.setPeerPublicKey(a_dh.publicKey());
+
+    auto input = std::vector<uint8_t>(5000U);
+    tr_rand_buffer(std::data(input), std::size(input));
+
+    // encrypt it all at once
+    auto a = tr_message_stream_encryption::Filter{};
+    a.encrypt_init(false, a_dh, SomeHash);
+    auto encrypted = std::vector<uint8_t>(std::size(input));
+    a.encrypt(std::data(input), std::size(input), std::data(encrypted));
+
+    // decrypt it in place, in odd-sized chunks
+    auto b = tr_message_stream_encryption::Filter{};
+    b.decrypt_init(true, b_dh, SomeHash);
+    auto buf = encrypted;
+    auto chunk_size = size_t{ 1U };
+    for (size_t offset = 0; offset < std::size(buf); offset += chunk_size, chunk_size = chunk_size * 3U + 1U)
+    {
+        auto const n = std::min(chunk_size, std::size(buf) - offset);
+        b.decrypt(std::data(buf) + offset, n, std::data(buf) + offset);
+    }
+
+    EXPECT_EQ(input, buf);
+}
+
+// Not run by default. Use --gtest_also_run_disabled_tests to run it.
+TEST(Crypto, DISABLED_FilterBenchmark)
+{
+    static auto constexpr TotalBytes = size_t{ 256U * 1024U * 1024U };
+
+    auto dh = tr_message_stream_encryption::DH{};
+    dh.setPeerPublicKey(tr_message_stream_encryption::DH{}.publicKey());
+
+    for (auto const chunk_size : { size_t{ 16U }, size_t{ 64U }, size_t{ 1024U }, size_t{ 16384U }, size_t{ 65536U } })
+    {
+        auto buf = std::vector<uint8_t>(chunk_size);
+        auto filter = tr_message_stream_encryption::Filter{};
+        filter.encrypt_init(false, dh, SomeHash);
+
+        auto const begin = std::chrono::steady_clock::now();
+        for (size_t done = 0; done < TotalBytes; done += chunk_size)
+        {
+            filter.encrypt(std::data(buf), std::size(buf), std::data(buf));
+        }
+        auto const elapsed = std::chrono::steady_clock::now() - begin;
+
+        auto const usec = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+        std::cout << "Filter: " << chunk_size << " byte chunks: " << (TotalBytes / std::max<int64_t>(usec, 1)) << " MB/s"
+                  << std::endl;
+    }
+}
+
 TEST(Crypto, sha1)
 {
     auto hash1 = tr_sha1::digest("test"sv);
@@ -308,11 +308,13 @@ TEST_F(FilePieceMapTest, wanted)
             auto const actual = files_wanted.file_wanted(i);
             EXPECT_EQ(expected, actual) << "idx[" << i << "] expected [" << expected << "] actual [" << actual << ']';
         }
+        auto const pieces_wanted = files_wanted.pieces_wanted(block_info_.piece_count());
         for (tr_piece_index_t i = 0U; i < block_info_.piece_count(); ++i)
         {
             auto const expected = expected_pieces_wanted.test(i);
             auto const actual = files_wanted.piece_wanted(i);
             EXPECT_EQ(expected, actual) << "idx[" << i << "] expected [" << expected << "] actual [" << actual << ']';
+            EXPECT_EQ(expected, pieces_wanted.test(i)) << "idx[" << i << "] expected [" << expected << ']';
         }
     };
 
@@ -116,10 +116,6 @@ public:
             return private_key_;
         }
 
-        void set_utp_failed(tr_sha1_digest_t const& /*info_hash*/, tr_socket_address const& /*socket_address*/) override
-        {
-        }
-
         void setPrivateKeyFromBase64(std::string_view b64)
         {
             auto const str = tr_base64_decode(b64);
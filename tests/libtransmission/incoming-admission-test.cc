@@ -0,0 +1,177 @@
+// This file Copyright (C) 2026 Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <cstddef> // size_t
+#include <cstdint>
+#include <string_view>
+
+#include <fmt/core.h>
+
+#include <libtransmission/transmission.h>
+
+#include <libtransmission/incoming-admission.h>
+#include <libtransmission/net.h>
+
+#include "gtest/gtest.h"
+
+using namespace std::literals;
+
+class IncomingAdmissionTest : public ::testing::Test
+{
+protected:
+    using Verdict = tr_incoming_admission::Verdict;
+
+    class MockMediator final : public tr_incoming_admission::Mediator
+    {
+    public:
+        [[nodiscard]] size_t pending_handshakes() const override
+        {
+            return pending_handshakes_;
+        }
+
+        [[nodiscard]] bool peer_limit_reached() const override
+        {
+            return peer_limit_reached_;
+        }
+
+        [[nodiscard]] uint64_t now_msec() const override
+        {
+            return now_msec_;
+        }
+
+        size_t pending_handshakes_ = 0U;
+        bool peer_limit_reached_ = false;
+        uint64_t now_msec_ = 1000000U;
+    };
+
+    [[nodiscard]] static tr_address addr(std::string_view const str)
+    {
+        return *tr_address::from_string(str);
+    }
+
+    MockMediator mediator_;
+    tr_incoming_admission admission_{ mediator_ };
+};
+
+TEST_F(IncomingAdmissionTest, admitsByDefault)
+{
+    EXPECT_EQ(Verdict::Admit, admission_.check(addr("10.0.0.1"sv)));
+    EXPECT_EQ(Verdict::Admit, admission_.check(addr("2001:db8::1"sv)));
+    EXPECT_EQ(0U, admission_.n_dropped());
+}
+
+TEST_F(IncomingAdmissionTest, globalLimits)
+{
+    mediator_.peer_limit_reached_ = true;
+    EXPECT_EQ(Verdict::PeerLimit, admission_.check(addr("10.0.0.1"sv)));
+
+    mediator_.peer_limit_reached_ = false;
+    mediator_.pending_handshakes_ = tr_incoming_admission::MaxPendingHandshakes;
+    EXPECT_EQ(Verdict::PendingHandshakes, admission_.check(addr("10.0.0.1"sv)));
+
+    mediator_.pending_handshakes_ = tr_incoming_admission::MaxPendingHandshakes - 1U;
+    EXPECT_EQ(Verdict::Admit, admission_.check(addr("10.0.0.1"sv)));
+
+    EXPECT_EQ(1U, admission_.n_dropped(Verdict::PeerLimit));
+    EXPECT_EQ(1U, admission_.n_dropped(Verdict::PendingHandshakes));
+    EXPECT_EQ(2U, admission_.n_dropped());
+}
+
+TEST_F(IncomingAdmissionTest, perAddressBucket)
+{
+    auto const a = addr("10.0.0.1"sv);
+    for (uint64_t i = 0U; i < tr_incoming_admission::PerAddressBurst; ++i)
+    {
+        EXPECT_EQ(Verdict::Admit, admission_.check(a));
+    }
+    EXPECT_EQ(Verdict::PerAddress, admission_.check(a));
+
+    // other addresses in the same subnet are unaffected
+    EXPECT_EQ(Verdict::Admit, admission_.check(addr("10.0.0.2"sv)));
+
+    // the bucket refills one token per interval
+    mediator_.now_msec_ += tr_incoming_admission::PerAddressIntervalMsec;
+    EXPECT_EQ(Verdict::Admit, admission_.check(a));
+    EXPECT_EQ(Verdict::PerAddress, admission_.check(a));
+
+    EXPECT_EQ(2U, admission_.n_dropped(Verdict::PerAddress));
+}
+
+TEST_F(IncomingAdmissionTest, perSubnetBucket)
+{
+    for (uint64_t i = 0U; i < tr_incoming_admission::PerSubnetBurst; ++i)
+    {
+        EXPECT_EQ(Verdict::Admit, admission_.check(addr(fmt::format("10.0.0.{:d}", i + 1U))));
+    }
+    EXPECT_EQ(Verdict::PerSubnet, admission_.check(addr("10.0.0.200"sv)));
+
+    // other subnets are unaffected
+    EXPECT_EQ(Verdict::Admit, admission_.check(addr("10.0.1.1"sv)));
+
+    mediator_.now_msec_ += tr_incoming_admission::PerSubnetIntervalMsec;
+    EXPECT_EQ(Verdict::Admit, admission_.check(addr("10.0.0.200"sv)));
+}
+
+TEST_F(IncomingAdmissionTest, ipv6Prefixes)
+{
+    // addresses in the same /64 share a bucket
+    for (uint64_t i = 0U; i < tr_incoming_admission::PerAddressBurst; ++i)
+    {
+        EXPECT_EQ(Verdict::Admit, admission_.check(addr(fmt::format("2001:db8:0:1::{:x}", i + 1U))));
+    }
+    EXPECT_EQ(Verdict::PerAddress, admission_.check(addr("2001:db8:0:1::ffff"sv)));
+    EXPECT_EQ(Verdict::Admit, admission_.check(addr("2001:db8:0:2::1"sv)));
+}
+
+TEST_F(IncomingAdmissionTest, dropsDontUseTokens)
+{
+    auto const a = addr("10.0.0.1"sv);
+    for (uint64_t i = 0U; i < tr_incoming_admission::PerAddressBurst; ++i)
+    {
+        EXPECT_EQ(Verdict::Admit, admission_.check(a));
+    }
+
+    // keep hammering; the address stays limited, but the subnet doesn't fill up
+    for (size_t i = 0U; i < 100U; ++i)
+    {
+        EXPECT_EQ(Verdict::PerAddress, admission_.check(a));
+    }
+    EXPECT_EQ(Verdict::Admit, admission_.check(addr("10.0.0.2"sv)));
+}
+
+TEST_F(IncomingAdmissionTest, trackingIsBounded)
+{
+    for (uint64_t i = 0U; i < 20000U; ++i)
+    {
+        mediator_.now_msec_ += tr_incoming_admission::PerAddressIntervalMsec;
+        auto const address = addr(fmt::format("10.{:d}.{:d}.{:d}", (i >> 16U) & 0xFF, (i >> 8U) & 0xFF, i & 0xFF));
+        EXPECT_EQ(Verdict::Admit, admission_.check(address));
+    }
+
+    EXPECT_LT(admission_.n_tracked(), 20000U);
+}
+
+TEST_F(IncomingAdmissionTest, floodKeepsThrottledBuckets)
+{
+    // empty one address's bucket
+    auto const a = addr("192.0.2.1"sv);
+    for (uint64_t i = 0U; i < tr_incoming_admission::PerAddressBurst; ++i)
+    {
+        EXPECT_EQ(Verdict::Admit, admission_.check(a));
+    }
+    EXPECT_EQ(Verdict::PerAddress, admission_.check(a));
+
+    // then get flooded from more sources than we track, all at once,
+    // so that no bucket has time to refill
+    for (uint64_t i = 0U; i < 20000U; ++i)
+    {
+        auto const address = addr(fmt::format("10.{:d}.{:d}.1", (i >> 8U) & 0xFF, i & 0xFF));
+        (void)admission_.check(address);
+    }
+    EXPECT_LT(admission_.n_tracked(), 20000U);
+
+    // the address that was being throttled still is
+    EXPECT_EQ(Verdict::PerAddress, admission_.check(a));
+}
@@ -0,0 +1,90 @@
+// This file Copyright (C) 2026 Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <string_view>
+
+#include <libtransmission/transmission.h>
+
+#include <libtransmission/lan-peers.h>
+#include <libtransmission/net.h>
+
+#include "gtest/gtest.h"
+
+using namespace std::literals;
+
+namespace
+{
+[[nodiscard]] tr_address addr(std::string_view const str)
+{
+    return *tr_address::from_string(str);
+}
+} // namespace
+
+TEST(LanPeers, localAddresses)
+{
+    for (auto const str : { "10.1.2.3"sv,
+                            "127.0.0.1"sv,
+                            "169.254.10.20"sv,
+                            "172.16.0.1"sv,
+                            "172.31.255.255"sv,
+                            "192.168.1.1"sv,
+                            "::1"sv,
+                            "fd12:3456::1"sv,
+                            "fc00::1"sv,
+                            "fe80::1"sv,
+                            "::ffff:192.168.1.1"sv })
+    {
+        EXPECT_TRUE(tr_lan_peers::is_local_address(addr(str))) << str;
+    }
+
+    for (auto const str : { "8.8.8.8"sv,
+                            "172.15.0.1"sv,
+                            "172.32.0.1"sv,
+                            "192.169.0.1"sv,
+                            "100.64.0.1"sv,
+                            "2001:db8::1"sv,
+                            "fe00::1"sv,
+                            "::ffff:8.8.8.8"sv })
+    {
+        EXPECT_FALSE(tr_lan_peers::is_local_address(addr(str))) << str;
+    }
+}
+
+TEST(LanPeers, configuredSubnets)
+{
+    auto lan = tr_lan_peers{};
+    EXPECT_FALSE(lan.contains(addr("203.0.113.7"sv)));
+
+    EXPECT_TRUE(lan.set_subnets(" 203.0.113.0/24, 198.51.100.17 ,2001:db8:1::/48,"sv));
+    EXPECT_EQ(3U, lan.n_subnets());
+
+    EXPECT_TRUE(lan.contains(addr("203.0.113.7"sv)));
+    EXPECT_FALSE(lan.contains(addr("203.0.114.7"sv)));
+    EXPECT_TRUE(lan.contains(addr("198.51.100.17"sv)));
+    EXPECT_FALSE(lan.contains(addr("198.51.100.18"sv)));
+    EXPECT_TRUE(lan.contains(addr("2001:db8:1:ffff::1"sv)));
+    EXPECT_FALSE(lan.contains(addr("2001:db8:2::1"sv)));
+
+    // local addresses are always on the LAN
+    EXPECT_TRUE(lan.contains(addr("192.168.0.1"sv)));
+
+    // prefixes that aren't on a byte boundary
+    EXPECT_TRUE(lan.set_subnets("100.64.0.0/10"sv));
+    EXPECT_TRUE(lan.contains(addr("100.127.255.255"sv)));
+    EXPECT_FALSE(lan.contains(addr("100.128.0.0"sv)));
+    EXPECT_FALSE(lan.contains(addr("203.0.113.7"sv)));
+}
+
+TEST(LanPeers, badSubnetsAreSkipped)
+{
+    auto lan = tr_lan_peers{};
+    EXPECT_FALSE(lan.set_subnets("203.0.113.0/33, nonsense, 198.51.100.0/24, 2001:db8::/129, 10.0.0.0/8x"sv));
+    EXPECT_EQ(1U, lan.n_subnets());
+    EXPECT_TRUE(lan.contains(addr("198.51.100.1"sv)));
+    EXPECT_FALSE(lan.contains(addr("203.0.113.1"sv)));
+
+    EXPECT_TRUE(lan.set_subnets(""sv));
+    EXPECT_EQ(0U, lan.n_subnets());
+}
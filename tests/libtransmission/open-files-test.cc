@@ -205,3 +205,32 @@ TEST_F(OpenFilesTest, closesLeastRecentlyUsedFile)
     EXPECT_EQ(sorted, results);
     EXPECT_GT(std::count(std::begin(results), std::end(results), true), 0);
 }
+
+#ifndef _WIN32
+TEST_F(OpenFilesTest, getSharedOutlivesThePool)
+{
+    static auto constexpr Contents = "Hello, World!\n"sv;
+    auto filename = tr_pathbuf{ sandboxDir(), "/test-file.txt" };
+    createFileWithContents(filename, Contents);
+
+    // only files that are already in the pool can be shared
+    EXPECT_FALSE(session_->openFiles().get_shared(0, 0));
+    EXPECT_TRUE(session_->openFiles().get(0, 0, false, filename, PreallocateFull, std::size(Contents)));
+
+    // everyone shares one descriptor
+    auto const shared1 = session_->openFiles().get_shared(0, 0);
+    auto const shared2 = session_->openFiles().get_shared(0, 0);
+    EXPECT_TRUE(shared1);
+    EXPECT_EQ(shared1, shared2);
+    assert(shared1);
+
+    // it stays usable after the pool closes the file
+    session_->openFiles().close_file(0, 0);
+    EXPECT_FALSE(session_->openFiles().get(0, 0, false));
+
+    auto buf = std::array<char, std::size(Contents)>{};
+    auto bytes_read = uint64_t{};
+    EXPECT_TRUE(tr_sys_file_read_at(*shared1, std::data(buf), std::size(buf), 0, &bytes_read));
+    EXPECT_EQ(Contents, (std::string_view{ std::data(buf), static_cast<size_t>(bytes_read) }));
+}
+#endif
@@ -0,0 +1,515 @@
+// This file Copyright (C) 2024 Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <array>
+#include <cerrno>
+#include <cstddef> // size_t, std::byte
+#include <cstdint> // uint32_t, uint64_t
+#include <future>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#endif
+
+#include <event2/util.h>
+
+#include <libtransmission/transmission.h>
+
+#include <libtransmission/crypto-utils.h>
+#include <libtransmission/file.h>
+#include <libtransmission/net.h>
+#include <libtransmission/peer-io.h>
+#include <libtransmission/peer-socket.h>
+#include <libtransmission/session.h>
+#include <libtransmission/tr-strbuf.h>
+#include <libtransmission/utils.h>
+#include <libtransmission/variant.h>
+
+#include "gtest/gtest.h"
+#include "test-fixtures.h"
+
+using namespace std::literals;
+
+#ifdef _WIN32
+#define LOCAL_SOCKETPAIR_AF AF_INET
+#else
+#define LOCAL_SOCKETPAIR_AF AF_UNIX
+#endif
+
+using PeerIoBuffersTest = ::testing::Test;
+
+namespace
+{
+auto constexpr Rtt100ms = uint32_t{ 100000U };
+auto constexpr OneMiB = uint64_t{ 1024U * 1024U };
+} // namespace
+
+TEST_F(PeerIoBuffersTest, holdsTwoBandwidthDelayProducts)
+{
+    // 1 MB/s * 100 ms = 100 KB in flight
+    auto constexpr OneMB = uint64_t{ 1000U * 1000U };
+    auto const bdp = OneMB / 10U;
+    auto const buffers = tr_peer_io_buffers::pick({}, OneMB, OneMB * 2U, Rtt100ms);
+    EXPECT_EQ(bdp * 2U, buffers.socket_rcvbuf);
+    EXPECT_EQ(bdp * 4U, buffers.socket_sndbuf);
+    EXPECT_EQ(buffers.socket_sndbuf / 4U, buffers.notsent_lowat);
+    EXPECT_EQ(buffers.socket_rcvbuf, buffers.read_size);
+    EXPECT_EQ(Rtt100ms, buffers.rtt_usec);
+}
+
+TEST_F(PeerIoBuffersTest, staysWithinBounds)
+{
+    auto buffers = tr_peer_io_buffers::pick({}, 0U, 0U, Rtt100ms);
+    EXPECT_EQ(tr_peer_io_buffers::MinSocketBuf, buffers.socket_rcvbuf);
+    EXPECT_EQ(tr_peer_io_buffers::MinSocketBuf, buffers.socket_sndbuf);
+    EXPECT_EQ(tr_peer_io_buffers::MinNotsentLowat, buffers.notsent_lowat);
+
+    // a 1 Gbit transatlantic link
+    buffers = tr_peer_io_buffers::pick({}, 125U * 1000U * 1000U, 125U * 1000U * 1000U, Rtt100ms);
+    EXPECT_EQ(tr_peer_io_buffers::MaxSocketBuf, buffers.socket_rcvbuf);
+    EXPECT_EQ(tr_peer_io_buffers::MaxSocketBuf, buffers.socket_sndbuf);
+    EXPECT_EQ(tr_peer_io_buffers::MaxReadSize, buffers.read_size);
+}
+
+TEST_F(PeerIoBuffersTest, windowLimitedConnectionsGrow)
+{
+    // a connection that's filling its buffer every RTT should double it
+    auto buffers = tr_peer_io_buffers::pick({}, 0U, 0U, Rtt100ms);
+    for (auto i = 0; i < 3; ++i)
+    {
+        auto const prev = buffers.socket_rcvbuf;
+        auto const window_limited_speed = uint64_t{ prev } * 1000000U / Rtt100ms;
+        buffers = tr_peer_io_buffers::pick(buffers, window_limited_speed, 0U, Rtt100ms);
+        EXPECT_EQ(prev * 2U, buffers.socket_rcvbuf);
+    }
+}
+
+TEST_F(PeerIoBuffersTest, shrinksOnlyWhenFarTooBig)
+{
+    auto const big = tr_peer_io_buffers::pick({}, 10U * OneMiB, 10U * OneMiB, Rtt100ms);
+
+    // a modest slowdown doesn't change anything...
+    auto buffers = tr_peer_io_buffers::pick(big, 4U * OneMiB, 4U * OneMiB, Rtt100ms);
+    EXPECT_EQ(big.socket_rcvbuf, buffers.socket_rcvbuf);
+    EXPECT_EQ(big.socket_sndbuf, buffers.socket_sndbuf);
+
+    // ...but a trickle does
+    buffers = tr_peer_io_buffers::pick(big, 1024U, 1024U, Rtt100ms);
+    EXPECT_EQ(tr_peer_io_buffers::MinSocketBuf, buffers.socket_rcvbuf);
+    EXPECT_EQ(tr_peer_io_buffers::MinSocketBuf, buffers.socket_sndbuf);
+}
+
+TEST_F(PeerIoBuffersTest, honorsCallersMinimum)
+{
+    // e.g. LAN peers, whose tiny RTT would otherwise keep their buffers small
+    static auto constexpr Min = size_t{ OneMiB };
+    static auto constexpr Rtt200us = uint32_t{ 200U };
+
+    auto buffers = tr_peer_io_buffers::pick({}, 100U * OneMiB, 100U * OneMiB, Rtt200us, Min);
+    EXPECT_EQ(Min, buffers.socket_rcvbuf);
+    EXPECT_EQ(Min, buffers.socket_sndbuf);
+    EXPECT_EQ(Min, buffers.read_size);
+
+    // still shrinks no further than the minimum
+    buffers = tr_peer_io_buffers::pick(buffers, 0U, 0U, Rtt200us, Min);
+    EXPECT_EQ(Min, buffers.socket_rcvbuf);
+}
+
+namespace libtransmission::test
+{
+
+class PeerIoTest : public SessionTest
+{
+protected:
+    // bigger than the sockets' buffers, so that sends only partly succeed
+    static auto constexpr ChunkSize = size_t{ 256U * 1024U };
+    static auto constexpr SocketBufSize = int{ 16U * 1024U };
+
+    // Returns a peer io on one end of a socketpair, and the other end.
+    // The io thinks it's connected to `sock_addr`.
+    auto create_io(tr_socket_address const& sock_addr)
+    {
+        auto sockpair = std::array<evutil_socket_t, 2>{ -1, -1 };
+        EXPECT_EQ(0, evutil_socketpair(LOCAL_SOCKETPAIR_AF, SOCK_STREAM, 0, std::data(sockpair))) << tr_strerror(errno);
+        for (auto const sock : sockpair)
+        {
+            evutil_make_socket_nonblocking(sock);
+            for (auto const optname : { SO_SNDBUF, SO_RCVBUF })
+            {
+                setsockopt(sock, SOL_SOCKET, optname, reinterpret_cast<char const*>(&SocketBufSize), sizeof(SocketBufSize));
+            }
+        }
+
+        auto const info_hash = tr_sha1::digest("peer-io-test"sv);
+        auto io = tr_peerIo::create(session_, &session_->top_bandwidth_, &info_hash, false /*incoming*/, false /*seed*/);
+        io->set_socket(tr_peer_socket{ session_, sock_addr, sockpair[0] });
+        return std::pair{ std::move(io), sockpair[1] };
+    }
+
+    auto create_io()
+    {
+        return create_io(PeerSockAddr);
+    }
+
+    // tr_peerIo isn't thread-safe, so poke at it from the session thread
+    template<typename Func>
+    void run_in_session_thread(Func&& func)
+    {
+        auto promise = std::promise<void>{};
+        auto future = promise.get_future();
+        session_->run_in_session_thread(
+            [&func, &promise]()
+            {
+                func();
+                promise.set_value();
+            });
+        future.wait();
+    }
+
+    [[nodiscard]] static std::vector<std::byte> make_payload(size_t n_bytes, uint8_t seed)
+    {
+        auto payload = std::vector<std::byte>(n_bytes);
+        for (size_t i = 0; i < n_bytes; ++i)
+        {
+            payload[i] = static_cast<std::byte>((i * 7U + seed) & 0xFFU);
+        }
+        return payload;
+    }
+
+    static void append(std::vector<std::byte>& tgt, std::vector<std::byte> const& src)
+    {
+        tgt.insert(std::end(tgt), std::begin(src), std::end(src));
+    }
+
+    static void read_available(evutil_socket_t sock, std::vector<std::byte>& setme)
+    {
+        auto buf = std::array<std::byte, 64U * 1024U>{};
+        for (;;)
+        {
+            auto const n_read = recv(sock, reinterpret_cast<char*>(std::data(buf)), std::size(buf), 0);
+            if (n_read <= 0)
+            {
+                return;
+            }
+
+            setme.insert(std::end(setme), std::begin(buf), std::begin(buf) + n_read);
+        }
+    }
+
+    [[nodiscard]] static auto pending_write_bytes(tr_peerIo const& io) noexcept
+    {
+        return io.pending_write_bytes();
+    }
+
+    [[nodiscard]] static auto n_chunks(tr_peerIo const& io) noexcept
+    {
+        return std::size(io.outchunks_);
+    }
+
+    // how many of the pending bytes were copied into the io's own buffer
+    [[nodiscard]] static auto n_buffered_bytes(tr_peerIo const& io) noexcept
+    {
+        return std::size(io.outbuf_);
+    }
+
+    // Checks that the outbound queue's running totals match its contents.
+    static void expect_consistent_queue(tr_peerIo const& io)
+    {
+        auto n_chunk_bytes = size_t{};
+        auto n_buffered_before = size_t{};
+        for (auto const& chunk : io.outchunks_)
+        {
+            n_chunk_bytes += chunk.n_bytes;
+            n_buffered_before += chunk.n_buffered_before;
+            EXPECT_NE(0U, chunk.n_bytes);
+        }
+
+        EXPECT_EQ(n_chunk_bytes, io.n_chunk_bytes_);
+        if (!std::empty(io.outchunks_))
+        {
+            EXPECT_EQ(std::size(io.outbuf_), n_buffered_before + io.n_buffered_after_chunks_);
+        }
+
+        auto n_info_bytes = size_t{};
+        for (auto const& [n_bytes, is_piece_data] : io.outbuf_info_)
+        {
+            n_info_bytes += n_bytes;
+        }
+
+        EXPECT_EQ(io.pending_write_bytes(), n_info_bytes);
+    }
+
+    // Flushes `io` until its queue is empty, reading what it sends from
+    // `peer_sock` as it goes. Returns what was read and how many flushes it took.
+    static std::pair<std::vector<std::byte>, size_t> flush_all(tr_peerIo& io, evutil_socket_t peer_sock)
+    {
+        static auto constexpr MaxFlushes = size_t{ 100000U };
+
+        auto received = std::vector<std::byte>{};
+        auto n_flushes = size_t{};
+        while (io.pending_write_bytes() > 0U && n_flushes < MaxFlushes)
+        {
+            auto const n_pending = io.pending_write_bytes();
+            auto const n_written = io.flush(TR_UP, n_pending);
+            EXPECT_LE(n_written, n_pending);
+            EXPECT_EQ(n_pending - n_written, io.pending_write_bytes());
+            expect_consistent_queue(io);
+
+            read_available(peer_sock, received);
+            ++n_flushes;
+        }
+
+        read_available(peer_sock, received);
+        return { std::move(received), n_flushes };
+    }
+
+    // not a LAN address, so the io keeps the socket buffers set above
+    tr_socket_address const PeerSockAddr{ *tr_address::from_string("198.51.100.1"sv), tr_port::from_host(8080) };
+
+    tr_socket_address const LanSockAddr{ *tr_address::from_string("192.168.1.2"sv), tr_port::from_host(8080) };
+};
+
+TEST_F(PeerIoTest, partialWritevsKeepQueueOrder)
+{
+    run_in_session_thread(
+        [this]()
+        {
+            auto [io, peer_sock] = create_io();
+
+            // interleave buffered protocol messages with refcounted chunks
+            auto expected = std::vector<std::byte>{};
+            for (uint8_t i = 0U; i < 4U; ++i)
+            {
+                auto const header = make_payload(13U, i);
+                io->write_bytes(std::data(header), std::size(header), false);
+                append(expected, header);
+
+                auto chunk = std::make_shared<std::vector<std::byte>>(make_payload(ChunkSize, i + 100U));
+                append(expected, *chunk);
+                auto* const data = std::data(*chunk);
+                io->write_chunk(std::shared_ptr<std::byte const>{ std::move(chunk), data }, ChunkSize, true);
+            }
+
+            auto const trailer = make_payload(100U, 200U);
+            io->write_bytes(std::data(trailer), std::size(trailer), false);
+            append(expected, trailer);
+
+            EXPECT_EQ(std::size(expected), pending_write_bytes(*io));
+            expect_consistent_queue(*io);
+
+            auto const [received, n_flushes] = flush_all(*io, peer_sock);
+            EXPECT_GT(n_flushes, 1U); // some of the writes were partial
+            EXPECT_EQ(0U, pending_write_bytes(*io));
+            EXPECT_EQ(0U, n_chunks(*io));
+            EXPECT_EQ(expected, received);
+
+            evutil_closesocket(peer_sock);
+        });
+}
+
+TEST_F(PeerIoTest, partialSendfilesKeepQueueOrder)
+{
+    run_in_session_thread(
+        [this]()
+        {
+            auto [io, peer_sock] = create_io();
+            if (!io->supports_sendfile())
+            {
+                evutil_closesocket(peer_sock);
+                GTEST_SKIP() << "sendfile() isn't supported on this platform";
+            }
+
+            auto const contents = make_payload(ChunkSize * 2U, 42U);
+            auto const filename = tr_pathbuf{ sandboxDir(), "/sendfile.bin"sv };
+            createFileWithContents(filename, std::data(contents), std::size(contents));
+            auto const fd = tr_sys_file_open(filename, TR_SYS_FILE_READ, 0);
+            ASSERT_NE(TR_BAD_SYS_FILE, fd);
+            auto const file = std::shared_ptr<tr_sys_file_t const>{ new tr_sys_file_t{ fd },
+                                                                    [](tr_sys_file_t const* pfd)
+                                                                    {
+                                                                        tr_sys_file_close(*pfd);
+                                                                        delete pfd;
+                                                                    } };
+
+            // queue both halves of the file, out of order, with
+            // buffered bytes and a memory chunk in between
+            auto expected = std::vector<std::byte>{};
+            auto const header = make_payload(13U, 1U);
+            io->write_bytes(std::data(header), std::size(header), false);
+            append(expected, header);
+
+            io->write_file(file, ChunkSize, ChunkSize, true);
+            expected.insert(std::end(expected), std::begin(contents) + ChunkSize, std::end(contents));
+
+            auto chunk = std::make_shared<std::vector<std::byte>>(make_payload(ChunkSize, 2U));
+            append(expected, *chunk);
+            auto* const data = std::data(*chunk);
+            io->write_chunk(std::shared_ptr<std::byte const>{ std::move(chunk), data }, ChunkSize, true);
+
+            io->write_file(file, 0U, ChunkSize, true);
+            expected.insert(std::end(expected), std::begin(contents), std::begin(contents) + ChunkSize);
+
+            // the queued spans share the caller's descriptor
+            EXPECT_EQ(3, file.use_count());
+            EXPECT_EQ(std::size(expected), pending_write_bytes(*io));
+            expect_consistent_queue(*io);
+
+            auto const [received, n_flushes] = flush_all(*io, peer_sock);
+            EXPECT_GT(n_flushes, 1U); // some of the writes were partial
+            EXPECT_EQ(0U, pending_write_bytes(*io));
+            EXPECT_EQ(expected, received);
+
+            // and let go of it once they've been sent
+            EXPECT_EQ(1, file.use_count());
+
+            evutil_closesocket(peer_sock);
+        });
+}
+
+TEST_F(PeerIoTest, uploadedPayloadsAreCopiedOnlyToEncrypt)
+{
+    static auto constexpr PayloadSize = size_t{ 16U * 1024U };
+
+    run_in_session_thread(
+        [this]()
+        {
+            // Queues a block-sized payload with `write` and returns how many
+            // bytes the io copied for each payload byte.
+            auto const copies_per_byte = [this](bool encrypted, auto const& write)
+            {
+                auto [io, peer_sock] = create_io();
+                if (encrypted)
+                {
+                    io->encrypt_init(false /*incoming*/, tr_message_stream_encryption::DH{}, tr_sha1::digest("peer-io-test"sv));
+                }
+
+                auto payload = std::make_shared<std::vector<std::byte>>(make_payload(PayloadSize, 7U));
+                auto* const data = std::data(*payload);
+                write(*io, std::shared_ptr<std::byte>{ std::move(payload), data });
+                EXPECT_EQ(PayloadSize, pending_write_bytes(*io));
+                auto const ret = static_cast<double>(n_buffered_bytes(*io)) / PayloadSize;
+
+                auto const [received, n_flushes] = flush_all(*io, peer_sock);
+                EXPECT_EQ(PayloadSize, std::size(received));
+
+                evutil_closesocket(peer_sock);
+                return ret;
+            };
+
+            auto const write_bytes = [](tr_peerIo& io, std::shared_ptr<std::byte> const& data)
+            {
+                io.write_bytes(data.get(), PayloadSize, true);
+            };
+            auto const write_chunk = [](tr_peerIo& io, std::shared_ptr<std::byte> data)
+            {
+                io.write_chunk(std::move(data), PayloadSize, true);
+            };
+            auto const write_owned_chunk = [](tr_peerIo& io, std::shared_ptr<std::byte> data)
+            {
+                io.write_owned_chunk(std::move(data), PayloadSize, true);
+            };
+
+            // write_bytes() is how every uploaded block used to be queued
+            auto const before = copies_per_byte(false, write_bytes);
+            auto const cached = copies_per_byte(false, write_chunk);
+            auto const uncached = copies_per_byte(false, write_owned_chunk);
+            auto const encrypted_cached = copies_per_byte(true, write_chunk);
+            auto const encrypted_uncached = copies_per_byte(true, write_owned_chunk);
+
+            RecordProperty("copies_per_byte_write_bytes", std::to_string(before));
+            RecordProperty("copies_per_byte_plaintext_cached", std::to_string(cached));
+            RecordProperty("copies_per_byte_plaintext_uncached", std::to_string(uncached));
+            RecordProperty("copies_per_byte_encrypted_cached", std::to_string(encrypted_cached));
+            RecordProperty("copies_per_byte_encrypted_uncached", std::to_string(encrypted_uncached));
+
+            EXPECT_EQ(1.0, before);
+            EXPECT_EQ(0.0, cached);
+            EXPECT_EQ(0.0, uncached);
+            // a cached block is shared, so it has to be encrypted into a copy
+            EXPECT_EQ(1.0, encrypted_cached);
+            EXPECT_EQ(0.0, encrypted_uncached);
+        });
+}
+
+TEST_F(PeerIoTest, leavesTcpBuffersToTheKernel)
+{
+    run_in_session_thread(
+        [this]()
+        {
+            auto [io, peer_sock] = create_io();
+            auto const before = io->applied_buffers();
+            EXPECT_NE(0U, before.socket_rcvbuf);
+            EXPECT_NE(0U, before.socket_sndbuf);
+
+            // setting SO_RCVBUF / SO_SNDBUF would turn off autotuning
+            auto const now = tr_time_msec();
+            io->tune_buffers(now);
+            io->tune_buffers(now + 60000U);
+            EXPECT_NE(0U, io->buffers().socket_rcvbuf);
+
+            auto const after = io->applied_buffers();
+            EXPECT_EQ(before.socket_rcvbuf, after.socket_rcvbuf);
+            EXPECT_EQ(before.socket_sndbuf, after.socket_sndbuf);
+
+            // a socketpair has no measured RTT to report
+            EXPECT_EQ(0U, after.rtt_usec);
+
+            evutil_closesocket(peer_sock);
+        });
+}
+
+TEST_F(PeerIoTest, lanSettingsReachConnectedPeers)
+{
+    auto io = std::shared_ptr<tr_peerIo>{};
+    auto peer_sock = evutil_socket_t{ -1 };
+    run_in_session_thread(
+        [this, &io, &peer_sock]()
+        {
+            std::tie(io, peer_sock) = create_io(LanSockAddr);
+            EXPECT_TRUE(io->is_lan());
+        });
+
+    auto const honors_limits = [this, &io]()
+    {
+        auto honored = std::pair<bool, bool>{};
+        run_in_session_thread(
+            [&io, &honored]()
+            {
+                honored = { io->bandwidth().are_parent_limits_honored(TR_UP),
+                            io->bandwidth().are_parent_limits_honored(TR_DOWN) };
+            });
+        return honored;
+    };
+
+    // LAN peers honor the speed limits by default...
+    EXPECT_EQ(std::pair(true, true), honors_limits());
+
+    // ...and stop as soon as that's turned off, even if they're already connected
+    auto settings = tr_sessionGetSettings(session_);
+    tr_variantDictAddBool(&settings, TR_KEY_lan_peers_unlimited, true);
+    tr_sessionSet(session_, settings);
+    EXPECT_EQ(std::pair(false, false), honors_limits());
+
+    tr_variantDictAddBool(&settings, TR_KEY_lan_peers_unlimited, false);
+    tr_sessionSet(session_, settings);
+    EXPECT_EQ(std::pair(true, true), honors_limits());
+
+    run_in_session_thread(
+        [&io, peer_sock]()
+        {
+            io.reset();
+            evutil_closesocket(peer_sock);
+        });
+}
+
+} // namespace libtransmission::test
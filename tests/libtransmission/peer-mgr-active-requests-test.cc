@@ -6,7 +6,11 @@
 #define LIBTRANSMISSION_PEER_MODULE
 
 #include <algorithm>
+#include <chrono>
+#include <cstddef> // size_t
 #include <ctime> // time_t
+#include <iostream>
+#include <utility>
 #include <vector>
 
 #include <libtransmission/transmission.h> // tr_block_index_t
@@ -189,3 +193,85 @@ TEST_F(PeerMgrActiveRequestsTest, sentBefore)
     EXPECT_EQ(block_a1, items[0].first);
     EXPECT_EQ(peer_a_, items[0].second);
 }
+
+TEST_F(PeerMgrActiveRequestsTest, sentBeforeHandlesOutOfOrderTimes)
+{
+    auto requests = ActiveRequests{};
+
+    // add requests out of order and straddling timing-wheel slot boundaries
+    auto const times = std::vector<time_t>{ 1000, 990, 1001, 1003, 1002, 995, 1007, 1004 };
+    for (size_t i = 0; i < std::size(times); ++i)
+    {
+        EXPECT_TRUE(requests.add(static_cast<tr_block_index_t>(i), peer_a_, times[i]));
+    }
+
+    for (time_t when = 985; when <= 1010; ++when)
+    {
+        auto const expected = static_cast<size_t>(
+            std::count_if(std::begin(times), std::end(times), [when](time_t sent_at) { return sent_at < when; }));
+        EXPECT_EQ(expected, std::size(requests.sentBefore(when))) << "when " << when;
+    }
+
+    // removing from the middle of the wheel keeps the remainder consistent
+    EXPECT_TRUE(requests.remove(tr_block_index_t{ 1 }, peer_a_));
+    EXPECT_TRUE(requests.remove(tr_block_index_t{ 4 }, peer_a_));
+    auto items = requests.sentBefore(1003);
+    std::sort(std::begin(items), std::end(items));
+    auto const expected = std::vector<std::pair<tr_block_index_t, tr_peer*>>{ { 0, peer_a_ }, { 2, peer_a_ }, { 5, peer_a_ } };
+    EXPECT_EQ(expected, items);
+
+    EXPECT_EQ(std::size(times) - 2U, std::size(requests.remove(peer_a_)));
+    EXPECT_EQ(0U, requests.size());
+    EXPECT_EQ(0U, std::size(requests.sentBefore(2000)));
+
+    // the pool is reused after everything has been released
+    EXPECT_TRUE(requests.add(tr_block_index_t{ 7 }, peer_b_, 50));
+    EXPECT_EQ(1U, std::size(requests.sentBefore(51)));
+    EXPECT_EQ(1U, requests.count(peer_b_));
+}
+
+// Not run by default. Use --gtest_also_run_disabled_tests to run it.
+TEST_F(PeerMgrActiveRequestsTest, DISABLED_sentBeforeBenchmark)
+{
+    static auto constexpr NumPeers = size_t{ 500U };
+    static auto constexpr NumRequests = size_t{ 50000U };
+    static auto constexpr Iterations = 1000;
+    static auto constexpr Ttl = time_t{ 90 };
+
+    auto peers = std::vector<tr_peer*>{};
+    peers.reserve(NumPeers);
+    for (size_t i = 0; i < NumPeers; ++i)
+    {
+        peers.push_back(reinterpret_cast<tr_peer*>(0x1000 + i * 16U));
+    }
+
+    // spread the outstanding requests over the last `Ttl` seconds
+    auto requests = ActiveRequests{};
+    auto now = time_t{ 100000 };
+    auto next_block = tr_block_index_t{};
+    for (size_t i = 0; i < NumRequests; ++i)
+    {
+        auto const when = now - Ttl + static_cast<time_t>(i * Ttl / NumRequests);
+        requests.add(next_block++, peers[i % NumPeers], when);
+    }
+
+    // each "second", expire the old requests and replace them with new ones
+    auto n_expired = size_t{};
+    auto const begin = std::chrono::steady_clock::now();
+    for (int iter = 0; iter < Iterations; ++iter)
+    {
+        ++now;
+        for (auto const& [block, peer] : requests.sentBefore(now - Ttl))
+        {
+            requests.remove(block, peer);
+            requests.add(next_block++, peer, now);
+            ++n_expired;
+        }
+    }
+    auto const elapsed = std::chrono::steady_clock::now() - begin;
+
+    EXPECT_EQ(NumRequests, requests.size());
+    std::cout << NumRequests << " requests, " << NumPeers << " peers: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() / Iterations
+              << " usec per sweep, " << n_expired << " expired" << std::endl;
+}
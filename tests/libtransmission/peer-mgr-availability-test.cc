@@ -0,0 +1,178 @@
+// This file Copyright (C) 2026 Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <cstddef> // size_t
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+#define LIBTRANSMISSION_PEER_MODULE
+
+#include <libtransmission/transmission.h>
+
+#include <libtransmission/bitfield.h>
+#include <libtransmission/peer-mgr-availability.h>
+
+#include "gtest/gtest.h"
+
+namespace
+{
+auto constexpr NumPieces = size_t{ 8U };
+
+[[nodiscard]] std::vector<uint16_t> make_counts(std::initializer_list<uint16_t> counts)
+{
+    return std::vector<uint16_t>{ counts };
+}
+} // namespace
+
+TEST(PieceAvailabilityTest, countsBitfieldsHavesAndDisconnects)
+{
+    auto availability = PieceAvailability{ NumPieces };
+    EXPECT_EQ(std::vector<uint16_t>(NumPieces), availability.counts());
+
+    // peer a sends a bitfield
+    auto a_has = tr_bitfield{ NumPieces };
+    a_has.set(0U);
+    a_has.set(1U);
+    availability.add(a_has);
+    EXPECT_EQ(make_counts({ 1, 1, 0, 0, 0, 0, 0, 0 }), availability.counts());
+
+    // peer b sends a have-all
+    auto b_has = tr_bitfield{ NumPieces };
+    b_has.set_has_all();
+    availability.add(b_has);
+    EXPECT_EQ(make_counts({ 2, 2, 1, 1, 1, 1, 1, 1 }), availability.counts());
+
+    // peer a sends a have. peer-msgs adds it to a's bitfield too.
+    a_has.set(2U);
+    availability.add(tr_piece_index_t{ 2U });
+    EXPECT_EQ(2U, availability.count(2U));
+
+    // when a disconnects, each of its pieces is subtracted once,
+    // including the one it announced with a have
+    availability.remove(a_has);
+    EXPECT_EQ(make_counts({ 1, 1, 1, 1, 1, 1, 1, 1 }), availability.counts());
+
+    availability.remove(b_has);
+    EXPECT_EQ(std::vector<uint16_t>(NumPieces), availability.counts());
+}
+
+TEST(PieceAvailabilityTest, ignoresPiecesOutOfRange)
+{
+    auto availability = PieceAvailability{ NumPieces };
+    availability.add(tr_piece_index_t{ NumPieces });
+    EXPECT_EQ(0U, availability.count(NumPieces));
+    EXPECT_EQ(std::vector<uint16_t>(NumPieces), availability.counts());
+}
+
+TEST(PieceAvailabilityTest, countsPeersFromBeforeTheMetainfo)
+{
+    // a magnet link doesn't know how many pieces there are yet
+    auto availability = PieceAvailability{};
+
+    auto seed_has = tr_bitfield{ 0U };
+    seed_has.set_has_all();
+    availability.add(seed_has);
+    availability.add(tr_piece_index_t{ 3U });
+    EXPECT_EQ(0U, availability.count(3U));
+
+    // once it does, the swarm recounts the peers it has
+    availability.reset(NumPieces);
+    availability.add(seed_has);
+    EXPECT_EQ(std::vector<uint16_t>(NumPieces, 1U), availability.counts());
+
+    availability.remove(seed_has);
+    EXPECT_EQ(std::vector<uint16_t>(NumPieces), availability.counts());
+}
+
+TEST(PieceAvailabilityTest, matchesBruteForceCounts)
+{
+    static auto constexpr NumPeers = size_t{ 12U };
+    static auto constexpr NumManyPieces = size_t{ 100U };
+    static auto constexpr NumEvents = 5000;
+
+    // a tiny deterministic generator, so that the event sequence
+    // doesn't depend on the standard library's distributions
+    auto state = uint32_t{ 0x12345678U };
+    auto const next = [&state](uint32_t bound)
+    {
+        state ^= state << 13U;
+        state ^= state >> 17U;
+        state ^= state << 5U;
+        return state % bound;
+    };
+
+    auto availability = PieceAvailability{ NumManyPieces };
+    auto peers = std::vector<tr_bitfield>(NumPeers, tr_bitfield{ NumManyPieces });
+    auto connected = std::vector<bool>(NumPeers);
+
+    auto const expect_brute_force_counts = [&]()
+    {
+        for (tr_piece_index_t piece = 0U; piece < NumManyPieces; ++piece)
+        {
+            auto n_have = uint16_t{};
+            for (size_t i = 0U; i < NumPeers; ++i)
+            {
+                n_have += connected[i] && peers[i].test(piece) ? 1U : 0U;
+            }
+
+            ASSERT_EQ(n_have, availability.count(piece)) << "piece " << piece;
+        }
+    };
+
+    for (auto event = 0; event < NumEvents; ++event)
+    {
+        auto const i = next(NumPeers);
+        auto& peer_has = peers[i];
+
+        if (!connected[i])
+        {
+            // connect, then maybe send a bitfield or a have-all
+            connected[i] = true;
+            peer_has = tr_bitfield{ NumManyPieces };
+            switch (next(3U))
+            {
+            case 0U:
+                for (size_t piece = 0U; piece < NumManyPieces; ++piece)
+                {
+                    peer_has.set(piece, next(2U) == 0U);
+                }
+                availability.add(peer_has);
+                break;
+
+            case 1U:
+                peer_has.set_has_all();
+                availability.add(peer_has);
+                break;
+
+            default:
+                break;
+            }
+        }
+        else if (next(8U) == 0U)
+        {
+            availability.remove(peer_has);
+            connected[i] = false;
+        }
+        else if (auto const piece = static_cast<tr_piece_index_t>(next(NumManyPieces)); !peer_has.test(piece))
+        {
+            // peer-msgs only publishes a have the first time it's sent
+            peer_has.set(piece);
+            availability.add(piece);
+        }
+
+        expect_brute_force_counts();
+    }
+
+    for (size_t i = 0U; i < NumPeers; ++i)
+    {
+        if (connected[i])
+        {
+            availability.remove(peers[i]);
+        }
+    }
+
+    EXPECT_EQ(std::vector<uint16_t>(NumManyPieces), availability.counts());
+}
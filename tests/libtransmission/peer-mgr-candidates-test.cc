@@ -0,0 +1,129 @@
+// This file Copyright (C) 2026 Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <algorithm>
+#include <cstddef> // size_t
+#include <cstdint>
+#include <ctime>
+#include <random>
+#include <vector>
+
+#include <fmt/core.h>
+
+#define LIBTRANSMISSION_PEER_MODULE
+
+#include <libtransmission/transmission.h>
+
+#include <libtransmission/net.h>
+#include <libtransmission/peer-mgr-candidates.h>
+
+#include "gtest/gtest.h"
+
+namespace
+{
+[[nodiscard]] tr_socket_address make_socket_address(size_t const n)
+{
+    auto const addr = tr_address::from_string(fmt::format("10.0.{:d}.{:d}", (n >> 8U) & 0xFF, n & 0xFF));
+    return { *addr, tr_port::from_host(6881U) };
+}
+
+[[nodiscard]] OutboundCandidateQueue::Entry make_entry(uint64_t const score, size_t const n = 0U)
+{
+    return { score, make_socket_address(n), 0U };
+}
+} // namespace
+
+TEST(OutboundCandidateQueueTest, emptyQueue)
+{
+    auto const queue = OutboundCandidateQueue{};
+
+    EXPECT_EQ(nullptr, queue.top());
+    EXPECT_EQ(0U, std::size(queue));
+}
+
+TEST(OutboundCandidateQueueTest, popsBestFirst)
+{
+    static auto constexpr NumEntries = size_t{ 1000U };
+
+    auto rng = std::mt19937{ 42U };
+    auto queue = OutboundCandidateQueue{};
+    auto scores = std::vector<uint64_t>{};
+    for (size_t i = 0U; i < NumEntries; ++i)
+    {
+        auto const score = static_cast<uint64_t>(rng());
+        scores.emplace_back(score);
+        queue.push(make_entry(score, i));
+    }
+    EXPECT_EQ(NumEntries, std::size(queue));
+
+    std::sort(std::begin(scores), std::end(scores));
+    for (auto const score : scores)
+    {
+        auto const* const top = queue.top();
+        ASSERT_NE(nullptr, top);
+        EXPECT_EQ(score, top->score);
+        queue.pop();
+    }
+
+    EXPECT_EQ(nullptr, queue.top());
+    EXPECT_EQ(0U, std::size(queue));
+}
+
+TEST(OutboundCandidateQueueTest, keepsEntryFields)
+{
+    auto queue = OutboundCandidateQueue{};
+    queue.push({ 10U, make_socket_address(1U), 7U });
+    queue.push({ 20U, make_socket_address(2U), 3U });
+
+    auto const* const top = queue.top();
+    ASSERT_NE(nullptr, top);
+    EXPECT_EQ(10U, top->score);
+    EXPECT_EQ(make_socket_address(1U), top->socket_address);
+    EXPECT_EQ(7U, top->generation);
+}
+
+TEST(OutboundCandidateQueueTest, deferredEntriesWaitUntilReady)
+{
+    static auto constexpr Now = time_t{ 1000 };
+
+    auto queue = OutboundCandidateQueue{};
+    queue.push(make_entry(1U, 1U));
+    queue.push(make_entry(2U, 2U));
+    queue.push(make_entry(3U, 3U));
+
+    // set aside the two best entries until different times
+    queue.defer_top(Now + 20);
+    queue.defer_top(Now + 10);
+    EXPECT_EQ(3U, std::size(queue));
+    ASSERT_NE(nullptr, queue.top());
+    EXPECT_EQ(3U, queue.top()->score);
+
+    // nothing is ready yet
+    queue.wake(Now + 9);
+    EXPECT_EQ(3U, queue.top()->score);
+
+    // only the second one is ready
+    queue.wake(Now + 10);
+    EXPECT_EQ(2U, queue.top()->score);
+
+    // both are ready and back in score order
+    queue.wake(Now + 20);
+    EXPECT_EQ(1U, queue.top()->score);
+    EXPECT_EQ(3U, std::size(queue));
+}
+
+TEST(OutboundCandidateQueueTest, clearRemovesDeferredEntries)
+{
+    auto queue = OutboundCandidateQueue{};
+    queue.push(make_entry(1U));
+    queue.push(make_entry(2U));
+    queue.defer_top(100);
+
+    queue.clear();
+    EXPECT_EQ(0U, std::size(queue));
+
+    queue.wake(1000);
+    EXPECT_EQ(nullptr, queue.top());
+}
@@ -0,0 +1,516 @@
+// This file Copyright (C) 2026 Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <algorithm>
+#include <cstddef> // size_t
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#define LIBTRANSMISSION_PEER_MODULE
+
+#include <libtransmission/peer-mgr-choker.h>
+
+#include "gtest/gtest.h"
+
+using Candidate = SeedChoker::Candidate;
+
+namespace
+{
+auto constexpr Now = uint64_t{ 1000000U };
+
+[[nodiscard]] Candidate make_waiting(uint64_t unchoked_at_msec = 0U, size_t recent_redistributions = 0U)
+{
+    auto candidate = Candidate{};
+    candidate.unchoked_at_msec = unchoked_at_msec;
+    candidate.recent_redistributions = recent_redistributions;
+    candidate.is_interested = true;
+    return candidate;
+}
+
+[[nodiscard]] Candidate make_unchoked(uint64_t unchoked_at_msec, uint64_t bytes_per_second = 1000U, size_t recent_blocks = 10U)
+{
+    auto candidate = make_waiting(unchoked_at_msec);
+    candidate.upload_bytes_per_second = bytes_per_second;
+    candidate.recent_blocks_sent = recent_blocks;
+    candidate.is_unchoked = true;
+    return candidate;
+}
+
+[[nodiscard]] size_t count_unchoked(std::vector<bool> const& unchoke)
+{
+    return std::count(std::begin(unchoke), std::end(unchoke), true);
+}
+} // namespace
+
+TEST(SeedChokerTest, unchokesUpToSlotCount)
+{
+    auto const candidates = std::vector<Candidate>(10U, make_waiting());
+
+    EXPECT_EQ(4U, count_unchoked(SeedChoker::rechoke(candidates, 4U, Now)));
+    EXPECT_EQ(10U, count_unchoked(SeedChoker::rechoke(candidates, 20U, Now)));
+    EXPECT_EQ(0U, count_unchoked(SeedChoker::rechoke(candidates, 0U, Now)));
+}
+
+TEST(SeedChokerTest, uninterestedPeersStayChoked)
+{
+    auto candidates = std::vector<Candidate>(3U, make_waiting());
+    candidates[1].is_interested = false;
+
+    auto const unchoke = SeedChoker::rechoke(candidates, 4U, Now);
+    EXPECT_TRUE(unchoke[0]);
+    EXPECT_FALSE(unchoke[1]);
+    EXPECT_TRUE(unchoke[2]);
+}
+
+TEST(SeedChokerTest, peersKeepSlotUntilTurnEnds)
+{
+    auto const candidates = std::vector<Candidate>{
+        make_unchoked(Now - SeedChoker::BaseUnchokeMsec / 2U),
+        make_unchoked(Now - SeedChoker::BaseUnchokeMsec - 1U),
+        make_waiting(Now - 60000U),
+    };
+
+    // the first peer's turn isn't over; the second's is,
+    // so it makes room for the peer that's been waiting
+    auto const unchoke = SeedChoker::rechoke(candidates, 2U, Now);
+    EXPECT_TRUE(unchoke[0]);
+    EXPECT_FALSE(unchoke[1]);
+    EXPECT_TRUE(unchoke[2]);
+}
+
+TEST(SeedChokerTest, peersWhoseTurnEndedKeepSlotIfNobodyIsWaiting)
+{
+    auto const candidates = std::vector<Candidate>{
+        make_unchoked(Now - SeedChoker::BaseUnchokeMsec - 1U),
+    };
+
+    EXPECT_TRUE(SeedChoker::rechoke(candidates, 2U, Now)[0]);
+}
+
+TEST(SeedChokerTest, fastPeersKeepSlotLonger)
+{
+    static auto constexpr Mean = uint64_t{ 1000U };
+
+    EXPECT_EQ(SeedChoker::BaseUnchokeMsec, SeedChoker::unchoke_duration_msec(Mean, Mean));
+    EXPECT_EQ(SeedChoker::BaseUnchokeMsec * 2U, SeedChoker::unchoke_duration_msec(Mean * 2U, Mean));
+    EXPECT_EQ(SeedChoker::MaxUnchokeMsec, SeedChoker::unchoke_duration_msec(Mean * 100U, Mean));
+    EXPECT_EQ(SeedChoker::MinUnchokeMsec, SeedChoker::unchoke_duration_msec(Mean / 100U, Mean));
+
+    // no rate yet? use the base duration
+    EXPECT_EQ(SeedChoker::BaseUnchokeMsec, SeedChoker::unchoke_duration_msec(0U, Mean));
+    EXPECT_EQ(SeedChoker::BaseUnchokeMsec, SeedChoker::unchoke_duration_msec(Mean, 0U));
+
+    // both peers have held their slot for 40 seconds, but only the
+    // fast one has earned that long. mean rate is 2000 B/s
+    auto const candidates = std::vector<Candidate>{
+        make_unchoked(Now - 40000U, 3000U),
+        make_unchoked(Now - 40000U, 1000U),
+        make_waiting(),
+        make_waiting(),
+    };
+    auto const unchoke = SeedChoker::rechoke(candidates, 2U, Now);
+    EXPECT_TRUE(unchoke[0]);
+    EXPECT_FALSE(unchoke[1]);
+    EXPECT_EQ(2U, count_unchoked(unchoke));
+}
+
+TEST(SeedChokerTest, longestWaitGoesFirst)
+{
+    auto const candidates = std::vector<Candidate>{
+        make_waiting(Now - 10000U),
+        make_waiting(Now - 50000U),
+        make_waiting(Now - 30000U),
+        make_waiting(0U), // never unchoked
+    };
+
+    auto const unchoke = SeedChoker::rechoke(candidates, 2U, Now);
+    EXPECT_FALSE(unchoke[0]);
+    EXPECT_TRUE(unchoke[1]);
+    EXPECT_FALSE(unchoke[2]);
+    EXPECT_TRUE(unchoke[3]);
+}
+
+TEST(SeedChokerTest, prefersPeersThatRedistribute)
+{
+    auto const candidates = std::vector<Candidate>{
+        make_waiting(Now - 40000U),
+        make_waiting(Now - 30000U, 2U),
+    };
+
+    auto const unchoke = SeedChoker::rechoke(candidates, 1U, Now);
+    EXPECT_FALSE(unchoke[0]);
+    EXPECT_TRUE(unchoke[1]);
+}
+
+TEST(SeedChokerTest, snubbedPeersLoseTheirSlot)
+{
+    auto const snubber = make_unchoked(Now - SeedChoker::SnubMsec, 0U, 0U);
+    EXPECT_TRUE(SeedChoker::is_snubbed(snubber, Now));
+
+    // give a freshly-unchoked peer time to start requesting
+    EXPECT_FALSE(SeedChoker::is_snubbed(make_unchoked(Now - SeedChoker::SnubMsec + 1U, 0U, 0U), Now));
+    EXPECT_FALSE(SeedChoker::is_snubbed(make_unchoked(Now - SeedChoker::SnubMsec, 0U, 1U), Now));
+    EXPECT_FALSE(SeedChoker::is_snubbed(make_waiting(Now - SeedChoker::SnubMsec), Now));
+
+    // a snubber loses its slot even if nobody else wants it
+    auto const unchoke = SeedChoker::rechoke({ snubber, make_waiting() }, 4U, Now);
+    EXPECT_FALSE(unchoke[0]);
+    EXPECT_TRUE(unchoke[1]);
+}
+
+TEST(SeedChokerTest, noNewUnchokesWhenMaxedOut)
+{
+    auto const candidates = std::vector<Candidate>{
+        make_unchoked(Now - 1000U),
+        make_unchoked(Now - SeedChoker::BaseUnchokeMsec - 1U),
+        make_waiting(),
+    };
+
+    auto const unchoke = SeedChoker::rechoke(candidates, 4U, Now, false);
+    EXPECT_TRUE(unchoke[0]);
+    EXPECT_FALSE(unchoke[1]);
+    EXPECT_FALSE(unchoke[2]);
+}
+
+TEST(SeedChokerTest, keepsMostRecentWhenSlotsShrink)
+{
+    auto const candidates = std::vector<Candidate>{
+        make_unchoked(Now - 3000U),
+        make_unchoked(Now - 1000U),
+        make_unchoked(Now - 2000U),
+    };
+
+    auto const unchoke = SeedChoker::rechoke(candidates, 2U, Now);
+    EXPECT_FALSE(unchoke[0]);
+    EXPECT_TRUE(unchoke[1]);
+    EXPECT_TRUE(unchoke[2]);
+}
+
+// Simulates an initial seed with a handful of upload slots feeding a
+// new swarm. Some leechers download fast but barely upload, some are
+// slow but share well, and a few never request anything. Compares the
+// stock fastest-upload choker (plus its optimistic unchoke) with the
+// round-robin SeedChoker on how quickly the swarm holds a full copy
+// without us, how much each upload slot delivered, and how long the
+// leechers take to finish.
+TEST(SeedChokerTest, roundRobinSpreadsPiecesFaster)
+{
+    static auto constexpr NumPieces = size_t{ 200U };
+    static auto constexpr NumLeechers = size_t{ 30U };
+    static auto constexpr NumSlots = size_t{ 4U };
+    static auto constexpr SeedPiecesPerTick = 3.0;
+    static auto constexpr RechokeTicks = uint64_t{ 10U };
+    static auto constexpr OptimisticTicks = RechokeTicks * 4U;
+    static auto constexpr MaxTicks = uint64_t{ 900U };
+    static auto constexpr TickMsec = uint64_t{ 1000U };
+    static auto constexpr WindowTicks = uint64_t{ 60U };
+    static auto constexpr NoPeer = std::numeric_limits<size_t>::max();
+
+    struct Result
+    {
+        uint64_t full_copy_tick = MaxTicks;
+        double copies_per_slot = {};
+        double mean_done_tick = {};
+        uint64_t last_done_tick = {};
+    };
+
+    auto const simulate = [](bool round_robin)
+    {
+        struct Leecher
+        {
+            double down = {};
+            double up = {};
+            std::vector<bool> has = std::vector<bool>(NumPieces);
+            size_t n_have = {};
+            double seed_credit = {};
+            double up_credit = {};
+            bool is_unchoked = false;
+            uint64_t unchoked_at_msec = {};
+            std::vector<uint64_t> seed_deliveries; // ticks
+            std::vector<uint64_t> redistributions; // ticks
+            uint64_t done_tick = {};
+        };
+
+        // a tiny deterministic generator, so that the simulation
+        // doesn't depend on the standard library's shuffle
+        auto state = uint32_t{ 0x12345678U };
+        auto const rng = [&state]()
+        {
+            state ^= state << 13U;
+            state ^= state >> 17U;
+            state ^= state << 5U;
+            return state;
+        };
+
+        auto leechers = std::vector<Leecher>(NumLeechers);
+        for (size_t i = 0; i < NumLeechers; ++i)
+        {
+            auto& leecher = leechers[i];
+            switch (i % 5U)
+            {
+            case 0: // fast downloader, freerider
+            case 1:
+                leecher.down = 2.0;
+                leecher.up = 0.05;
+                break;
+            case 2: // slow downloader, good sharer
+            case 3:
+                leecher.down = 0.5;
+                leecher.up = 1.0;
+                break;
+            default: // connected and interested, but never requests
+                leecher.down = 0.0;
+                leecher.up = 0.0;
+                break;
+            }
+        }
+
+        auto availability = std::vector<size_t>(NumPieces);
+        auto seeded_to = std::vector<size_t>(NumPieces, NoPeer);
+        auto distributed_pieces = size_t{};
+        auto optimistic = NoPeer;
+        auto result = Result{};
+
+        auto const count_recent = [](std::vector<uint64_t> const& ticks, uint64_t now, uint64_t window)
+        {
+            return static_cast<size_t>(
+                std::count_if(std::begin(ticks), std::end(ticks), [&](uint64_t tick) { return tick + window > now; }));
+        };
+
+        // rarest piece that `to` lacks, and that `from` has if it's a leecher
+        auto const pick_piece = [&](Leecher const& to, Leecher const* from)
+        {
+            auto best = NumPieces;
+            auto const start = static_cast<size_t>(rng() % NumPieces);
+            for (size_t j = 0; j < NumPieces; ++j)
+            {
+                auto const piece = (start + j) % NumPieces;
+                if (!to.has[piece] && (from == nullptr || from->has[piece]) &&
+                    (best == NumPieces || availability[piece] < availability[best]))
+                {
+                    best = piece;
+                }
+            }
+            return best;
+        };
+
+        auto const give = [&](size_t to_idx, size_t piece, uint64_t tick, bool from_seed)
+        {
+            auto& to = leechers[to_idx];
+            to.has[piece] = true;
+            ++to.n_have;
+            ++availability[piece];
+
+            if (from_seed)
+            {
+                seeded_to[piece] = to_idx;
+                to.seed_deliveries.emplace_back(tick);
+                ++distributed_pieces;
+            }
+            else if (auto const source = seeded_to[piece]; source != NoPeer && source != to_idx)
+            {
+                leechers[source].redistributions.emplace_back(tick);
+            }
+        };
+
+        auto const rechoke_fastest_upload = [&](uint64_t tick)
+        {
+            // mirrors rechokeUploads() for a seed: best upload rate
+            // first, incumbents win ties, plus one optimistic unchoke
+            auto order = std::vector<size_t>(NumLeechers);
+            std::iota(std::begin(order), std::end(order), 0U);
+            for (size_t i = std::size(order) - 1U; i > 0U; --i)
+            {
+                std::swap(order[i], order[rng() % (i + 1U)]);
+            }
+            std::stable_sort(
+                std::begin(order),
+                std::end(order),
+                [&](size_t a, size_t b)
+                {
+                    auto const rate_a = count_recent(leechers[a].seed_deliveries, tick, RechokeTicks);
+                    auto const rate_b = count_recent(leechers[b].seed_deliveries, tick, RechokeTicks);
+                    if (rate_a != rate_b)
+                    {
+                        return rate_a > rate_b;
+                    }
+                    return leechers[a].is_unchoked && !leechers[b].is_unchoked;
+                });
+
+            if (tick % OptimisticTicks == 0U)
+            {
+                optimistic = NoPeer;
+            }
+
+            auto n_unchoked = size_t{};
+            auto still_choked = std::vector<size_t>{};
+            for (auto const idx : order)
+            {
+                auto& leecher = leechers[idx];
+                auto const interested = leecher.n_have < NumPieces;
+                if (idx == optimistic)
+                {
+                    leecher.is_unchoked = interested;
+                }
+                else if (interested && n_unchoked < NumSlots)
+                {
+                    leecher.is_unchoked = true;
+                    ++n_unchoked;
+                }
+                else
+                {
+                    leecher.is_unchoked = false;
+                    if (interested)
+                    {
+                        still_choked.emplace_back(idx);
+                    }
+                }
+            }
+
+            if (optimistic == NoPeer && !std::empty(still_choked))
+            {
+                optimistic = still_choked[rng() % std::size(still_choked)];
+                leechers[optimistic].is_unchoked = true;
+            }
+        };
+
+        auto const rechoke_round_robin = [&](uint64_t tick)
+        {
+            auto const now_msec = tick * TickMsec;
+            auto candidates = std::vector<Candidate>{};
+            for (auto const& leecher : leechers)
+            {
+                auto& candidate = candidates.emplace_back();
+                candidate.unchoked_at_msec = leecher.unchoked_at_msec;
+                candidate.upload_bytes_per_second = count_recent(leecher.seed_deliveries, tick, RechokeTicks);
+                candidate.recent_blocks_sent = count_recent(
+                    leecher.seed_deliveries,
+                    tick,
+                    SeedChoker::SnubMsec / TickMsec);
+                candidate.recent_redistributions = count_recent(leecher.redistributions, tick, WindowTicks);
+                candidate.is_interested = leecher.n_have < NumPieces;
+                candidate.is_unchoked = leecher.is_unchoked;
+            }
+
+            auto const unchoke = SeedChoker::rechoke(candidates, NumSlots, now_msec);
+            for (size_t i = 0; i < NumLeechers; ++i)
+            {
+                if (unchoke[i] && !leechers[i].is_unchoked)
+                {
+                    leechers[i].unchoked_at_msec = now_msec;
+                }
+                leechers[i].is_unchoked = unchoke[i];
+            }
+        };
+
+        for (uint64_t tick = 1U; tick <= MaxTicks; ++tick)
+        {
+            if (tick % RechokeTicks == 1U)
+            {
+                if (round_robin)
+                {
+                    rechoke_round_robin(tick);
+                }
+                else
+                {
+                    rechoke_fastest_upload(tick);
+                }
+            }
+
+            // the seed splits its upload between the unchoked leechers.
+            // bandwidth a slow leecher can't use goes to the others
+            auto unchoked = std::vector<size_t>{};
+            for (size_t idx = 0; idx < NumLeechers; ++idx)
+            {
+                if (leechers[idx].is_unchoked)
+                {
+                    unchoked.emplace_back(idx);
+                }
+            }
+            std::sort(
+                std::begin(unchoked),
+                std::end(unchoked),
+                [&](size_t a, size_t b) { return leechers[a].down < leechers[b].down; });
+            auto seed_left = SeedPiecesPerTick;
+            for (size_t i = 0, n = std::size(unchoked); i < n; ++i)
+            {
+                auto const idx = unchoked[i];
+                auto& leecher = leechers[idx];
+                auto const share = std::min(seed_left / (n - i), leecher.down);
+                seed_left -= share;
+
+                leecher.seed_credit += share;
+                for (; leecher.seed_credit >= 1.0; leecher.seed_credit -= 1.0)
+                {
+                    if (auto const piece = pick_piece(leecher, nullptr); piece != NumPieces)
+                    {
+                        give(idx, piece, tick, true);
+                    }
+                }
+            }
+
+            // the leechers trade between themselves
+            for (size_t from_idx = 0; from_idx < NumLeechers; ++from_idx)
+            {
+                auto& from = leechers[from_idx];
+                from.up_credit += from.up;
+                for (; from.up_credit >= 1.0; from.up_credit -= 1.0)
+                {
+                    auto const to_idx = static_cast<size_t>(rng() % NumLeechers);
+                    if (to_idx == from_idx || leechers[to_idx].down == 0.0)
+                    {
+                        continue;
+                    }
+
+                    if (auto const piece = pick_piece(leechers[to_idx], &from); piece != NumPieces)
+                    {
+                        give(to_idx, piece, tick, false);
+                    }
+                }
+            }
+
+            for (auto& leecher : leechers)
+            {
+                if (leecher.n_have == NumPieces && leecher.done_tick == 0U)
+                {
+                    leecher.done_tick = tick;
+                }
+            }
+
+            if (result.full_copy_tick == MaxTicks &&
+                std::all_of(std::begin(availability), std::end(availability), [](size_t n) { return n != 0U; }))
+            {
+                result.full_copy_tick = tick;
+            }
+        }
+
+        result.copies_per_slot = static_cast<double>(distributed_pieces) / NumPieces / NumSlots;
+
+        auto n_done = size_t{};
+        auto done_sum = uint64_t{};
+        for (auto const& leecher : leechers)
+        {
+            if (leecher.down != 0.0)
+            {
+                ++n_done;
+                done_sum += leecher.done_tick == 0U ? MaxTicks : leecher.done_tick;
+                result.last_done_tick = std::max(result.last_done_tick, leecher.done_tick == 0U ? MaxTicks : leecher.done_tick);
+            }
+        }
+        result.mean_done_tick = static_cast<double>(done_sum) / n_done;
+        return result;
+    };
+
+    auto const fastest = simulate(false);
+    auto const round_robin = simulate(true);
+
+    EXPECT_LE(round_robin.full_copy_tick, fastest.full_copy_tick) << "ticks until the swarm holds a full copy";
+    EXPECT_GT(round_robin.copies_per_slot, fastest.copies_per_slot) << "distributed copies per upload slot";
+    EXPECT_LT(round_robin.mean_done_tick, fastest.mean_done_tick) << "mean ticks until a leecher is done";
+    EXPECT_LT(round_robin.last_done_tick, fastest.last_done_tick) << "ticks until the last leecher is done";
+}
@@ -0,0 +1,158 @@
+// This file Copyright (C) 2026 Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <cstddef> // size_t
+#include <cstdint>
+#include <string_view>
+
+#define LIBTRANSMISSION_PEER_MODULE
+
+#include <libtransmission/transmission.h>
+
+#include <libtransmission/net.h>
+#include <libtransmission/peer-io.h>
+#include <libtransmission/peer-mgr-connect.h>
+
+#include "gtest/gtest.h"
+
+using namespace std::literals;
+
+namespace
+{
+[[nodiscard]] tr_socket_address make_socket_address(std::string_view const address)
+{
+    return { *tr_address::from_string(address), tr_port::from_host(6881U) };
+}
+
+[[nodiscard]] ConnectPlanOptions make_options()
+{
+    auto opts = ConnectPlanOptions{};
+    opts.socket_address = make_socket_address("10.0.0.1"sv);
+    return opts;
+}
+} // namespace
+
+TEST(PlanConnectAttemptsTest, racesBothTransports)
+{
+    auto const attempts = plan_connect_attempts(make_options());
+
+    ASSERT_EQ(2U, std::size(attempts));
+    EXPECT_TRUE(attempts[0].utp);
+    EXPECT_FALSE(attempts[1].utp);
+    EXPECT_EQ(make_socket_address("10.0.0.1"sv), attempts[0].socket_address);
+    EXPECT_EQ(make_socket_address("10.0.0.1"sv), attempts[1].socket_address);
+}
+
+TEST(PlanConnectAttemptsTest, honorsPreferredTransport)
+{
+    auto opts = make_options();
+    opts.preferred_transport = TR_PREFER_TCP;
+
+    auto const attempts = plan_connect_attempts(opts);
+    ASSERT_EQ(2U, std::size(attempts));
+    EXPECT_FALSE(attempts[0].utp);
+    EXPECT_TRUE(attempts[1].utp);
+}
+
+TEST(PlanConnectAttemptsTest, skipsUnusableTransports)
+{
+    auto opts = make_options();
+    opts.supports_utp = false;
+    auto attempts = plan_connect_attempts(opts);
+    ASSERT_EQ(1U, std::size(attempts));
+    EXPECT_FALSE(attempts[0].utp);
+
+    opts = make_options();
+    opts.allows_tcp = false;
+    attempts = plan_connect_attempts(opts);
+    ASSERT_EQ(1U, std::size(attempts));
+    EXPECT_TRUE(attempts[0].utp);
+
+    opts.allows_utp = false;
+    EXPECT_TRUE(std::empty(plan_connect_attempts(opts)));
+}
+
+TEST(PlanConnectAttemptsTest, sticksWithWhatWorked)
+{
+    auto opts = make_options();
+    opts.last_transport = TR_PREFER_TCP;
+
+    auto attempts = plan_connect_attempts(opts);
+    ASSERT_EQ(1U, std::size(attempts));
+    EXPECT_FALSE(attempts[0].utp);
+
+    // ...unless it's not allowed anymore
+    opts.allows_tcp = false;
+    attempts = plan_connect_attempts(opts);
+    ASSERT_EQ(1U, std::size(attempts));
+    EXPECT_TRUE(attempts[0].utp);
+}
+
+TEST(PlanConnectAttemptsTest, racesAddressFamilies)
+{
+    auto opts = make_options();
+    opts.alt_socket_address = make_socket_address("2001:db8::1"sv);
+
+    auto const attempts = plan_connect_attempts(opts);
+    ASSERT_EQ(4U, std::size(attempts));
+
+    // both families over the preferred transport first
+    EXPECT_EQ(opts.socket_address, attempts[0].socket_address);
+    EXPECT_TRUE(attempts[0].utp);
+    EXPECT_EQ(*opts.alt_socket_address, attempts[1].socket_address);
+    EXPECT_TRUE(attempts[1].utp);
+    EXPECT_EQ(opts.socket_address, attempts[2].socket_address);
+    EXPECT_FALSE(attempts[2].utp);
+    EXPECT_EQ(*opts.alt_socket_address, attempts[3].socket_address);
+    EXPECT_FALSE(attempts[3].utp);
+}
+
+TEST(PlanConnectAttemptsTest, ignoresAltAddressInSameFamily)
+{
+    auto opts = make_options();
+    opts.alt_socket_address = make_socket_address("10.0.0.2"sv);
+    opts.last_transport = TR_PREFER_UTP;
+
+    auto const attempts = plan_connect_attempts(opts);
+    ASSERT_EQ(1U, std::size(attempts));
+    EXPECT_EQ(opts.socket_address, attempts[0].socket_address);
+}
+
+TEST(ConnectLatencyStatsTest, emptyStats)
+{
+    auto const stats = ConnectLatencyStats{};
+
+    EXPECT_EQ(0U, stats.size());
+    EXPECT_EQ(0U, stats.percentile(50U));
+}
+
+TEST(ConnectLatencyStatsTest, percentiles)
+{
+    auto stats = ConnectLatencyStats{};
+    for (uint64_t msec = 100U; msec >= 1U; --msec)
+    {
+        stats.add(msec);
+    }
+
+    EXPECT_EQ(100U, stats.size());
+    EXPECT_EQ(1U, stats.percentile(0U));
+    EXPECT_EQ(51U, stats.percentile(50U));
+    EXPECT_EQ(91U, stats.percentile(90U));
+    EXPECT_EQ(100U, stats.percentile(99U));
+    EXPECT_EQ(100U, stats.percentile(100U));
+}
+
+TEST(ConnectLatencyStatsTest, oldSamplesAgeOut)
+{
+    auto stats = ConnectLatencyStats{};
+    for (size_t i = 0U; i < 5000U; ++i)
+    {
+        stats.add(i < 2500U ? 10000U : 10U);
+    }
+
+    // the window is full of the recent, fast connections
+    EXPECT_LT(0U, stats.size());
+    EXPECT_EQ(10U, stats.percentile(99U));
+}
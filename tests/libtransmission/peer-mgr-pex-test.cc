@@ -0,0 +1,203 @@
+// This file Copyright (C) 2026 Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <algorithm>
+#include <cstddef> // size_t
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/core.h>
+
+#define LIBTRANSMISSION_PEER_MODULE
+
+#include <libtransmission/transmission.h>
+
+#include <libtransmission/net.h>
+#include <libtransmission/peer-mgr-pex.h>
+#include <libtransmission/peer-mgr.h>
+#include <libtransmission/quark.h>
+#include <libtransmission/variant.h>
+
+#include "gtest/gtest.h"
+
+namespace
+{
+[[nodiscard]] tr_pex make_pex(size_t const n)
+{
+    auto const addr = tr_address::from_string(fmt::format("10.0.{:d}.{:d}", (n >> 8U) & 0xFF, n & 0xFF));
+    return tr_pex{ { *addr, tr_port::from_host(6881U) }, static_cast<uint8_t>(n & 0x0F) };
+}
+
+[[nodiscard]] std::vector<tr_pex> make_list(std::vector<size_t> const& ns)
+{
+    auto ret = std::vector<tr_pex>{};
+    for (auto const n : ns)
+    {
+        ret.emplace_back(make_pex(n));
+    }
+    std::sort(std::begin(ret), std::end(ret));
+    return ret;
+}
+
+[[nodiscard]] PexDeltaLog::Snapshot make_snapshot(std::vector<size_t> const& ns)
+{
+    auto ret = PexDeltaLog::Snapshot{};
+    ret[TR_AF_INET] = make_list(ns);
+    return ret;
+}
+
+// apply a delta to a peer's view of the list, the way the receiving peer would
+void apply_delta(std::vector<tr_pex>& view, PexDeltaLog::Delta const& delta)
+{
+    for (auto const& pex : delta.dropped[TR_AF_INET])
+    {
+        view.erase(std::remove(std::begin(view), std::end(view), pex), std::end(view));
+    }
+
+    view.insert(std::end(view), std::begin(delta.added[TR_AF_INET]), std::end(delta.added[TR_AF_INET]));
+    std::sort(std::begin(view), std::end(view));
+}
+} // namespace
+
+TEST(PexDeltaLogTest, startsEmpty)
+{
+    auto const log = PexDeltaLog{};
+
+    EXPECT_EQ(0U, log.version());
+    auto const delta = log.delta_since(0U);
+    EXPECT_TRUE(std::empty(delta.added[TR_AF_INET]));
+    EXPECT_TRUE(std::empty(delta.dropped[TR_AF_INET]));
+}
+
+TEST(PexDeltaLogTest, onlyChangesBumpTheVersion)
+{
+    auto log = PexDeltaLog{};
+
+    log.update(make_snapshot({ 1U, 2U, 3U }));
+    EXPECT_EQ(1U, log.version());
+
+    log.update(make_snapshot({ 1U, 2U, 3U }));
+    EXPECT_EQ(1U, log.version());
+
+    log.update(make_snapshot({ 1U, 2U }));
+    EXPECT_EQ(2U, log.version());
+}
+
+TEST(PexDeltaLogTest, deltaSinceOneVersion)
+{
+    auto log = PexDeltaLog{};
+    log.update(make_snapshot({ 1U, 2U, 3U }));
+    log.update(make_snapshot({ 2U, 3U, 4U }));
+
+    auto const delta = log.delta_since(1U);
+    EXPECT_EQ(make_list({ 4U }), delta.added[TR_AF_INET]);
+    EXPECT_EQ(make_list({ 1U }), delta.dropped[TR_AF_INET]);
+
+    auto const from_scratch = log.delta_since(0U);
+    EXPECT_EQ(make_list({ 2U, 3U, 4U }), from_scratch.added[TR_AF_INET]);
+    EXPECT_TRUE(std::empty(from_scratch.dropped[TR_AF_INET]));
+}
+
+TEST(PexDeltaLogTest, deltaSinceSeveralVersionsCancelsOut)
+{
+    auto log = PexDeltaLog{};
+    log.update(make_snapshot({ 1U, 2U }));
+    log.update(make_snapshot({ 2U, 3U })); // drop 1, add 3
+    log.update(make_snapshot({ 1U, 2U })); // add 1 back, drop 3
+
+    // a peer at version 1 already has exactly this list
+    auto const delta = log.delta_since(1U);
+    EXPECT_TRUE(std::empty(delta.added[TR_AF_INET]));
+    EXPECT_TRUE(std::empty(delta.dropped[TR_AF_INET]));
+}
+
+TEST(PexDeltaLogTest, everyPeerCatchesUp)
+{
+    // peers that have seen different versions all end up
+    // with the same view of the list as the log itself
+    auto log = PexDeltaLog{};
+    auto views = std::vector<std::vector<tr_pex>>(4U);
+    auto versions = std::vector<PexDeltaLog::Version>(std::size(views));
+
+    for (size_t round = 0U; round < 20U; ++round)
+    {
+        auto ns = std::vector<size_t>{};
+        for (size_t n = 0U; n < 30U; ++n)
+        {
+            if ((n * 7U + round * 3U) % 5U != 0U)
+            {
+                ns.emplace_back(n);
+            }
+        }
+        log.update(make_snapshot(ns));
+
+        // each peer asks on a different schedule
+        for (size_t i = 0U; i < std::size(views); ++i)
+        {
+            if (round % (i + 1U) == 0U)
+            {
+                apply_delta(views[i], log.delta_since(versions[i]));
+                versions[i] = log.version();
+                EXPECT_EQ(log.snapshot()[TR_AF_INET], views[i]) << "round " << round << " peer " << i;
+            }
+        }
+    }
+}
+
+TEST(PexDeltaLogTest, fallsBackToFullListWhenTooFarBehind)
+{
+    auto log = PexDeltaLog{};
+    for (size_t i = 1U; i <= 20U; ++i)
+    {
+        log.update(make_snapshot({ i, i + 1U }));
+    }
+
+    // version 1 is long gone from the log, so resend everything
+    auto const delta = log.delta_since(1U);
+    EXPECT_EQ(make_list({ 20U, 21U }), delta.added[TR_AF_INET]);
+    EXPECT_TRUE(std::empty(delta.dropped[TR_AF_INET]));
+}
+
+TEST(PexDeltaLogTest, messagesAreSharedAndDecodable)
+{
+    auto log = PexDeltaLog{};
+    log.update(make_snapshot({ 1U, 2U }));
+    log.update(make_snapshot({ 2U, 3U }));
+
+    // peers at the same version share one message
+    EXPECT_EQ(&log.message_since(1U), &log.message_since(1U));
+    auto const message = log.message_since(1U);
+
+    auto serde = tr_variant_serde::benc();
+    auto var = serde.parse(message);
+    ASSERT_TRUE(var);
+    auto* const map = var->get_if<tr_variant::Map>();
+    ASSERT_NE(nullptr, map);
+
+    auto const added = map->value_if<std::string_view>(TR_KEY_added);
+    auto const added_f = map->value_if<std::string_view>(TR_KEY_added_f);
+    auto const dropped = map->value_if<std::string_view>(TR_KEY_dropped);
+    ASSERT_TRUE(added && added_f && dropped);
+    EXPECT_FALSE(map->find_if<std::string_view>(TR_KEY_added6));
+
+    auto const added_pex = tr_pex::from_compact_ipv4(
+        std::data(*added),
+        std::size(*added),
+        reinterpret_cast<uint8_t const*>(std::data(*added_f)),
+        std::size(*added_f));
+    ASSERT_EQ(1U, std::size(added_pex));
+    EXPECT_EQ(make_pex(3U), added_pex.front());
+    EXPECT_EQ(make_pex(3U).flags, added_pex.front().flags);
+
+    auto const dropped_pex = tr_pex::from_compact_ipv4(std::data(*dropped), std::size(*dropped), nullptr, 0U);
+    ASSERT_EQ(1U, std::size(dropped_pex));
+    EXPECT_EQ(make_pex(1U), dropped_pex.front());
+
+    // a new version gets new messages
+    log.update(make_snapshot({ 3U }));
+    EXPECT_NE(message, log.message_since(1U));
+}
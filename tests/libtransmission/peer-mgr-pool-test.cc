@@ -0,0 +1,221 @@
+// This file Copyright (C) 2026 Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <cstddef> // size_t
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <fmt/core.h>
+
+#define LIBTRANSMISSION_PEER_MODULE
+
+#include <libtransmission/transmission.h>
+
+#include <libtransmission/net.h>
+#include <libtransmission/peer-mgr-pool.h>
+#include <libtransmission/peer-mgr.h>
+
+#include "gtest/gtest.h"
+
+namespace
+{
+[[nodiscard]] tr_socket_address make_socket_address(size_t const n)
+{
+    auto const addr = tr_address::from_string(fmt::format("10.{:d}.{:d}.{:d}", (n >> 16U) & 0xFF, (n >> 8U) & 0xFF, n & 0xFF));
+    return { *addr, tr_port::from_host(static_cast<uint16_t>(6881U + n % 8U)) };
+}
+
+[[nodiscard]] std::shared_ptr<tr_peer_info> make_info(size_t const n)
+{
+    return std::make_shared<tr_peer_info>(make_socket_address(n), 0U, TR_PEER_FROM_PEX);
+}
+
+[[nodiscard]] std::set<tr_socket_address> addresses(PeerInfoPool const& pool)
+{
+    auto ret = std::set<tr_socket_address>{};
+    for (auto const& info : pool)
+    {
+        ret.insert(info->listen_socket_address());
+    }
+    return ret;
+}
+} // namespace
+
+TEST(PeerInfoPoolTest, emptyPool)
+{
+    auto const pool = PeerInfoPool{};
+
+    EXPECT_TRUE(pool.empty());
+    EXPECT_EQ(0U, std::size(pool));
+    EXPECT_EQ(std::end(pool), std::begin(pool));
+    EXPECT_FALSE(pool.find(make_socket_address(1U)));
+}
+
+TEST(PeerInfoPoolTest, insertFindErase)
+{
+    auto pool = PeerInfoPool{};
+    auto const info = make_info(1U);
+
+    EXPECT_TRUE(pool.insert_or_assign(info));
+    EXPECT_EQ(1U, std::size(pool));
+    EXPECT_EQ(info, pool.find(make_socket_address(1U)));
+    EXPECT_FALSE(pool.find(make_socket_address(2U)));
+
+    // same address replaces the old entry
+    auto const replacement = make_info(1U);
+    EXPECT_FALSE(pool.insert_or_assign(replacement));
+    EXPECT_EQ(1U, std::size(pool));
+    EXPECT_EQ(replacement, pool.find(make_socket_address(1U)));
+
+    EXPECT_EQ(0U, pool.erase(make_socket_address(2U)));
+    EXPECT_EQ(1U, pool.erase(make_socket_address(1U)));
+    EXPECT_TRUE(pool.empty());
+    EXPECT_FALSE(pool.find(make_socket_address(1U)));
+}
+
+TEST(PeerInfoPoolTest, matchesReferenceMap)
+{
+    // random inserts and erases, checked against a std::map.
+    // This exercises growth and the backward shifts on erase.
+    static auto constexpr NumOps = 20000U;
+    static auto constexpr KeySpace = size_t{ 2000U };
+
+    auto rng = std::mt19937{ 42U };
+    auto key_dist = std::uniform_int_distribution<size_t>{ 0U, KeySpace - 1U };
+
+    auto pool = PeerInfoPool{};
+    auto reference = std::map<tr_socket_address, std::shared_ptr<tr_peer_info>>{};
+
+    for (unsigned i = 0U; i < NumOps; ++i)
+    {
+        auto const key = key_dist(rng);
+        auto const socket_address = make_socket_address(key);
+
+        if (rng() % 3U == 0U)
+        {
+            EXPECT_EQ(reference.erase(socket_address), pool.erase(socket_address));
+        }
+        else
+        {
+            auto const info = make_info(key);
+            EXPECT_EQ(reference.insert_or_assign(socket_address, info).second, pool.insert_or_assign(info));
+        }
+
+        ASSERT_EQ(std::size(reference), std::size(pool));
+    }
+
+    for (size_t key = 0U; key < KeySpace; ++key)
+    {
+        auto const socket_address = make_socket_address(key);
+        auto const iter = reference.find(socket_address);
+        EXPECT_EQ(iter == std::end(reference) ? nullptr : iter->second, pool.find(socket_address));
+    }
+
+    auto expected = std::set<tr_socket_address>{};
+    for (auto const& [socket_address, info] : reference)
+    {
+        expected.insert(socket_address);
+    }
+    EXPECT_EQ(expected, addresses(pool));
+}
+
+TEST(PeerInfoPoolTest, reserveKeepsEntries)
+{
+    auto pool = PeerInfoPool{};
+    for (size_t i = 0U; i < 10U; ++i)
+    {
+        pool.insert_or_assign(make_info(i));
+    }
+
+    auto const before = addresses(pool);
+    pool.reserve(1000U);
+    EXPECT_EQ(before, addresses(pool));
+    EXPECT_EQ(10U, std::size(pool));
+}
+
+TEST(PeerInfoPoolTest, pruneEvictsLeastUseful)
+{
+    static auto constexpr NumInfos = size_t{ 100U };
+
+    auto pool = PeerInfoPool{};
+    for (size_t i = 0U; i < NumInfos; ++i)
+    {
+        pool.insert_or_assign(make_info(i));
+    }
+
+    // in this test, lower addresses are more useful
+    auto const is_more_useful = [](tr_peer_info const* a, tr_peer_info const* b)
+    {
+        return a->listen_socket_address() < b->listen_socket_address();
+    };
+
+    auto n_evicted = size_t{};
+    EXPECT_EQ(60U, pool.prune(40U, is_more_useful, [&n_evicted](tr_peer_info const& /*info*/) { ++n_evicted; }));
+    EXPECT_EQ(60U, n_evicted);
+    EXPECT_EQ(40U, std::size(pool));
+
+    for (size_t i = 0U; i < NumInfos; ++i)
+    {
+        EXPECT_EQ(i < 40U, static_cast<bool>(pool.find(make_socket_address(i)))) << i;
+    }
+
+    // nothing to do if we're already under the target
+    EXPECT_EQ(0U, pool.prune(50U, is_more_useful, [](tr_peer_info const& /*info*/) {}));
+    EXPECT_EQ(40U, std::size(pool));
+}
+
+TEST(PeerInfoPoolTest, pruneKeepsPeersInUse)
+{
+    auto pool = PeerInfoPool{};
+    auto connected = std::vector<std::shared_ptr<tr_peer_info>>{};
+    for (size_t i = 0U; i < 10U; ++i)
+    {
+        auto info = make_info(i);
+        info->set_connected(tr_time());
+        connected.emplace_back(info);
+        pool.insert_or_assign(info);
+    }
+
+    for (size_t i = 10U; i < 20U; ++i)
+    {
+        pool.insert_or_assign(make_info(i));
+    }
+
+    // only the 10 idle peers can go, even though we asked for fewer
+    auto const n_evicted = pool.prune(
+        5U,
+        [](tr_peer_info const* a, tr_peer_info const* b) { return a->listen_socket_address() < b->listen_socket_address(); },
+        [](tr_peer_info const& info) { EXPECT_FALSE(info.is_in_use()); });
+    EXPECT_EQ(10U, n_evicted);
+    EXPECT_EQ(10U, std::size(pool));
+
+    for (auto const& info : connected)
+    {
+        EXPECT_EQ(info, pool.find(info->listen_socket_address()));
+        info->set_connected(tr_time(), false);
+    }
+}
+
+TEST(PeerInfoPoolTest, memoryUsageTracksSize)
+{
+    auto pool = PeerInfoPool{};
+    auto const empty_usage = pool.memory_usage();
+
+    for (size_t i = 0U; i < 100U; ++i)
+    {
+        pool.insert_or_assign(make_info(i));
+    }
+
+    auto const full_usage = pool.memory_usage();
+    EXPECT_GE(full_usage, empty_usage + 100U * sizeof(tr_peer_info));
+
+    pool.clear();
+    EXPECT_EQ(empty_usage, pool.memory_usage());
+}
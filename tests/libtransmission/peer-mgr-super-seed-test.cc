@@ -0,0 +1,350 @@
+// This file Copyright (C) 2026 Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <algorithm>
+#include <cstddef> // size_t
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#define LIBTRANSMISSION_PEER_MODULE
+
+#include <libtransmission/transmission.h>
+
+#include <libtransmission/bitfield.h>
+#include <libtransmission/peer-mgr-super-seed.h>
+
+#include "gtest/gtest.h"
+
+TEST(SuperSeederTest, picksNothingWithoutPieces)
+{
+    auto seeder = SuperSeeder{};
+    auto const availability = std::vector<uint16_t>{};
+
+    EXPECT_FALSE(seeder.pick(tr_bitfield{ 0U }, availability));
+}
+
+TEST(SuperSeederTest, picksNothingForSeeds)
+{
+    static auto constexpr NumPieces = size_t{ 8U };
+    auto seeder = SuperSeeder{ NumPieces };
+    auto const availability = std::vector<uint16_t>(NumPieces);
+
+    auto peer_has = tr_bitfield{ NumPieces };
+    peer_has.set_has_all();
+    EXPECT_FALSE(seeder.pick(peer_has, availability));
+}
+
+TEST(SuperSeederTest, picksPiecesThePeerLacks)
+{
+    static auto constexpr NumPieces = size_t{ 8U };
+    auto seeder = SuperSeeder{ NumPieces };
+    auto const availability = std::vector<uint16_t>(NumPieces);
+
+    auto peer_has = tr_bitfield{ NumPieces };
+    peer_has.set_has_all();
+    peer_has.unset(5U);
+
+    auto const piece = seeder.pick(peer_has, availability);
+    ASSERT_TRUE(piece);
+    EXPECT_EQ(5U, *piece);
+}
+
+TEST(SuperSeederTest, prefersPiecesNobodyWasOffered)
+{
+    static auto constexpr NumPieces = size_t{ 4U };
+    auto seeder = SuperSeeder{ NumPieces };
+    auto const availability = std::vector<uint16_t>(NumPieces);
+    auto const peer_has = tr_bitfield{ NumPieces };
+
+    // every piece gets offered once before any is offered twice
+    auto offered = std::vector<size_t>(NumPieces);
+    for (size_t i = 0U; i < NumPieces; ++i)
+    {
+        auto const piece = seeder.pick(peer_has, availability);
+        ASSERT_TRUE(piece);
+        seeder.add_offer(*piece);
+        ++offered[*piece];
+    }
+
+    EXPECT_EQ(std::vector<size_t>(NumPieces, 1U), offered);
+
+    seeder.remove_offer(2U);
+    auto const piece = seeder.pick(peer_has, availability);
+    ASSERT_TRUE(piece);
+    EXPECT_EQ(2U, *piece);
+}
+
+TEST(SuperSeederTest, prefersRarePieces)
+{
+    static auto constexpr NumPieces = size_t{ 4U };
+    auto seeder = SuperSeeder{ NumPieces };
+    auto const availability = std::vector<uint16_t>{ 3U, 1U, 2U, 4U };
+    auto const peer_has = tr_bitfield{ NumPieces };
+
+    auto const piece = seeder.pick(peer_has, availability);
+    ASSERT_TRUE(piece);
+    EXPECT_EQ(1U, *piece);
+}
+
+TEST(SuperSeederTest, offerCountIsTracked)
+{
+    auto seeder = SuperSeeder{ 4U };
+
+    EXPECT_EQ(0U, seeder.offer_count(1U));
+    seeder.add_offer(1U);
+    seeder.add_offer(1U);
+    EXPECT_EQ(2U, seeder.offer_count(1U));
+    seeder.remove_offer(1U);
+    seeder.remove_offer(1U);
+    seeder.remove_offer(1U);
+    EXPECT_EQ(0U, seeder.offer_count(1U));
+
+    // out of range is harmless
+    seeder.add_offer(100U);
+    EXPECT_EQ(0U, seeder.offer_count(100U));
+}
+
+TEST(SuperSeederTest, propagatedOnceAnotherPeerHasIt)
+{
+    static auto constexpr NumPieces = size_t{ 4U };
+    auto peer_has = tr_bitfield{ NumPieces };
+    auto availability = std::vector<uint16_t>(NumPieces);
+
+    // the peer hasn't downloaded it yet
+    EXPECT_FALSE(SuperSeeder::has_propagated(peer_has, 1U, availability));
+
+    // the peer has it, but nobody else does
+    peer_has.set(1U);
+    availability[1U] = 1U;
+    EXPECT_FALSE(SuperSeeder::has_propagated(peer_has, 1U, availability));
+
+    // someone else has it too
+    availability[1U] = 2U;
+    EXPECT_TRUE(SuperSeeder::has_propagated(peer_has, 1U, availability));
+}
+
+namespace
+{
+struct SwarmResult
+{
+    size_t seed_uploads = {};
+    size_t ticks = {};
+};
+
+// A seed with a few upload slots and a swarm of peers that each
+// know a few neighbours. Each tick, the seed uploads one piece to
+// each of its slots and each peer downloads one piece from a
+// neighbour, picking the rarest piece that it can see. Runs until
+// the peers have a full copy between them.
+[[nodiscard]] SwarmResult simulate_swarm(bool const super_seeding, unsigned const seed)
+{
+    static auto constexpr NumPieces = size_t{ 128U };
+    static auto constexpr NumPeers = size_t{ 24U };
+    static auto constexpr Degree = size_t{ 4U };
+    static auto constexpr SeedSlots = size_t{ 4U };
+    static auto constexpr MaxTicks = size_t{ 10000U };
+
+    // a tiny deterministic generator, so that the simulation
+    // doesn't depend on the standard library's distributions
+    auto state = uint32_t{ 0x12345678U } + seed;
+    auto const next = [&state](size_t bound)
+    {
+        state ^= state << 13U;
+        state ^= state >> 17U;
+        state ^= state << 5U;
+        return state % bound;
+    };
+
+    auto neighbours = std::vector<std::vector<size_t>>(NumPeers);
+    for (size_t peer = 0U; peer < NumPeers; ++peer)
+    {
+        while (std::size(neighbours[peer]) < Degree)
+        {
+            auto const other = next(NumPeers);
+            if (other != peer && std::find(std::begin(neighbours[peer]), std::end(neighbours[peer]), other) ==
+                    std::end(neighbours[peer]))
+            {
+                neighbours[peer].push_back(other);
+                neighbours[other].push_back(peer);
+            }
+        }
+    }
+
+    auto has = std::vector<tr_bitfield>(NumPeers, tr_bitfield{ NumPieces });
+    auto availability = std::vector<uint16_t>(NumPieces);
+    auto seeder = SuperSeeder{ NumPieces };
+    auto offers = std::vector<std::optional<tr_piece_index_t>>(NumPeers);
+
+    auto const offer_next = [&](size_t peer)
+    {
+        if (offers[peer])
+        {
+            seeder.remove_offer(*offers[peer]);
+        }
+
+        offers[peer] = seeder.pick(has[peer], availability);
+
+        if (offers[peer])
+        {
+            seeder.add_offer(*offers[peer]);
+        }
+    };
+
+    // the rarest piece that `peer` lacks, as far as `peer` can tell,
+    // that `source` has. Ties are broken at random.
+    auto const pick_rarest = [&](size_t peer, tr_bitfield const& source) -> std::optional<tr_piece_index_t>
+    {
+        auto best = std::optional<tr_piece_index_t>{};
+        auto best_count = size_t{};
+        auto const offset = next(NumPieces);
+        for (size_t i = 0U; i < NumPieces; ++i)
+        {
+            auto const piece = static_cast<tr_piece_index_t>((offset + i) % NumPieces);
+            if (has[peer].test(piece) || !source.test(piece))
+            {
+                continue;
+            }
+
+            auto count = size_t{};
+            for (auto const other : neighbours[peer])
+            {
+                count += has[other].test(piece) ? 1U : 0U;
+            }
+
+            if (!best || count < best_count)
+            {
+                best = piece;
+                best_count = count;
+            }
+        }
+
+        return best;
+    };
+
+    auto all = tr_bitfield{ NumPieces };
+    all.set_has_all();
+
+    auto result = SwarmResult{};
+    auto next_slot = size_t{};
+    auto uploaded = std::vector<bool>(NumPeers);
+
+    for (; result.ticks < MaxTicks; ++result.ticks)
+    {
+        auto swarm_has = tr_bitfield{ NumPieces };
+        for (auto const& bitfield : has)
+        {
+            swarm_has |= bitfield;
+        }
+
+        if (swarm_has.has_all())
+        {
+            break;
+        }
+
+        // requests are all made at the start of the tick
+        auto transfers = std::vector<std::pair<size_t /*peer*/, tr_piece_index_t>>{};
+
+        for (size_t slot = 0U; slot < SeedSlots; ++slot)
+        {
+            auto const peer = next_slot++ % NumPeers;
+
+            if (super_seeding)
+            {
+                if (!offers[peer])
+                {
+                    offer_next(peer);
+                }
+
+                if (offers[peer] && !has[peer].test(*offers[peer]))
+                {
+                    transfers.emplace_back(peer, *offers[peer]);
+                    ++result.seed_uploads;
+                }
+            }
+            else if (auto const piece = pick_rarest(peer, all); piece)
+            {
+                transfers.emplace_back(peer, *piece);
+                ++result.seed_uploads;
+            }
+        }
+
+        std::fill(std::begin(uploaded), std::end(uploaded), false);
+        for (size_t peer = 0U; peer < NumPeers; ++peer)
+        {
+            for (auto const other : neighbours[peer])
+            {
+                if (uploaded[other])
+                {
+                    continue;
+                }
+
+                if (auto const piece = pick_rarest(peer, has[other]); piece)
+                {
+                    transfers.emplace_back(peer, *piece);
+                    uploaded[other] = true;
+                    break;
+                }
+            }
+        }
+
+        for (auto const& [peer, piece] : transfers)
+        {
+            if (has[peer].test(piece))
+            {
+                continue;
+            }
+
+            has[peer].set(piece);
+            ++availability[piece];
+
+            if (super_seeding)
+            {
+                for (size_t other = 0U; other < NumPeers; ++other)
+                {
+                    if (offers[other] == piece && SuperSeeder::has_propagated(has[other], piece, availability))
+                    {
+                        offer_next(other);
+                    }
+                }
+            }
+        }
+    }
+
+    return result;
+}
+} // namespace
+
+// BEP 16 says that super-seeding should get a full copy of the torrent
+// out to the swarm while uploading little more than one copy ourselves.
+TEST(SuperSeederTest, firstCopyCostsAboutOneUpload)
+{
+    static auto constexpr NumPieces = size_t{ 128U };
+    static auto constexpr NumRuns = 5U;
+
+    auto normal_uploads = size_t{};
+    auto super_uploads = size_t{};
+    auto normal_ticks = size_t{};
+    auto super_ticks = size_t{};
+
+    for (unsigned run = 0U; run < NumRuns; ++run)
+    {
+        auto const normal = simulate_swarm(false, run);
+        auto const super = simulate_swarm(true, run);
+        normal_uploads += normal.seed_uploads;
+        super_uploads += super.seed_uploads;
+        normal_ticks += normal.ticks;
+        super_ticks += super.ticks;
+    }
+
+    auto const normal_ratio = static_cast<double>(normal_uploads) / (NumPieces * NumRuns);
+    auto const super_ratio = static_cast<double>(super_uploads) / (NumPieces * NumRuns);
+
+    // the super-seeded swarm has to actually finish, too
+    EXPECT_LT(super_ticks, normal_ticks * 2U) << "ticks until the swarm has a full copy";
+    EXPECT_LT(super_ratio, 1.1) << "seed uploads per piece with super-seeding";
+    EXPECT_LT(super_ratio, normal_ratio) << "seed uploads per piece";
+}
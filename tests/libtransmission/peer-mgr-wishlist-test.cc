@@ -3,16 +3,26 @@
 // or any future license endorsed by Mnemosyne LLC.
 // License text can be found in the licenses/ folder.
 
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <cstddef> // size_t
+#include <cstdint>
+#include <deque>
+#include <iostream>
 #include <map>
 #include <memory>
 #include <set>
+#include <string>
+#include <vector>
 
 #define LIBTRANSMISSION_PEER_MODULE
 
 #include <libtransmission/transmission.h>
 
 #include <libtransmission/bitfield.h>
+#include <libtransmission/block-info.h>
+#include <libtransmission/crypto-utils.h> // tr_rand_int()
 #include <libtransmission/peer-mgr-wishlist.h>
 
 #include "gtest/gtest.h"
@@ -29,6 +39,7 @@ protected:
         mutable std::map<tr_piece_index_t, size_t> piece_replication_;
         mutable std::set<tr_block_index_t> client_has_block_;
         mutable std::set<tr_piece_index_t> client_wants_piece_;
+        std::vector<tr_stream_deadline> stream_deadlines_;
         tr_piece_index_t piece_count_ = 0;
         bool is_endgame_ = false;
         bool is_sequential_download_ = false;
@@ -90,6 +101,134 @@ protected:
             return piece_priority_[piece];
         }
 
+        [[nodiscard]] std::vector<tr_stream_deadline> stream_deadlines() const override
+        {
+            return stream_deadlines_;
+        }
+
+        [[nodiscard]] libtransmission::ObserverTag observe_peer_disconnect(
+            libtransmission::SimpleObservable<tr_torrent*, tr_bitfield const&>::Observer observer) override
+        {
+            return parent_.peer_disconnect_.observe(std::move(observer));
+        }
+
+        [[nodiscard]] libtransmission::ObserverTag observe_got_bitfield(
+            libtransmission::SimpleObservable<tr_torrent*, tr_bitfield const&>::Observer observer) override
+        {
+            return parent_.got_bitfield_.observe(std::move(observer));
+        }
+
+        [[nodiscard]] libtransmission::ObserverTag observe_got_block(
+            libtransmission::SimpleObservable<tr_torrent*, tr_piece_index_t, tr_block_index_t>::Observer observer) override
+        {
+            return parent_.got_block_.observe(std::move(observer));
+        }
+
+        [[nodiscard]] libtransmission::ObserverTag observe_got_have(
+            libtransmission::SimpleObservable<tr_torrent*, tr_piece_index_t>::Observer observer) override
+        {
+            return parent_.got_have_.observe(std::move(observer));
+        }
+
+        [[nodiscard]] libtransmission::ObserverTag observe_got_have_all(
+            libtransmission::SimpleObservable<tr_torrent*>::Observer observer) override
+        {
+            return parent_.got_have_all_.observe(std::move(observer));
+        }
+
+        [[nodiscard]] libtransmission::ObserverTag observe_piece_completed(
+            libtransmission::SimpleObservable<tr_torrent*, tr_piece_index_t>::Observer observer) override
+        {
+            return parent_.piece_completed_.observe(std::move(observer));
+        }
+
+        [[nodiscard]] libtransmission::ObserverTag observe_priority_changed(
+            libtransmission::SimpleObservable<tr_torrent*, tr_file_index_t const*, tr_file_index_t, tr_priority_t>::Observer
+                observer) override
+        {
+            return parent_.priority_changed_.observe(std::move(observer));
+        }
+
+        [[nodiscard]] libtransmission::ObserverTag observe_sequential_download_changed(
+            libtransmission::SimpleObservable<tr_torrent*, bool>::Observer observer) override
+        {
+            return parent_.sequential_download_changed_.observe(std::move(observer));
+        }
+    };
+
+    // A mediator for a synthetic swarm, used by the benchmark. Unlike MockMediator,
+    // it's cheap enough that the timings mostly measure the wishlist itself.
+    struct SyntheticMediator final : public Wishlist::Mediator
+    {
+        static auto constexpr BlocksPerPiece = tr_block_index_t{ 16U };
+
+        SyntheticMediator(PeerMgrWishlistTest& parent, tr_piece_index_t n_pieces)
+            : parent_{ parent }
+            , missing_blocks_(n_pieces, BlocksPerPiece)
+            , replication_(n_pieces)
+            , client_has_block_(size_t{ n_pieces } * BlocksPerPiece)
+        {
+            for (auto& replication : replication_)
+            {
+                replication = 1U + tr_rand_int(50U);
+            }
+        }
+
+        [[nodiscard]] bool client_has_block(tr_block_index_t block) const override
+        {
+            return client_has_block_[block];
+        }
+
+        [[nodiscard]] bool client_wants_piece(tr_piece_index_t /*piece*/) const override
+        {
+            return true;
+        }
+
+        [[nodiscard]] bool is_endgame() const override
+        {
+            return false;
+        }
+
+        [[nodiscard]] bool is_sequential_download() const override
+        {
+            return is_sequential_;
+        }
+
+        [[nodiscard]] size_t count_active_requests(tr_block_index_t /*block*/) const override
+        {
+            return 0U;
+        }
+
+        [[nodiscard]] size_t count_missing_blocks(tr_piece_index_t piece) const override
+        {
+            return missing_blocks_[piece];
+        }
+
+        [[nodiscard]] size_t count_piece_replication(tr_piece_index_t piece) const override
+        {
+            return replication_[piece];
+        }
+
+        [[nodiscard]] tr_block_span_t block_span(tr_piece_index_t piece) const override
+        {
+            return { piece * BlocksPerPiece, (piece + 1U) * BlocksPerPiece };
+        }
+
+        [[nodiscard]] tr_piece_index_t piece_count() const override
+        {
+            return static_cast<tr_piece_index_t>(std::size(missing_blocks_));
+        }
+
+        [[nodiscard]] tr_priority_t priority(tr_piece_index_t /*piece*/) const override
+        {
+            return TR_PRI_NORMAL;
+        }
+
+        [[nodiscard]] std::vector<tr_stream_deadline> stream_deadlines() const override
+        {
+            return {};
+        }
+
         [[nodiscard]] libtransmission::ObserverTag observe_peer_disconnect(
             libtransmission::SimpleObservable<tr_torrent*, tr_bitfield const&>::Observer observer) override
         {
@@ -138,6 +277,12 @@ protected:
         {
             return parent_.sequential_download_changed_.observe(std::move(observer));
         }
+
+        PeerMgrWishlistTest& parent_;
+        std::vector<size_t> missing_blocks_;
+        std::vector<size_t> replication_;
+        std::vector<bool> client_has_block_;
+        bool is_sequential_ = false;
     };
 
     libtransmission::SimpleObservable<tr_torrent*, tr_bitfield const&> peer_disconnect_;
@@ -1172,3 +1317,478 @@ TEST_F(PeerMgrWishlistTest, settingSequentialDownloadRebuildsWishlist)
         EXPECT_EQ(50U, requested.count(200, 300));
     }
 }
+
+TEST_F(PeerMgrWishlistTest, sequentialDownloadStaysInOrderAfterMoves)
+{
+    auto mediator_ptr = std::make_unique<MockMediator>(*this);
+    auto& mediator = *mediator_ptr;
+
+    // setup: four pieces, all missing and equally rare
+    mediator.piece_count_ = 4;
+    mediator.is_sequential_download_ = true;
+    for (tr_piece_index_t piece = 0; piece < 4; ++piece)
+    {
+        mediator.missing_block_count_[piece] = 100;
+        mediator.block_span_[piece] = { piece * 100, (piece + 1) * 100 };
+        mediator.client_wants_piece_.insert(piece);
+        mediator.piece_replication_[piece] = 1;
+    }
+
+    // allow the wishlist to build its cache
+    auto wishlist = Wishlist{ std::move(mediator_ptr) };
+    (void)wishlist.next(1, PeerHasAllPieces, ClientHasNoActiveRequests);
+
+    // move the pieces between buckets until they're equally rare again
+    got_have_.emit(nullptr, 2);
+    auto have = tr_bitfield{ 4 };
+    have.set(0);
+    have.set(3);
+    got_bitfield_.emit(nullptr, have);
+    got_have_.emit(nullptr, 1);
+
+    // the pieces should still come in order
+    auto const spans = wishlist.next(150, PeerHasAllPieces, ClientHasNoActiveRequests);
+    auto requested = tr_bitfield{ 400 };
+    for (auto const& span : spans)
+    {
+        requested.set_span(span.begin, span.end);
+    }
+    EXPECT_EQ(150U, requested.count());
+    EXPECT_EQ(100U, requested.count(0, 100));
+    EXPECT_EQ(50U, requested.count(100, 200));
+    EXPECT_EQ(0U, requested.count(200, 400));
+}
+
+TEST_F(PeerMgrWishlistTest, streamingDeadlinePiecesComeFirst)
+{
+    auto mediator = std::make_unique<MockMediator>(*this);
+
+    // setup: three pieces, all missing, and piece 0 is the rarest
+    mediator->piece_count_ = 3;
+    for (tr_piece_index_t i = 0; i < 3; ++i)
+    {
+        mediator->missing_block_count_[i] = 100;
+        mediator->block_span_[i] = { i * 100U, (i + 1U) * 100U };
+        mediator->client_wants_piece_.insert(i);
+    }
+    mediator->piece_replication_[0] = 1;
+    mediator->piece_replication_[1] = 3;
+    mediator->piece_replication_[2] = 3;
+
+    // but playback needs piece 2, then piece 1
+    mediator->stream_deadlines_ = { { 2, 1000 }, { 1, 5000 } };
+
+    auto const fast_peer = Wishlist::PeerSpeed{ 1000U * 1000U * 1000U, 0U };
+    auto const spans = Wishlist{ std::move(mediator) }.next(250, PeerHasAllPieces, ClientHasNoActiveRequests, fast_peer);
+    auto requested = tr_bitfield{ 300 };
+    for (auto const& span : spans)
+    {
+        requested.set_span(span.begin, span.end);
+    }
+    EXPECT_EQ(250U, requested.count());
+    EXPECT_EQ(50U, requested.count(0, 100));
+    EXPECT_EQ(100U, requested.count(100, 200));
+    EXPECT_EQ(100U, requested.count(200, 300));
+}
+
+TEST_F(PeerMgrWishlistTest, streamingLeavesDeadlineBlocksToFastPeers)
+{
+    auto const get_requested = [this](Wishlist::PeerSpeed const& peer_speed, int64_t deadline_msec)
+    {
+        auto mediator = std::make_unique<MockMediator>(*this);
+
+        mediator->piece_count_ = 2;
+        for (tr_piece_index_t i = 0; i < 2; ++i)
+        {
+            mediator->missing_block_count_[i] = 100;
+            mediator->block_span_[i] = { i * 100U, (i + 1U) * 100U };
+            mediator->client_wants_piece_.insert(i);
+        }
+        mediator->stream_deadlines_ = { { 1, deadline_msec } };
+
+        auto const spans = Wishlist{ std::move(mediator) }.next(20, PeerHasAllPieces, ClientHasNoActiveRequests, peer_speed);
+        auto requested = tr_bitfield{ 200 };
+        for (auto const& span : spans)
+        {
+            requested.set_span(span.begin, span.end);
+        }
+        return requested;
+    };
+
+    // a peer that sends one block per second can only deliver five blocks
+    // of the deadline piece in time; the rest of its requests go elsewhere
+    auto const slow_peer = Wishlist::PeerSpeed{ tr_block_info::BlockSize, 0U };
+    auto requested = get_requested(slow_peer, 5000);
+    EXPECT_EQ(20U, requested.count());
+    EXPECT_EQ(5U, requested.count(100, 200));
+    EXPECT_EQ(15U, requested.count(0, 100));
+
+    // a peer with an unknown speed doesn't get any of them...
+    requested = get_requested(Wishlist::PeerSpeed{}, 5000);
+    EXPECT_EQ(0U, requested.count(100, 200));
+
+    // ...unless the deadline is at risk and nobody else has asked
+    requested = get_requested(Wishlist::PeerSpeed{}, Wishlist::StreamAtRiskMsec);
+    EXPECT_EQ(20U, requested.count(100, 200));
+}
+
+TEST_F(PeerMgrWishlistTest, streamingDuplicatesAtRiskRequests)
+{
+    auto const get_requested = [this](Wishlist::PeerSpeed const& peer_speed, int64_t deadline_msec)
+    {
+        auto mediator = std::make_unique<MockMediator>(*this);
+
+        mediator->piece_count_ = 2;
+        for (tr_piece_index_t i = 0; i < 2; ++i)
+        {
+            mediator->missing_block_count_[i] = 100;
+            mediator->block_span_[i] = { i * 100U, (i + 1U) * 100U };
+            mediator->client_wants_piece_.insert(i);
+        }
+
+        // every block in the deadline piece has already been requested from another peer
+        for (tr_block_index_t block = 100; block < 200; ++block)
+        {
+            mediator->active_request_count_[block] = 1;
+        }
+        mediator->stream_deadlines_ = { { 1, deadline_msec } };
+
+        auto const spans = Wishlist{ std::move(mediator) }.next(50, PeerHasAllPieces, ClientHasNoActiveRequests, peer_speed);
+        auto requested = tr_bitfield{ 200 };
+        for (auto const& span : spans)
+        {
+            requested.set_span(span.begin, span.end);
+        }
+        return requested;
+    };
+
+    auto const fast_peer = Wishlist::PeerSpeed{ 1000U * 1000U * 1000U, 0U };
+    auto const slow_peer = Wishlist::PeerSpeed{ tr_block_info::BlockSize, 0U };
+
+    // a fast peer duplicates requests whose deadline is at risk
+    EXPECT_EQ(50U, get_requested(fast_peer, 1000).count(100, 200));
+
+    // but not ones that are still on track
+    EXPECT_EQ(0U, get_requested(fast_peer, 10000).count(100, 200));
+
+    // and a slow peer can't help, so it doesn't duplicate them
+    EXPECT_EQ(0U, get_requested(slow_peer, 500).count(100, 200));
+}
+
+TEST_F(PeerMgrWishlistTest, endgameOnlyDuplicatesToFastPeers)
+{
+    auto const get_requested = [this](Wishlist::PeerSpeed const& peer_speed)
+    {
+        auto mediator = std::make_unique<MockMediator>(*this);
+
+        mediator->piece_count_ = 1;
+        mediator->missing_block_count_[0] = 100;
+        mediator->block_span_[0] = { 0, 100 };
+        mediator->client_wants_piece_.insert(0);
+
+        // blocks [0..90) are already requested from someone else
+        mediator->is_endgame_ = true;
+        for (tr_block_index_t block = 0; block < 90; ++block)
+        {
+            mediator->active_request_count_[block] = 1;
+        }
+
+        auto const spans = Wishlist{ std::move(mediator) }.next(1000, PeerHasAllPieces, ClientHasNoActiveRequests, peer_speed);
+        auto requested = tr_bitfield{ 100 };
+        for (auto const& span : spans)
+        {
+            requested.set_span(span.begin, span.end);
+        }
+        return requested;
+    };
+
+    // a fast peer gets the unrequested blocks and duplicates the rest
+    auto requested = get_requested(Wishlist::PeerSpeed{});
+    EXPECT_EQ(100U, requested.count());
+
+    // a slow peer only gets the unrequested blocks
+    auto slow_peer = Wishlist::PeerSpeed{};
+    slow_peer.is_fast = false;
+    requested = get_requested(slow_peer);
+    EXPECT_EQ(10U, requested.count());
+    EXPECT_EQ(10U, requested.count(90, 100));
+}
+
+TEST_F(PeerMgrWishlistTest, pickEndgameFastPeers)
+{
+    EXPECT_TRUE(std::empty(Wishlist::pick_endgame_fast_peers({})));
+
+    // nobody has been measured yet, so everyone may duplicate
+    EXPECT_EQ((std::vector<bool>{ true, true }), Wishlist::pick_endgame_fast_peers({ 0U, 0U }));
+
+    // a peer that's much slower than the best one isn't fast,
+    // even if it's one of the best EndgameFastPeers
+    EXPECT_EQ((std::vector<bool>{ true, false }), Wishlist::pick_endgame_fast_peers({ 100U, 500U }));
+
+    // only the best EndgameFastPeers are fast, plus any unmeasured ones
+    EXPECT_EQ(
+        (std::vector<bool>{ true, true, false, false, true, true, true }),
+        Wishlist::pick_endgame_fast_peers({ 100U, 0U, 150U, 900U, 120U, 110U, 130U }));
+}
+
+// Simulates the end of a download from peers of very different speeds,
+// and compares how long the last 1% takes when every peer may duplicate
+// endgame requests vs. when only the fast ones may.
+TEST_F(PeerMgrWishlistTest, endgameSimulationFinishesTailSooner)
+{
+    static auto constexpr NumPieces = tr_piece_index_t{ 100U };
+    static auto constexpr BlocksPerPiece = tr_block_index_t{ 20U };
+    static auto constexpr NumBlocks = size_t{ NumPieces * BlocksPerPiece };
+    static auto constexpr QueueDepth = size_t{ 8U };
+    static auto constexpr TickMsec = uint64_t{ 10U };
+    static auto constexpr MaxMsec = uint64_t{ 3600U * 1000U };
+    static auto constexpr PeerMsecPerBlock = std::array<uint64_t, 8>{ 20U, 50U, 800U, 800U, 800U, 800U, 800U, 800U };
+
+    struct Result
+    {
+        uint64_t tail_msec = {};
+        size_t wasted_blocks = {};
+    };
+
+    auto const simulate = [this](bool rank_peers)
+    {
+        struct Request
+        {
+            tr_block_index_t block = {};
+            uint64_t sent_at = {};
+            bool cancelled = false;
+        };
+
+        struct Peer
+        {
+            uint64_t msec_per_block = {};
+            std::deque<Request> queue;
+            uint64_t front_done_at = {};
+            uint32_t latency_msec = {};
+        };
+
+        auto mediator_ptr = std::make_unique<MockMediator>(*this);
+        auto& mediator = *mediator_ptr;
+        mediator.piece_count_ = NumPieces;
+        for (tr_piece_index_t piece = 0; piece < NumPieces; ++piece)
+        {
+            mediator.missing_block_count_[piece] = BlocksPerPiece;
+            mediator.block_span_[piece] = { piece * BlocksPerPiece, (piece + 1U) * BlocksPerPiece };
+            mediator.client_wants_piece_.insert(piece);
+        }
+        auto wishlist = Wishlist{ std::move(mediator_ptr) };
+
+        auto peers = std::vector<Peer>{};
+        for (auto const msec_per_block : PeerMsecPerBlock)
+        {
+            peers.emplace_back().msec_per_block = msec_per_block;
+        }
+
+        auto result = Result{};
+        auto n_active = size_t{};
+        auto t99 = uint64_t{};
+        auto now = uint64_t{};
+        for (; std::size(mediator.client_has_block_) < NumBlocks && now < MaxMsec; now += TickMsec)
+        {
+            // deliver the blocks that are done
+            for (auto& peer : peers)
+            {
+                while (!std::empty(peer.queue) && peer.front_done_at <= now)
+                {
+                    auto const req = peer.queue.front();
+                    peer.queue.pop_front();
+                    peer.front_done_at = now + peer.msec_per_block;
+                    auto const sample = static_cast<uint32_t>(now - req.sent_at);
+                    peer.latency_msec = peer.latency_msec == 0U ? sample : (peer.latency_msec * 7U + sample) / 8U;
+
+                    if (req.cancelled)
+                    {
+                        // the cancel got there too late
+                        ++result.wasted_blocks;
+                        continue;
+                    }
+
+                    --mediator.active_request_count_[req.block];
+                    --n_active;
+                    mediator.client_has_block_.insert(req.block);
+                    auto const piece = req.block / BlocksPerPiece;
+                    --mediator.missing_block_count_[piece];
+                    got_block_.emit(nullptr, piece, req.block);
+                    if (mediator.missing_block_count_[piece] == 0U)
+                    {
+                        piece_completed_.emit(nullptr, piece);
+                    }
+
+                    // cancel the other requests for this block. the ones that
+                    // are already being sent will arrive anyway.
+                    for (auto& other : peers)
+                    {
+                        for (auto it = std::begin(other.queue); it != std::end(other.queue);)
+                        {
+                            if (it->block != req.block || it->cancelled)
+                            {
+                                ++it;
+                                continue;
+                            }
+
+                            --mediator.active_request_count_[req.block];
+                            --n_active;
+                            if (it == std::begin(other.queue))
+                            {
+                                it->cancelled = true;
+                                ++it;
+                            }
+                            else
+                            {
+                                it = other.queue.erase(it);
+                            }
+                        }
+                    }
+                }
+            }
+
+            auto const n_missing = NumBlocks - std::size(mediator.client_has_block_);
+            if (t99 == 0U && n_missing <= NumBlocks / 100U)
+            {
+                t99 = now;
+            }
+            mediator.is_endgame_ = n_active >= n_missing;
+
+            // refill the peers' request queues
+            auto latencies = std::vector<uint32_t>{};
+            for (auto const& peer : peers)
+            {
+                latencies.emplace_back(peer.latency_msec);
+            }
+            auto const is_fast = Wishlist::pick_endgame_fast_peers(latencies);
+
+            for (size_t i = 0; i < std::size(peers) && n_missing > 0U; ++i)
+            {
+                auto& peer = peers[i];
+                auto peer_speed = Wishlist::PeerSpeed{};
+                peer_speed.is_fast = !rank_peers || is_fast[i];
+                auto const has_active_pending_to_peer = [&peer](tr_block_index_t block)
+                {
+                    return std::any_of(
+                        std::begin(peer.queue),
+                        std::end(peer.queue),
+                        [block](Request const& req) { return req.block == block && !req.cancelled; });
+                };
+
+                auto const was_idle = std::empty(peer.queue);
+                auto const spans = wishlist.next(
+                    QueueDepth - std::size(peer.queue),
+                    PeerHasAllPieces,
+                    has_active_pending_to_peer,
+                    peer_speed);
+                for (auto const& [begin, end] : spans)
+                {
+                    for (auto block = begin; block < end; ++block)
+                    {
+                        peer.queue.push_back({ block, now });
+                        ++mediator.active_request_count_[block];
+                        ++n_active;
+                    }
+                }
+                if (was_idle && !std::empty(peer.queue))
+                {
+                    peer.front_done_at = now + peer.msec_per_block;
+                }
+            }
+        }
+
+        EXPECT_EQ(NumBlocks, std::size(mediator.client_has_block_));
+        result.tail_msec = now - t99;
+        return result;
+    };
+
+    auto const everyone = simulate(false);
+    auto const fast_only = simulate(true);
+    RecordProperty("everyone_tail_msec", std::to_string(everyone.tail_msec));
+    RecordProperty("everyone_wasted_blocks", std::to_string(everyone.wasted_blocks));
+    RecordProperty("fast_only_tail_msec", std::to_string(fast_only.tail_msec));
+    RecordProperty("fast_only_wasted_blocks", std::to_string(fast_only.wasted_blocks));
+    EXPECT_LT(fast_only.tail_msec * 2U, everyone.tail_msec)
+        << "last 1% took " << everyone.tail_msec << " msec (" << everyone.wasted_blocks
+        << " wasted blocks) when every peer duplicates requests, " << fast_only.tail_msec << " msec ("
+        << fast_only.wasted_blocks << " wasted blocks) when only the fastest peers do";
+}
+
+// Not run by default. Use --gtest_also_run_disabled_tests to run it.
+TEST_F(PeerMgrWishlistTest, DISABLED_nextBenchmark)
+{
+    static auto constexpr Iterations = 20000;
+    static auto constexpr BitfieldIterations = 200;
+    static auto constexpr BlocksPerRequest = size_t{ 16U };
+
+    for (auto const is_sequential : { false, true })
+    {
+        for (auto const n_pieces : { tr_piece_index_t{ 10000U }, tr_piece_index_t{ 30000U }, tr_piece_index_t{ 100000U } })
+        {
+            auto mediator_ptr = std::make_unique<SyntheticMediator>(*this, n_pieces);
+            auto& mediator = *mediator_ptr;
+            mediator.is_sequential_ = is_sequential;
+            auto wishlist = Wishlist{ std::move(mediator_ptr) };
+
+            // a peer that has a random half of the pieces
+            auto peer_has = tr_bitfield{ n_pieces };
+            for (tr_piece_index_t piece = 0U; piece < n_pieces; ++piece)
+            {
+                peer_has.set(piece, tr_rand_int(2U) == 0U);
+            }
+            auto const peer_has_piece = [&peer_has](tr_piece_index_t piece)
+            {
+                return peer_has.test(piece);
+            };
+
+            auto begin = std::chrono::steady_clock::now();
+            (void)wishlist.next(1U, peer_has_piece, ClientHasNoActiveRequests);
+            auto const build_usec = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - begin);
+
+            // Each iteration: a peer announces a piece, we receive a block
+            // of the piece we're working on, and we ask for more blocks.
+            begin = std::chrono::steady_clock::now();
+            for (int i = 0; i < Iterations; ++i)
+            {
+                auto const have = tr_rand_int(n_pieces);
+                ++mediator.replication_[have];
+                got_have_.emit(nullptr, have);
+
+                auto const spans = wishlist.next(BlocksPerRequest, peer_has_piece, ClientHasNoActiveRequests);
+                if (std::empty(spans))
+                {
+                    break;
+                }
+
+                auto const block = spans.front().begin;
+                auto const piece = block / SyntheticMediator::BlocksPerPiece;
+                mediator.client_has_block_[block] = true;
+                --mediator.missing_blocks_[piece];
+                got_block_.emit(nullptr, piece, block);
+                if (mediator.missing_blocks_[piece] == 0U)
+                {
+                    piece_completed_.emit(nullptr, piece);
+                }
+            }
+            auto const loop_usec = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - begin);
+
+            // Each iteration: a peer with half of the pieces connects and disconnects.
+            begin = std::chrono::steady_clock::now();
+            for (int i = 0; i < BitfieldIterations; ++i)
+            {
+                got_bitfield_.emit(nullptr, peer_has);
+                peer_disconnect_.emit(nullptr, peer_has);
+            }
+            auto const bitfield_usec = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - begin);
+
+            std::cout << "Wishlist: " << (is_sequential ? "sequential, " : "random, ") << n_pieces << " pieces: build "
+                      << build_usec.count() << " usec; "
+                      << (static_cast<double>(loop_usec.count()) / Iterations) << " usec per have + next + block; "
+                      << (static_cast<double>(bitfield_usec.count()) / BitfieldIterations)
+                      << " usec per bitfield + disconnect" << std::endl;
+        }
+    }
+}
@@ -3,8 +3,839 @@
 // or any future license endorsed by Mnemosyne LLC.
 // License text can be found in the licenses/ folder.
 
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstddef> // size_t, std::byte
+#include <cstdint> // uint64_t
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#endif
+
+#include <event2/util.h>
+
+#include <libtransmission/transmission.h>
+
+#include <libtransmission/block-info.h>
+#include <libtransmission/net.h>
+#include <libtransmission/peer-io.h>
+#include <libtransmission/peer-mgr.h>
+#include <libtransmission/peer-msgs.h>
+#include <libtransmission/peer-msgs-decoder.h>
+#include <libtransmission/peer-socket.h>
+#include <libtransmission/session.h>
+#include <libtransmission/torrent.h>
+#include <libtransmission/tr-strbuf.h>
+#include <libtransmission/utils.h>
+
 #include "gtest/gtest.h"
+#include "test-fixtures.h"
+
+using namespace std::literals;
+
+#ifdef _WIN32
+#define LOCAL_SOCKETPAIR_AF AF_INET
+#else
+#define LOCAL_SOCKETPAIR_AF AF_UNIX
+#endif
 
 TEST(PeerMsgs, placeholder)
 {
 }
+
+namespace
+{
+auto constexpr BlockSize = uint64_t{ tr_block_info::BlockSize };
+auto constexpr Ceil = size_t{ 250U };
+
+// time one request -> block round trip of `rtt_msec`
+void sample_rtt(tr_request_pipeline& pipeline, tr_block_index_t block, uint64_t& now_msec, uint64_t rtt_msec)
+{
+    pipeline.on_request_sent(block, now_msec);
+    now_msec += rtt_msec;
+    pipeline.on_block_received(block, now_msec);
+}
+} // namespace
+
+TEST(PeerMsgs, requestPipelineSlowStartDoublesPerRoundTrip)
+{
+    auto pipeline = tr_request_pipeline{};
+    auto now = uint64_t{ 1000U };
+    EXPECT_EQ(tr_request_pipeline::InitialDepth, pipeline.update(0U, Ceil, now));
+    EXPECT_TRUE(pipeline.is_slow_start());
+
+    // receiving a full pipeline's worth of blocks doubles the depth
+    for (auto round = 0; round < 2; ++round)
+    {
+        auto const depth = pipeline.depth();
+        for (size_t i = 0; i < depth; ++i)
+        {
+            pipeline.on_block_received(static_cast<tr_block_index_t>(i), now);
+        }
+        EXPECT_EQ(depth * 2U, pipeline.update(0U, Ceil, now));
+    }
+
+    // but never past the ceiling, which also ends slow start
+    for (size_t i = 0; i < Ceil; ++i)
+    {
+        pipeline.on_block_received(static_cast<tr_block_index_t>(i), now);
+    }
+    EXPECT_EQ(Ceil, pipeline.update(0U, Ceil, now));
+    EXPECT_FALSE(pipeline.is_slow_start());
+}
+
+TEST(PeerMsgs, requestPipelineStartsAtTheFloor)
+{
+    // a new peer gets as many requests as the old fixed floor gave it
+    auto pipeline = tr_request_pipeline{};
+    EXPECT_EQ(tr_request_pipeline::FloorDepth, pipeline.depth());
+    EXPECT_EQ(tr_request_pipeline::FloorDepth, pipeline.update(0U, Ceil, 1000U));
+    EXPECT_TRUE(pipeline.is_slow_start());
+
+    // unless it won't take that many
+    static auto constexpr SmallCeil = size_t{ 8U };
+    auto small = tr_request_pipeline{};
+    EXPECT_EQ(SmallCeil, small.update(0U, SmallCeil, 1000U));
+}
+
+TEST(PeerMsgs, requestPipelineSlowStartEndsWhenRttClimbs)
+{
+    auto pipeline = tr_request_pipeline{};
+    auto now = uint64_t{ 1000U };
+    pipeline.update(0U, Ceil, now);
+
+    sample_rtt(pipeline, 1U, now, 50U);
+    EXPECT_EQ(50U, pipeline.min_rtt_msec());
+    EXPECT_EQ(50U, pipeline.rtt_msec());
+    EXPECT_TRUE(pipeline.is_slow_start());
+
+    // modest jitter doesn't end slow start...
+    sample_rtt(pipeline, 2U, now, 110U);
+    EXPECT_TRUE(pipeline.is_slow_start());
+
+    // ...but requests queueing at the peer does
+    sample_rtt(pipeline, 3U, now, 400U);
+    EXPECT_FALSE(pipeline.is_slow_start());
+    EXPECT_EQ(50U, pipeline.min_rtt_msec());
+}
+
+TEST(PeerMsgs, requestPipelineFollowsBandwidthDelayProduct)
+{
+    auto pipeline = tr_request_pipeline{};
+    auto now = uint64_t{ 1000U };
+    pipeline.update(0U, Ceil, now);
+    sample_rtt(pipeline, 1U, now, 100U);
+    for (auto block = tr_block_index_t{ 2U }; !pipeline.is_queueing(); ++block)
+    {
+        sample_rtt(pipeline, block, now, 1000U);
+    }
+    ASSERT_FALSE(pipeline.is_slow_start());
+
+    // 200 blocks per second with a 100 msec RTT is a 20-block BDP
+    auto const depth = pipeline.update(200U * BlockSize, Ceil, now);
+    EXPECT_EQ(20U * 2U + tr_request_pipeline::MinDepth, depth);
+
+    // a faster peer gets a deeper pipeline, up to the ceiling
+    EXPECT_EQ(100U * 2U + tr_request_pipeline::MinDepth, pipeline.update(1000U * BlockSize, Ceil, now));
+    EXPECT_EQ(Ceil, pipeline.update(100000U * BlockSize, Ceil, now));
+
+    // a slow or stalled peer drops to the floor, but no further,
+    // so that it can speed back up quickly
+    EXPECT_EQ(tr_request_pipeline::FloorDepth, pipeline.update(100U * BlockSize, Ceil, now));
+    EXPECT_EQ(tr_request_pipeline::FloorDepth, pipeline.update(0U, Ceil, now));
+
+    // unless the peer won't take that many requests
+    static auto constexpr SmallCeil = size_t{ 8U };
+    EXPECT_EQ(SmallCeil, pipeline.update(0U, SmallCeil, now));
+}
+
+TEST(PeerMsgs, requestPipelineKeepsFastPeersDeepUntilTheyQueue)
+{
+    auto pipeline = tr_request_pipeline{};
+    auto now = uint64_t{ 1000U };
+    pipeline.update(0U, Ceil, now);
+
+    // a 10 MB/s peer with a steady 50 msec RTT that reached the ceiling
+    static auto constexpr Speed = uint64_t{ 10U * 1000U * 1000U };
+    sample_rtt(pipeline, 1U, now, 50U);
+    for (size_t i = 0; i < Ceil; ++i)
+    {
+        pipeline.on_block_received(static_cast<tr_block_index_t>(i), now);
+    }
+    ASSERT_EQ(Ceil, pipeline.update(Speed, Ceil, now));
+    ASSERT_FALSE(pipeline.is_slow_start());
+
+    // its 2xBDP is only ~62 blocks, but nothing shows that it can't keep
+    // up with more, so it keeps `MaxQueueSecs` worth, up to the ceiling
+    sample_rtt(pipeline, 2U, now, 60U);
+    EXPECT_FALSE(pipeline.is_queueing());
+    EXPECT_EQ(Ceil, pipeline.update(Speed, Ceil, now));
+
+    // once the round trips show our requests waiting at the peer,
+    // the depth falls back towards the BDP...
+    for (auto block = tr_block_index_t{ 3U }; !pipeline.is_queueing(); ++block)
+    {
+        sample_rtt(pipeline, block, now, 500U);
+    }
+    EXPECT_EQ(Speed * 50U / 1000U / BlockSize * 2U + tr_request_pipeline::MinDepth, pipeline.update(Speed, Ceil, now));
+
+    // ...and goes back up when the queue has drained
+    for (auto block = tr_block_index_t{ 100U }; pipeline.is_queueing(); ++block)
+    {
+        sample_rtt(pipeline, block, now, 50U);
+    }
+    EXPECT_EQ(Ceil, pipeline.update(Speed, Ceil, now));
+}
+
+TEST(PeerMsgs, requestPipelineCapsSlowPeers)
+{
+    auto pipeline = tr_request_pipeline{};
+    auto now = uint64_t{ 1000U };
+    pipeline.update(0U, Ceil, now);
+
+    // a long-RTT peer that only sends five blocks per second
+    sample_rtt(pipeline, 1U, now, 20000U);
+    sample_rtt(pipeline, 2U, now, 60000U);
+    ASSERT_FALSE(pipeline.is_slow_start());
+
+    // its BDP is 100 blocks, but it only gets `MaxQueueSecs` worth of them
+    EXPECT_EQ(size_t{ tr_request_pipeline::MaxQueueSecs * 5U }, pipeline.update(5U * BlockSize, Ceil, now));
+}
+
+TEST(PeerMsgs, requestPipelineIgnoresDroppedProbes)
+{
+    auto pipeline = tr_request_pipeline{};
+    auto now = uint64_t{ 1000U };
+    pipeline.update(0U, Ceil, now);
+
+    // a cancelled request doesn't produce a sample
+    pipeline.on_request_sent(1U, now);
+    pipeline.on_request_dropped(1U);
+    now += 5000U;
+    pipeline.on_block_received(1U, now);
+    EXPECT_EQ(0U, pipeline.rtt_msec());
+
+    // neither does one lost to a choke
+    pipeline.on_request_sent(2U, now);
+    pipeline.on_requests_cleared();
+    now += 5000U;
+    pipeline.on_block_received(2U, now);
+    EXPECT_EQ(0U, pipeline.rtt_msec());
+
+    // the next request is timed instead
+    sample_rtt(pipeline, 3U, now, 80U);
+    EXPECT_EQ(80U, pipeline.rtt_msec());
+}
+
+namespace
+{
+// Canned wire traffic, fed to the decoder no faster than `limit` bytes at a time
+class WireSource
+{
+public:
+    void add_uint8(uint8_t val)
+    {
+        bytes_.emplace_back(val);
+    }
+
+    void add_uint32(uint32_t val)
+    {
+        for (auto shift = 24; shift >= 0; shift -= 8)
+        {
+            add_uint8(static_cast<uint8_t>(val >> shift));
+        }
+    }
+
+    void add_message(uint8_t id, std::vector<uint8_t> const& payload)
+    {
+        add_uint32(static_cast<uint32_t>(1U + std::size(payload)));
+        add_uint8(id);
+        bytes_.insert(std::end(bytes_), std::begin(payload), std::end(payload));
+    }
+
+    void add_keepalive()
+    {
+        add_uint32(0U);
+    }
+
+    void add_piece(uint32_t piece, uint32_t offset, size_t len)
+    {
+        add_uint32(static_cast<uint32_t>(1U + 8U + len));
+        add_uint8(tr_peer_msgs_decoder::PieceMessageId);
+        add_uint32(piece);
+        add_uint32(offset);
+        for (size_t i = 0; i < len; ++i)
+        {
+            add_uint8(static_cast<uint8_t>(offset + i));
+        }
+    }
+
+    // Source API
+
+    [[nodiscard]] size_t read_buffer_size() const noexcept
+    {
+        return std::min(limit_, std::size(bytes_) - pos_);
+    }
+
+    void read_bytes(void* bytes, size_t n_bytes)
+    {
+        n_bytes = std::min(n_bytes, read_buffer_size());
+        if (bytes != nullptr)
+        {
+            std::copy_n(std::data(bytes_) + pos_, n_bytes, static_cast<uint8_t*>(bytes));
+        }
+        pos_ += n_bytes;
+        limit_ -= std::min(limit_, n_bytes);
+    }
+
+    void read_uint8(uint8_t* setme)
+    {
+        read_bytes(setme, sizeof(*setme));
+    }
+
+    void read_uint32(uint32_t* setme)
+    {
+        auto buf = std::array<uint8_t, 4U>{};
+        read_bytes(std::data(buf), std::size(buf));
+        *setme = uint32_t{ buf[0] } << 24U | uint32_t{ buf[1] } << 16U | uint32_t{ buf[2] } << 8U | uint32_t{ buf[3] };
+    }
+
+    void rewind() noexcept
+    {
+        pos_ = 0U;
+    }
+
+    std::vector<uint8_t> bytes_;
+    size_t pos_ = 0U;
+    size_t limit_ = SIZE_MAX;
+};
+
+class RecordingMediator final : public tr_peer_msgs_decoder::Mediator
+{
+public:
+    struct Message
+    {
+        uint8_t id;
+        std::vector<uint8_t> payload;
+    };
+
+    ReadState on_message(uint8_t id, tr_peer_msgs_decoder::MessageReader& payload) override
+    {
+        auto& message = messages_.emplace_back();
+        message.id = id;
+        message.payload.resize(std::size(payload));
+        payload.to_buf(std::data(message.payload), std::size(message.payload));
+        return READ_NOW;
+    }
+
+    ReadState on_piece_begin(uint32_t /*piece*/, uint32_t offset, uint32_t len, uint8_t** setme_dst) override
+    {
+        offsets_.emplace_back(offset);
+        if (!want_pieces_)
+        {
+            *setme_dst = nullptr;
+            return READ_NOW;
+        }
+
+        auto& block = keep_blocks_ ? blocks_.emplace_back() : scratch_;
+        block.resize(len);
+        *setme_dst = std::data(block);
+        return READ_NOW;
+    }
+
+    ReadState on_piece_end() override
+    {
+        ++n_pieces_ended_;
+        return READ_NOW;
+    }
+
+    std::vector<Message> messages_;
+    std::vector<uint32_t> offsets_;
+    std::vector<std::vector<uint8_t>> blocks_;
+    std::vector<uint8_t> scratch_;
+    size_t n_pieces_ended_ = 0U;
+    bool want_pieces_ = true;
+    bool keep_blocks_ = true;
+};
+
+[[nodiscard]] WireSource make_traffic()
+{
+    auto src = WireSource{};
+    src.add_keepalive();
+    src.add_message(4U, { 0, 0, 0, 5 }); // have
+    src.add_message(6U, { 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 3 }); // request
+    src.add_piece(1U, 0U, 300U);
+    src.add_keepalive();
+    src.add_message(5U, std::vector<uint8_t>(100U, 0xFF)); // bitfield, too big for the stack
+    src.add_piece(1U, 300U, 20U);
+    src.add_message(1U, {}); // unchoke
+    return src;
+}
+
+// decode all of `src`, `chunk_size` bytes at a time
+size_t decode_all(tr_peer_msgs_decoder& decoder, WireSource& src, size_t chunk_size)
+{
+    auto n_piece = size_t{};
+    while (src.pos_ < std::size(src.bytes_))
+    {
+        // more bytes arrive
+        src.limit_ = std::min(src.limit_, SIZE_MAX - chunk_size) + chunk_size;
+        for (;;)
+        {
+            auto const [state, n_piece_bytes] = decoder.read_one(src);
+            n_piece += n_piece_bytes;
+            EXPECT_NE(READ_ERR, state);
+            if (state != READ_NOW || src.read_buffer_size() == 0U)
+            {
+                break;
+            }
+        }
+    }
+    return n_piece;
+}
+
+void expect_traffic_decoded(RecordingMediator const& mediator)
+{
+    ASSERT_EQ(4U, std::size(mediator.messages_));
+    EXPECT_EQ(4U, mediator.messages_[0].id);
+    EXPECT_EQ((std::vector<uint8_t>{ 0, 0, 0, 5 }), mediator.messages_[0].payload);
+    EXPECT_EQ(6U, mediator.messages_[1].id);
+    EXPECT_EQ(12U, std::size(mediator.messages_[1].payload));
+    EXPECT_EQ(5U, mediator.messages_[2].id);
+    EXPECT_EQ(std::vector<uint8_t>(100U, 0xFF), mediator.messages_[2].payload);
+    EXPECT_EQ(1U, mediator.messages_[3].id);
+    EXPECT_TRUE(std::empty(mediator.messages_[3].payload));
+
+    EXPECT_EQ((std::vector<uint32_t>{ 0U, 300U }), mediator.offsets_);
+    EXPECT_EQ(2U, mediator.n_pieces_ended_);
+}
+} // namespace
+
+TEST(PeerMsgs, decoderReadsMixedTraffic)
+{
+    auto mediator = RecordingMediator{};
+    auto decoder = tr_peer_msgs_decoder{ mediator };
+    auto src = make_traffic();
+
+    EXPECT_EQ(320U, decode_all(decoder, src, SIZE_MAX));
+    expect_traffic_decoded(mediator);
+
+    // the block data went straight to where the mediator asked
+    ASSERT_EQ(2U, std::size(mediator.blocks_));
+    EXPECT_EQ(300U, std::size(mediator.blocks_[0]));
+    EXPECT_EQ(20U, std::size(mediator.blocks_[1]));
+    for (size_t i = 0; i < 300U; ++i)
+    {
+        EXPECT_EQ(static_cast<uint8_t>(i), mediator.blocks_[0][i]);
+    }
+    for (size_t i = 0; i < 20U; ++i)
+    {
+        EXPECT_EQ(static_cast<uint8_t>(300U + i), mediator.blocks_[1][i]);
+    }
+}
+
+TEST(PeerMsgs, decoderReadsSplitMessages)
+{
+    for (auto const chunk_size : { size_t{ 1U }, size_t{ 3U }, size_t{ 7U }, size_t{ 64U } })
+    {
+        auto mediator = RecordingMediator{};
+        auto decoder = tr_peer_msgs_decoder{ mediator };
+        auto src = make_traffic();
+
+        EXPECT_EQ(320U, decode_all(decoder, src, chunk_size)) << chunk_size;
+        expect_traffic_decoded(mediator);
+
+        auto whole = make_traffic();
+        auto whole_mediator = RecordingMediator{};
+        auto whole_decoder = tr_peer_msgs_decoder{ whole_mediator };
+        decode_all(whole_decoder, whole, SIZE_MAX);
+        EXPECT_EQ(whole_mediator.blocks_, mediator.blocks_) << chunk_size;
+    }
+}
+
+TEST(PeerMsgs, decoderDiscardsUnwantedBlocks)
+{
+    auto mediator = RecordingMediator{};
+    mediator.want_pieces_ = false;
+    auto decoder = tr_peer_msgs_decoder{ mediator };
+    auto src = make_traffic();
+
+    // the bytes are still read and counted, but go nowhere
+    EXPECT_EQ(320U, decode_all(decoder, src, 5U));
+    expect_traffic_decoded(mediator);
+    EXPECT_TRUE(std::empty(mediator.blocks_));
+}
+
+// Not run by default. Use --gtest_also_run_disabled_tests to run it.
+TEST(PeerMsgs, DISABLED_decoderBenchmark)
+{
+    static auto constexpr Iterations = 50;
+    static auto constexpr BlocksPerIteration = uint32_t{ 1024U };
+
+    // a busy download: full blocks, with the odd have and keepalive mixed in
+    auto src = WireSource{};
+    for (uint32_t i = 0; i < BlocksPerIteration; ++i)
+    {
+        src.add_piece(i / 16U, (i % 16U) * tr_block_info::BlockSize, tr_block_info::BlockSize);
+        if (i % 8U == 0U)
+        {
+            src.add_message(4U, { 0, 0, 0, static_cast<uint8_t>(i) });
+        }
+        if (i % 64U == 0U)
+        {
+            src.add_keepalive();
+        }
+    }
+
+    // a TCP-ish segment size, so messages straddle reads
+    static auto constexpr ChunkSize = size_t{ 1460U };
+
+    auto mediator = RecordingMediator{};
+    mediator.keep_blocks_ = false;
+    auto decoder = tr_peer_msgs_decoder{ mediator };
+    auto n_piece = size_t{};
+
+    auto const begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < Iterations; ++i)
+    {
+        src.rewind();
+        mediator.messages_.clear();
+        n_piece += decode_all(decoder, src, ChunkSize);
+    }
+    auto const usec = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin);
+
+    EXPECT_EQ(size_t{ Iterations } * BlocksPerIteration * tr_block_info::BlockSize, n_piece);
+    auto const n_bytes = std::size(src.bytes_) * Iterations;
+    std::cout << "decoded " << n_bytes << " bytes in " << usec.count() << " usec ("
+              << (n_bytes / std::max(int64_t{ 1 }, static_cast<int64_t>(usec.count()))) << " MB/s)" << std::endl;
+}
+
+namespace libtransmission::test
+{
+
+class PeerMsgsTest : public SessionTest
+{
+protected:
+    void SetUp() override
+    {
+        tr_variantDictAddBool(settings(), TR_KEY_lazy_have_enabled, true);
+        SessionTest::SetUp();
+    }
+
+    struct Peer
+    {
+        std::shared_ptr<tr_peerIo> io;
+        std::unique_ptr<tr_peerMsgs> msgs;
+
+        // the remote end of the connection
+        evutil_socket_t sock = TR_BAD_SOCKET;
+    };
+
+    // Returns a connected peer for `tor` that has nothing queued to send.
+    // Must be called from the session thread.
+    Peer create_peer(tr_torrent* const tor, bool const encrypted = false)
+    {
+        auto sockpair = std::array<evutil_socket_t, 2>{ -1, -1 };
+        EXPECT_EQ(0, evutil_socketpair(LOCAL_SOCKETPAIR_AF, SOCK_STREAM, 0, std::data(sockpair))) << tr_strerror(errno);
+        for (auto const sock : sockpair)
+        {
+            evutil_make_socket_nonblocking(sock);
+        }
+
+        auto peer = Peer{};
+        peer.io = tr_peerIo::create(session_, &session_->top_bandwidth_, &tor->info_hash(), false /*incoming*/, false /*seed*/);
+        peer.io->set_socket(tr_peer_socket{ session_, PeerSockAddr, sockpair[0] });
+        peer.sock = sockpair[1];
+
+        if (encrypted)
+        {
+            auto const dh = tr_peerIo::DH{};
+            peer.io->decrypt_init(false /*incoming*/, dh, tor->info_hash());
+            peer.io->encrypt_init(false /*incoming*/, dh, tor->info_hash());
+        }
+
+        auto peer_info = std::make_shared<tr_peer_info>(PeerSockAddr, 0U, TR_PEER_FROM_INCOMING);
+        auto const callback = [](tr_peerMsgs* /*msgs*/, tr_peer_event const& event, void* user_data)
+        {
+            static_cast<PeerMsgsTest*>(user_data)->events_.emplace_back(event);
+        };
+        peer.msgs.reset(tr_peerMsgs::create(*tor, std::move(peer_info), peer.io, {}, callback, this));
+
+        // skip past the bitfield that a new connection starts with
+        (void)sent_bytes(peer);
+        return peer;
+    }
+
+    static void destroy_peer(Peer& peer)
+    {
+        peer.msgs.reset();
+        peer.io.reset();
+        evutil_closesocket(peer.sock);
+    }
+
+    // Sends whatever `peer` has queued and returns the bytes that reached the other end.
+    static std::vector<std::byte> sent_bytes(Peer& peer)
+    {
+        (void)peer.io->flush(TR_UP, SIZE_MAX);
+
+        auto received = std::vector<std::byte>{};
+        auto buf = std::array<std::byte, 4096U>{};
+        for (;;)
+        {
+            auto const n_read = recv(peer.sock, reinterpret_cast<char*>(std::data(buf)), std::size(buf), 0);
+            if (n_read <= 0)
+            {
+                break;
+            }
+            received.insert(std::end(received), std::begin(buf), std::begin(buf) + n_read);
+        }
+
+        return received;
+    }
+
+    // Sends whatever `peer` has queued and returns the
+    // pieces of the HAVE messages that reached the other end.
+    static std::vector<tr_piece_index_t> sent_haves(Peer& peer)
+    {
+        static auto constexpr HaveId = std::byte{ 4U };
+
+        auto const received = sent_bytes(peer);
+
+        auto const to_uint32 = [&received](size_t pos)
+        {
+            auto val = uint32_t{};
+            for (size_t i = 0; i < 4U; ++i)
+            {
+                val = (val << 8U) | std::to_integer<uint32_t>(received[pos + i]);
+            }
+            return val;
+        };
+
+        auto haves = std::vector<tr_piece_index_t>{};
+        for (size_t pos = 0U; pos + 4U <= std::size(received);)
+        {
+            auto const len = to_uint32(pos);
+            EXPECT_LE(pos + 4U + len, std::size(received));
+            if (len == 5U && received[pos + 4U] == HaveId)
+            {
+                haves.emplace_back(to_uint32(pos + 5U));
+            }
+            pos += 4U + len;
+        }
+
+        return haves;
+    }
+
+    // Has the other end send `peer` a piece message with one byte of `piece`.
+    static void receive_piece_byte(Peer& peer, tr_piece_index_t const piece)
+    {
+        auto msg = std::array<uint8_t, 14U>{ 0, 0, 0, 10, 7 };
+        for (size_t i = 0; i < 4U; ++i)
+        {
+            msg[5U + i] = static_cast<uint8_t>(piece >> (8U * (3U - i)));
+        }
+
+        auto const n_sent = send(peer.sock, reinterpret_cast<char const*>(std::data(msg)), std::size(msg), 0);
+        EXPECT_EQ(std::size(msg), static_cast<size_t>(n_sent));
+        (void)peer.io->flush(TR_DOWN, std::size(msg));
+    }
+
+    [[nodiscard]] bool got_error(int const err) const
+    {
+        return std::any_of(
+            std::begin(events_),
+            std::end(events_),
+            [err](tr_peer_event const& event) { return event.type == tr_peer_event::Type::Error && event.err == err; });
+    }
+
+    // tr_peerIo and tr_peerMsgs aren't thread-safe, so poke at them from the session thread
+    template<typename Func>
+    void run_in_session_thread(Func&& func)
+    {
+        auto promise = std::promise<void>{};
+        auto future = promise.get_future();
+        session_->run_in_session_thread(
+            [&func, &promise]()
+            {
+                func();
+                promise.set_value();
+            });
+        future.wait();
+    }
+
+    // not a LAN address, so the peer is treated like any other
+    tr_socket_address const PeerSockAddr{ *tr_address::from_string("198.51.100.1"sv), tr_port::from_host(8080) };
+
+    // what the peers have published, in order
+    std::vector<tr_peer_event> events_;
+};
+
+TEST_F(PeerMsgsTest, completedPiecesShareOneWrite)
+{
+    auto* const tor = zeroTorrentInit(ZeroTorrentState::NoFiles);
+    ASSERT_NE(nullptr, tor);
+
+    run_in_session_thread(
+        [this, tor]()
+        {
+            auto peer = create_peer(tor);
+
+            // nothing is sent as the pieces complete...
+            for (tr_piece_index_t piece = 0U; piece < 3U; ++piece)
+            {
+                peer.msgs->on_piece_completed(piece);
+                EXPECT_EQ(0U, peer.io->flush(TR_UP, SIZE_MAX));
+            }
+
+            // ...and the next pulse sends them all at once
+            peer.msgs->pulse();
+            EXPECT_EQ((std::vector<tr_piece_index_t>{ 0U, 1U, 2U }), sent_haves(peer));
+
+            destroy_peer(peer);
+        });
+
+    tr_torrentRemove(tor, false, nullptr, nullptr, nullptr, nullptr);
+}
+
+TEST_F(PeerMsgsTest, haveTimerFlushesWithoutPulse)
+{
+    auto* const tor = zeroTorrentInit(ZeroTorrentState::NoFiles);
+    ASSERT_NE(nullptr, tor);
+
+    auto peer = Peer{};
+    run_in_session_thread(
+        [this, tor, &peer]()
+        {
+            peer = create_peer(tor);
+            peer.msgs->on_piece_completed(5U);
+            EXPECT_TRUE(std::empty(sent_haves(peer)));
+        });
+
+    // nobody calls pulse(), but the HAVE goes out anyway
+    auto haves = std::vector<tr_piece_index_t>{};
+    EXPECT_TRUE(waitFor(
+        [this, &peer, &haves]()
+        {
+            run_in_session_thread(
+                [&peer, &haves]()
+                {
+                    auto const sent = sent_haves(peer);
+                    haves.insert(std::end(haves), std::begin(sent), std::end(sent));
+                });
+            return !std::empty(haves);
+        },
+        5s));
+    EXPECT_EQ(std::vector<tr_piece_index_t>{ 5U }, haves);
+
+    run_in_session_thread([&peer]() { destroy_peer(peer); });
+    tr_torrentRemove(tor, false, nullptr, nullptr, nullptr, nullptr);
+}
+
+TEST_F(PeerMsgsTest, idleEncryptedPeerUsesUnder8KiB)
+{
+    static auto constexpr MaxIdleBytes = size_t{ 8U * 1024U };
+
+    auto* const tor = zeroTorrentInit(ZeroTorrentState::NoFiles);
+    ASSERT_NE(nullptr, tor);
+
+    auto total = size_t{};
+    run_in_session_thread(
+        [this, tor, &total]()
+        {
+            auto peer = create_peer(tor, true /*encrypted*/);
+            EXPECT_TRUE(peer.io->is_encrypted());
+
+            auto const usage = peer.msgs->memory_usage();
+            total = usage.msgs_bytes + usage.io_bytes + usage.buffer_bytes;
+
+            destroy_peer(peer);
+        });
+
+    RecordProperty("idle_encrypted_peer_bytes", static_cast<int>(total));
+    EXPECT_LT(total, MaxIdleBytes);
+
+    tr_torrentRemove(tor, false, nullptr, nullptr, nullptr, nullptr);
+}
+
+TEST_F(PeerMsgsTest, unrequestedBlocksPastTheAllowanceAreAnError)
+{
+    auto* const tor = zeroTorrentInit(ZeroTorrentState::NoFiles);
+    ASSERT_NE(nullptr, tor);
+
+    run_in_session_thread(
+        [this, tor]()
+        {
+            auto peer = create_peer(tor);
+
+            // the peer may send the block that we cancelled, plus a little slack...
+            peer.msgs->cancel_block_request(0U);
+            (void)sent_bytes(peer);
+            for (int i = 0; i < 3; ++i)
+            {
+                receive_piece_byte(peer, 0U);
+                EXPECT_FALSE(got_error(ERANGE));
+            }
+
+            auto const n_wasted = std::count_if(
+                std::begin(events_),
+                std::end(events_),
+                [](tr_peer_event const& event) { return event.type == tr_peer_event::Type::ClientGotWastedData; });
+            EXPECT_EQ(3, n_wasted);
+
+            // ...but no more than that
+            receive_piece_byte(peer, 0U);
+            EXPECT_TRUE(got_error(ERANGE));
+
+            destroy_peer(peer);
+        });
+
+    tr_torrentRemove(tor, false, nullptr, nullptr, nullptr, nullptr);
+}
+
+TEST_F(PeerMsgsTest, lazyHaveSkipsPeersThatHaveThePiece)
+{
+    ASSERT_TRUE(session_->lazy_have_enabled());
+
+    auto* const tor = zeroTorrentInit(ZeroTorrentState::NoFiles);
+    ASSERT_NE(nullptr, tor);
+
+    run_in_session_thread(
+        [this, tor]()
+        {
+            auto seeder = create_peer(tor);
+            auto leecher = create_peer(tor);
+
+            // the seeder tells us it has piece 1
+            static auto constexpr HaveOne = std::array<uint8_t, 9U>{ 0, 0, 0, 5, 4, 0, 0, 0, 1 };
+            auto const n_sent = send(seeder.sock, reinterpret_cast<char const*>(std::data(HaveOne)), std::size(HaveOne), 0);
+            EXPECT_EQ(std::size(HaveOne), static_cast<size_t>(n_sent));
+            (void)seeder.io->flush(TR_DOWN, std::size(HaveOne));
+            EXPECT_TRUE(seeder.msgs->has().test(1U));
+
+            for (auto* const peer : { &seeder, &leecher })
+            {
+                peer->msgs->on_piece_completed(1U);
+                peer->msgs->on_piece_completed(2U);
+                peer->msgs->pulse();
+            }
+
+            EXPECT_EQ(std::vector<tr_piece_index_t>{ 2U }, sent_haves(seeder));
+            EXPECT_EQ((std::vector<tr_piece_index_t>{ 1U, 2U }), sent_haves(leecher));
+
+            destroy_peer(seeder);
+            destroy_peer(leecher);
+        });
+
+    tr_torrentRemove(tor, false, nullptr, nullptr, nullptr, nullptr);
+}
+
+} // namespace libtransmission::test
@@ -0,0 +1,122 @@
+// This file Copyright (C) 2026 Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <algorithm>
+#include <cstddef> // size_t
+#include <memory>
+#include <vector>
+
+#include <libtransmission/ring.h>
+
+#include "gtest/gtest.h"
+
+namespace
+{
+template<typename T>
+[[nodiscard]] std::vector<T> to_vector(tr_ring<T> const& ring)
+{
+    return { std::begin(ring), std::end(ring) };
+}
+} // namespace
+
+TEST(RingTest, emptyRingAllocatesNothing)
+{
+    auto const ring = tr_ring<int>{};
+    EXPECT_TRUE(std::empty(ring));
+    EXPECT_EQ(0U, std::size(ring));
+    EXPECT_EQ(0U, ring.capacity());
+    EXPECT_EQ(std::begin(ring), std::end(ring));
+}
+
+TEST(RingTest, fifo)
+{
+    auto ring = tr_ring<int>{};
+    for (int i = 0; i < 3; ++i)
+    {
+        ring.emplace_back(i);
+    }
+    EXPECT_EQ((std::vector<int>{ 0, 1, 2 }), to_vector(ring));
+    EXPECT_EQ(0, ring.front());
+    EXPECT_EQ(2, ring.back());
+
+    ring.pop_front();
+    EXPECT_EQ((std::vector<int>{ 1, 2 }), to_vector(ring));
+
+    ring.clear();
+    EXPECT_TRUE(std::empty(ring));
+}
+
+TEST(RingTest, reusesStorageWhenWrappingAround)
+{
+    auto ring = tr_ring<int>{};
+    ring.emplace_back(0);
+    auto const capacity = ring.capacity();
+
+    // push and pop many more items than the ring holds
+    for (int i = 1; i < 1000; ++i)
+    {
+        ring.emplace_back(i);
+        ring.pop_front();
+        EXPECT_EQ(i, ring.front());
+    }
+
+    EXPECT_EQ(capacity, ring.capacity());
+}
+
+TEST(RingTest, growsWhenFullAndKeepsOrder)
+{
+    auto ring = tr_ring<int>{};
+    auto expected = std::vector<int>{};
+
+    // offset the head so that the items wrap around when it grows
+    ring.emplace_back(-1);
+    ring.emplace_back(-1);
+    ring.pop_front();
+    ring.pop_front();
+
+    for (int i = 0; i < 100; ++i)
+    {
+        ring.emplace_back(i);
+        expected.emplace_back(i);
+    }
+
+    EXPECT_EQ(expected, to_vector(ring));
+    EXPECT_LE(100U, ring.capacity());
+}
+
+TEST(RingTest, erase)
+{
+    auto ring = tr_ring<int>{};
+    for (int i = 0; i < 5; ++i)
+    {
+        ring.emplace_back(i);
+    }
+
+    auto const it = ring.erase(std::find(std::begin(ring), std::end(ring), 2));
+    EXPECT_EQ(3, *it);
+    EXPECT_EQ((std::vector<int>{ 0, 1, 3, 4 }), to_vector(ring));
+
+    ring.erase(std::find(std::begin(ring), std::end(ring), 4));
+    EXPECT_EQ((std::vector<int>{ 0, 1, 3 }), to_vector(ring));
+}
+
+TEST(RingTest, destroysItems)
+{
+    auto const item = std::make_shared<int>(42);
+
+    {
+        auto ring = tr_ring<std::shared_ptr<int>>{};
+        for (size_t i = 0; i < 10U; ++i)
+        {
+            ring.emplace_back(item);
+        }
+        EXPECT_EQ(11, item.use_count());
+
+        ring.pop_front();
+        EXPECT_EQ(10, item.use_count());
+    }
+
+    EXPECT_EQ(1, item.use_count());
+}
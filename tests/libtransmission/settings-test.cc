@@ -451,6 +451,47 @@ TEST_F(SettingsTest, canSavePreferredTransport)
     EXPECT_EQ("tcp", val);
 }
 
+TEST_F(SettingsTest, canLoadSeedChoker)
+{
+    static auto constexpr Key = TR_KEY_seed_choking_algorithm;
+    auto constexpr ExpectedValue = TR_SEED_CHOKER_ROUND_ROBIN;
+
+    auto settings = std::make_unique<tr_session::Settings>();
+    auto const default_value = settings->seed_choker;
+    ASSERT_NE(ExpectedValue, default_value);
+
+    auto var = tr_variant{};
+    tr_variantInitDict(&var, 1);
+    tr_variantDictAddInt(&var, Key, ExpectedValue);
+    settings->load(var);
+    EXPECT_EQ(ExpectedValue, settings->seed_choker);
+    var.clear();
+
+    settings = std::make_unique<tr_session::Settings>();
+    tr_variantInitDict(&var, 1);
+    tr_variantDictAddStrView(&var, Key, "round-robin");
+    settings->load(var);
+    EXPECT_EQ(ExpectedValue, settings->seed_choker);
+}
+
+TEST_F(SettingsTest, canSaveSeedChoker)
+{
+    static auto constexpr Key = TR_KEY_seed_choking_algorithm;
+    static auto constexpr ExpectedValue = TR_SEED_CHOKER_ROUND_ROBIN;
+
+    auto settings = tr_session::Settings{};
+    auto const default_value = settings.seed_choker;
+    ASSERT_NE(ExpectedValue, default_value);
+
+    auto var = tr_variant{};
+    tr_variantInitDict(&var, 100);
+    settings.seed_choker = ExpectedValue;
+    var = settings.save();
+    auto val = std::string_view{};
+    EXPECT_TRUE(tr_variantDictFindStrView(&var, Key, &val));
+    EXPECT_EQ("round-robin", val);
+}
+
 TEST_F(SettingsTest, canLoadSleepPerSecondsDuringVerify)
 {
     static auto constexpr Key = TR_KEY_sleep_per_seconds_during_verify;
@@ -0,0 +1,269 @@
+// This file Copyright (C) 2026 Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <array>
+#include <chrono>
+#include <cstddef> // size_t
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <libtransmission/timer.h>
+#include <libtransmission/timer-wheel.h>
+
+#include "gtest/gtest.h"
+
+using namespace std::literals;
+
+namespace libtransmission::test
+{
+
+class TimerWheelTest : public ::testing::Test
+{
+protected:
+    // Stands in for the libevent timer that drives the wheel.
+    class MockTimer final : public Timer
+    {
+    public:
+        void stop() override
+        {
+            is_running_ = false;
+        }
+
+        void set_callback(std::function<void()> callback) override
+        {
+            callback_ = std::move(callback);
+        }
+
+        void set_repeating(bool repeating = true) override
+        {
+            is_repeating_ = repeating;
+        }
+
+        void set_interval(std::chrono::milliseconds interval) override
+        {
+            interval_ = interval;
+        }
+
+        void start() override
+        {
+            is_running_ = true;
+        }
+
+        [[nodiscard]] std::chrono::milliseconds interval() const noexcept override
+        {
+            return interval_;
+        }
+
+        [[nodiscard]] bool is_repeating() const noexcept override
+        {
+            return is_repeating_;
+        }
+
+        std::function<void()> callback_;
+        std::chrono::milliseconds interval_ = {};
+        bool is_repeating_ = false;
+        bool is_running_ = false;
+    };
+
+    class MockTimerMaker final : public TimerMaker
+    {
+    public:
+        [[nodiscard]] std::unique_ptr<Timer> create() override
+        {
+            auto timer = std::make_unique<MockTimer>();
+            timers_.emplace_back(timer.get());
+            return timer;
+        }
+
+        std::vector<MockTimer*> timers_;
+    };
+
+    static auto constexpr Tick = 100ms;
+
+    [[nodiscard]] MockTimer& tick_timer() const
+    {
+        return *parent_.timers_.front();
+    }
+
+    // Let `duration` go by, calling the tick timer along the way
+    // whenever it's running.
+    void run_for(std::chrono::milliseconds duration)
+    {
+        for (auto elapsed = 0ms; elapsed < duration; elapsed += Tick)
+        {
+            now_msec_ += static_cast<uint64_t>(Tick.count());
+
+            if (tick_timer().is_running_)
+            {
+                tick_timer().callback_();
+            }
+        }
+    }
+
+    [[nodiscard]] auto elapsed() const
+    {
+        return std::chrono::milliseconds{ now_msec_ - StartMsec };
+    }
+
+    static auto constexpr StartMsec = uint64_t{ 1000000U };
+
+    MockTimerMaker parent_;
+    uint64_t now_msec_ = StartMsec;
+    WheelTimerMaker wheel_{ parent_, Tick, [this]() { return now_msec_; } };
+};
+
+TEST_F(TimerWheelTest, usesOneParentTimer)
+{
+    auto timers = std::vector<std::unique_ptr<Timer>>{};
+    for (size_t i = 0; i < 100U; ++i)
+    {
+        timers.emplace_back(wheel_.create([]() {}))->start_single_shot(1s);
+    }
+
+    EXPECT_EQ(1U, std::size(parent_.timers_));
+    EXPECT_EQ(100U, wheel_.size());
+    EXPECT_TRUE(tick_timer().is_running_);
+    EXPECT_TRUE(tick_timer().is_repeating());
+    EXPECT_EQ(Tick, tick_timer().interval());
+}
+
+TEST_F(TimerWheelTest, singleShotFiresOnceOnTime)
+{
+    static auto constexpr Interval = 1s;
+
+    auto fired_at = std::vector<std::chrono::milliseconds>{};
+    auto timer = wheel_.create([&]() { fired_at.emplace_back(elapsed()); });
+    timer->start_single_shot(Interval);
+
+    run_for(Interval - Tick);
+    EXPECT_TRUE(std::empty(fired_at));
+
+    run_for(10s);
+    ASSERT_EQ(1U, std::size(fired_at));
+    EXPECT_LE(Interval, fired_at.front());
+    EXPECT_GE(Interval + Tick, fired_at.front());
+
+    // the wheel stops ticking when it has nothing to do
+    EXPECT_EQ(0U, wheel_.size());
+    EXPECT_FALSE(tick_timer().is_running_);
+}
+
+TEST_F(TimerWheelTest, repeatingFiresEachInterval)
+{
+    static auto constexpr Interval = 2s;
+
+    auto n_fired = size_t{};
+    auto timer = wheel_.create([&]() { ++n_fired; });
+    timer->start_repeating(Interval);
+
+    run_for(Interval * 10);
+    EXPECT_EQ(10U, n_fired);
+    EXPECT_TRUE(tick_timer().is_running_);
+
+    timer->stop();
+    run_for(Interval * 10);
+    EXPECT_EQ(10U, n_fired);
+    EXPECT_FALSE(tick_timer().is_running_);
+}
+
+TEST_F(TimerWheelTest, longIntervalsCascade)
+{
+    // one per wheel level, plus one past the end of the wheel
+    static auto constexpr Intervals = std::array<std::chrono::milliseconds, 5U>{ 3s, 5min, 6h, 10 * 24h, 30 * 24h };
+
+    auto fired_at = std::array<std::chrono::milliseconds, std::size(Intervals)>{};
+    auto timers = std::vector<std::unique_ptr<Timer>>{};
+    for (size_t i = 0; i < std::size(Intervals); ++i)
+    {
+        timers.emplace_back(wheel_.create([this, &fired_at, i]() { fired_at[i] = elapsed(); }))->start_single_shot(Intervals[i]);
+    }
+
+    // jump to just before each deadline, as if the process had been
+    // asleep, to check the catch-up logic as well
+    for (auto const& interval : Intervals)
+    {
+        now_msec_ = StartMsec + static_cast<uint64_t>(interval.count()) - 1000U;
+        tick_timer().callback_();
+        run_for(2s);
+    }
+
+    for (size_t i = 0; i < std::size(Intervals); ++i)
+    {
+        EXPECT_LE(Intervals[i], fired_at[i]) << i;
+        EXPECT_GE(Intervals[i] + Tick, fired_at[i]) << i;
+    }
+}
+
+TEST_F(TimerWheelTest, stopAndRestart)
+{
+    auto n_fired = size_t{};
+    auto timer = wheel_.create([&]() { ++n_fired; });
+
+    timer->start_single_shot(1s);
+    run_for(500ms);
+    timer->stop();
+    run_for(5s);
+    EXPECT_EQ(0U, n_fired);
+
+    // changing the interval of a running timer restarts it
+    timer->start_single_shot(1s);
+    run_for(500ms);
+    timer->set_interval(2s);
+    run_for(1500ms);
+    EXPECT_EQ(0U, n_fired);
+    run_for(1s);
+    EXPECT_EQ(1U, n_fired);
+}
+
+TEST_F(TimerWheelTest, callbacksCanDestroyTimers)
+{
+    auto timers = std::vector<std::unique_ptr<Timer>>(3U);
+    auto n_fired = size_t{};
+
+    // all three are due on the same tick; the first one to fire
+    // destroys itself and the others
+    for (auto& timer : timers)
+    {
+        timer = wheel_.create(
+            [&]()
+            {
+                ++n_fired;
+                timers.clear();
+            });
+        timer->start_single_shot(1s);
+    }
+
+    run_for(2s);
+    EXPECT_EQ(1U, n_fired);
+    EXPECT_EQ(0U, wheel_.size());
+}
+
+TEST_F(TimerWheelTest, manyTimersFireInOrder)
+{
+    static auto constexpr NumTimers = size_t{ 1000U };
+
+    auto fired = std::vector<size_t>{};
+    auto timers = std::vector<std::unique_ptr<Timer>>{};
+    for (size_t i = 0; i < NumTimers; ++i)
+    {
+        // spread them out so that each fires on its own tick
+        auto const interval = Tick * ((i * 7919U) % NumTimers + 1U);
+        auto& timer = timers.emplace_back(wheel_.create([&fired, i]() { fired.emplace_back(i); }));
+        timer->start_single_shot(interval);
+    }
+
+    run_for(Tick * (NumTimers + 1U));
+    ASSERT_EQ(NumTimers, std::size(fired));
+
+    for (size_t i = 1; i < NumTimers; ++i)
+    {
+        EXPECT_LT((fired[i - 1U] * 7919U) % NumTimers, (fired[i] * 7919U) % NumTimers);
+    }
+}
+
+} // namespace libtransmission::test
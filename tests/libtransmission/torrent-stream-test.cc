@@ -0,0 +1,195 @@
+// This file Copyright (C) 2024 Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <algorithm>
+#include <cstdint> // uint64_t
+#include <set>
+#include <vector>
+
+#include <libtransmission/transmission.h>
+
+#include <libtransmission/block-info.h>
+#include <libtransmission/torrent-stream.h>
+
+#include "gtest/gtest.h"
+
+class TorrentStreamTest : public ::testing::Test
+{
+protected:
+    static auto constexpr PieceSize = uint32_t{ 1024U * 1024U };
+    static auto constexpr PieceCount = 40U;
+    static auto constexpr Rate = uint64_t{ PieceSize }; // one piece per second
+    static auto constexpr Now = uint64_t{ 1000000U };
+
+    tr_block_info const block_info_{ uint64_t{ PieceSize } * PieceCount, PieceSize };
+
+    // one file that fills the whole torrent
+    static tr_torrent_stream::Position make_position(uint64_t offset)
+    {
+        auto pos = tr_torrent_stream::Position{};
+        pos.file = 0U;
+        pos.offset = offset;
+        pos.byte = offset;
+        pos.file_end = uint64_t{ PieceSize } * PieceCount;
+        return pos;
+    }
+
+    [[nodiscard]] static auto make_stream(uint64_t offset)
+    {
+        auto stream = tr_torrent_stream{};
+        stream.set_rate(Rate, Now);
+        stream.set_positions({ make_position(offset) }, Now);
+        return stream;
+    }
+
+    static auto constexpr HasNoPieces = [](tr_piece_index_t)
+    {
+        return false;
+    };
+};
+
+TEST_F(TorrentStreamTest, deadlinesFollowPlayback)
+{
+    auto const stream = make_stream(uint64_t{ PieceSize } * 2U);
+    EXPECT_TRUE(stream.is_active());
+
+    // the window covers `WindowSecs` of playback from the position
+    auto deadlines = stream.deadlines(block_info_, HasNoPieces, Now);
+    ASSERT_EQ(tr_torrent_stream::WindowSecs, std::size(deadlines));
+    for (size_t i = 0; i < std::size(deadlines); ++i)
+    {
+        EXPECT_EQ(2U + i, deadlines[i].piece);
+        EXPECT_EQ(static_cast<int64_t>(i) * 1000, deadlines[i].msec);
+    }
+
+    // pieces that we have aren't listed
+    auto const have = std::set<tr_piece_index_t>{ 2U, 4U };
+    deadlines = stream.deadlines(block_info_, [&have](tr_piece_index_t p) { return have.count(p) != 0U; }, Now);
+    ASSERT_EQ(tr_torrent_stream::WindowSecs - 2U, std::size(deadlines));
+    EXPECT_EQ(3U, deadlines[0].piece);
+    EXPECT_EQ(1000, deadlines[0].msec);
+    EXPECT_EQ(5U, deadlines[1].piece);
+
+    // as time passes, the window slides forward and missed pieces become overdue
+    deadlines = stream.deadlines(block_info_, HasNoPieces, Now + 5000U);
+    ASSERT_EQ(tr_torrent_stream::WindowSecs + 5U, std::size(deadlines));
+    EXPECT_EQ(2U, deadlines.front().piece);
+    EXPECT_EQ(-5000, deadlines.front().msec);
+    EXPECT_EQ(26U, deadlines.back().piece);
+}
+
+TEST_F(TorrentStreamTest, windowStopsAtEndOfFile)
+{
+    auto const stream = make_stream(uint64_t{ PieceSize } * (PieceCount - 3U));
+    auto const deadlines = stream.deadlines(block_info_, HasNoPieces, Now);
+    ASSERT_EQ(3U, std::size(deadlines));
+    EXPECT_EQ(PieceCount - 1U, deadlines.back().piece);
+}
+
+TEST_F(TorrentStreamTest, windowHasMinimumSize)
+{
+    auto stream = make_stream(0U);
+    stream.set_rate(1U, Now);
+
+    auto const deadlines = stream.deadlines(block_info_, HasNoPieces, Now);
+    EXPECT_EQ(tr_torrent_stream::MinWindowPieces, std::size(deadlines));
+}
+
+TEST_F(TorrentStreamTest, setRateKeepsPlaybackPosition)
+{
+    auto stream = make_stream(0U);
+
+    // after two seconds at one piece per second, playback is at piece 2
+    stream.set_rate(Rate * 2U, Now + 2000U);
+    ASSERT_EQ(1U, std::size(stream.positions()));
+    EXPECT_EQ(uint64_t{ PieceSize } * 2U, stream.positions().front().offset);
+    EXPECT_EQ(Rate * 2U, stream.rate());
+
+    // and now it goes twice as fast
+    auto const deadlines = stream.deadlines(block_info_, HasNoPieces, Now + 2000U);
+    EXPECT_EQ(2U, deadlines[0].piece);
+    EXPECT_EQ(0, deadlines[0].msec);
+    EXPECT_EQ(3U, deadlines[1].piece);
+    EXPECT_EQ(500, deadlines[1].msec);
+
+    // zero means the default rate
+    stream.set_rate(0U, Now + 2000U);
+    EXPECT_EQ(tr_torrent_stream::DefaultRate, stream.rate());
+}
+
+TEST_F(TorrentStreamTest, sharedPiecesAreListedOnce)
+{
+    auto stream = tr_torrent_stream{};
+    stream.set_rate(Rate, Now);
+
+    // two streams whose windows overlap
+    stream.set_positions({ make_position(0U), make_position(uint64_t{ PieceSize } * 10U) }, Now);
+    auto const deadlines = stream.deadlines(block_info_, HasNoPieces, Now);
+
+    auto pieces = std::set<tr_piece_index_t>{};
+    for (auto const& deadline : deadlines)
+    {
+        EXPECT_TRUE(pieces.insert(deadline.piece).second);
+    }
+    EXPECT_EQ(30U, std::size(pieces));
+
+    // and a shared piece keeps its earliest deadline
+    auto const it = std::find_if(
+        std::begin(deadlines),
+        std::end(deadlines),
+        [](auto const& deadline) { return deadline.piece == 12U; });
+    ASSERT_NE(std::end(deadlines), it);
+    EXPECT_EQ(2000, it->msec);
+}
+
+TEST_F(TorrentStreamTest, completedPiecesAreCounted)
+{
+    auto stream = make_stream(0U);
+
+    // piece 3 is due in 3 seconds and arrives in 1
+    stream.on_piece_completed(block_info_, 3U, Now + 1000U);
+    EXPECT_EQ(1U, stream.stats().pieces_on_time);
+    EXPECT_EQ(0U, stream.stats().pieces_late);
+
+    // piece 1 was due a second ago
+    stream.on_piece_completed(block_info_, 1U, Now + 2000U);
+    EXPECT_EQ(1U, stream.stats().pieces_on_time);
+    EXPECT_EQ(1U, stream.stats().pieces_late);
+
+    // pieces outside of the window don't count either way
+    stream.on_piece_completed(block_info_, 35U, Now + 2000U);
+    EXPECT_EQ(1U, stream.stats().pieces_on_time);
+    EXPECT_EQ(1U, stream.stats().pieces_late);
+
+    stream.on_duplicate_request();
+    EXPECT_EQ(1U, stream.stats().duplicate_requests);
+
+    // an empty position list stops streaming
+    stream.set_positions({}, Now);
+    EXPECT_FALSE(stream.is_active());
+    EXPECT_TRUE(std::empty(stream.deadlines(block_info_, HasNoPieces, Now)));
+}
+
+TEST_F(TorrentStreamTest, windowIsCachedBetweenPulses)
+{
+    auto stream = make_stream(0U);
+    auto deadlines = stream.deadlines(block_info_, HasNoPieces, Now);
+    ASSERT_EQ(tr_torrent_stream::WindowSecs, std::size(deadlines));
+
+    // inside the cache lifetime, the same window is reused with fresh deadlines
+    // and pieces that completed in the meantime are still left out
+    auto const later = Now + tr_torrent_stream::CandidatesTtlMsec - 1U;
+    deadlines = stream.deadlines(block_info_, [](tr_piece_index_t p) { return p == 0U; }, later);
+    ASSERT_EQ(tr_torrent_stream::WindowSecs - 1U, std::size(deadlines));
+    EXPECT_EQ(1U, deadlines.front().piece);
+    EXPECT_EQ(1000 - static_cast<int64_t>(later - Now), deadlines.front().msec);
+
+    // new positions take effect immediately
+    stream.set_positions({ make_position(uint64_t{ PieceSize } * 10U) }, later);
+    deadlines = stream.deadlines(block_info_, HasNoPieces, later);
+    ASSERT_FALSE(std::empty(deadlines));
+    EXPECT_EQ(10U, deadlines.front().piece);
+    EXPECT_EQ(0, deadlines.front().msec);
+}
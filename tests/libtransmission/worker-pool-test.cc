@@ -0,0 +1,93 @@
+// This file Copyright (C) 2024 Mnemosyne LLC.
+// It may be used under GPLv2 (SPDX: GPL-2.0-only), GPLv3 (SPDX: GPL-3.0-only),
+// or any future license endorsed by Mnemosyne LLC.
+// License text can be found in the licenses/ folder.
+
+#include <atomic>
+#include <chrono>
+#include <cstddef> // size_t
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include <libtransmission/worker-pool.h>
+
+#include "gtest/gtest.h"
+#include "test-fixtures.h"
+
+using namespace std::literals;
+
+namespace libtransmission::test
+{
+
+using WorkerPoolTest = ::testing::Test;
+
+TEST_F(WorkerPoolTest, runsAllWork)
+{
+    static auto constexpr NumJobs = size_t{ 100U };
+
+    auto pool = tr_worker_pool{ 3U };
+    auto n_done = std::atomic<size_t>{};
+
+    for (size_t i = 0; i < NumJobs; ++i)
+    {
+        pool.add([&n_done]() { ++n_done; });
+    }
+
+    EXPECT_TRUE(waitFor([&n_done]() { return n_done == NumJobs; }, 5s));
+}
+
+TEST_F(WorkerPoolTest, runsWorkOffCallingThread)
+{
+    auto pool = tr_worker_pool{ 2U };
+    auto mutex = std::mutex{};
+    auto thread_ids = std::set<std::thread::id>{};
+    auto n_done = std::atomic<size_t>{};
+
+    for (size_t i = 0; i < 4U; ++i)
+    {
+        pool.add(
+            [&]()
+            {
+                std::this_thread::sleep_for(50ms);
+                auto const lock = std::scoped_lock{ mutex };
+                thread_ids.insert(std::this_thread::get_id());
+                ++n_done;
+            });
+    }
+
+    EXPECT_TRUE(waitFor([&n_done]() { return n_done == 4U; }, 5s));
+
+    auto const lock = std::scoped_lock{ mutex };
+    EXPECT_EQ(0U, thread_ids.count(std::this_thread::get_id()));
+    EXPECT_LE(std::size(thread_ids), 2U);
+}
+
+TEST_F(WorkerPoolTest, destructorDiscardsPendingWork)
+{
+    auto started = std::atomic<bool>{};
+    auto n_done = std::atomic<size_t>{};
+
+    {
+        auto pool = tr_worker_pool{ 1U };
+        pool.add(
+            [&]()
+            {
+                started = true;
+                std::this_thread::sleep_for(100ms);
+                ++n_done;
+            });
+        for (size_t i = 0; i < 10U; ++i)
+        {
+            pool.add([&n_done]() { ++n_done; });
+        }
+
+        EXPECT_TRUE(waitFor([&started]() { return started.load(); }, 5s));
+    }
+
+    // the destructor waited for the running job,
+    // but the queued ones never got started
+    EXPECT_EQ(1U, n_done);
+}
+
+} // namespace libtransmission::test